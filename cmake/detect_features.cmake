@@ -59,6 +59,7 @@ check_symbol_exists(memrchr "string.h" SYSLOG_NG_HAVE_MEMRCHR)
 check_symbol_exists(strcasestr "string.h" SYSLOG_NG_HAVE_STRCASESTR)
 check_symbol_exists(pread "unistd.h" SYSLOG_NG_HAVE_PREAD)
 check_symbol_exists(pwrite "unistd.h" SYSLOG_NG_HAVE_PWRITE)
+check_function_exists(recvmmsg SYSLOG_NG_HAVE_RECVMMSG)
 check_symbol_exists(posix_fallocate "fcntl.h" SYSLOG_NG_HAVE_POSIX_FALLOCATE)
 check_symbol_exists(timezone time.h SYSLOG_NG_HAVE_TIMEZONE)
 
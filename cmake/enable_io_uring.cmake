@@ -0,0 +1,76 @@
+# ############################################################################
+# Copyright (c) 2026 Axoflow
+#
+# This library is free software; you can redistribute it and/or
+# modify it under the terms of the GNU Lesser General Public
+# License as published by the Free Software Foundation; either
+# version 2.1 of the License, or (at your option) any later version.
+#
+# This library is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+# Lesser General Public License for more details.
+#
+# You should have received a copy of the GNU Lesser General Public
+# License along with this library; if not, write to the Free Software
+# Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+#
+# As an additional exemption you are allowed to compile & link against the
+# OpenSSL libraries as published by the OpenSSL project. See the file
+# COPYING for details.
+#
+# ############################################################################
+
+set(ENABLE_IO_URING "AUTO" CACHE STRING "Enable io_uring based socket transport: ON, OFF, AUTO")
+set_property(CACHE ENABLE_IO_URING PROPERTY STRINGS AUTO ON OFF)
+message(STATUS "Checking io_uring support")
+
+if(ENABLE_IO_URING STREQUAL "OFF")
+  set(SYSLOG_NG_ENABLE_IO_URING OFF)
+  message(STATUS "  io_uring: disabled (forced OFF)")
+  return()
+endif()
+
+if(ENABLE_IO_URING STREQUAL "ON" AND NOT CMAKE_SYSTEM_NAME STREQUAL "Linux")
+  message(FATAL_ERROR "  io_uring can only be enabled on Linux systems.")
+endif()
+
+find_package(uring)
+
+# provided buffer rings (io_uring_setup_buf_ring) need liburing 2.4
+set(LIBURING_USABLE OFF)
+if(URING_FOUND)
+  include(CheckSymbolExists)
+  set(CMAKE_REQUIRED_INCLUDES ${URING_INCLUDE_DIR})
+  set(CMAKE_REQUIRED_LIBRARIES ${URING_LIBRARIES})
+  check_symbol_exists(io_uring_setup_buf_ring "liburing.h" LIBURING_HAS_BUF_RING)
+  unset(CMAKE_REQUIRED_INCLUDES)
+  unset(CMAKE_REQUIRED_LIBRARIES)
+  if(LIBURING_HAS_BUF_RING)
+    set(LIBURING_USABLE ON)
+  endif()
+endif()
+
+if("${ENABLE_IO_URING}" MATCHES "^(auto|AUTO)$")
+  if(LIBURING_USABLE)
+    set(SYSLOG_NG_ENABLE_IO_URING ON)
+    message(STATUS "  io_uring support: enabled (AUTO, found liburing)")
+  else()
+    set(SYSLOG_NG_ENABLE_IO_URING OFF)
+    message(STATUS "  io_uring support: disabled (AUTO, liburing >= 2.4 not found)")
+  endif()
+elseif(ENABLE_IO_URING STREQUAL "ON")
+  if(NOT LIBURING_USABLE)
+    message(FATAL_ERROR "Could not find liburing >= 2.4, and io_uring was explicitly enabled.")
+  endif()
+
+  set(SYSLOG_NG_ENABLE_IO_URING ON)
+  message(STATUS "  io_uring: enabled (forced ON)")
+else()
+  message(FATAL_ERROR "Invalid value (${ENABLE_IO_URING}) for ENABLE_IO_URING (must be ON, OFF, or AUTO)")
+endif()
+
+if(SYSLOG_NG_ENABLE_IO_URING)
+  set(IO_URING_INCLUDE_DIRS ${URING_INCLUDE_DIR})
+  set(IO_URING_LIBRARIES ${URING_LIBRARIES})
+endif()
@@ -31,6 +31,8 @@
 #include "metrics/metrics.h"
 #include "healthcheck/healthcheck-stats.h"
 #include "logmsg/logmsg.h"
+#include "logmsg/logmsg-slab.h"
+#include "logmsg/logmsg-intern.h"
 #include "logsource.h"
 #include "logwriter.h"
 #include "afinter.h"
@@ -236,6 +238,8 @@ app_startup(void)
   value_pairs_global_init();
   service_management_init();
   scratch_buffers_allocator_init();
+  log_msg_slab_thread_init();
+  log_msg_intern_thread_init();
   nondumpable_setlogger(nondumpable_allocator_msg_debug, nondumpable_allocator_msg_fatal);
   secret_storage_init();
   scratch_buffers_global_init();
@@ -275,6 +279,8 @@ app_shutdown(void)
   main_loop_thread_resource_deinit();
   secret_storage_deinit();
   scratch_buffers_allocator_deinit();
+  log_msg_intern_thread_deinit();
+  log_msg_slab_thread_deinit();
   scratch_buffers_global_deinit();
   value_pairs_global_deinit();
   log_template_global_deinit();
@@ -342,6 +348,8 @@ void
 app_thread_start(void)
 {
   scratch_buffers_allocator_init();
+  log_msg_slab_thread_init();
+  log_msg_intern_thread_init();
   dns_caching_thread_init();
   main_loop_call_thread_init();
   run_application_thread_init_hooks();
@@ -353,6 +361,8 @@ app_thread_stop(void)
   run_application_thread_deinit_hooks();
   main_loop_call_thread_deinit();
   dns_caching_thread_deinit();
+  log_msg_intern_thread_deinit();
+  log_msg_slab_thread_deinit();
   scratch_buffers_allocator_deinit();
   timeutils_cache_deinit();
 }
@@ -28,6 +28,7 @@
 #include "syslog-ng.h"
 
 #include "driver.h"
+#include "logqueue-fifo.h"
 #include "logreader.h"
 #include "logwriter.h"
 #include "logmatcher.h"
@@ -208,6 +208,9 @@
 %token KW_BATCH_LINES                 10087
 %token KW_BATCH_TIMEOUT               10088
 %token KW_TRIM_LARGE_MESSAGES         10089
+%token KW_LOG_MSG_SLAB                10098
+%token KW_ZERO_COPY_MIN_SIZE          10099
+%token KW_DGRAM_BATCH_SIZE            10101
 
 %token KW_STATS                       10400
 %token KW_FREQ                        10401
@@ -217,6 +220,7 @@
 %token KW_SYSLOG_STATS                10405
 %token KW_HEALTHCHECK_FREQ            10406
 %token KW_WORKER_PARTITION_KEY        10407
+%token KW_WORKER_STEALING             10408
 
 %token KW_CHAIN_HOSTNAMES             10090
 %token KW_NORMALIZE_HOSTNAMES         10091
@@ -249,11 +253,15 @@
 %token KW_FRAC_DIGITS                 10152
 
 %token KW_LOG_FIFO_SIZE               10160
+%token KW_LOG_MSG_INTERN              10161
 %token KW_LOG_FETCH_LIMIT             10162
 %token KW_LOG_IW_SIZE                 10163
 %token KW_LOG_PREFIX                  10164
 %token KW_PROGRAM_OVERRIDE            10165
 %token KW_HOST_OVERRIDE               10166
+%token KW_LOG_FIFO_SIZE_BYTES         10167
+%token KW_MEMORY_QUEUE_BUDGET         10168
+%token KW_MEMORY_QUEUE_BUDGET_POLICY  10169
 
 %token KW_THROTTLE                    10170
 %token KW_THREADED                    10171
@@ -261,6 +269,8 @@
 %token KW_PASS_UNIX_CREDENTIALS       10180
 %token KW_PERSIST_NAME                10181
 %token KW_USE_SYSLOGNG_PID            10182
+%token KW_PRIORITY_LANES              10183
+%token KW_PRIORITY_LANE_TEMPLATE      10184
 
 %token KW_READ_OLD_RECORDS            10185
 %token KW_IGNORE_SAVED_BOOKMARKS      10186
@@ -1065,10 +1075,19 @@ options_item
 	| KW_USE_RCPTID '(' yesno ')'		{ cfg_set_use_uniqid($3); }
 	| KW_USE_UNIQID '(' yesno ')'		{ cfg_set_use_uniqid($3); }
 	| KW_LOG_FIFO_SIZE '(' positive_integer ')'	{ configuration->log_fifo_size = $3; }
+	| KW_LOG_FIFO_SIZE_BYTES '(' nonnegative_integer64 ')'	{ configuration->log_fifo_size_bytes = $3; }
+	| KW_MEMORY_QUEUE_BUDGET '(' nonnegative_integer64 ')'	{ configuration->memory_queue_budget = $3; }
+	| KW_MEMORY_QUEUE_BUDGET_POLICY '(' string ')'
+	  {
+	    CHECK_ERROR(cfg_set_memory_queue_budget_policy(configuration, $3), @3, "Unknown memory-queue-budget-policy() \"%s\", expected flow-control or drop", $3);
+	    free($3);
+	  }
 	| KW_LOG_IW_SIZE '(' positive_integer ')'	{ msg_warning("WARNING: Support for the global log-iw-size() option was removed, please use a per-source log-iw-size()", cfg_lexer_format_location_tag(lexer, &@1)); }
 	| KW_LOG_FETCH_LIMIT '(' positive_integer ')'	{ msg_warning("WARNING: Support for the global log-fetch-limit() option was removed, please use a per-source log-fetch-limit()", cfg_lexer_format_location_tag(lexer, &@1)); }
 	| KW_LOG_MSG_SIZE '(' positive_integer ')'	{ configuration->log_msg_size = $3; }
 	| KW_TRIM_LARGE_MESSAGES '(' yesno ')'	{ configuration->trim_large_messages = $3; }
+	| KW_LOG_MSG_SLAB '(' yesno ')'	{ configuration->log_msg_slab = $3; }
+	| KW_LOG_MSG_INTERN '(' yesno ')'	{ configuration->log_msg_intern = $3; }
 	| KW_KEEP_TIMESTAMP '(' yesno ')'	{ configuration->keep_timestamp = $3; }
 	| KW_CREATE_DIRS '(' yesno ')'		{ configuration->create_dirs = $3; }
 	| KW_CUSTOM_DOMAIN '(' string ')'	{ configuration->custom_domain = g_strdup($3); free($3); }
@@ -1351,6 +1370,17 @@ dest_driver_option
         /* NOTE: plugins need to set "last_driver" in order to incorporate this rule in their grammar */
 
 	: KW_LOG_FIFO_SIZE '(' positive_integer ')'	{ ((LogDestDriver *) last_driver)->log_fifo_size = $3; }
+	| KW_LOG_FIFO_SIZE_BYTES '(' nonnegative_integer64 ')'	{ ((LogDestDriver *) last_driver)->log_fifo_size_bytes = $3; }
+	| KW_PRIORITY_LANES '(' positive_integer ')'
+	  {
+	    CHECK_ERROR($3 <= LOG_QUEUE_FIFO_MAX_LANES, @3, "priority-lanes() must be at most %d", LOG_QUEUE_FIFO_MAX_LANES);
+	    ((LogDestDriver *) last_driver)->priority_lanes = $3;
+	  }
+	| KW_PRIORITY_LANE_TEMPLATE '(' template_content ')'
+	  {
+	    log_template_unref(((LogDestDriver *) last_driver)->priority_lane_template);
+	    ((LogDestDriver *) last_driver)->priority_lane_template = $3;
+	  }
 	| KW_THROTTLE '(' nonnegative_integer ')'         { ((LogDestDriver *) last_driver)->throttle = $3; }
         | inner_dest
         | driver_option
@@ -1364,6 +1394,7 @@ threaded_dest_driver_batch_option
 threaded_dest_driver_workers_option
         : KW_WORKERS '(' positive_integer ')'  { log_threaded_dest_driver_set_num_workers(last_driver, $3); }
         | KW_WORKER_PARTITION_KEY '(' template_content ')' { log_threaded_dest_driver_set_worker_partition_key_ref(last_driver, $3); }
+        | KW_WORKER_STEALING '(' yesno ')' { log_threaded_dest_driver_set_worker_stealing(last_driver, $3); }
         ;
 
 /* implies dest_driver_option */
@@ -1465,6 +1496,8 @@ source_proto_option
           }
         | KW_LOG_MSG_SIZE '(' positive_integer ')'      { last_proto_server_options->super.max_msg_size = $3; }
         | KW_TRIM_LARGE_MESSAGES '(' yesno ')'          { last_proto_server_options->super.trim_large_messages = $3; }
+        | KW_ZERO_COPY_MIN_SIZE '(' nonnegative_integer ')' { last_proto_server_options->super.zero_copy_min_size = $3; }
+        | KW_DGRAM_BATCH_SIZE '(' positive_integer ')'  { last_proto_server_options->super.dgram_batch_size = $3; }
         | KW_IDLE_TIMEOUT '(' positive_integer ')'      { last_proto_server_options->super.idle_timeout = $3; }
         ;
 
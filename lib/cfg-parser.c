@@ -146,6 +146,11 @@ static CfgLexerKeyword main_keywords[] =
   { "log_level",          KW_LOG_LEVEL },
 
   { "log_fifo_size",      KW_LOG_FIFO_SIZE },
+  { "log_fifo_size_bytes", KW_LOG_FIFO_SIZE_BYTES },
+  { "priority_lanes",     KW_PRIORITY_LANES },
+  { "priority_lane_template", KW_PRIORITY_LANE_TEMPLATE },
+  { "memory_queue_budget", KW_MEMORY_QUEUE_BUDGET },
+  { "memory_queue_budget_policy", KW_MEMORY_QUEUE_BUDGET_POLICY },
   { "log_fetch_limit",    KW_LOG_FETCH_LIMIT },
   { "fetch_delay",        KW_LOG_FETCH_DELAY, KWS_OBSOLETE, "log_fetch_delay" },
   { "log_fetch_delay",    KW_LOG_FETCH_DELAY },
@@ -154,6 +159,10 @@ static CfgLexerKeyword main_keywords[] =
   { "log_iw_size",        KW_LOG_IW_SIZE },
   { "log_msg_size",       KW_LOG_MSG_SIZE },
   { "trim_large_messages", KW_TRIM_LARGE_MESSAGES },
+  { "zero_copy_min_size", KW_ZERO_COPY_MIN_SIZE },
+  { "dgram_batch_size",   KW_DGRAM_BATCH_SIZE },
+  { "log_msg_slab",       KW_LOG_MSG_SLAB },
+  { "log_msg_intern",     KW_LOG_MSG_INTERN },
   { "idle_timeout",       KW_IDLE_TIMEOUT },
   { "log_prefix",         KW_LOG_PREFIX, KWS_OBSOLETE, "program_override" },
   { "program_override",   KW_PROGRAM_OVERRIDE },
@@ -190,6 +199,7 @@ static CfgLexerKeyword main_keywords[] =
   { "retries",            KW_RETRIES },
   { "workers",            KW_WORKERS },
   { "worker_partition_key", KW_WORKER_PARTITION_KEY },
+  { "worker_stealing",    KW_WORKER_STEALING },
   { "parallelize",        KW_PARALLELIZE },
   { "partitions",         KW_PARTITIONS, KWS_OBSOLETE, "workers" },
   { "partition_key",      KW_PARTITION_KEY, KWS_OBSOLETE, "worker_partition_key" },
@@ -31,6 +31,9 @@
 #include "template/templates.h"
 #include "userdb.h"
 #include "logmsg/logmsg.h"
+#include "logmsg/logmsg-slab.h"
+#include "logmsg/logmsg-intern.h"
+#include "logqueue-fifo.h"
 #include "dnscache.h"
 #include "serialize.h"
 #include "plugin.h"
@@ -120,6 +123,18 @@ cfg_set_log_level(GlobalConfig *self, const gchar *log_level)
   return TRUE;
 }
 
+gboolean
+cfg_set_memory_queue_budget_policy(GlobalConfig *self, const gchar *policy)
+{
+  if (strcmp(policy, "flow-control") == 0 || strcmp(policy, "flow_control") == 0)
+    self->memory_queue_budget_policy = LQF_MEMORY_BUDGET_FLOW_CONTROL;
+  else if (strcmp(policy, "drop") == 0)
+    self->memory_queue_budget_policy = LQF_MEMORY_BUDGET_DROP;
+  else
+    return FALSE;
+  return TRUE;
+}
+
 static void
 _invoke_module_init(gchar *key, ModuleConfig *mc, gpointer *args)
 {
@@ -317,6 +332,10 @@ cfg_init(GlobalConfig *cfg)
   if (!rcptid_init(cfg->state, cfg->use_uniqid))
     return FALSE;
 
+  log_msg_slab_set_enabled(cfg->log_msg_slab);
+  log_msg_intern_set_enabled(cfg->log_msg_intern);
+  log_queue_fifo_set_memory_budget(cfg->memory_queue_budget, cfg->memory_queue_budget_policy);
+
   stats_reinit(&cfg->stats_options);
 
   dns_caching_update_options(&cfg->dns_cache_options);
@@ -471,6 +490,9 @@ cfg_new(gint version)
   self->time_reap = 60;
 
   self->log_fifo_size = 10000;
+  self->log_fifo_size_bytes = 0;
+  self->memory_queue_budget = 0;
+  self->memory_queue_budget_policy = LQF_MEMORY_BUDGET_FLOW_CONTROL;
   self->log_msg_size = 65536;
 
   file_perm_options_global_defaults(&self->file_perm_options);
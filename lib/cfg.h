@@ -95,8 +95,13 @@ struct _GlobalConfig
   gint type_cast_strictness;
 
   gint log_fifo_size;
+  gint64 log_fifo_size_bytes;
+  gint64 memory_queue_budget;
+  gint memory_queue_budget_policy;
   gint log_msg_size;
   gboolean trim_large_messages;
+  gboolean log_msg_slab;
+  gboolean log_msg_intern;
   gint log_level;
 
   gboolean create_dirs;
@@ -144,6 +149,7 @@ void cfg_bad_hostname_set(GlobalConfig *self, gchar *bad_hostname_re);
 gint cfg_lookup_mark_mode(const gchar *mark_mode);
 void cfg_set_mark_mode(GlobalConfig *self, const gchar *mark_mode);
 gboolean cfg_set_log_level(GlobalConfig *self, const gchar *log_level);
+gboolean cfg_set_memory_queue_budget_policy(GlobalConfig *self, const gchar *policy);
 
 gint cfg_tz_convert_value(gchar *convert);
 gint cfg_ts_format_value(gchar *format);
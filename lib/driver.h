@@ -173,6 +173,9 @@ struct _LogDestDriver
   GList *queues;
 
   gint log_fifo_size;
+  gint64 log_fifo_size_bytes;
+  gint priority_lanes;
+  LogTemplate *priority_lane_template;
   gint throttle;
   StatsCounterItem *queued_global_messages;
 };
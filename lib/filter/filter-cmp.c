@@ -115,14 +115,14 @@ _evaluate_comparison(FilterCmp *self, gint cmp)
  *
  */
 static void
-_convert_to_number(const GString *value, LogMessageValueType type, GenericNumber *number)
+_convert_to_number(const gchar *value, LogMessageValueType type, GenericNumber *number)
 {
   switch (type)
     {
     case LM_VT_STRING:
     case LM_VT_INTEGER:
     case LM_VT_DOUBLE:
-      if (!parse_generic_number(value->str, number))
+      if (!parse_generic_number(value, number))
         gn_set_nan(number);
       break;
     case LM_VT_JSON:
@@ -138,7 +138,7 @@ _convert_to_number(const GString *value, LogMessageValueType type, GenericNumber
     {
       gboolean b;
 
-      if (type_cast_to_boolean(value->str, -1, &b, NULL))
+      if (type_cast_to_boolean(value, -1, &b, NULL))
         gn_set_int64(number, b);
       else
         gn_set_int64(number, 0);
@@ -148,7 +148,7 @@ _convert_to_number(const GString *value, LogMessageValueType type, GenericNumber
     {
       gint64 msec;
 
-      if (type_cast_to_datetime_msec(value->str, -1, &msec, NULL))
+      if (type_cast_to_datetime_msec(value, -1, &msec, NULL))
         gn_set_int64(number, msec);
       else
         gn_set_int64(number, 0);
@@ -159,6 +159,26 @@ _convert_to_number(const GString *value, LogMessageValueType type, GenericNumber
     }
 }
 
+static gboolean
+_evaluate_numbers(FilterCmp *self, const GenericNumber *l, const GenericNumber *r)
+{
+  if (gn_is_nan(l) || gn_is_nan(r))
+    {
+      /* NaN == NaN is false */
+      /* NaN > NaN is false */
+      /* NaN < NaN is false */
+      /* NaN != NaN is true */
+
+      /* != is handled specially */
+      if ((self->compare_mode & (FCMP_LT + FCMP_GT)) == (FCMP_LT + FCMP_GT))
+        return TRUE;
+      /* if we have NaN on either side, we return FALSE in any comparisons */
+      return FALSE;
+    }
+
+  return _evaluate_comparison(self, gn_compare(l, r));
+}
+
 /*
  * The "new" 4.0 comparison operators have become type aware, e.g.  when
  * doing comparisons they consult with the types associated with the arguments.
@@ -215,24 +235,106 @@ _evaluate_typed(FilterCmp *self,
 
   /* ok, we need to convert to numbers and compare that way */
 
-  _convert_to_number(left, left_type, &l);
-  _convert_to_number(right, right_type, &r);
+  _convert_to_number(left->str, left_type, &l);
+  _convert_to_number(right->str, right_type, &r);
 
-  if (gn_is_nan(&l) || gn_is_nan(&r))
-    {
-      /* NaN == NaN is false */
-      /* NaN > NaN is false */
-      /* NaN < NaN is false */
-      /* NaN != NaN is true */
+  return _evaluate_numbers(self, &l, &r);
+}
 
-      /* != is handled specially */
-      if ((self->compare_mode & (FCMP_LT + FCMP_GT)) == (FCMP_LT + FCMP_GT))
-        return TRUE;
-      /* if we have NaN on either side, we return FALSE in any comparisons */
+/* the type a value stored in binary form is rendered and parsed as */
+static gboolean
+_is_native_kind_of_type(NVNativeKind kind, LogMessageValueType type)
+{
+  switch (kind)
+    {
+    case NVN_INT64:
+      return type == LM_VT_INTEGER;
+    case NVN_DOUBLE:
+      return type == LM_VT_DOUBLE;
+    case NVN_BOOLEAN:
+      return type == LM_VT_BOOLEAN;
+    case NVN_DATETIME_MSEC:
+      return type == LM_VT_DATETIME;
+    default:
       return FALSE;
     }
+}
 
-  return _evaluate_comparison(self, gn_compare(&l, &r));
+/* a value that was stored in binary form (e.g. by json-parser()) */
+static gboolean
+_get_native_operand(LogTemplate *template, LogMessage *msg, GenericNumber *number, LogMessageValueType *type)
+{
+  NVHandle handle;
+  NVNativeValue value;
+
+  if (!log_template_is_trivial(template) || log_template_is_literal_string(template))
+    return FALSE;
+
+  handle = log_template_get_trivial_value_handle(template);
+  if (!log_msg_get_native_value(msg, handle, &value, type))
+    return FALSE;
+
+  if (template->type_hint != LM_VT_NONE && template->type_hint != *type)
+    return FALSE;
+
+  /* any other type would be converted differently by _convert_to_number() */
+  if (!_is_native_kind_of_type(value.kind, *type))
+    return FALSE;
+
+  /* doubles are compared by their exact binary value, their "%f"
+   * rendering would round small values */
+  if (value.kind == NVN_DOUBLE)
+    {
+      if (isfinite(value.d))
+        gn_set_double(number, value.d, -1);
+      else
+        gn_set_nan(number);
+    }
+  else
+    {
+      gn_set_int64(number, value.i64);
+    }
+  return TRUE;
+}
+
+static gboolean
+_get_literal_operand(LogTemplate *template, LogMessage *msg, GenericNumber *number, LogMessageValueType *type)
+{
+  if (!log_template_is_trivial(template) || !log_template_is_literal_string(template))
+    return FALSE;
+
+  const gchar *value = log_template_get_trivial_value_and_type(template, msg, NULL, type);
+  _convert_to_number(value, *type, number);
+  return TRUE;
+}
+
+/*
+ * Fast path of type aware comparisons for values stored in binary form,
+ * compared to each other or to a literal: these are numbers (or booleans
+ * and datetimes that are compared as numbers), so we can skip formatting
+ * them as strings and parsing them back.  Returns FALSE if the slow path
+ * needs to be taken.
+ */
+static gboolean
+_evaluate_native(FilterCmp *self, LogMessage *msg, gboolean *result)
+{
+  GenericNumber l, r;
+  LogMessageValueType left_type, right_type;
+  gboolean left_native = _get_native_operand(self->left, msg, &l, &left_type);
+  gboolean right_native = _get_native_operand(self->right, msg, &r, &right_type);
+
+  if (!left_native && !right_native)
+    return FALSE;
+
+  if ((!left_native && !_get_literal_operand(self->left, msg, &l, &left_type)) ||
+      (!right_native && !_get_literal_operand(self->right, msg, &r, &right_type)))
+    return FALSE;
+
+  if (left_type == LM_VT_NULL || right_type == LM_VT_NULL)
+    return FALSE;
+
+  *result = _evaluate_numbers(self, &l, &r);
+  return TRUE;
 }
 
 static gboolean
@@ -277,6 +379,11 @@ fop_cmp_eval(FilterExprNode *s, LogMessage **msgs, gint num_msg, LogTemplateEval
 {
   FilterCmp *self = (FilterCmp *) s;
   LogMessageValueType left_type, right_type;
+  gboolean result;
+
+  if ((self->compare_mode & FCMP_TYPE_AWARE) && !trace_flag &&
+      _evaluate_native(self, msgs[num_msg - 1], &result))
+    return result ^ s->comp;
 
   ScratchBuffersMarker marker;
   GString *left_buf = scratch_buffers_alloc_and_mark(&marker);
@@ -285,7 +392,6 @@ fop_cmp_eval(FilterExprNode *s, LogMessage **msgs, gint num_msg, LogTemplateEval
   log_template_append_format_value_and_type_with_context(self->left, msgs, num_msg, options, left_buf, &left_type);
   log_template_append_format_value_and_type_with_context(self->right, msgs, num_msg, options, right_buf, &right_type);
 
-  gboolean result;
   if (self->compare_mode & FCMP_TYPE_AWARE)
     result = _evaluate_typed(self, left_buf, left_type, right_buf, right_type);
   else if (self->compare_mode & FCMP_STRING_BASED)
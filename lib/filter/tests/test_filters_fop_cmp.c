@@ -51,6 +51,10 @@ _construct_sample_message(void)
   log_msg_set_value_by_name_with_type(msg, "nullvalue", "", -1, LM_VT_NULL);
   log_msg_set_value_by_name_with_type(msg, "bytesvalue", "\0\1\2\3", 4, LM_VT_BYTES);
   log_msg_set_value_by_name_with_type(msg, "protobufvalue", "\4\5\6\7", 4, LM_VT_PROTOBUF);
+  log_msg_set_value_int64(msg, log_msg_get_value_handle("nativeint"), 32);
+  log_msg_set_value_double(msg, log_msg_get_value_handle("nativedbl"), 3.1415);
+  log_msg_set_value_boolean(msg, log_msg_get_value_handle("nativetrue"), TRUE);
+  log_msg_set_value_double(msg, log_msg_get_value_handle("nativetiny"), 1e-9);
   return msg;
 }
 
@@ -456,6 +460,26 @@ Test(filter, test_int32_and_int64_are_aliases_to_int)
   cr_assert(evaluate("int64(64) === int(64)"));
 }
 
+Test(filter, test_type_aware_comparison_of_native_values_matches_their_string_form)
+{
+  cr_assert(evaluate("'$nativeint' == 32"));
+  cr_assert(evaluate("'$nativeint' == '$int32value'"));
+  cr_assert(evaluate("'$nativeint' < '$int64value'"));
+  cr_assert(evaluate("'$nativedbl' > 3"));
+  cr_assert(evaluate("'$nativedbl' == '$dblvalue'"));
+  cr_assert(evaluate("'$nativetrue' == '$truevalue'"));
+  cr_assert(evaluate("'$nativetrue' == 1"));
+  cr_assert(evaluate("'$nativeint' != '$nanvalue'"));
+
+  cr_assert_not(evaluate("'$nativeint' == 33"));
+  cr_assert_not(evaluate("'$nativeint' == '$nanvalue'"));
+  cr_assert_not(evaluate("'$nativeint' == '$nullvalue'"));
+
+  /* doubles are compared by their binary value, not their "%f" rendering */
+  cr_assert_not(evaluate("'$nativetiny' == 0"));
+  cr_assert(evaluate("'$nativetiny' > 0"));
+}
+
 static void
 setup(void)
 {
@@ -0,0 +1,77 @@
+/*
+ * Copyright (c) 2026 Axoflow
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+#include "logmsg/logmsg-chunk.h"
+
+#include <string.h>
+
+LogMsgChunk *
+log_msg_chunk_new(gsize size)
+{
+  LogMsgChunk *self = g_malloc(sizeof(LogMsgChunk) + size);
+
+  g_atomic_counter_set(&self->ref_cnt, 1);
+  self->size = size;
+  return self;
+}
+
+/* Grow or shrink a chunk owned by the caller.  If the chunk is
+ * referenced by messages, the old chunk is left alone and a private copy
+ * is returned instead. */
+LogMsgChunk *
+log_msg_chunk_realloc(LogMsgChunk *self, gsize size)
+{
+  if (!self)
+    return log_msg_chunk_new(size);
+
+  if (log_msg_chunk_is_shared(self))
+    {
+      LogMsgChunk *new_chunk = log_msg_chunk_new(size);
+
+      memcpy(new_chunk->data, self->data, MIN(size, self->size));
+      log_msg_chunk_unref(self);
+      return new_chunk;
+    }
+
+  self = g_realloc(self, sizeof(LogMsgChunk) + size);
+  self->size = size;
+  return self;
+}
+
+LogMsgChunk *
+log_msg_chunk_ref(LogMsgChunk *self)
+{
+  g_assert(g_atomic_counter_get(&self->ref_cnt) > 0);
+  g_atomic_counter_inc(&self->ref_cnt);
+  return self;
+}
+
+void
+log_msg_chunk_unref(LogMsgChunk *self)
+{
+  if (!self)
+    return;
+
+  g_assert(g_atomic_counter_get(&self->ref_cnt) > 0);
+  if (g_atomic_counter_dec_and_test(&self->ref_cnt))
+    g_free(self);
+}
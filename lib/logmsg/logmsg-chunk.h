@@ -0,0 +1,71 @@
+/*
+ * Copyright (c) 2026 Axoflow
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#ifndef LOGMSG_CHUNK_H_INCLUDED
+#define LOGMSG_CHUNK_H_INCLUDED
+
+#include "syslog-ng.h"
+#include "atomic.h"
+
+/*
+ * A reference counted block of input data.
+ *
+ * Input buffers are allocated as chunks, so that LogMessage instances
+ * parsed from the buffer can reference their values right in the buffer
+ * instead of copying them into their NVTable.  The owner of the buffer
+ * must not modify the parts of a chunk that were already passed on as
+ * messages while the chunk is shared (e.g.  log_msg_chunk_is_shared()
+ * returns TRUE), it needs to allocate a new chunk instead.
+ *
+ * The reference counter is atomic, as messages are freed by arbitrary
+ * threads.  References are only added by the thread owning the buffer,
+ * so once log_msg_chunk_is_shared() returns FALSE, the owner has
+ * exclusive access to the chunk.
+ */
+typedef struct _LogMsgChunk
+{
+  GAtomicCounter ref_cnt;
+  gsize size;
+  guchar data[];
+} LogMsgChunk;
+
+LogMsgChunk *log_msg_chunk_new(gsize size);
+LogMsgChunk *log_msg_chunk_realloc(LogMsgChunk *self, gsize size);
+LogMsgChunk *log_msg_chunk_ref(LogMsgChunk *self);
+void log_msg_chunk_unref(LogMsgChunk *self);
+
+static inline gboolean
+log_msg_chunk_is_shared(LogMsgChunk *self)
+{
+  return g_atomic_counter_get(&self->ref_cnt) > 1;
+}
+
+static inline gboolean
+log_msg_chunk_contains(LogMsgChunk *self, gconstpointer p, gsize len)
+{
+  const guchar *start = (const guchar *) p;
+
+  return start >= self->data && len <= self->size && start - self->data <= self->size - len;
+}
+
+#endif
@@ -0,0 +1,420 @@
+/*
+ * Copyright (c) 2026 Axoflow
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+#include "logmsg/logmsg-intern.h"
+#include "logmsg/logmsg.h"
+#include "tls-support.h"
+#include "stats/stats-registry.h"
+#include "stats/stats-cluster-single.h"
+
+#include <string.h>
+
+/*
+ * Interned value dictionary
+ *
+ * Values like HOST, PROGRAM or the fields extracted by parsers repeat
+ * across a large number of messages.  Messages waiting in large memory
+ * queues each carry their own copy of these in their payload.
+ *
+ * With interning enabled, such values are stored once in a dictionary
+ * page and messages reference them as external NVTable entries, the same
+ * way values in the receive buffer are referenced (see
+ * log_msg_set_input_chunk()).
+ *
+ * Design:
+ *   - each thread has its own dictionary, so lookups need no locking.
+ *     The same value may be stored once per thread, that's fine.
+ *
+ *   - values are appended to a page (a LogMsgChunk) and are never
+ *     changed afterwards, so other threads can read them freely.  Messages
+ *     referencing values in a page hold a reference to the page.  A
+ *     message only references a single page, values that would need
+ *     another one are copied as usual.  Pages are kept small, as a single
+ *     message sitting in a queue keeps its entire page alive.
+ *
+ *   - once the page fills up, the dictionary drops its reference and
+ *     starts over with an empty page.  Values that were looked up while
+ *     in the old page are carried over to the new one, so the hot set
+ *     survives the switch.  The old page is freed with the last message
+ *     referencing it, there is no need for per-value reference counts or
+ *     eviction.
+ *
+ *   - values of the name-value pairs on the allowlist (HOST, PROGRAM and
+ *     the like) are always interned.  Others are only stored in the
+ *     dictionary while lookups hit often enough, so that unique values
+ *     (ids, timestamps) don't fill it up.
+ *
+ *   - the index is an open addressing hash table of offsets into the
+ *     page, each value is prefixed by its length and NUL terminated.
+ */
+
+#define LOG_MSG_INTERN_INDEX_SIZE          1024
+#define LOG_MSG_INTERN_MAX_VALUES          (LOG_MSG_INTERN_INDEX_SIZE / 2)
+#define LOG_MSG_INTERN_STATS_FLUSH_INTERVAL  1024
+
+/* the hit rate of values not on the allowlist is measured over roughly
+ * this many lookups, they are stored while at least one in
+ * LOG_MSG_INTERN_LOOKUPS_PER_HIT lookups is a hit */
+#define LOG_MSG_INTERN_HIT_RATE_WINDOW     1024
+#define LOG_MSG_INTERN_LOOKUPS_PER_HIT     4
+
+/* below that hit rate every LOG_MSG_INTERN_PROBE_INTERVAL-th miss is
+ * stored anyway, so that the rate can recover once values start to
+ * repeat */
+#define LOG_MSG_INTERN_PROBE_INTERVAL      64
+
+typedef struct _LogMsgInternDict
+{
+  LogMsgChunk *page;
+  gsize page_used;
+  gint num_values;
+
+  /* hit rate of the values not on the allowlist */
+  gint lookups;
+  gint hits;
+  gint misses_since_probe;
+
+  /* offset + 1 of the length prefix in the page, 0 for an empty slot */
+  guint32 index[LOG_MSG_INTERN_INDEX_SIZE];
+  /* whether the value was looked up since it was stored in this page */
+  guint8 hot[LOG_MSG_INTERN_INDEX_SIZE];
+} LogMsgInternDict;
+
+TLS_BLOCK_START
+{
+  gboolean log_msg_intern_thread_registered;
+  LogMsgInternDict *log_msg_intern_dict;
+  gint log_msg_intern_pending_hits;
+  gssize log_msg_intern_pending_bytes_saved;
+}
+TLS_BLOCK_END;
+
+#define log_msg_intern_thread_registered    __slng_tls_deref(log_msg_intern_thread_registered)
+#define log_msg_intern_dict                 __slng_tls_deref(log_msg_intern_dict)
+#define log_msg_intern_pending_hits         __slng_tls_deref(log_msg_intern_pending_hits)
+#define log_msg_intern_pending_bytes_saved  __slng_tls_deref(log_msg_intern_pending_bytes_saved)
+
+static gboolean log_msg_intern_enabled = FALSE;
+
+static StatsCounterItem *count_intern_hits;
+static StatsCounterItem *count_intern_bytes_saved;
+static StatsCounterItem *count_intern_dictionary_bytes;
+
+static void
+_flush_stats(void)
+{
+  stats_counter_add(count_intern_hits, log_msg_intern_pending_hits);
+  stats_counter_add(count_intern_bytes_saved, log_msg_intern_pending_bytes_saved);
+  log_msg_intern_pending_hits = 0;
+  log_msg_intern_pending_bytes_saved = 0;
+}
+
+/* a direct entry would store the value, an external one a pointer, the
+ * name is stored the same way in both */
+static inline gssize
+_payload_bytes_saved(gsize value_len)
+{
+  return (gssize) NV_ENTRY_DIRECT_SIZE(0, value_len) - (gssize) NV_ENTRY_EXTERNAL_SIZE(0);
+}
+
+static inline void
+_account_hit(gsize value_len)
+{
+  log_msg_intern_pending_hits++;
+  log_msg_intern_pending_bytes_saved += _payload_bytes_saved(value_len);
+  if (log_msg_intern_pending_hits >= LOG_MSG_INTERN_STATS_FLUSH_INTERVAL)
+    _flush_stats();
+}
+
+/* storing a value costs its copy in the page, misses that are not stored
+ * cost nothing but the lookup */
+static inline void
+_account_store(gsize value_len)
+{
+  log_msg_intern_pending_bytes_saved -= value_len + 2;
+}
+
+static inline gboolean
+_is_handle_on_allowlist(NVHandle handle)
+{
+  /* these repeat across all messages of the same sender */
+  return handle == LM_V_HOST ||
+         handle == LM_V_HOST_FROM ||
+         handle == LM_V_PROGRAM ||
+         handle == LM_V_MSGID;
+}
+
+static inline guint32
+_hash_value(const gchar *value, gsize value_len)
+{
+  /* FNV-1a */
+  guint32 hash = 2166136261U;
+
+  for (gsize i = 0; i < value_len; i++)
+    {
+      hash ^= (guchar) value[i];
+      hash *= 16777619U;
+    }
+  return hash;
+}
+
+static const gchar *
+_dict_store(LogMsgInternDict *self, guint32 slot, const gchar *value, gsize value_len)
+{
+  guchar *entry = self->page->data + self->page_used;
+
+  entry[0] = value_len;
+  memcpy(&entry[1], value, value_len);
+  entry[value_len + 1] = 0;
+
+  self->index[slot] = self->page_used + 1;
+  self->hot[slot] = FALSE;
+  self->page_used += value_len + 2;
+  self->num_values++;
+  _account_store(value_len);
+  return (const gchar *) &entry[1];
+}
+
+/* returns the slot of @value or the empty slot it should be stored in */
+static guint32
+_dict_find_slot(LogMsgInternDict *self, const gchar *value, gsize value_len)
+{
+  guint32 mask = LOG_MSG_INTERN_INDEX_SIZE - 1;
+  guint32 i = _hash_value(value, value_len) & mask;
+
+  /* the table is at most half full, so there's always an empty slot */
+  while (self->index[i])
+    {
+      const guchar *entry = self->page->data + self->index[i] - 1;
+
+      if (entry[0] == value_len && memcmp(&entry[1], value, value_len) == 0)
+        return i;
+      i = (i + 1) & mask;
+    }
+  return i;
+}
+
+static inline const gchar *
+_dict_get_value(LogMsgInternDict *self, guint32 slot)
+{
+  if (!self->index[slot])
+    return NULL;
+  return (const gchar *) self->page->data + self->index[slot];
+}
+
+static void
+_dict_start_new_page(LogMsgInternDict *self)
+{
+  LogMsgChunk *old_page = self->page;
+  guint32 old_index[LOG_MSG_INTERN_INDEX_SIZE];
+  guint8 old_hot[LOG_MSG_INTERN_INDEX_SIZE];
+
+  memcpy(old_index, self->index, sizeof(old_index));
+  memcpy(old_hot, self->hot, sizeof(old_hot));
+
+  self->page = log_msg_chunk_new(LOG_MSG_INTERN_PAGE_SIZE);
+  self->page_used = 0;
+  self->num_values = 0;
+  memset(self->index, 0, sizeof(self->index));
+  memset(self->hot, 0, sizeof(self->hot));
+  stats_counter_add(count_intern_dictionary_bytes, LOG_MSG_INTERN_PAGE_SIZE);
+
+  if (!old_page)
+    return;
+
+  /* the values that were hit are likely to be hit again, carry over at
+   * most half a page of them to leave room for new ones */
+  for (gint i = 0; i < LOG_MSG_INTERN_INDEX_SIZE; i++)
+    {
+      if (!old_index[i] || !old_hot[i])
+        continue;
+
+      const guchar *entry = old_page->data + old_index[i] - 1;
+      const gchar *value = (const gchar *) &entry[1];
+      gsize value_len = entry[0];
+
+      if (self->num_values >= LOG_MSG_INTERN_MAX_VALUES / 2 ||
+          self->page_used + value_len + 2 > self->page->size / 2)
+        break;
+
+      _dict_store(self, _dict_find_slot(self, value, value_len), value, value_len);
+    }
+
+  log_msg_chunk_unref(old_page);
+  stats_counter_sub(count_intern_dictionary_bytes, LOG_MSG_INTERN_PAGE_SIZE);
+}
+
+static LogMsgInternDict *
+_dict_new(void)
+{
+  LogMsgInternDict *self = g_new0(LogMsgInternDict, 1);
+
+  _dict_start_new_page(self);
+  return self;
+}
+
+static void
+_dict_free(LogMsgInternDict *self)
+{
+  /* messages may still reference the page, they keep it alive */
+  log_msg_chunk_unref(self->page);
+  stats_counter_sub(count_intern_dictionary_bytes, LOG_MSG_INTERN_PAGE_SIZE);
+  g_free(self);
+}
+
+static inline gboolean
+_dict_has_room_for(LogMsgInternDict *self, gsize value_len)
+{
+  return self->num_values < LOG_MSG_INTERN_MAX_VALUES &&
+         self->page_used + value_len + 2 <= self->page->size;
+}
+
+static inline void
+_dict_track_hit_rate(LogMsgInternDict *self, gboolean hit)
+{
+  if (self->lookups >= LOG_MSG_INTERN_HIT_RATE_WINDOW)
+    {
+      self->lookups /= 2;
+      self->hits /= 2;
+    }
+  self->lookups++;
+  if (hit)
+    self->hits++;
+}
+
+static inline gboolean
+_dict_should_store_missed_value(LogMsgInternDict *self)
+{
+  /* don't judge the rate until it has seen a few lookups */
+  if (self->lookups < LOG_MSG_INTERN_PROBE_INTERVAL ||
+      self->hits * LOG_MSG_INTERN_LOOKUPS_PER_HIT >= self->lookups)
+    return TRUE;
+
+  if (++self->misses_since_probe < LOG_MSG_INTERN_PROBE_INTERVAL)
+    return FALSE;
+  self->misses_since_probe = 0;
+  return TRUE;
+}
+
+/*
+ * Returns the interned copy of @value, or NULL if it cannot be interned.
+ * @page is the page the caller already references (or NULL), the value is
+ * only interned if it can be stored in the same page.  On success @page
+ * is set to the page holding the value, the caller needs to take a
+ * reference to it, unless it already holds one.
+ */
+const gchar *
+log_msg_intern_value(NVHandle handle, const gchar *value, gsize value_len, LogMsgChunk **page)
+{
+  if (!log_msg_intern_enabled || !log_msg_intern_thread_registered)
+    return NULL;
+
+  if (value_len < LOG_MSG_INTERN_MIN_SIZE || value_len > LOG_MSG_INTERN_MAX_SIZE)
+    return NULL;
+
+  /* allocated on first use, so that threads pay nothing while interning is disabled */
+  if (!log_msg_intern_dict)
+    log_msg_intern_dict = _dict_new();
+
+  LogMsgInternDict *self = log_msg_intern_dict;
+
+  if (*page && *page != self->page)
+    return NULL;
+
+  gboolean on_allowlist = _is_handle_on_allowlist(handle);
+  guint32 slot = _dict_find_slot(self, value, value_len);
+  const gchar *interned = _dict_get_value(self, slot);
+
+  if (!on_allowlist)
+    _dict_track_hit_rate(self, interned != NULL);
+
+  if (interned)
+    {
+      self->hot[slot] = TRUE;
+      _account_hit(value_len);
+      *page = self->page;
+      return interned;
+    }
+
+  if (!on_allowlist && !_dict_should_store_missed_value(self))
+    return NULL;
+
+  if (!_dict_has_room_for(self, value_len))
+    {
+      /* the new page would not be the one the caller references */
+      if (*page)
+        return NULL;
+
+      _dict_start_new_page(self);
+      slot = _dict_find_slot(self, value, value_len);
+    }
+
+  *page = self->page;
+  return _dict_store(self, slot, value, value_len);
+}
+
+void
+log_msg_intern_set_enabled(gboolean enabled)
+{
+  log_msg_intern_enabled = enabled;
+}
+
+gboolean
+log_msg_intern_is_enabled(void)
+{
+  return log_msg_intern_enabled;
+}
+
+void
+log_msg_intern_thread_init(void)
+{
+  log_msg_intern_thread_registered = TRUE;
+}
+
+void
+log_msg_intern_thread_deinit(void)
+{
+  log_msg_intern_thread_registered = FALSE;
+  if (log_msg_intern_dict)
+    {
+      _dict_free(log_msg_intern_dict);
+      log_msg_intern_dict = NULL;
+    }
+  _flush_stats();
+}
+
+void
+log_msg_intern_register_stats(void)
+{
+  StatsClusterKey sc_key;
+
+  stats_lock();
+  stats_cluster_single_key_set(&sc_key, "events_interned_values_total", NULL, 0);
+  stats_register_counter(1, &sc_key, SC_TYPE_SINGLE_VALUE, &count_intern_hits);
+
+  stats_cluster_single_key_set(&sc_key, "events_interned_bytes_saved_total", NULL, 0);
+  stats_register_counter(1, &sc_key, SC_TYPE_SINGLE_VALUE, &count_intern_bytes_saved);
+
+  stats_cluster_single_key_set(&sc_key, "events_intern_dictionary_bytes", NULL, 0);
+  stats_register_counter(1, &sc_key, SC_TYPE_SINGLE_VALUE, &count_intern_dictionary_bytes);
+  stats_unlock();
+}
@@ -0,0 +1,47 @@
+/*
+ * Copyright (c) 2026 Axoflow
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#ifndef LOGMSG_INTERN_H_INCLUDED
+#define LOGMSG_INTERN_H_INCLUDED
+
+#include "syslog-ng.h"
+#include "logmsg/logmsg-chunk.h"
+#include "logmsg/nvtable.h"
+
+/* shorter values would take more room in the payload as an external entry
+ * than as a direct one */
+#define LOG_MSG_INTERN_MIN_SIZE   (NV_ENTRY_EXTERNAL_HDR - NV_ENTRY_DIRECT_HDR)
+#define LOG_MSG_INTERN_MAX_SIZE   255
+#define LOG_MSG_INTERN_PAGE_SIZE  (16 * 1024)
+
+const gchar *log_msg_intern_value(NVHandle handle, const gchar *value, gsize value_len, LogMsgChunk **page);
+
+void log_msg_intern_set_enabled(gboolean enabled);
+gboolean log_msg_intern_is_enabled(void);
+
+void log_msg_intern_thread_init(void);
+void log_msg_intern_thread_deinit(void);
+
+void log_msg_intern_register_stats(void);
+
+#endif
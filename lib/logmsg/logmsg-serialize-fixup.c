@@ -272,6 +272,12 @@ _update_entry(LogMessageSerializationState *state, NVEntry *entry)
        * adding new flags easier. */
       entry->flags = entry->flags & NVENTRY_FLAGS_DEFINED_IN_LEGACY_FORMATS;
     }
+
+  /* these are compacted into direct entries before serialization, an
+   * external one would point outside of the table */
+  if (entry->external || entry->native)
+    return FALSE;
+
   if (!entry->type_present)
     {
       entry->type_present = TRUE;
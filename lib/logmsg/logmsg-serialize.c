@@ -79,10 +79,19 @@ _serialize_message(LogMessageSerializationState *state)
   serialize_write_uint8(sa, msg->alloc_sdata);
   serialize_write_uint32_array(sa, (guint32 *) msg->sdata, msg->num_sdata);
 
-  if (state->flags & LMSF_COMPACTION)
-    nv_table_serialize_with_compaction(state, msg->payload);
+  /* the overlay of a clone is merged with the shared payload, so that
+   * the message is deserialized as a single NVTable */
+  NVTable *payload = msg->payload_base ? log_msg_flatten_payload(msg) : msg->payload;
+
+  /* values referencing the input buffer or stored in binary form have to
+   * be copied into the serialized payload, compaction takes care of that */
+  if ((state->flags & LMSF_COMPACTION) || nv_table_has_unserializable_entries(payload))
+    nv_table_serialize_with_compaction(state, payload);
   else
-    nv_table_serialize(state, msg->payload);
+    nv_table_serialize(state, payload);
+
+  if (payload != msg->payload)
+    nv_table_unref(payload);
   return TRUE;
 }
 
@@ -105,6 +114,50 @@ log_msg_serialize(LogMessage *self, SerializeArchive *sa, guint32 flags)
   return log_msg_serialize_with_ts_processed(self, sa, NULL, flags);
 }
 
+static gboolean
+_serialize_message_compact(LogMessageSerializationState *state)
+{
+  LogMessage *msg = state->msg;
+  SerializeArchive *sa = state->sa;
+  UnixTime timestamps[LM_TS_MAX];
+
+  memcpy(&timestamps, msg->timestamps, LM_TS_MAX * sizeof(UnixTime));
+  _setup_ts_processed(timestamps, state->processed);
+
+  serialize_write_uint8(sa, state->version);
+  serialize_write_varint(sa, msg->rcptid);
+  serialize_write_varint(sa, msg->flags & ~LF_STATE_MASK);
+  serialize_write_varint(sa, msg->pri);
+  serialize_write_varint(sa, msg->host_id);
+  g_sockaddr_serialize(sa, msg->saddr);
+  timestamp_serialize_compact(sa, timestamps);
+  tags_serialize_compact(msg, sa);
+  serialize_write_uint8(sa, msg->initial_parse);
+  serialize_write_uint8(sa, msg->num_matches);
+  serialize_write_uint8(sa, msg->num_sdata);
+
+  NVTable *payload = msg->payload_base ? log_msg_flatten_payload(msg) : msg->payload;
+  gboolean success = nv_table_serialize_compact(state, payload);
+
+  if (payload != msg->payload)
+    nv_table_unref(payload);
+  return success;
+}
+
+/* @name_dict may be NULL, in which case the names of all dynamic values
+ * are stored in the message itself */
+gboolean
+log_msg_serialize_compact(LogMessage *self, SerializeArchive *sa, NVNameDict *name_dict)
+{
+  LogMessageSerializationState state = { 0 };
+
+  state.version = LGM_V27;
+  state.msg = self;
+  state.sa = sa;
+  state.name_dict = name_dict;
+  return _serialize_message_compact(&state);
+}
+
 static gboolean
 _deserialize_sdata(LogMessageSerializationState *state)
 {
@@ -207,6 +260,45 @@ _deserialize_message_version_2x(LogMessageSerializationState *state)
   return TRUE;
 }
 
+static gboolean
+_deserialize_message_version_27(LogMessageSerializationState *state)
+{
+  LogMessage *msg = state->msg;
+  SerializeArchive *sa = state->sa;
+  guint32 pri;
+  guint8 initial_parse, num_matches, num_sdata;
+
+  if (!serialize_read_varint(sa, &msg->rcptid))
+    return FALSE;
+  if (!serialize_read_varint32(sa, &msg->flags))
+    return FALSE;
+  msg->flags |= LF_STATE_MASK;
+  if (!serialize_read_varint32(sa, &pri) || pri > G_MAXUINT16)
+    return FALSE;
+  msg->pri = pri;
+  if (!serialize_read_varint32(sa, &msg->host_id))
+    return FALSE;
+  if (!g_sockaddr_deserialize(sa, &msg->saddr))
+    return FALSE;
+  if (!timestamp_deserialize_compact(sa, msg->timestamps))
+    return FALSE;
+  if (!tags_deserialize_compact(msg, sa))
+    return FALSE;
+
+  if (!serialize_read_uint8(sa, &initial_parse) ||
+      !serialize_read_uint8(sa, &num_matches) ||
+      !serialize_read_uint8(sa, &num_sdata))
+    return FALSE;
+  msg->initial_parse = initial_parse;
+
+  /* values are added one by one, so there is nothing to fix up afterwards */
+  if (!nv_table_deserialize_compact(state, num_sdata))
+    return FALSE;
+
+  msg->num_matches = num_matches;
+  return TRUE;
+}
+
 static gboolean
 log_msg_read_tags(LogMessage *self, SerializeArchive *sa)
 {
@@ -499,7 +591,7 @@ _check_msg_version(LogMessageSerializationState *state)
   if (!serialize_read_uint8(state->sa, &state->version))
     return FALSE;
 
-  if (state->version < LGM_V10 || state->version > LGM_V26)
+  if (state->version < LGM_V10 || state->version > LGM_V27)
     {
       msg_error("Error deserializing log message, unsupported version",
                 evt_tag_int("version", state->version));
@@ -508,13 +600,16 @@ _check_msg_version(LogMessageSerializationState *state)
   return TRUE;
 }
 
+/* @name_dict is the dictionary the message was serialized with, only
+ * used by the compact format */
 gboolean
-log_msg_deserialize(LogMessage *self, SerializeArchive *sa)
+log_msg_deserialize_with_names(LogMessage *self, SerializeArchive *sa, NVNameDict *name_dict)
 {
   LogMessageSerializationState state = { 0 };
 
   state.sa = sa;
   state.msg = self;
+  state.name_dict = name_dict;
   if (!_check_msg_version(&state))
     {
       return FALSE;
@@ -523,5 +618,14 @@ log_msg_deserialize(LogMessage *self, SerializeArchive *sa)
   if (state.version < LGM_V20)
     return _deserialize_message_version_1x(&state);
 
+  if (state.version == LGM_V27)
+    return _deserialize_message_version_27(&state);
+
   return _deserialize_message_version_2x(&state);
 }
+
+gboolean
+log_msg_deserialize(LogMessage *self, SerializeArchive *sa)
+{
+  return log_msg_deserialize_with_names(self, sa, NULL);
+}
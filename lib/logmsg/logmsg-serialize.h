@@ -27,6 +27,7 @@
 #define LOGMSG_SERIALIZE_H
 
 #include "serialize.h"
+#include "logmsg/serialization.h"
 #include "timeutils/unixtime.h"
 
 /*
@@ -48,6 +49,8 @@
  *   24      new processed timestamp
  *   25      added hostid
  *   26      use 32 bit values nvtable
+ *   27      compact format: varint integers, no unused space, names of
+ *           dynamic values in a per-file dictionary
  */
 
 enum _LogMessageVersion
@@ -62,7 +65,8 @@ enum _LogMessageVersion
   LGM_V23 = 23,
   LGM_V24 = 24,
   LGM_V25 = 25,
-  LGM_V26 = 26
+  LGM_V26 = 26,
+  LGM_V27 = 27
 };
 
 enum _LogMessageSerializationFlags
@@ -75,4 +79,7 @@ gboolean log_msg_serialize_with_ts_processed(LogMessage *self, SerializeArchive
                                              guint32 flags);
 gboolean log_msg_serialize(LogMessage *self, SerializeArchive *sa, guint32 flags);
 
+gboolean log_msg_serialize_compact(LogMessage *self, SerializeArchive *sa, NVNameDict *name_dict);
+gboolean log_msg_deserialize_with_names(LogMessage *self, SerializeArchive *sa, NVNameDict *name_dict);
+
 #endif
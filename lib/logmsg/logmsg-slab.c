@@ -0,0 +1,481 @@
+/*
+ * Copyright (c) 2026 Axoflow
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+#include "logmsg/logmsg-slab.h"
+#include "tls-support.h"
+#include "stats/stats-registry.h"
+#include "stats/stats-cluster-single.h"
+
+#include <string.h>
+
+/*
+ * Per-thread slab allocator for LogMessage instances and NVTable payloads
+ *
+ * LogMessage structures (with their embedded payload) and NVTable
+ * payloads are allocated and freed at a very high rate, on the order of
+ * several allocations per message.  Going to the general purpose heap for
+ * each of these makes malloc one of the top symbols in profiles and
+ * fragments memory in long running processes.
+ *
+ * This allocator keeps a per-thread cache of free blocks in a handful of
+ * power-of-two size classes.  Allocation and freeing by the owner thread
+ * is a simple singly linked list operation, without any locking or atomic
+ * operations.
+ *
+ * Design:
+ *   - each block is prefixed by a small header that tells the size class
+ *     and the cache (thread) that originally allocated it.  Requests larger
+ *     than the largest size class, requests made while the allocator is
+ *     disabled and requests made by threads that never registered with
+ *     log_msg_slab_thread_init() are served by the heap, but still get a
+ *     header, so log_msg_slab_free() can always tell where to return the
+ *     block.
+ *
+ *   - a block freed by a thread other than its owner is pushed to the
+ *     owner's "remote free" list, using a lock-free stack push.  The owner
+ *     grabs the entire list with a single atomic exchange once its local
+ *     free list runs empty, thus there's no ABA problem.
+ *
+ *   - the amount of memory held in free lists is capped per size class,
+ *     blocks over the limit are released to the heap.
+ *
+ *   - a cache is reference counted: the owner thread holds a reference and
+ *     so does each block allocated from it, until it is released to the
+ *     heap.  Once the owner thread exits, the cache is marked orphaned and
+ *     remote frees release their blocks right away, the cache itself is
+ *     freed with the last block.
+ *
+ *   - hit/miss counters are accumulated in thread-local variables and
+ *     published to the stats subsystem in batches, so that the fast path
+ *     does not touch shared cache lines.
+ */
+
+#define LOG_MSG_SLAB_HEAP_CLASS            0xFF
+#define LOG_MSG_SLAB_MAX_CACHED_BYTES      (1024 * 1024)
+#define LOG_MSG_SLAB_STATS_FLUSH_INTERVAL  1024
+
+typedef struct _LogMsgSlabCache LogMsgSlabCache;
+
+typedef union _LogMsgSlabHeader
+{
+  struct
+  {
+    LogMsgSlabCache *owner;
+    guint32 size_class;
+    /* usable size of the block, excluding the header */
+    guint32 size;
+  };
+  /* keep the user data aligned at a 16 byte boundary */
+  guint8 __alignment[16];
+} LogMsgSlabHeader;
+
+/* free blocks are linked together through their (unused) data area */
+typedef struct _LogMsgSlabFreeBlock
+{
+  LogMsgSlabHeader header;
+  struct _LogMsgSlabFreeBlock *next;
+} LogMsgSlabFreeBlock;
+
+typedef struct _LogMsgSlabFreeList
+{
+  LogMsgSlabFreeBlock *head;
+  gint count;
+} LogMsgSlabFreeList;
+
+struct _LogMsgSlabCache
+{
+  /* atomic: owner thread + blocks not yet released to the heap */
+  gint ref_cnt;
+  /* atomic: set when the owner thread exits */
+  gint orphaned;
+  /* atomic: blocks freed by other threads */
+  LogMsgSlabFreeBlock *remote_free;
+
+  LogMsgSlabFreeList free_lists[LOG_MSG_SLAB_NUM_CLASSES];
+};
+
+TLS_BLOCK_START
+{
+  LogMsgSlabCache *log_msg_slab_cache;
+  gint log_msg_slab_pending_hits;
+  gint log_msg_slab_pending_misses;
+  gssize log_msg_slab_pending_cached_bytes;
+}
+TLS_BLOCK_END;
+
+#define log_msg_slab_cache                 __slng_tls_deref(log_msg_slab_cache)
+#define log_msg_slab_pending_hits          __slng_tls_deref(log_msg_slab_pending_hits)
+#define log_msg_slab_pending_misses        __slng_tls_deref(log_msg_slab_pending_misses)
+#define log_msg_slab_pending_cached_bytes  __slng_tls_deref(log_msg_slab_pending_cached_bytes)
+
+static gboolean log_msg_slab_enabled = FALSE;
+
+static StatsCounterItem *count_slab_hits;
+static StatsCounterItem *count_slab_misses;
+static StatsCounterItem *count_slab_cached_bytes;
+
+static inline gsize
+_class_to_size(guint32 size_class)
+{
+  return 1 << (LOG_MSG_SLAB_MIN_SHIFT + size_class);
+}
+
+static inline guint32
+_size_to_class(gsize size)
+{
+  guint32 size_class = 0;
+
+  while (_class_to_size(size_class) < size)
+    size_class++;
+  return size_class;
+}
+
+static inline gint
+_class_max_cached_blocks(guint32 size_class)
+{
+  return LOG_MSG_SLAB_MAX_CACHED_BYTES / _class_to_size(size_class);
+}
+
+static void
+_flush_stats(void)
+{
+  stats_counter_add(count_slab_hits, log_msg_slab_pending_hits);
+  stats_counter_add(count_slab_misses, log_msg_slab_pending_misses);
+  stats_counter_add(count_slab_cached_bytes, log_msg_slab_pending_cached_bytes);
+  log_msg_slab_pending_hits = 0;
+  log_msg_slab_pending_misses = 0;
+  log_msg_slab_pending_cached_bytes = 0;
+}
+
+static inline void
+_lazy_flush_stats(void)
+{
+  if (log_msg_slab_pending_hits + log_msg_slab_pending_misses >= LOG_MSG_SLAB_STATS_FLUSH_INTERVAL)
+    _flush_stats();
+}
+
+/* LogMsgSlabCache */
+
+static LogMsgSlabCache *
+_cache_new(void)
+{
+  LogMsgSlabCache *self = g_new0(LogMsgSlabCache, 1);
+
+  self->ref_cnt = 1;
+  return self;
+}
+
+static inline void
+_cache_unref(LogMsgSlabCache *self)
+{
+  if (g_atomic_int_dec_and_test(&self->ref_cnt))
+    g_free(self);
+}
+
+static inline void
+_release_block_to_heap(LogMsgSlabFreeBlock *block)
+{
+  LogMsgSlabCache *owner = block->header.owner;
+
+  g_free(block);
+  if (owner)
+    _cache_unref(owner);
+}
+
+static LogMsgSlabFreeBlock *
+_cache_grab_remote_free_list(LogMsgSlabCache *self)
+{
+  LogMsgSlabFreeBlock *head;
+
+  do
+    {
+      head = g_atomic_pointer_get(&self->remote_free);
+    }
+  while (head && !g_atomic_pointer_compare_and_exchange(&self->remote_free, head, NULL));
+  return head;
+}
+
+static void
+_cache_push_remote_free(LogMsgSlabCache *self, LogMsgSlabFreeBlock *block)
+{
+  LogMsgSlabFreeBlock *head;
+
+  do
+    {
+      head = g_atomic_pointer_get(&self->remote_free);
+      block->next = head;
+    }
+  while (!g_atomic_pointer_compare_and_exchange(&self->remote_free, head, block));
+}
+
+static void
+_release_block_list_to_heap(LogMsgSlabFreeBlock *block)
+{
+  while (block)
+    {
+      LogMsgSlabFreeBlock *next = block->next;
+
+      _release_block_to_heap(block);
+      block = next;
+    }
+}
+
+/* owner thread only */
+static inline gboolean
+_cache_put_local(LogMsgSlabCache *self, LogMsgSlabFreeBlock *block)
+{
+  LogMsgSlabFreeList *free_list = &self->free_lists[block->header.size_class];
+
+  if (free_list->count >= _class_max_cached_blocks(block->header.size_class))
+    return FALSE;
+
+  block->next = free_list->head;
+  free_list->head = block;
+  free_list->count++;
+  log_msg_slab_pending_cached_bytes += block->header.size;
+  return TRUE;
+}
+
+/* owner thread only */
+static void
+_cache_reclaim_remote_frees(LogMsgSlabCache *self)
+{
+  LogMsgSlabFreeBlock *block = _cache_grab_remote_free_list(self);
+
+  while (block)
+    {
+      LogMsgSlabFreeBlock *next = block->next;
+
+      if (!_cache_put_local(self, block))
+        _release_block_to_heap(block);
+      block = next;
+    }
+}
+
+/* owner thread only */
+static inline LogMsgSlabFreeBlock *
+_cache_get_local(LogMsgSlabCache *self, guint32 size_class)
+{
+  LogMsgSlabFreeList *free_list = &self->free_lists[size_class];
+
+  if (!free_list->head)
+    {
+      _cache_reclaim_remote_frees(self);
+      if (!free_list->head)
+        return NULL;
+    }
+
+  LogMsgSlabFreeBlock *block = free_list->head;
+  free_list->head = block->next;
+  free_list->count--;
+  log_msg_slab_pending_cached_bytes -= block->header.size;
+  return block;
+}
+
+/* owner thread only */
+static void
+_cache_orphan(LogMsgSlabCache *self)
+{
+  /* after this point remote frees release their blocks themselves, see
+   * _free_remote() */
+  g_atomic_int_set(&self->orphaned, TRUE);
+
+  for (gint i = 0; i < LOG_MSG_SLAB_NUM_CLASSES; i++)
+    {
+      LogMsgSlabFreeList *free_list = &self->free_lists[i];
+
+      log_msg_slab_pending_cached_bytes -= free_list->count * _class_to_size(i);
+      _release_block_list_to_heap(free_list->head);
+      free_list->head = NULL;
+      free_list->count = 0;
+    }
+  _release_block_list_to_heap(_cache_grab_remote_free_list(self));
+  _cache_unref(self);
+}
+
+/* allocation API */
+
+static gpointer
+_alloc_from_heap(LogMsgSlabCache *owner, guint32 size_class, gsize size)
+{
+  LogMsgSlabHeader *header = g_malloc(sizeof(LogMsgSlabHeader) + size);
+
+  header->owner = owner;
+  header->size_class = size_class;
+  header->size = size;
+  if (owner)
+    g_atomic_int_inc(&owner->ref_cnt);
+  return header + 1;
+}
+
+gsize
+log_msg_slab_get_usable_size(gsize size)
+{
+  if (!log_msg_slab_enabled || size > LOG_MSG_SLAB_MAX_SIZE)
+    return size;
+  return _class_to_size(_size_to_class(size));
+}
+
+gpointer
+log_msg_slab_alloc(gsize size)
+{
+  LogMsgSlabCache *cache = log_msg_slab_cache;
+
+  if (!log_msg_slab_enabled || !cache || size > LOG_MSG_SLAB_MAX_SIZE)
+    return _alloc_from_heap(NULL, LOG_MSG_SLAB_HEAP_CLASS, size);
+
+  guint32 size_class = _size_to_class(size);
+  LogMsgSlabFreeBlock *block = _cache_get_local(cache, size_class);
+  gpointer result;
+
+  if (block)
+    {
+      log_msg_slab_pending_hits++;
+      result = &block->header + 1;
+    }
+  else
+    {
+      log_msg_slab_pending_misses++;
+      result = _alloc_from_heap(cache, size_class, _class_to_size(size_class));
+    }
+  _lazy_flush_stats();
+  return result;
+}
+
+static void
+_free_remote(LogMsgSlabFreeBlock *block)
+{
+  LogMsgSlabCache *owner = block->header.owner;
+
+  /* once pushed, the block (and the reference it holds) may be released
+   * by anyone, hold our own reference until we are done with @owner.
+   * This is safe as @block still holds a reference at this point. */
+  g_atomic_int_inc(&owner->ref_cnt);
+
+  _cache_push_remote_free(owner, block);
+
+  /* the owner might have exited in the meanwhile, in which case it may
+   * not see our push, we need to release whatever is on the list.
+   * Either the owner or we grab each block, as the list is always taken
+   * away as a whole */
+
+  if (g_atomic_int_get(&owner->orphaned))
+    _release_block_list_to_heap(_cache_grab_remote_free_list(owner));
+
+  _cache_unref(owner);
+}
+
+void
+log_msg_slab_free(gpointer p)
+{
+  if (!p)
+    return;
+
+  LogMsgSlabFreeBlock *block = (LogMsgSlabFreeBlock *) (((LogMsgSlabHeader *) p) - 1);
+  LogMsgSlabCache *owner = block->header.owner;
+
+  if (!owner)
+    {
+      g_free(block);
+      return;
+    }
+
+  if (owner == log_msg_slab_cache)
+    {
+      if (!_cache_put_local(owner, block))
+        _release_block_to_heap(block);
+      return;
+    }
+  _free_remote(block);
+}
+
+gpointer
+log_msg_slab_realloc(gpointer p, gsize size)
+{
+  if (!p)
+    return log_msg_slab_alloc(size);
+
+  LogMsgSlabHeader *header = ((LogMsgSlabHeader *) p) - 1;
+
+  if (size <= header->size)
+    return p;
+
+  if (!header->owner)
+    {
+      header = g_realloc(header, sizeof(LogMsgSlabHeader) + size);
+      header->size = size;
+      return header + 1;
+    }
+
+  gpointer new_p = log_msg_slab_alloc(size);
+  memcpy(new_p, p, header->size);
+  log_msg_slab_free(p);
+  return new_p;
+}
+
+void
+log_msg_slab_set_enabled(gboolean enabled)
+{
+  log_msg_slab_enabled = enabled;
+}
+
+gboolean
+log_msg_slab_is_enabled(void)
+{
+  return log_msg_slab_enabled;
+}
+
+void
+log_msg_slab_thread_init(void)
+{
+  if (log_msg_slab_cache)
+    return;
+  log_msg_slab_cache = _cache_new();
+}
+
+void
+log_msg_slab_thread_deinit(void)
+{
+  if (!log_msg_slab_cache)
+    return;
+
+  _cache_orphan(log_msg_slab_cache);
+  log_msg_slab_cache = NULL;
+  _flush_stats();
+}
+
+void
+log_msg_slab_register_stats(void)
+{
+  StatsClusterKey sc_key;
+
+  stats_lock();
+  stats_cluster_single_key_set(&sc_key, "events_allocator_hits_total", NULL, 0);
+  stats_register_counter(1, &sc_key, SC_TYPE_SINGLE_VALUE, &count_slab_hits);
+
+  stats_cluster_single_key_set(&sc_key, "events_allocator_misses_total", NULL, 0);
+  stats_register_counter(1, &sc_key, SC_TYPE_SINGLE_VALUE, &count_slab_misses);
+
+  stats_cluster_single_key_set(&sc_key, "events_allocator_cached_bytes", NULL, 0);
+  stats_register_counter(1, &sc_key, SC_TYPE_SINGLE_VALUE, &count_slab_cached_bytes);
+  stats_unlock();
+}
@@ -0,0 +1,47 @@
+/*
+ * Copyright (c) 2026 Axoflow
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#ifndef LOGMSG_SLAB_H_INCLUDED
+#define LOGMSG_SLAB_H_INCLUDED
+
+#include "syslog-ng.h"
+
+/* size classes are powers of two, from 512 bytes up to 16k */
+#define LOG_MSG_SLAB_MIN_SHIFT    9
+#define LOG_MSG_SLAB_NUM_CLASSES  6
+#define LOG_MSG_SLAB_MAX_SIZE     (1 << (LOG_MSG_SLAB_MIN_SHIFT + LOG_MSG_SLAB_NUM_CLASSES - 1))
+
+gpointer log_msg_slab_alloc(gsize size);
+gpointer log_msg_slab_realloc(gpointer p, gsize size);
+void log_msg_slab_free(gpointer p);
+gsize log_msg_slab_get_usable_size(gsize size);
+
+void log_msg_slab_set_enabled(gboolean enabled);
+gboolean log_msg_slab_is_enabled(void);
+
+void log_msg_slab_thread_init(void);
+void log_msg_slab_thread_deinit(void);
+
+void log_msg_slab_register_stats(void);
+
+#endif
@@ -30,6 +30,8 @@
 #include "timeutils/cache.h"
 #include "timeutils/misc.h"
 #include "logmsg/nvtable.h"
+#include "logmsg/logmsg-slab.h"
+#include "logmsg/logmsg-intern.h"
 #include "stats/stats-registry.h"
 #include "stats/stats-cluster-single.h"
 #include "template/templates.h"
@@ -138,6 +140,11 @@ TLS_BLOCK_START
   gboolean logmsg_cached_abort;
   /* suspend flag in the current thread for acks */
   gboolean logmsg_cached_suspend;
+
+  /* input buffer the message being parsed by the current thread comes
+   * from, values stored in it may be referenced instead of copied */
+  LogMsgChunk *logmsg_input_chunk;
+  gsize logmsg_input_chunk_min_size;
 }
 TLS_BLOCK_END;
 
@@ -147,6 +154,8 @@ TLS_BLOCK_END;
 #define logmsg_cached_ack_needed    __slng_tls_deref(logmsg_cached_ack_needed)
 #define logmsg_cached_abort         __slng_tls_deref(logmsg_cached_abort)
 #define logmsg_cached_suspend       __slng_tls_deref(logmsg_cached_suspend)
+#define logmsg_input_chunk          __slng_tls_deref(logmsg_input_chunk)
+#define logmsg_input_chunk_min_size __slng_tls_deref(logmsg_input_chunk_min_size)
 
 #define LOGMSG_REFCACHE_SUSPEND_SHIFT                 31 /* number of bits to shift to get the SUSPEND flag */
 #define LOGMSG_REFCACHE_SUSPEND_MASK          0x80000000 /* bit mask to extract the SUSPEND flag */
@@ -277,6 +286,8 @@ static StatsCounterItem *count_msg_clones;
 static StatsCounterItem *count_payload_reallocs;
 static StatsCounterItem *count_sdata_updates;
 static StatsCounterItem *count_allocated_bytes;
+static StatsCounterItem *count_payload_overlays;
+static StatsCounterItem *count_payload_cow_bytes_saved;
 static GPrivate priv_macro_value = G_PRIVATE_INIT(__free_macro_value);
 
 void
@@ -477,6 +488,7 @@ log_msg_init_queue_node(LogMessage *msg, LogMessageQueueNode *node, const LogPat
   INIT_IV_LIST_HEAD(&node->list);
   node->ack_needed = path_options->ack_needed;
   node->flow_control_requested = path_options->flow_control_requested;
+  node->lane = 0;
   node->msg = log_msg_ref(msg);
 }
 
@@ -561,6 +573,15 @@ log_msg_rename_value(LogMessage *self, NVHandle from, NVHandle to)
 
   gssize value_len = 0;
   LogMessageValueType type;
+  NVNativeValue native;
+
+  if (log_msg_get_native_value(self, from, &native, &type))
+    {
+      log_msg_set_value_native(self, to, &native, type);
+      log_msg_unset_value(self, from);
+      return;
+    }
+
   const gchar *value = log_msg_get_value_if_set_with_type(self, from, &value_len, &type);
   if (!value)
     return;
@@ -569,6 +590,130 @@ log_msg_rename_value(LogMessage *self, NVHandle from, NVHandle to)
   log_msg_unset_value(self, from);
 }
 
+/*
+ * log_msg_set_input_chunk:
+ * @chunk: the input buffer the current thread is parsing messages from, or NULL
+ * @min_size: values at least this long are referenced instead of copied
+ *
+ * While set, log_msg_set_value() stores NUL terminated values that are
+ * located in @chunk as external NVTable entries, and takes a reference
+ * to @chunk, instead of copying the value into the payload.
+ */
+void
+log_msg_set_input_chunk(LogMsgChunk *chunk, gsize min_size)
+{
+  logmsg_input_chunk = chunk;
+  logmsg_input_chunk_min_size = min_size;
+}
+
+static inline gboolean
+_value_can_reference_input_chunk(LogMessage *self, const gchar *value, gssize value_len)
+{
+  LogMsgChunk *chunk = logmsg_input_chunk;
+
+  if (G_LIKELY(!chunk))
+    return FALSE;
+
+  if ((gsize) value_len < logmsg_input_chunk_min_size || value_len > NV_TABLE_MAX_BYTES)
+    return FALSE;
+
+  /* we only hold a single chunk */
+  if (self->input_chunk && self->input_chunk != chunk)
+    return FALSE;
+
+  return log_msg_chunk_contains(chunk, value, value_len + 1) && value[value_len] == 0;
+}
+
+/* replaces @value with its copy in the interned value dictionary */
+static inline gboolean
+_value_can_reference_interned_copy(LogMessage *self, NVHandle handle, const gchar **value, gssize value_len,
+                                   LogMsgChunk **page)
+{
+  *page = self->interned_page;
+  const gchar *interned = log_msg_intern_value(handle, *value, value_len, page);
+
+  if (!interned)
+    return FALSE;
+
+  *value = interned;
+  return TRUE;
+}
+
+/*
+ * A clone shares the payload of the message it was cloned from.  Instead
+ * of copying the whole NVTable at the first write, the clone gets a small
+ * overlay table that only stores the values it changes, while the others
+ * are read from the shared table (payload_base).  A clone of such a clone
+ * only needs to copy the overlay.
+ */
+static void
+_make_payload_writable(LogMessage *self, gint additional_space)
+{
+  gsize full_copy_size;
+
+  if (log_msg_chk_flag(self, LF_STATE_OWN_PAYLOAD))
+    return;
+
+  if (self->payload_base)
+    {
+      full_copy_size = self->payload_base->size + self->payload->size + additional_space;
+      self->payload = nv_table_clone(self->payload, additional_space);
+    }
+  else
+    {
+      full_copy_size = self->payload->size + additional_space;
+      self->payload_base = self->payload;
+      self->payload = nv_table_new(LM_V_MAX, 4, additional_space);
+      stats_counter_inc(count_payload_overlays);
+    }
+  log_msg_set_flag(self, LF_STATE_OWN_PAYLOAD);
+  self->allocated_bytes += self->payload->size;
+  stats_counter_add(count_allocated_bytes, self->payload->size);
+  if (full_copy_size > self->payload->size)
+    stats_counter_add(count_payload_cow_bytes_saved, full_copy_size - self->payload->size);
+}
+
+static gboolean
+_grow_payload(LogMessage *self)
+{
+  guint32 old_size = self->payload->size;
+
+  if (!nv_table_realloc(self->payload, &self->payload))
+    return FALSE;
+
+  self->allocated_bytes += (self->payload->size - old_size);
+  stats_counter_add(count_allocated_bytes, self->payload->size - old_size);
+  stats_counter_inc(count_payload_reallocs);
+  return TRUE;
+}
+
+/* hide a value of payload_base by storing an unset entry in the overlay */
+static void
+_mask_base_value(LogMessage *self, NVHandle handle)
+{
+  gssize name_len = 0;
+  const gchar *name = log_msg_get_value_name(handle, &name_len);
+
+  if (nv_table_get_entry(self->payload, handle, NULL, NULL) || !nv_table_is_value_set(self->payload_base, handle))
+    return;
+
+  while (!nv_table_add_value(self->payload, handle, name, name_len, "", 0, LM_VT_NULL, NULL))
+    {
+      if (!_grow_payload(self))
+        return;
+    }
+}
+
+static gboolean
+_add_value_to_payload(LogMessage *self, NVHandle handle, const gchar *name, gssize name_len,
+                      const gchar *value, gssize value_len, LogMessageValueType type,
+                      gboolean external, gboolean *new_entry)
+{
+  if (external)
+    return nv_table_add_value_external(self->payload, handle, name, name_len, value, value_len, type, new_entry);
+  return nv_table_add_value(self->payload, handle, name, name_len, value, value_len, type, new_entry);
+}
+
 void
 log_msg_set_value_with_type(LogMessage *self, NVHandle handle,
                             const gchar *value, gssize value_len,
@@ -599,18 +744,18 @@ log_msg_set_value_with_type(LogMessage *self, NVHandle handle,
                 evt_tag_msg_reference(self));
     }
 
-  if (!log_msg_chk_flag(self, LF_STATE_OWN_PAYLOAD))
-    {
-      self->payload = nv_table_clone(self->payload, name_len + value_len + 2);
-      log_msg_set_flag(self, LF_STATE_OWN_PAYLOAD);
-      self->allocated_bytes += self->payload->size;
-      stats_counter_add(count_allocated_bytes, self->payload->size);
-    }
+  LogMsgChunk *interned_page = NULL;
+  gboolean in_input_chunk = _value_can_reference_input_chunk(self, value, value_len);
+  gboolean interned = !in_input_chunk &&
+                      _value_can_reference_interned_copy(self, handle, &value, value_len, &interned_page);
+  gboolean external = in_input_chunk || interned;
+
+  _make_payload_writable(self, external ? NV_ENTRY_EXTERNAL_SIZE(name_len) : name_len + value_len + 2);
 
   /* we need a loop here as a single realloc may not be enough. Might help
    * if we pass how much bytes we need though. */
 
-  while (!nv_table_add_value(self->payload, handle, name, name_len, value, value_len, type, &new_entry))
+  while (!_add_value_to_payload(self, handle, name, name_len, value, value_len, type, external, &new_entry))
     {
       /* error allocating string in payload, reallocate */
       guint32 old_size = self->payload->size;
@@ -629,6 +774,11 @@ log_msg_set_value_with_type(LogMessage *self, NVHandle handle,
       stats_counter_inc(count_payload_reallocs);
     }
 
+  if (in_input_chunk && !self->input_chunk)
+    self->input_chunk = log_msg_chunk_ref(logmsg_input_chunk);
+  if (interned && !self->interned_page)
+    self->interned_page = log_msg_chunk_ref(interned_page);
+
   if (new_entry)
     log_msg_update_sdata(self, handle, name, name_len);
   log_msg_update_num_matches(self, handle);
@@ -643,6 +793,62 @@ log_msg_set_value(LogMessage *self, NVHandle handle, const gchar *value, gssize
   log_msg_set_value_with_type(self, handle, value, value_len, LM_VT_STRING);
 }
 
+/*
+ * Store an integer, double, boolean or datetime in binary form.  Its string
+ * representation is only rendered if someone asks for it, consumers that
+ * need the number can use log_msg_get_native_value() instead of parsing.
+ */
+void
+log_msg_set_value_native(LogMessage *self, NVHandle handle, const NVNativeValue *value,
+                         LogMessageValueType type)
+{
+  const gchar *name;
+  gssize name_len;
+  gboolean new_entry = FALSE;
+
+  g_assert(!log_msg_is_write_protected(self));
+
+  if (handle == LM_V_NONE)
+    return;
+
+  name_len = 0;
+  name = log_msg_get_value_name(handle, &name_len);
+
+  self->generation++;
+  _make_payload_writable(self, NV_ENTRY_NATIVE_SIZE(name_len, nv_native_value_format_bound(value)));
+
+  while (!nv_table_add_value_native(self->payload, handle, name, name_len, value, type, &new_entry))
+    {
+      /* error allocating space in payload, reallocate */
+      if (!_grow_payload(self))
+        {
+          msg_info("Cannot store value for this log message, maximum size has been reached",
+                   evt_tag_int("maximum_payload", NV_TABLE_MAX_BYTES),
+                   evt_tag_str("name", name));
+          break;
+        }
+    }
+
+  if (_log_name_value_updates(self))
+    {
+      gssize value_len;
+      const gchar *rendered_value = log_msg_get_value(self, handle, &value_len);
+
+      msg_trace("Setting value",
+                evt_tag_str("name", name),
+                evt_tag_mem("value", rendered_value, value_len),
+                evt_tag_str("type", log_msg_value_type_to_str(type)),
+                evt_tag_msg_reference(self));
+    }
+
+  if (new_entry)
+    log_msg_update_sdata(self, handle, name, name_len);
+  log_msg_update_num_matches(self, handle);
+
+  if (_value_invalidates_legacy_header(handle))
+    log_msg_unset_value(self, LM_V_LEGACY_MSGHDR);
+}
+
 void
 log_msg_unset_value(LogMessage *self, NVHandle handle)
 {
@@ -656,11 +862,9 @@ log_msg_unset_value(LogMessage *self, NVHandle handle)
                 evt_tag_msg_reference(self));
     }
 
-  if (!log_msg_chk_flag(self, LF_STATE_OWN_PAYLOAD))
-    {
-      self->payload = nv_table_clone(self->payload, 0);
-      log_msg_set_flag(self, LF_STATE_OWN_PAYLOAD);
-    }
+  _make_payload_writable(self, 0);
+  if (self->payload_base)
+    _mask_base_value(self, handle);
 
   while (!nv_table_unset_value(self->payload, handle))
     {
@@ -722,10 +926,25 @@ log_msg_set_value_indirect_with_type(LogMessage *self, NVHandle handle,
                 evt_tag_msg_reference(self));
     }
 
-  if (!log_msg_chk_flag(self, LF_STATE_OWN_PAYLOAD))
+  _make_payload_writable(self, name_len + 1);
+  if (self->payload_base && !nv_table_get_entry(self->payload, ref_handle, NULL, NULL))
     {
-      self->payload = nv_table_clone(self->payload, name_len + 1);
-      log_msg_set_flag(self, LF_STATE_OWN_PAYLOAD);
+      /* indirect entries can only point within the same table, copy the
+       * referenced slice out of payload_base instead */
+      gssize ref_len;
+      const gchar *ref_value = nv_table_get_value(self->payload_base, ref_handle, &ref_len, NULL);
+
+      if (!ref_value || ofs > ref_len)
+        {
+          ref_value = "";
+          ofs = len = 0;
+        }
+      else if (ofs + len > ref_len)
+        {
+          len = ref_len - ofs;
+        }
+      log_msg_set_value_with_type(self, handle, ref_value + ofs, len, type);
+      return;
     }
 
   NVReferencedSlice referenced_slice =
@@ -761,10 +980,67 @@ log_msg_set_value_indirect(LogMessage *self, NVHandle handle, NVHandle ref_handl
   log_msg_set_value_indirect_with_type(self, handle, ref_handle, ofs, len, LM_VT_STRING);
 }
 
+static gboolean
+_call_foreach_unless_overridden(NVHandle handle, const gchar *name,
+                                const gchar *value, gssize value_len,
+                                NVType type, gpointer user_data)
+{
+  const LogMessage *self = ((gpointer *) user_data)[0];
+  NVTableForeachFunc func = ((gpointer *) user_data)[1];
+
+  if (nv_table_get_entry(self->payload, handle, NULL, NULL))
+    return FALSE;
+  return func(handle, name, value, value_len, type, ((gpointer *) user_data)[2]);
+}
+
 gboolean
 log_msg_values_foreach(const LogMessage *self, NVTableForeachFunc func, gpointer user_data)
 {
-  return nv_table_foreach(self->payload, logmsg_registry, func, user_data);
+  if (nv_table_foreach(self->payload, logmsg_registry, func, user_data))
+    return TRUE;
+
+  if (!self->payload_base)
+    return FALSE;
+
+  gpointer args[] = { (gpointer) self, func, user_data };
+  return nv_table_foreach(self->payload_base, logmsg_registry, _call_foreach_unless_overridden, args);
+}
+
+static gboolean
+_flatten_overlay_entry(NVHandle handle, NVEntry *entry, NVIndexEntry *index_entry, gpointer user_data)
+{
+  NVTable *overlay = ((gpointer *) user_data)[0];
+  NVTable **flat = ((gpointer *) user_data)[1];
+  gssize name_len = 0;
+  const gchar *name = log_msg_get_value_name(handle, &name_len);
+  gssize value_len;
+  NVType type = LM_VT_STRING;
+  const gchar *value = nv_table_get_value(overlay, handle, &value_len, &type);
+
+  while (!(value ? nv_table_add_value(*flat, handle, name, name_len, value, value_len, type, NULL)
+           : nv_table_unset_value(*flat, handle)))
+    {
+      if (!nv_table_realloc(*flat, flat))
+        break;
+    }
+  return FALSE;
+}
+
+/*
+ * Merge the overlay with payload_base into a single, newly allocated
+ * NVTable, e.g. to serialize the message.  Must only be called if
+ * payload_base is set, the caller owns the returned reference.
+ */
+NVTable *
+log_msg_flatten_payload(const LogMessage *self)
+{
+  g_assert(self->payload_base);
+
+  NVTable *flat = nv_table_clone(self->payload_base, self->payload->used);
+  gpointer args[] = { self->payload, &flat };
+
+  nv_table_foreach_entry(self->payload, _flatten_overlay_entry, args);
+  return flat;
 }
 
 NVHandle
@@ -821,7 +1097,8 @@ log_msg_get_match_if_set_with_type(const LogMessage *self, gint index_, gssize *
                                    LogMessageValueType *type)
 {
   if (index_ >= 0 && index_ < LOGMSG_MAX_MATCHES)
-    return nv_table_get_value(self->payload, match_handles[index_], value_len, type);
+    return nv_table_get_value(log_msg_get_payload_for_handle(self, match_handles[index_]),
+                              match_handles[index_], value_len, type);
   return NULL;
 }
 
@@ -1362,6 +1639,7 @@ log_msg_clear(LogMessage *self)
   if (log_msg_chk_flag(self, LF_STATE_OWN_PAYLOAD))
     nv_table_unref(self->payload);
   self->payload = nv_table_new(LM_V_MAX, 16, 256);
+  self->payload_base = NULL;
   log_msg_set_flag(self, LF_STATE_OWN_PAYLOAD);
 
   if (log_msg_chk_flag(self, LF_STATE_OWN_TAGS) && self->tags)
@@ -1389,6 +1667,12 @@ log_msg_clear(LogMessage *self)
     g_sockaddr_unref(self->daddr);
   self->daddr = NULL;
 
+  /* the old payload is gone, nothing references the input buffer anymore */
+  log_msg_chunk_unref(self->input_chunk);
+  self->input_chunk = NULL;
+  log_msg_chunk_unref(self->interned_page);
+  self->interned_page = NULL;
+
   /* clear "local", "utf8", "internal", "mark" and similar flags, we start afresh */
   self->flags = LF_STATE_OWN_MASK;
 }
@@ -1410,8 +1694,17 @@ log_msg_alloc(gsize payload_size)
       alloc_size = (alloc_size + 7) & ~7;
       payload_ofs = alloc_size;
       alloc_size += payload_space;
+
+      /* the slab allocator rounds up to its size classes, let the
+       * embedded payload use the slack instead of wasting it */
+      gsize usable_size = log_msg_slab_get_usable_size(alloc_size);
+      if (usable_size - payload_ofs <= NV_TABLE_MAX_BYTES)
+        {
+          payload_space = usable_size - payload_ofs;
+          alloc_size = usable_size;
+        }
     }
-  msg = g_malloc(alloc_size);
+  msg = log_msg_slab_alloc(alloc_size);
 
   memset(msg, 0, sizeof(LogMessage));
 
@@ -1468,7 +1761,7 @@ log_msg_alloc_clone(LogMessage *original)
   gint nodes = (volatile gint) logmsg_queue_node_max;
 
   gsize alloc_size = sizeof(LogMessage) + sizeof(LogMessageQueueNode) * nodes;
-  msg = g_malloc(alloc_size);
+  msg = log_msg_slab_alloc(alloc_size);
 
   memcpy(msg, original, sizeof(*msg));
   msg->num_nodes = nodes;
@@ -1499,6 +1792,9 @@ log_msg_clone_cow(LogMessage *msg, const LogPathOptions *path_options)
 
   /* reference the original message */
   self->original = log_msg_ref(msg);
+  /* external values in the payload are kept alive by the original */
+  self->input_chunk = NULL;
+  self->interned_page = NULL;
   self->ack_and_ref_and_abort_and_suspended = LOGMSG_REFCACHE_REF_TO_VALUE(1) + LOGMSG_REFCACHE_ACK_TO_VALUE(
                                                 0) + LOGMSG_REFCACHE_ABORT_TO_VALUE(0);
   self->cur_node = 0;
@@ -1612,13 +1908,15 @@ log_msg_free(LogMessage *self)
     g_sockaddr_unref(self->saddr);
   if (log_msg_chk_flag(self, LF_STATE_OWN_DADDR))
     g_sockaddr_unref(self->daddr);
+  log_msg_chunk_unref(self->input_chunk);
+  log_msg_chunk_unref(self->interned_page);
 
   if (self->original)
     log_msg_unref(self->original);
 
   stats_counter_sub(count_allocated_bytes, self->allocated_bytes);
 
-  g_free(self);
+  log_msg_slab_free(self);
 }
 
 /**
@@ -2088,6 +2386,12 @@ log_msg_register_stats(void)
   stats_cluster_logpipe_key_legacy_set(&sc_key, SCS_GLOBAL, "payload_reallocs", NULL );
   stats_register_counter(0, &sc_key, SC_TYPE_PROCESSED, &count_payload_reallocs);
 
+  stats_cluster_logpipe_key_legacy_set(&sc_key, SCS_GLOBAL, "payload_overlays", NULL );
+  stats_register_counter(0, &sc_key, SC_TYPE_PROCESSED, &count_payload_overlays);
+
+  stats_cluster_logpipe_key_legacy_set(&sc_key, SCS_GLOBAL, "payload_cow_bytes_saved", NULL );
+  stats_register_counter(0, &sc_key, SC_TYPE_PROCESSED, &count_payload_cow_bytes_saved);
+
   stats_cluster_logpipe_key_legacy_set(&sc_key, SCS_GLOBAL, "sdata_updates", NULL );
   stats_register_counter(0, &sc_key, SC_TYPE_PROCESSED, &count_sdata_updates);
 
@@ -2095,6 +2399,9 @@ log_msg_register_stats(void)
   stats_cluster_single_key_add_legacy_alias(&sc_key, SCS_GLOBAL, "msg_allocated_bytes", NULL);
   stats_register_counter(1, &sc_key, SC_TYPE_SINGLE_VALUE, &count_allocated_bytes);
   stats_unlock();
+
+  log_msg_slab_register_stats();
+  log_msg_intern_register_stats();
 }
 
 void
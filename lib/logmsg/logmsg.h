@@ -31,6 +31,7 @@
 #include "serialize.h"
 #include "timeutils/unixtime.h"
 #include "logmsg/nvtable.h"
+#include "logmsg/logmsg-chunk.h"
 #include "logmsg/tags.h"
 #include "messages.h"
 
@@ -231,6 +232,7 @@ typedef struct _LogMessageQueueNode
   struct iv_list_head list;
   LogMessage *msg;
   guint ack_needed: 1, embedded: 1, flow_control_requested: 1;
+  guint lane: 3; /* priority lane in memory queues */
 } LogMessageQueueNode;
 
 
@@ -258,6 +260,10 @@ struct _LogMessage
   guint32 flags;
 
   NVTable *payload;
+  /* if set, payload is an overlay that only holds the values changed
+   * since cloning and the rest are looked up here.  Not referenced, it
+   * is kept alive by "original" */
+  NVTable *payload_base;
   LogMessage *original;
   gulong *tags;
   NVHandle *sdata;
@@ -316,6 +322,13 @@ struct _LogMessage
   GSockAddr *saddr;
   GSockAddr *daddr;
 
+  /* input buffer referenced by external values in the payload, not
+   * inherited by clones, they keep it alive through "original" */
+  LogMsgChunk *input_chunk;
+  /* page of the interned value dictionary referenced by external values,
+   * handled the same way as input_chunk */
+  LogMsgChunk *interned_page;
+
   UnixTime timestamps[LM_TS_MAX];
 
   /* preallocated LogQueueNodes used to insert this message into a LogQueue */
@@ -403,12 +416,21 @@ log_msg_is_handle_settable_with_an_indirect_value(NVHandle handle)
 }
 
 const gchar *log_msg_get_macro_value(const LogMessage *self, gint id, gssize *value_len, LogMessageValueType *type);
+NVTable *log_msg_flatten_payload(const LogMessage *self);
 const gchar *log_msg_get_match_with_type(const LogMessage *self, gint index_,
                                          gssize *value_len, LogMessageValueType *type);
 const gchar *log_msg_get_match_if_set_with_type(const LogMessage *self, gint index_,
                                                 gssize *value_len, LogMessageValueType *type);
 
 
+/* the NVTable that holds the value of @handle, see payload_base */
+static inline NVTable *
+log_msg_get_payload_for_handle(const LogMessage *self, NVHandle handle)
+{
+  if (G_UNLIKELY(self->payload_base) && !nv_table_get_entry(self->payload, handle, NULL, NULL))
+    return self->payload_base;
+  return self->payload;
+}
 
 static inline const gchar *
 log_msg_get_value_if_set_with_type(const LogMessage *self, NVHandle handle,
@@ -421,13 +443,20 @@ log_msg_get_value_if_set_with_type(const LogMessage *self, NVHandle handle,
   if (G_UNLIKELY((flags & LM_VF_MACRO)))
     return log_msg_get_macro_value(self, flags >> 8, value_len, type);
   else
-    return nv_table_get_value(self->payload, handle, value_len, type);
+    return nv_table_get_value(log_msg_get_payload_for_handle(self, handle), handle, value_len, type);
 }
 
 static inline gboolean
 log_msg_is_value_set(const LogMessage *self, NVHandle handle)
 {
-  return nv_table_is_value_set(self->payload, handle);
+  return nv_table_is_value_set(log_msg_get_payload_for_handle(self, handle), handle);
+}
+
+/* returns FALSE unless the value was set with log_msg_set_value_native() */
+static inline gboolean
+log_msg_get_native_value(const LogMessage *self, NVHandle handle, NVNativeValue *value, LogMessageValueType *type)
+{
+  return nv_table_get_native_value(log_msg_get_payload_for_handle(self, handle), handle, value, type);
 }
 
 static inline const gchar *
@@ -485,6 +514,10 @@ void log_msg_set_value(LogMessage *self, NVHandle handle, const gchar *new_value
 void log_msg_set_value_with_type(LogMessage *self, NVHandle handle,
                                  const gchar *value, gssize value_len,
                                  LogMessageValueType type);
+void log_msg_set_value_native(LogMessage *self, NVHandle handle, const NVNativeValue *value,
+                              LogMessageValueType type);
+
+void log_msg_set_input_chunk(LogMsgChunk *chunk, gsize min_size);
 
 void log_msg_set_value_indirect(LogMessage *self, NVHandle handle, NVHandle ref_handle,
                                 guint16 ofs, guint16 len);
@@ -530,6 +563,34 @@ log_msg_set_value_to_string(LogMessage *self, NVHandle handle, const gchar *lite
   log_msg_set_value(self, handle, literal_string, strlen(literal_string));
 }
 
+static inline void
+log_msg_set_value_int64(LogMessage *self, NVHandle handle, gint64 value)
+{
+  NVNativeValue native = { .kind = NVN_INT64, .i64 = value };
+  log_msg_set_value_native(self, handle, &native, LM_VT_INTEGER);
+}
+
+static inline void
+log_msg_set_value_double(LogMessage *self, NVHandle handle, gdouble value)
+{
+  NVNativeValue native = { .kind = NVN_DOUBLE, .d = value };
+  log_msg_set_value_native(self, handle, &native, LM_VT_DOUBLE);
+}
+
+static inline void
+log_msg_set_value_boolean(LogMessage *self, NVHandle handle, gboolean value)
+{
+  NVNativeValue native = { .kind = NVN_BOOLEAN, .i64 = !!value };
+  log_msg_set_value_native(self, handle, &native, LM_VT_BOOLEAN);
+}
+
+static inline void
+log_msg_set_value_datetime_msec(LogMessage *self, NVHandle handle, gint64 msec)
+{
+  NVNativeValue native = { .kind = NVN_DATETIME_MSEC, .i64 = msec };
+  log_msg_set_value_native(self, handle, &native, LM_VT_DATETIME);
+}
+
 void log_msg_rename_value(LogMessage *self, NVHandle from, NVHandle to);
 
 void log_msg_append_format_sdata(const LogMessage *self, GString *result, guint32 seq_num);
@@ -27,12 +27,12 @@
 #include "nvtable-serialize-legacy.h"
 #include "nvtable-serialize-endianutils.h"
 #include "nvtable-serialize.h"
+#include "logmsg-slab.h"
 #include "syslog-ng.h"
 #include <string.h>
 
 #define NV_TABLE_OLD_SCALE 2
 #define NV_TABLE_MAGIC_V2  "NVT2"
-static const int NV_TABLE_HEADER_DIFF_V22_V26 = 4;
 static const int NV_TABLE_DYNVALUE_DIFF_V22_V26 = 4;
 static const int NV_TABLE_HANDLE_DIFF_V22_V26 = 2;
 static const int SIZE_DIFF_OF_OLD_NVENTRY_AND_NEW_NVENTRY = 12;
@@ -90,6 +90,8 @@ typedef struct _OldNVTable
   };
 } OldNVTable;
 
+#define NV_TABLE_HEADER_DIFF_V22_V26 ((gint) (sizeof(NVTable) - sizeof(OldNVTable)))
+
 static inline void
 _swap_old_entry_flags(OldNVEntry *entry)
 {
@@ -297,52 +299,53 @@ nv_table_deserialize_22(SerializeArchive *sa)
   if (memcmp(&magic, NV_TABLE_MAGIC_V2, 4) != 0)
     return NULL;
 
-  res = (NVTable *)g_malloc(sizeof(NVTable));
+  res = (NVTable *)log_msg_slab_alloc(sizeof(NVTable));
 
   if (!serialize_read_uint16(sa, &old_res))
     {
-      g_free(res);
+      log_msg_slab_free(res);
       return NULL;
     }
   res->size = old_res << NV_TABLE_OLD_SCALE;
 
   if (!serialize_read_uint16(sa, &old_res))
     {
-      g_free(res);
+      log_msg_slab_free(res);
       return NULL;
     }
   res->used = old_res << NV_TABLE_OLD_SCALE;
 
   if (!serialize_read_uint16(sa, &res->index_size))
     {
-      g_free(res);
+      log_msg_slab_free(res);
       return NULL;
     }
 
   if (!serialize_read_uint8(sa, &res->num_static_entries))
     {
-      g_free(res);
+      log_msg_slab_free(res);
       return NULL;
     }
 
   res->size = _calculate_new_size(res);
-  res = (NVTable *)g_realloc(res, res->size);
+  res = (NVTable *)log_msg_slab_realloc(res, res->size);
   if (!res)
     return NULL;
 
   res->ref_cnt = 1;
   res->borrowed = FALSE;
+  res->index_hash_ofs = 0;
 
   if (!_deserialize_struct_22(sa, res))
     {
-      g_free(res);
+      log_msg_slab_free(res);
       return NULL;
     }
 
   different_endianness = (is_big_endian != (flags & NVT_SF_BE));
   if (!_deserialize_blob_v22(sa, res, nv_table_get_top(res), different_endianness))
     {
-      g_free(res);
+      log_msg_slab_free(res);
       return NULL;
     }
 
@@ -365,7 +368,7 @@ static inline guint32 *_get_legacy_dynamic_entries(OldNVTable *old)
 static NVTable *
 _create_new_nvtable_from_legacy_nvtable(OldNVTable *old)
 {
-  NVTable *res = g_try_malloc(_calculate_new_size_from_legacy_nvtable(old));
+  NVTable *res = log_msg_slab_alloc(_calculate_new_size_from_legacy_nvtable(old));
   NVIndexEntry *dyn_entries;
   guint32 *old_entries;
   int i;
@@ -461,17 +464,18 @@ nv_table_deserialize_legacy(SerializeArchive *sa)
     }
   g_free(tmp);
 
-  res = (NVTable *)g_try_realloc(res, res->size);
+  res = (NVTable *)log_msg_slab_realloc(res, res->size);
 
   if (!res)
     return NULL;
 
   res->borrowed = FALSE;
   res->ref_cnt = 1;
+  res->index_hash_ofs = 0;
 
   if (!_deserialize_blob_v22(sa, res, nv_table_get_top(res), swap_bytes))
     {
-      g_free(res);
+      log_msg_slab_free(res);
       return NULL;
     }
 
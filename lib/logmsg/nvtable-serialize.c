@@ -27,6 +27,8 @@
 #include "logmsg/nvtable-serialize.h"
 #include "logmsg/nvtable-serialize-endianutils.h"
 #include "logmsg/logmsg.h"
+#include "logmsg/logmsg-slab.h"
+#include "scratch-buffers.h"
 #include "messages.h"
 
 #include <stdlib.h>
@@ -115,27 +117,37 @@ static gboolean
 _read_header(SerializeArchive *sa, NVTable **nvtable)
 {
   NVTable *res = NULL;
-  guint32 size;
+  guint32 size, used;
+  guint16 index_size;
+  guint8 num_static_entries;
 
   g_assert(*nvtable == NULL);
 
-  if (!serialize_read_uint32(sa, &size))
+  if (!serialize_read_uint32(sa, &size) ||
+      !serialize_read_uint32(sa, &used) ||
+      !serialize_read_uint16(sa, &index_size) ||
+      !serialize_read_uint8(sa, &num_static_entries))
     goto error;
 
-  if (size > NV_TABLE_MAX_BYTES)
+  if (size > NV_TABLE_MAX_BYTES || used > size)
     goto error;
 
-  res = (NVTable *) g_malloc(size);
-  res->size = size;
-
-  if (!serialize_read_uint32(sa, &res->used))
-    goto error;
-
-  if (!serialize_read_uint16(sa, &res->index_size))
-    goto error;
+  /* the serialized header lacks index_hash_ofs, make room for it, as the
+   * sender may have used up all the space in between, and for the index
+   * hash that we rebuild after loading.  Both are best effort within
+   * NV_TABLE_MAX_BYTES, nv_table_alloc_check() below validates that the
+   * serialized contents still fit. */
+  size += sizeof(NVTable) - NV_TABLE_SERIALIZED_HEADER_SIZE;
+  size += nv_table_get_index_hash_alloc_size(index_size);
+  if (size > NV_TABLE_MAX_BYTES)
+    size = NV_TABLE_MAX_BYTES;
 
-  if (!serialize_read_uint8(sa, &res->num_static_entries))
-    goto error;
+  res = (NVTable *) log_msg_slab_alloc(size);
+  res->size = size;
+  res->used = used;
+  res->index_size = index_size;
+  res->num_static_entries = num_static_entries;
+  res->index_hash_ofs = 0;
 
   /* static entries has to be known by this syslog-ng, if they are over
    * LM_V_MAX, that means we have no clue how an entry is called, as static
@@ -156,7 +168,7 @@ _read_header(SerializeArchive *sa, NVTable **nvtable)
 
 error:
   if (res)
-    g_free(res);
+    log_msg_slab_free(res);
   return FALSE;
 }
 
@@ -190,12 +202,13 @@ nv_table_deserialize(LogMessageSerializationState *state)
   if (_has_to_swap_bytes(meta_data.flags))
     nv_table_data_swap_bytes(res);
 
+  nv_table_build_index_hash(res);
 
   return res;
 
 error:
   if (res)
-    g_free(res);
+    log_msg_slab_free(res);
   return NULL;
 }
 
@@ -203,6 +216,15 @@ error:
  * serialize an NVTable
  **********************************************************************/
 
+static void
+_write_index(SerializeArchive *sa, NVTable *self)
+{
+  /* tables with a hashed index are compacted before serialization, see
+   * nv_table_has_unserializable_entries() */
+  g_assert(!self->index_hash_ofs);
+  serialize_write_uint32_array(sa, (guint32 *) nv_table_get_index(self), self->index_size * 2);
+}
+
 static void
 _write_struct(SerializeArchive *sa, NVTable *self)
 {
@@ -211,7 +233,7 @@ _write_struct(SerializeArchive *sa, NVTable *self)
   serialize_write_uint16(sa, self->index_size);
   serialize_write_uint8(sa, self->num_static_entries);
   serialize_write_uint32_array(sa, self->static_entries, self->num_static_entries);
-  serialize_write_uint32_array(sa, (guint32 *) nv_table_get_index(self), self->index_size * 2);
+  _write_index(sa, self);
 }
 
 static void
@@ -250,3 +272,465 @@ nv_table_serialize(LogMessageSerializationState *state, NVTable *self)
   _write_payload(sa, self);
   return TRUE;
 }
+
+/**********************************************************************
+ * name dictionary of the compact format
+ **********************************************************************/
+
+/*
+ * The compact format references the names of dynamic values by an id,
+ * instead of storing them in every message.  The ids are assigned by a
+ * dictionary that is kept in a storage area supplied by the owner
+ * (e.g. in the header of a disk-buffer file), as a sequence of
+ * [len][name] records, terminated by a zero length.
+ *
+ * Ids are never reassigned, so records remain readable as long as the
+ * storage is kept.  Once the storage fills up, names are stored inline.
+ *
+ * New names get their id right away, but they are only copied to the
+ * storage by nv_name_dict_commit(), which the owner calls once the
+ * records referencing them are written.  This way the storage never
+ * refers to records that were never stored, and the names become
+ * persistent together with the records.
+ */
+struct _NVNameDict
+{
+  GMutex lock;
+  gchar *storage;
+  gsize storage_size;
+  /* committed to the storage */
+  gsize storage_used;
+  /* [len][name] records waiting for nv_name_dict_commit() */
+  GString *pending;
+  /* NVHandle -> id + 1 */
+  GHashTable *ids;
+  /* id -> NVHandle */
+  GArray *handles;
+};
+
+static void
+_name_dict_register(NVNameDict *self, NVHandle handle)
+{
+  guint32 id = self->handles->len;
+
+  g_array_append_val(self->handles, handle);
+  g_hash_table_insert(self->ids, GUINT_TO_POINTER(handle), GUINT_TO_POINTER(id + 1));
+}
+
+static void
+_name_dict_load(NVNameDict *self)
+{
+  gchar name[256];
+
+  while (self->storage_used < self->storage_size)
+    {
+      guint8 name_len = self->storage[self->storage_used];
+
+      if (name_len == 0 || self->storage_used + 1 + name_len > self->storage_size)
+        break;
+
+      memcpy(name, &self->storage[self->storage_used + 1], name_len);
+      name[name_len] = 0;
+      _name_dict_register(self, log_msg_get_value_handle(name));
+      self->storage_used += name_len + 1;
+    }
+}
+
+/* returns the id of @handle, or -1 if the dictionary is full */
+static gint64
+_name_dict_lookup_or_add(NVNameDict *self, NVHandle handle, const gchar *name, gsize name_len)
+{
+  gint64 result = -1;
+
+  g_mutex_lock(&self->lock);
+  gpointer id = g_hash_table_lookup(self->ids, GUINT_TO_POINTER(handle));
+  if (id)
+    {
+      result = GPOINTER_TO_UINT(id) - 1;
+    }
+  /* the terminating zero length has to fit too */
+  else if (name_len > 0 && name_len <= G_MAXUINT8 &&
+           self->storage_used + self->pending->len + name_len + 2 <= self->storage_size)
+    {
+      g_string_append_c(self->pending, name_len);
+      g_string_append_len(self->pending, name, name_len);
+
+      _name_dict_register(self, handle);
+      result = self->handles->len - 1;
+    }
+  g_mutex_unlock(&self->lock);
+  return result;
+}
+
+static NVHandle
+_name_dict_get_handle(NVNameDict *self, guint32 id)
+{
+  NVHandle handle = 0;
+
+  g_mutex_lock(&self->lock);
+  if (id < self->handles->len)
+    handle = g_array_index(self->handles, NVHandle, id);
+  g_mutex_unlock(&self->lock);
+  return handle;
+}
+
+NVNameDict *
+nv_name_dict_new(gchar *storage, gsize storage_size)
+{
+  NVNameDict *self = g_new0(NVNameDict, 1);
+
+  g_mutex_init(&self->lock);
+  self->storage = storage;
+  self->storage_size = storage_size;
+  self->ids = g_hash_table_new(g_direct_hash, g_direct_equal);
+  self->handles = g_array_new(FALSE, FALSE, sizeof(NVHandle));
+  self->pending = g_string_new(NULL);
+  _name_dict_load(self);
+  return self;
+}
+
+/* copies the names added since the last call to the storage */
+void
+nv_name_dict_commit(NVNameDict *self)
+{
+  g_mutex_lock(&self->lock);
+  if (self->pending->len > 0)
+    {
+      memcpy(&self->storage[self->storage_used], self->pending->str, self->pending->len);
+      self->storage_used += self->pending->len;
+      self->storage[self->storage_used] = 0;
+      g_string_truncate(self->pending, 0);
+    }
+  g_mutex_unlock(&self->lock);
+}
+
+void
+nv_name_dict_free(NVNameDict *self)
+{
+  g_string_free(self->pending, TRUE);
+  g_hash_table_destroy(self->ids);
+  g_array_free(self->handles, TRUE);
+  g_mutex_clear(&self->lock);
+  g_free(self);
+}
+
+/**********************************************************************
+ * compact serialization of an NVTable
+ **********************************************************************/
+
+/*
+ * Entries are written one after the other, direct ones first, so that
+ * indirect entries can be added after the value they reference:
+ *
+ *   name-ref, kind, type, value
+ *
+ * where value is a varint length and the value itself for direct entries,
+ * the name-ref of the referenced value, varint offset and length for
+ * indirect ones and the 8 byte binary value for native ones.  Unset
+ * entries and unused space are not written at all.  The list is
+ * terminated by a zero name-ref.
+ *
+ * A name-ref is a varint, its low 2 bits select how the name is
+ * identified: by the handle of a builtin value, by an id in the name
+ * dictionary or by the name itself, following the name-ref.
+ */
+#define NV_NAME_REF_BUILTIN  0
+#define NV_NAME_REF_DICT     1
+#define NV_NAME_REF_INLINE   2
+
+#define NV_COMPACT_ENTRY_DIRECT    0
+#define NV_COMPACT_ENTRY_INDIRECT  1
+#define NV_COMPACT_ENTRY_NATIVE    2
+
+static void
+_write_name_ref(LogMessageSerializationState *state, NVHandle handle, const gchar *name, gsize name_len)
+{
+  SerializeArchive *sa = state->sa;
+
+  if (handle < LM_V_MAX)
+    {
+      serialize_write_varint(sa, ((guint64) handle << 2) | NV_NAME_REF_BUILTIN);
+      return;
+    }
+
+  if (state->name_dict)
+    {
+      gint64 id = _name_dict_lookup_or_add(state->name_dict, handle, name, name_len);
+
+      if (id >= 0)
+        {
+          serialize_write_varint(sa, ((guint64) id << 2) | NV_NAME_REF_DICT);
+          return;
+        }
+    }
+
+  serialize_write_varint(sa, ((guint64) name_len << 2) | NV_NAME_REF_INLINE);
+  serialize_write_blob(sa, name, name_len);
+}
+
+static gboolean
+_read_name_ref(LogMessageSerializationState *state, NVHandle *handle)
+{
+  SerializeArchive *sa = state->sa;
+  guint64 ref;
+
+  if (!serialize_read_varint(sa, &ref))
+    return FALSE;
+
+  guint64 value = ref >> 2;
+  switch (ref & 0x3)
+    {
+    case NV_NAME_REF_BUILTIN:
+      /* zero terminates the list of entries */
+      if (value >= LM_V_MAX)
+        return FALSE;
+      *handle = value;
+      return TRUE;
+
+    case NV_NAME_REF_DICT:
+      if (!state->name_dict || value > G_MAXUINT32)
+        return FALSE;
+      *handle = _name_dict_get_handle(state->name_dict, value);
+      return *handle != 0;
+
+    case NV_NAME_REF_INLINE:
+    {
+      gchar name[256];
+
+      if (value == 0 || value >= sizeof(name) || !serialize_read_blob(sa, name, value))
+        return FALSE;
+      name[value] = 0;
+      *handle = log_msg_get_value_handle(name);
+      return TRUE;
+    }
+
+    default:
+      return FALSE;
+    }
+}
+
+static const gchar *
+_get_entry_name(NVHandle handle, NVEntry *entry, gssize *name_len)
+{
+  if (handle < LM_V_MAX)
+    {
+      *name_len = 0;
+      return NULL;
+    }
+  *name_len = entry->name_len;
+  return nv_entry_get_name(entry);
+}
+
+static gboolean
+_write_compact_value_entry(NVHandle handle, NVEntry *entry, NVIndexEntry *index_entry, gpointer user_data)
+{
+  LogMessageSerializationState *state = (LogMessageSerializationState *) user_data;
+  SerializeArchive *sa = state->sa;
+  const gchar *name;
+  gssize name_len;
+
+  if (entry->unset || entry->indirect)
+    return FALSE;
+
+  name = _get_entry_name(handle, entry, &name_len);
+  _write_name_ref(state, handle, name, name_len);
+
+  if (entry->native)
+    {
+      NVNativeValue value;
+
+      nv_entry_get_native_value(entry, &value);
+      serialize_write_uint8(sa, NV_COMPACT_ENTRY_NATIVE);
+      serialize_write_uint8(sa, entry->type);
+      serialize_write_uint8(sa, value.kind);
+      serialize_write_uint64(sa, (guint64) value.i64);
+      return FALSE;
+    }
+
+  const gchar *value;
+  gsize value_len;
+
+  if (entry->external)
+    {
+      value = nv_entry_get_external_value(entry);
+      value_len = entry->vexternal.value_len;
+    }
+  else
+    {
+      value = entry->vdirect.data + entry->name_len + 1;
+      value_len = entry->vdirect.value_len;
+    }
+
+  serialize_write_uint8(sa, NV_COMPACT_ENTRY_DIRECT);
+  serialize_write_uint8(sa, entry->type);
+  serialize_write_varint(sa, value_len);
+  serialize_write_blob(sa, value, value_len);
+  return FALSE;
+}
+
+static gboolean
+_write_compact_indirect_entry(NVHandle handle, NVEntry *entry, NVIndexEntry *index_entry, gpointer user_data)
+{
+  LogMessageSerializationState *state = (LogMessageSerializationState *) user_data;
+  SerializeArchive *sa = state->sa;
+  const gchar *name;
+  gssize name_len;
+
+  if (entry->unset || !entry->indirect)
+    return FALSE;
+
+  name = _get_entry_name(handle, entry, &name_len);
+  _write_name_ref(state, handle, name, name_len);
+  serialize_write_uint8(sa, NV_COMPACT_ENTRY_INDIRECT);
+  serialize_write_uint8(sa, entry->type);
+
+  NVHandle ref_handle = entry->vindirect.handle;
+  name = log_msg_get_value_name(ref_handle, &name_len);
+  _write_name_ref(state, ref_handle, name, name_len);
+  serialize_write_varint(sa, entry->vindirect.ofs);
+  serialize_write_varint(sa, entry->vindirect.len);
+  return FALSE;
+}
+
+gboolean
+nv_table_serialize_compact(LogMessageSerializationState *state, NVTable *self)
+{
+  SerializeArchive *sa = state->sa;
+
+  /* size hints for the deserializer */
+  serialize_write_varint(sa, self->used);
+  serialize_write_varint(sa, self->index_size);
+
+  nv_table_foreach_entry(self, _write_compact_value_entry, state);
+  nv_table_foreach_entry(self, _write_compact_indirect_entry, state);
+  serialize_write_varint(sa, 0);
+
+  for (gint i = 0; i < state->msg->num_sdata; i++)
+    {
+      NVHandle handle = state->msg->sdata[i];
+      gssize name_len;
+      const gchar *name = log_msg_get_value_name(handle, &name_len);
+
+      _write_name_ref(state, handle, name, name_len);
+    }
+  return sa->error == NULL;
+}
+
+static gboolean
+_read_compact_entry(LogMessageSerializationState *state, NVHandle handle, GString *value_buffer)
+{
+  SerializeArchive *sa = state->sa;
+  LogMessage *msg = state->msg;
+  guint8 kind, type;
+
+  if (!serialize_read_uint8(sa, &kind) || !serialize_read_uint8(sa, &type))
+    return FALSE;
+
+  switch (kind)
+    {
+    case NV_COMPACT_ENTRY_DIRECT:
+    {
+      guint32 value_len;
+
+      if (!serialize_read_varint32(sa, &value_len) || value_len > NV_TABLE_MAX_BYTES)
+        return FALSE;
+
+      g_string_set_size(value_buffer, value_len);
+      if (!serialize_read_blob(sa, value_buffer->str, value_len))
+        return FALSE;
+      log_msg_set_value_with_type(msg, handle, value_buffer->str, value_len, type);
+      return TRUE;
+    }
+
+    case NV_COMPACT_ENTRY_INDIRECT:
+    {
+      NVHandle ref_handle;
+      guint32 ofs, len;
+
+      if (handle < LM_V_MAX ||
+          !_read_name_ref(state, &ref_handle) ||
+          !serialize_read_varint32(sa, &ofs) || ofs > G_MAXUINT16 ||
+          !serialize_read_varint32(sa, &len) || len > G_MAXUINT16)
+        return FALSE;
+      log_msg_set_value_indirect_with_type(msg, handle, ref_handle, ofs, len, type);
+      return TRUE;
+    }
+
+    case NV_COMPACT_ENTRY_NATIVE:
+    {
+      NVNativeValue value;
+      guint8 native_kind;
+      guint64 n;
+
+      if (!serialize_read_uint8(sa, &native_kind) || native_kind > NVN_DATETIME_MSEC ||
+          !serialize_read_uint64(sa, &n))
+        return FALSE;
+      value.kind = native_kind;
+      value.i64 = (gint64) n;
+      log_msg_set_value_native(msg, handle, &value, type);
+      return TRUE;
+    }
+
+    default:
+      return FALSE;
+    }
+}
+
+static gboolean
+_read_compact_entries(LogMessageSerializationState *state, GString *value_buffer)
+{
+  SerializeArchive *sa = state->sa;
+  LogMessage *msg = state->msg;
+  guint32 used, index_size;
+
+  if (!serialize_read_varint32(sa, &used) || used > NV_TABLE_MAX_BYTES ||
+      !serialize_read_varint32(sa, &index_size) || index_size > G_MAXUINT16)
+    return FALSE;
+
+  nv_table_unref(msg->payload);
+  msg->payload = nv_table_new(LM_V_MAX, index_size, used);
+
+  while (TRUE)
+    {
+      NVHandle handle;
+
+      if (!_read_name_ref(state, &handle))
+        return FALSE;
+      if (handle == LM_V_NONE)
+        break;
+      if (!_read_compact_entry(state, handle, value_buffer))
+        return FALSE;
+    }
+  return TRUE;
+}
+
+static gboolean
+_read_compact_sdata(LogMessageSerializationState *state, guint8 num_sdata)
+{
+  LogMessage *msg = state->msg;
+
+  /* setting the values has already collected the SDATA handles, but
+   * possibly in a different order */
+  g_free(msg->sdata);
+  msg->sdata = num_sdata ? g_new(NVHandle, num_sdata) : NULL;
+  msg->num_sdata = msg->alloc_sdata = 0;
+  for (gint i = 0; i < num_sdata; i++)
+    {
+      if (!_read_name_ref(state, &msg->sdata[i]))
+        return FALSE;
+      msg->alloc_sdata = msg->num_sdata = i + 1;
+    }
+  return TRUE;
+}
+
+gboolean
+nv_table_deserialize_compact(LogMessageSerializationState *state, guint8 num_sdata)
+{
+  ScratchBuffersMarker marker;
+  GString *value_buffer = scratch_buffers_alloc_and_mark(&marker);
+
+  gboolean success = _read_compact_entries(state, value_buffer) && _read_compact_sdata(state, num_sdata);
+
+  scratch_buffers_reclaim_marked(marker);
+  return success;
+}
@@ -40,4 +40,11 @@ NVTable *nv_table_deserialize(LogMessageSerializationState *state);
 gboolean nv_table_serialize(LogMessageSerializationState *state, NVTable *self);
 gboolean nv_table_fixup_handles(LogMessageSerializationState *state);
 
+gboolean nv_table_serialize_compact(LogMessageSerializationState *state, NVTable *self);
+gboolean nv_table_deserialize_compact(LogMessageSerializationState *state, guint8 num_sdata);
+
+NVNameDict *nv_name_dict_new(gchar *storage, gsize storage_size);
+void nv_name_dict_commit(NVNameDict *self);
+void nv_name_dict_free(NVNameDict *self);
+
 #endif
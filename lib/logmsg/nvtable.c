@@ -22,6 +22,7 @@
  *
  */
 #include "logmsg/nvtable.h"
+#include "logmsg/logmsg-slab.h"
 #include "messages.h"
 
 #include <string.h>
@@ -31,32 +32,157 @@ static GMutex nv_registry_lock;
 
 const gchar *null_string = "";
 
+/*
+ * NVRegistryLookupIndex
+ *
+ * An open addressing hash table with linear probing, which only ever grows:
+ * slots are never removed and a slot's name never changes once set.  The
+ * name pointer is published last, so a reader that sees a non-NULL name
+ * also sees the hash and the handle that belong to it.  The handle of an
+ * existing slot may change, when an alias is redefined.
+ *
+ * Writers are serialized by nv_registry_lock.
+ */
+typedef struct _NVRegistryLookupSlot
+{
+  gchar *name;
+  guint32 hash;
+  NVHandle handle;
+} NVRegistryLookupSlot;
+
+struct _NVRegistryLookupIndex
+{
+  guint32 mask;
+  guint32 count;
+  NVRegistryLookupSlot slots[];
+};
+
+#define NV_REGISTRY_LOOKUP_INDEX_INITIAL_SIZE 1024
+
+static NVRegistryLookupIndex *
+_lookup_index_new(guint32 size)
+{
+  NVRegistryLookupIndex *self = g_malloc0(sizeof(NVRegistryLookupIndex) + size * sizeof(NVRegistryLookupSlot));
+
+  self->mask = size - 1;
+  return self;
+}
+
+static inline NVRegistryLookupSlot *
+_lookup_index_find_slot(NVRegistryLookupIndex *self, const gchar *name, guint32 hash)
+{
+  for (guint32 i = hash & self->mask; ; i = (i + 1) & self->mask)
+    {
+      NVRegistryLookupSlot *slot = &self->slots[i];
+      const gchar *slot_name = g_atomic_pointer_get(&slot->name);
+
+      if (!slot_name || (slot->hash == hash && strcmp(slot_name, name) == 0))
+        return slot;
+    }
+}
+
+static void
+_lookup_index_publish_slot(NVRegistryLookupSlot *slot, gchar *name, guint32 hash, NVHandle handle)
+{
+  slot->hash = hash;
+  g_atomic_int_set(&slot->handle, handle);
+  g_atomic_pointer_set(&slot->name, name);
+}
+
+static void
+_lookup_index_grow(NVRegistry *self)
+{
+  NVRegistryLookupIndex *old_index = self->lookup_index;
+  NVRegistryLookupIndex *new_index = _lookup_index_new((old_index->mask + 1) * 2);
+
+  for (guint32 i = 0; i <= old_index->mask; i++)
+    {
+      NVRegistryLookupSlot *old_slot = &old_index->slots[i];
+
+      if (!old_slot->name)
+        continue;
+
+      NVRegistryLookupSlot *new_slot = _lookup_index_find_slot(new_index, old_slot->name, old_slot->hash);
+      *new_slot = *old_slot;
+    }
+  new_index->count = old_index->count;
+
+  g_atomic_pointer_set(&self->lookup_index, new_index);
+  g_ptr_array_add(self->retired_lookup_indexes, old_index);
+}
+
+/* must be called with nv_registry_lock held */
+static void
+_lookup_index_insert(NVRegistry *self, const gchar *name, NVHandle handle)
+{
+  guint32 hash = g_str_hash(name);
+  NVRegistryLookupSlot *slot = _lookup_index_find_slot(self->lookup_index, name, hash);
+
+  if (slot->name)
+    {
+      g_atomic_int_set(&slot->handle, handle);
+      return;
+    }
+
+  /* keep the load factor below 50% */
+  if ((self->lookup_index->count + 1) * 2 > self->lookup_index->mask + 1)
+    {
+      _lookup_index_grow(self);
+      slot = _lookup_index_find_slot(self->lookup_index, name, hash);
+    }
+
+  _lookup_index_publish_slot(slot, g_strdup(name), hash, handle);
+  self->lookup_index->count++;
+}
+
+static void
+_lookup_index_free_all(NVRegistry *self)
+{
+  NVRegistryLookupIndex *index = self->lookup_index;
+
+  /* the current index contains all names, older ones only a subset */
+  for (guint32 i = 0; i <= index->mask; i++)
+    g_free(index->slots[i].name);
+  g_free(index);
+  g_ptr_array_free(self->retired_lookup_indexes, TRUE);
+}
+
+static inline NVHandle
+_lookup_handle(NVRegistry *self, const gchar *name)
+{
+  NVRegistryLookupIndex *index = g_atomic_pointer_get(&self->lookup_index);
+  NVRegistryLookupSlot *slot = _lookup_index_find_slot(index, name, g_str_hash(name));
+
+  if (!g_atomic_pointer_get(&slot->name))
+    return 0;
+  return g_atomic_int_get(&slot->handle);
+}
+
 NVHandle
 nv_registry_get_handle(NVRegistry *self, const gchar *name)
 {
-  gpointer p;
-
-  p = g_hash_table_lookup(self->name_map, name);
-  if (p)
-    return GPOINTER_TO_UINT(p);
-  return 0;
+  return _lookup_handle(self, name);
 }
 
 NVHandle
 nv_registry_alloc_handle(NVRegistry *self, const gchar *name)
 {
-  gpointer p;
   NVHandleDesc stored;
   gsize len;
-  NVHandle res = 0;
+  NVHandle res;
+
+  /* fast path: the name is already known, which is the case for all but
+   * the first occurrence of a name */
+  res = _lookup_handle(self, name);
+  if (res)
+    return res;
 
   g_mutex_lock(&nv_registry_lock);
-  p = g_hash_table_lookup(self->name_map, name);
-  if (p)
-    {
-      res = GPOINTER_TO_UINT(p);
-      goto exit;
-    }
+
+  /* someone else may have allocated it since we looked */
+  res = _lookup_handle(self, name);
+  if (res)
+    goto exit;
 
   len = strlen(name);
   if (len == 0)
@@ -87,6 +213,9 @@ nv_registry_alloc_handle(NVRegistry *self, const gchar *name)
   nvhandle_desc_array_append(self->names, &stored);
   g_hash_table_insert(self->name_map, g_strdup(name), GUINT_TO_POINTER(self->names->len));
   res = self->names->len;
+
+  /* publish the handle only after its descriptor is in place */
+  _lookup_index_insert(self, name, res);
 exit:
   g_mutex_unlock(&nv_registry_lock);
   return res;
@@ -102,6 +231,7 @@ nv_registry_add_alias(NVRegistry *self, NVHandle handle, const gchar *alias)
 {
   g_mutex_lock(&nv_registry_lock);
   g_hash_table_insert(self->name_map, g_strdup(alias), GUINT_TO_POINTER((glong) handle));
+  _lookup_index_insert(self, alias, handle);
   g_mutex_unlock(&nv_registry_lock);
 }
 
@@ -148,6 +278,8 @@ nv_registry_new(const gchar **static_names, guint32 nvhandle_max_value)
   self->nvhandle_max_value = nvhandle_max_value;
   self->name_map = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
   self->names = nvhandle_desc_array_new(NVHANDLE_DESC_ARRAY_INITIAL_SIZE);
+  self->lookup_index = _lookup_index_new(NV_REGISTRY_LOOKUP_INDEX_INITIAL_SIZE);
+  self->retired_lookup_indexes = g_ptr_array_new_with_free_func(g_free);
   for (i = 0; static_names[i]; i++)
     {
       nv_registry_alloc_handle(self, static_names[i]);
@@ -160,6 +292,7 @@ nv_registry_free(NVRegistry *self)
 {
   nvhandle_desc_array_free(self->names);
   g_hash_table_destroy(self->name_map);
+  _lookup_index_free_all(self);
   g_free(self);
 }
 
@@ -222,13 +355,23 @@ nv_table_resolve_indirect(NVTable *self, NVEntry *entry, gssize *length)
 static inline const gchar *
 nv_table_resolve_direct(NVTable *self, NVEntry *entry, gssize *length)
 {
-  g_assert(!entry->indirect);
+  g_assert(!entry->indirect && !entry->external && !entry->native);
 
   if (length)
     *length = entry->vdirect.value_len;
   return entry->vdirect.data + entry->name_len + 1;
 }
 
+static inline const gchar *
+nv_table_resolve_external(NVTable *self, NVEntry *entry, gssize *length)
+{
+  g_assert(entry->external);
+
+  if (length)
+    *length = entry->vexternal.value_len;
+  return nv_entry_get_external_value(entry);
+}
+
 static inline const gchar *
 nv_table_resolve_entry(NVTable *self, NVEntry *entry, gssize *length, NVType *type)
 {
@@ -246,6 +389,10 @@ nv_table_resolve_entry(NVTable *self, NVEntry *entry, gssize *length, NVType *ty
 
   if (entry->indirect)
     return nv_table_resolve_indirect(self, entry, length);
+  else if (entry->external)
+    return nv_table_resolve_external(self, entry, length);
+  else if (entry->native)
+    return nv_entry_get_native_rendered_value(entry, length);
   else
     return nv_table_resolve_direct(self, entry, length);
 }
@@ -292,6 +439,155 @@ _find_index_entry(NVIndexEntry *index_table, gint index_size, NVHandle handle, N
   return NULL;
 }
 
+static gint
+_index_entry_cmp(const void *a, const void *b)
+{
+  const NVIndexEntry *entry_a = (const NVIndexEntry *) a;
+  const NVIndexEntry *entry_b = (const NVIndexEntry *) b;
+
+  if (entry_a->handle == entry_b->handle)
+    return 0;
+  return entry_a->handle < entry_b->handle ? -1 : 1;
+}
+
+/* Index hash
+ *
+ * An open addressing hash with linear probing that maps handles to
+ * positions in the index.  Slots store the position plus one, so that zero
+ * can mean an empty slot.  It is stored in the name-value area, so it gets
+ * copied along with the rest of the payload by nv_table_clone() and
+ * nv_table_realloc() and as it only contains offsets, it remains valid in
+ * the copy.
+ */
+typedef struct _NVIndexHash
+{
+  guint32 num_slots_log2;
+  guint16 slots[];
+} NVIndexHash;
+
+#define NV_INDEX_HASH_MIN_SLOTS_LOG2 8
+
+static inline gsize
+_index_hash_get_alloc_size(guint32 num_slots_log2)
+{
+  return NV_TABLE_BOUND(sizeof(NVIndexHash) + (sizeof(guint16) << num_slots_log2));
+}
+
+static inline NVIndexHash *
+_index_hash_get(NVTable *self)
+{
+  return (NVIndexHash *) (nv_table_get_top(self) - self->index_hash_ofs);
+}
+
+static inline guint32
+_index_hash_get_bucket(NVIndexHash *hash, NVHandle handle)
+{
+  /* Fibonacci hashing, handles are allocated sequentially, so we need to
+   * spread them */
+  return (handle * 2654435769U) >> (32 - hash->num_slots_log2);
+}
+
+static inline NVIndexEntry *
+_index_hash_lookup(NVIndexHash *hash, NVIndexEntry *index_table, NVHandle handle)
+{
+  guint32 mask = (1 << hash->num_slots_log2) - 1;
+
+  for (guint32 i = _index_hash_get_bucket(hash, handle); hash->slots[i]; i = (i + 1) & mask)
+    {
+      NVIndexEntry *index_entry = &index_table[hash->slots[i] - 1];
+
+      if (index_entry->handle == handle)
+        return index_entry;
+    }
+  return NULL;
+}
+
+static inline void
+_index_hash_insert(NVIndexHash *hash, NVIndexEntry *index_table, guint16 position)
+{
+  guint32 mask = (1 << hash->num_slots_log2) - 1;
+  guint32 i = _index_hash_get_bucket(hash, index_table[position].handle);
+
+  while (hash->slots[i])
+    i = (i + 1) & mask;
+  hash->slots[i] = position + 1;
+}
+
+/* keep the load factor below 50% */
+static inline gboolean
+_index_hash_has_room_for(NVIndexHash *hash, gint index_size)
+{
+  return (index_size << 1) <= (1 << hash->num_slots_log2);
+}
+
+/* allocates a new hash in the name-value area and fills it from the
+ * current index, the space of the previous hash (if any) is lost until the
+ * next nv_table_compact() */
+static guint32
+_index_hash_get_num_slots_log2(gint index_size)
+{
+  guint32 num_slots_log2 = NV_INDEX_HASH_MIN_SLOTS_LOG2;
+
+  while ((index_size << 2) > (1 << num_slots_log2))
+    num_slots_log2++;
+  return num_slots_log2;
+}
+
+static gboolean
+_index_hash_build(NVTable *self, gint index_size, gsize reserve)
+{
+  guint32 num_slots_log2 = _index_hash_get_num_slots_log2(index_size);
+  gsize alloc_size = _index_hash_get_alloc_size(num_slots_log2);
+  if (!nv_table_alloc_check(self, alloc_size + reserve))
+    return FALSE;
+
+  self->used += alloc_size;
+  self->index_hash_ofs = self->used;
+
+  NVIndexHash *hash = _index_hash_get(self);
+  NVIndexEntry *index_table = nv_table_get_index(self);
+
+  hash->num_slots_log2 = num_slots_log2;
+  memset(hash->slots, 0, sizeof(guint16) << num_slots_log2);
+  for (gint i = 0; i < self->index_size; i++)
+    _index_hash_insert(hash, index_table, i);
+  return TRUE;
+}
+
+/* fall back to the sorted index */
+static void
+_index_hash_drop(NVTable *self)
+{
+  qsort(nv_table_get_index(self), self->index_size, sizeof(NVIndexEntry), _index_entry_cmp);
+  self->index_hash_ofs = 0;
+}
+
+static void
+_try_build_index_hash(NVTable *self)
+{
+  if (self->index_hash_ofs || self->index_size < NV_TABLE_INDEX_HASH_THRESHOLD)
+    return;
+
+  _index_hash_build(self, self->index_size, 0);
+}
+
+/* the room needed for the hash of an index with @index_size entries, zero
+ * if it would not be hashed */
+gsize
+nv_table_get_index_hash_alloc_size(gint index_size)
+{
+  if (index_size < NV_TABLE_INDEX_HASH_THRESHOLD)
+    return 0;
+  return _index_hash_get_alloc_size(_index_hash_get_num_slots_log2(index_size));
+}
+
+/* used after deserialization, the hash itself is never serialized */
+void
+nv_table_build_index_hash(NVTable *self)
+{
+  _try_build_index_hash(self);
+}
+
 /* slow path for nv_table_get_entry(), i.e.  we need to perform the lookup
  * for handle in the sorted index_table by implementing a binary search.
  *
@@ -308,12 +604,26 @@ _find_index_entry(NVIndexEntry *index_table, gint index_size, NVHandle handle, N
  *
  * In case the handle is present in NVTable, both index_entry and index_slot
  * will point to the same location.
+ *
+ * If the index is hashed, new entries are appended, so index_slot points
+ * right after the last index entry.
  */
 
 NVEntry *
 nv_table_get_entry_slow(NVTable *self, NVHandle handle, NVIndexEntry **index_entry, NVIndexEntry **index_slot)
 {
-  *index_entry = _find_index_entry(nv_table_get_index(self), self->index_size, handle, index_slot);
+  NVIndexEntry *index_table = nv_table_get_index(self);
+
+  if (self->index_hash_ofs)
+    {
+      *index_entry = _index_hash_lookup(_index_hash_get(self), index_table, handle);
+      *index_slot = *index_entry ? *index_entry : &index_table[self->index_size];
+    }
+  else
+    {
+      *index_entry = _find_index_entry(index_table, self->index_size, handle, index_slot);
+    }
+
   if (*index_entry)
     return nv_table_get_entry_at_ofs(self, (*index_entry)->ofs);
   return NULL;
@@ -330,6 +640,17 @@ _alloc_index_entry(NVTable *self, NVHandle handle, NVIndexEntry **index_entry, N
       if (!nv_table_alloc_check(self, sizeof(index_table[0])))
         return FALSE;
 
+      if (self->index_hash_ofs && !_index_hash_has_room_for(_index_hash_get(self), self->index_size + 1))
+        {
+          /* grow the hash if we can afford it without failing this
+           * allocation, otherwise revert to a sorted index */
+          if (!_index_hash_build(self, self->index_size + 1, sizeof(index_table[0])))
+            {
+              _index_hash_drop(self);
+              _find_index_entry(index_table, self->index_size, handle, &index_slot);
+            }
+        }
+
       NVIndexEntry *index_top = index_table + self->index_size;
       if (index_slot != index_top)
         {
@@ -344,6 +665,9 @@ _alloc_index_entry(NVTable *self, NVHandle handle, NVIndexEntry **index_entry, N
       (*index_entry)->handle = handle;
       (*index_entry)->ofs    = 0;
       self->index_size++;
+
+      if (self->index_hash_ofs)
+        _index_hash_insert(_index_hash_get(self), index_table, index_slot - index_table);
     }
   return TRUE;
 }
@@ -413,7 +737,7 @@ _overwrite_with_a_direct_entry(NVTable *self, NVHandle handle, NVEntry *entry, c
   gchar *dst;
 
   /* this value already exists and the new value fits in the old space */
-  if (!entry->indirect)
+  if (!entry->indirect && !entry->external && !entry->native)
     {
       dst = entry->vdirect.data + entry->name_len + 1;
 
@@ -423,8 +747,10 @@ _overwrite_with_a_direct_entry(NVTable *self, NVHandle handle, NVEntry *entry, c
     }
   else
     {
-      /* this was an indirect entry, convert it */
+      /* this was an indirect, external or native entry, convert it */
       entry->indirect = 0;
+      entry->external = 0;
+      entry->native = 0;
       entry->vdirect.value_len = value_len;
 
       if (!nv_table_is_handle_static(self, handle))
@@ -527,6 +853,14 @@ nv_table_unset_value(NVTable *self, NVHandle handle)
     }
   else
     {
+      if (entry->external || entry->native)
+        {
+          /* turn it into a direct entry, an empty one fits into the same space */
+          memmove(entry->vdirect.data, nv_entry_get_name(entry), entry->name_len);
+          entry->vdirect.data[entry->name_len] = 0;
+          entry->external = 0;
+          entry->native = 0;
+        }
       entry->vdirect.value_len = 0;
       entry->vdirect.data[entry->name_len + 1] = 0;
     }
@@ -547,8 +881,10 @@ nv_table_set_indirect_entry(NVTable *self, NVHandle handle, NVEntry *entry, cons
   if (entry->indirect)
     return;
 
-  /* previously a non-indirect entry, convert it */
+  /* previously a direct, external or native entry, convert it */
   entry->indirect = 1;
+  entry->external = 0;
+  entry->native = 0;
 
   if (!nv_table_is_handle_static(self, handle))
     {
@@ -594,10 +930,11 @@ nv_table_add_value_indirect(NVTable *self, NVHandle handle, const gchar *name, g
     *new_entry = FALSE;
   ref_entry = nv_table_get_entry(self, referenced_slice->handle, NULL, NULL);
 
-  if ((ref_entry && ref_entry->indirect) || handle == referenced_slice->handle)
+  if ((ref_entry && (ref_entry->indirect || ref_entry->native)) || handle == referenced_slice->handle)
     {
       /* NOTE: uh-oh, the to-be-referenced value is already an indirect
-       * reference, this is not supported, copy the stuff */
+       * reference or a native value, this is not supported, copy the
+       * stuff */
       return nv_table_copy_referenced_value(self, ref_entry, handle, name, name_len, referenced_slice, type, new_entry);
     }
 
@@ -645,6 +982,252 @@ nv_table_add_value_indirect(NVTable *self, NVHandle handle, const gchar *name, g
   return TRUE;
 }
 
+static void
+nv_table_set_external_entry(NVTable *self, NVHandle handle, NVEntry *entry, const gchar *name, gsize name_len,
+                            const gchar *value, gsize value_len, NVType type)
+{
+  if (!entry->external)
+    {
+      /* previously a direct, indirect or native entry, convert it */
+      entry->indirect = 0;
+      entry->native = 0;
+      entry->external = 1;
+
+      if (!nv_table_is_handle_static(self, handle))
+        {
+          entry->name_len = name_len;
+          memmove(entry->vexternal.name, name, name_len + 1);
+        }
+      else
+        {
+          entry->name_len = 0;
+        }
+    }
+  entry->vexternal.value_len = value_len;
+  memcpy(entry->vexternal.value_ptr, &value, sizeof(value));
+  entry->type = type;
+  entry->unset = FALSE;
+}
+
+/*
+ * Store a value that lives outside of the NVTable, see "External values"
+ * in nvtable.h.  The value must be NUL terminated and the caller is
+ * responsible for keeping it alive as long as the NVTable references it.
+ */
+gboolean
+nv_table_add_value_external(NVTable *self, NVHandle handle, const gchar *name, gsize name_len,
+                            const gchar *value, gsize value_len, NVType type, gboolean *new_entry)
+{
+  NVEntry *entry;
+  NVIndexEntry *index_entry, *index_slot;
+  guint32 ofs;
+
+  g_assert(value[value_len] == 0);
+
+  if (value_len > NV_TABLE_MAX_BYTES)
+    value_len = NV_TABLE_MAX_BYTES;
+  if (new_entry)
+    *new_entry = FALSE;
+  entry = nv_table_get_entry(self, handle, &index_entry, &index_slot);
+  if (!nv_table_break_references_to_entry(self, handle, entry))
+    return FALSE;
+
+  if (entry && entry->alloc_len >= NV_ENTRY_EXTERNAL_SIZE(entry->name_len))
+    {
+      nv_table_set_external_entry(self, handle, entry, name, entry->name_len, value, value_len, type);
+      return TRUE;
+    }
+  else if (!entry && new_entry)
+    *new_entry = TRUE;
+
+  if (!_alloc_index_entry(self, handle, &index_entry, index_slot))
+    return FALSE;
+
+  if (nv_table_is_handle_static(self, handle))
+    name_len = 0;
+
+  entry = nv_table_alloc_value(self, NV_ENTRY_EXTERNAL_SIZE(name_len));
+  if (G_UNLIKELY(!entry))
+    return FALSE;
+
+  ofs = nv_table_get_ofs_for_an_entry(self, entry);
+  nv_table_set_external_entry(self, handle, entry, name, name_len, value, value_len, type);
+  nv_table_set_table_entry(self, handle, ofs, index_entry);
+  return TRUE;
+}
+
+static void
+nv_table_set_native_entry(NVTable *self, NVHandle handle, NVEntry *entry, const gchar *name, gsize name_len,
+                          const NVNativeValue *value, NVType type)
+{
+  if (!entry->native)
+    {
+      /* previously a direct, indirect or external entry, convert it */
+      entry->indirect = 0;
+      entry->external = 0;
+      entry->native = 1;
+
+      if (!nv_table_is_handle_static(self, handle))
+        {
+          entry->name_len = name_len;
+          memmove(entry->vnative.name, name, name_len + 1);
+        }
+      else
+        {
+          entry->name_len = 0;
+        }
+    }
+  entry->vnative.kind = value->kind;
+  memcpy(entry->vnative.value, &value->i64, sizeof(value->i64));
+  /* rendered on demand, see nv_entry_get_native_rendered_value() */
+  entry->vnative.value_len = 0;
+  entry->type = type;
+  entry->unset = FALSE;
+}
+
+/*
+ * Store a value in binary form, see "Native values" in nvtable.h.
+ */
+gboolean
+nv_table_add_value_native(NVTable *self, NVHandle handle, const gchar *name, gsize name_len,
+                          const NVNativeValue *value, NVType type, gboolean *new_entry)
+{
+  NVEntry *entry;
+  NVIndexEntry *index_entry, *index_slot;
+  guint32 ofs;
+  gsize rendered_len = nv_native_value_format_bound(value);
+
+  if (new_entry)
+    *new_entry = FALSE;
+  entry = nv_table_get_entry(self, handle, &index_entry, &index_slot);
+  if (!nv_table_break_references_to_entry(self, handle, entry))
+    return FALSE;
+
+  if (entry && entry->alloc_len >= NV_ENTRY_NATIVE_SIZE(entry->name_len, rendered_len))
+    {
+      nv_table_set_native_entry(self, handle, entry, name, entry->name_len, value, type);
+      return TRUE;
+    }
+  else if (!entry && new_entry)
+    *new_entry = TRUE;
+
+  if (!_alloc_index_entry(self, handle, &index_entry, index_slot))
+    return FALSE;
+
+  if (nv_table_is_handle_static(self, handle))
+    name_len = 0;
+
+  entry = nv_table_alloc_value(self, NV_ENTRY_NATIVE_SIZE(name_len, rendered_len));
+  if (G_UNLIKELY(!entry))
+    return FALSE;
+
+  ofs = nv_table_get_ofs_for_an_entry(self, entry);
+  nv_table_set_native_entry(self, handle, entry, name, name_len, value, type);
+  nv_table_set_table_entry(self, handle, ofs, index_entry);
+  return TRUE;
+}
+
+/* render @value into @buffer and return its length, the formats match what
+ * json-parser() used to store for these types */
+gsize
+nv_native_value_format(const NVNativeValue *value, gchar *buffer, gsize buffer_size)
+{
+  gint len;
+
+  switch (value->kind)
+    {
+    case NVN_INT64:
+      len = g_snprintf(buffer, buffer_size, "%" G_GINT64_FORMAT, value->i64);
+      break;
+    case NVN_DOUBLE:
+      len = g_snprintf(buffer, buffer_size, "%f", value->d);
+      break;
+    case NVN_BOOLEAN:
+      len = g_snprintf(buffer, buffer_size, "%s", value->i64 ? "true" : "false");
+      break;
+    case NVN_DATETIME_MSEC:
+    {
+      gint64 sec = value->i64 / 1000;
+      gint msec = value->i64 % 1000;
+
+      if (msec < 0)
+        {
+          sec--;
+          msec += 1000;
+        }
+      len = g_snprintf(buffer, buffer_size, "%" G_GINT64_FORMAT ".%03d", sec, msec);
+      break;
+    }
+    default:
+      g_assert_not_reached();
+    }
+
+  return MIN((gsize) len, buffer_size - 1);
+}
+
+/* the maximum length nv_native_value_format() renders @value to, without
+ * rendering it */
+gsize
+nv_native_value_format_bound(const NVNativeValue *value)
+{
+  switch (value->kind)
+    {
+    case NVN_INT64:
+      /* -9223372036854775808 */
+      return 20;
+    case NVN_DOUBLE:
+      /* sign, up to 18 integral digits, the dot and 6 decimals */
+      if (value->d > -1e18 && value->d < 1e18)
+        return 26;
+      return NV_NATIVE_VALUE_FORMAT_MAX - 1;
+    case NVN_BOOLEAN:
+      return 5;
+    case NVN_DATETIME_MSEC:
+      /* sign, up to 16 digits of seconds, the dot and 3 decimals */
+      return 21;
+    default:
+      g_assert_not_reached();
+    }
+}
+
+/*
+ * Render the string representation of a native entry into the space that
+ * was reserved for it when the value was set.  Messages are read by
+ * multiple threads at the same time, which may render the same value
+ * concurrently: they write the same bytes, and the length is only
+ * published once the rendering is complete.
+ */
+guint32
+nv_entry_render_native_value(NVEntry *self)
+{
+  NVNativeValue value;
+  gchar *rendered = self->vnative.name + self->name_len + 1;
+
+  g_assert(self->native);
+
+  nv_entry_get_native_value(self, &value);
+  guint32 value_len = nv_native_value_format(&value, rendered, nv_native_value_format_bound(&value) + 1);
+  g_atomic_int_set((gint *) &self->vnative.value_len, value_len);
+  return value_len;
+}
+
+static gboolean
+_is_entry_unserializable(NVHandle handle, NVEntry *entry, NVIndexEntry *index_entry, gpointer user_data)
+{
+  return entry->external || entry->native;
+}
+
+/* external and native entries have to be compacted before serialization,
+ * and so do tables with a hashed index: compaction drops the hash from
+ * the name-value area and sorts the index */
+gboolean
+nv_table_has_unserializable_entries(NVTable *self)
+{
+  if (self->index_hash_ofs)
+    return TRUE;
+  return nv_table_foreach_entry(self, _is_entry_unserializable, NULL);
+}
+
 static gboolean
 nv_table_call_foreach(NVHandle handle, NVEntry *entry, NVIndexEntry *index_entry, gpointer user_data)
 {
@@ -713,6 +1296,7 @@ nv_table_init(NVTable *self, gsize alloc_length, gint num_static_entries)
   self->num_static_entries = num_static_entries;
   self->ref_cnt = 1;
   self->borrowed = FALSE;
+  self->index_hash_ofs = 0;
   memset(&self->static_entries[0], 0, self->num_static_entries * sizeof(self->static_entries[0]));
 }
 
@@ -723,7 +1307,7 @@ nv_table_new(gint num_static_entries, gint index_size_hint, gint init_length)
   gsize alloc_length;
 
   alloc_length = nv_table_get_alloc_size(num_static_entries, index_size_hint, init_length);
-  self = (NVTable *) g_malloc(alloc_length);
+  self = (NVTable *) log_msg_slab_alloc(alloc_length);
 
   nv_table_init(self, alloc_length, num_static_entries);
   return self;
@@ -752,12 +1336,12 @@ nv_table_realloc(NVTable *self, NVTable **new_nv_table)
   new_size = ((gsize) self->size) << 1;
   if (new_size > NV_TABLE_MAX_BYTES)
     new_size = NV_TABLE_MAX_BYTES;
-  if (new_size == old_size)
+  if (new_size <= old_size)
     return FALSE;
 
   if (self->ref_cnt == 1 && !self->borrowed)
     {
-      *new_nv_table = self = g_realloc(self, new_size);
+      *new_nv_table = self = log_msg_slab_realloc(self, new_size);
 
       self->size = new_size;
       /* move the downwards growing region to the end of the new buffer */
@@ -767,7 +1351,7 @@ nv_table_realloc(NVTable *self, NVTable **new_nv_table)
     }
   else
     {
-      *new_nv_table = g_malloc(new_size);
+      *new_nv_table = log_msg_slab_alloc(new_size);
 
       /* we only copy the header first */
       memcpy(*new_nv_table, self, sizeof(NVTable) + self->num_static_entries * sizeof(self->static_entries[0]) +
@@ -782,6 +1366,10 @@ nv_table_realloc(NVTable *self, NVTable **new_nv_table)
 
       nv_table_unref(self);
     }
+
+  /* we have just doubled our size, so there should be plenty of space for
+   * the hash */
+  _try_build_index_hash(*new_nv_table);
   return TRUE;
 }
 
@@ -797,7 +1385,7 @@ nv_table_unref(NVTable *self)
 {
   if ((--self->ref_cnt == 0) && !self->borrowed)
     {
-      g_free(self);
+      log_msg_slab_free(self);
     }
 }
 
@@ -822,7 +1410,7 @@ nv_table_clone(NVTable *self, gint additional_space)
   if (new_size > NV_TABLE_MAX_BYTES)
     new_size = NV_TABLE_MAX_BYTES;
 
-  new = g_malloc(new_size);
+  new = log_msg_slab_alloc(new_size);
   memcpy(new, self, sizeof(NVTable) + self->num_static_entries * sizeof(self->static_entries[0]) + self->index_size *
          sizeof(NVIndexEntry));
   new->size = new_size;
@@ -866,7 +1454,8 @@ _compact_foreach_entry(NVHandle handle, NVEntry *entry, NVIndexEntry *index_entr
 
   if (!entry->indirect)
     {
-      value = nv_table_resolve_direct(old, entry, &value_len);
+      /* external and native values are copied into the new table as strings */
+      value = nv_table_resolve_entry(old, entry, &value_len, NULL);
 
       gboolean value_successfully_added =
         nv_table_add_value(new, handle,
@@ -898,7 +1487,7 @@ NVTable *
 nv_table_compact(NVTable *self)
 {
   gint new_size = self->size;
-  NVTable *new = g_malloc(new_size);
+  NVTable *new = log_msg_slab_alloc(new_size);
   gpointer args[2] = { self, new };
 
   nv_table_init(new, new_size, self->num_static_entries);
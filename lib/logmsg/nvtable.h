@@ -28,10 +28,13 @@
 #include "syslog-ng.h"
 #include "nvhandle-descriptors.h"
 
+#include <string.h>
+
 typedef struct _NVTable NVTable;
 typedef struct _NVRegistry NVRegistry;
 typedef struct _NVIndexEntry NVIndexEntry;
 typedef struct _NVEntry NVEntry;
+typedef struct _NVNativeValue NVNativeValue;
 typedef guint32 NVHandle;
 typedef guint8 NVType;
 typedef gboolean (*NVTableForeachFunc)(NVHandle handle, const gchar *name,
@@ -57,6 +60,8 @@ struct _NVIndexEntry
   guint32 ofs;
 };
 
+typedef struct _NVRegistryLookupIndex NVRegistryLookupIndex;
+
 struct _NVRegistry
 {
   /* number of static names that are statically allocated in each payload */
@@ -64,6 +69,13 @@ struct _NVRegistry
   NVHandleDescArray *names;
   GHashTable *name_map;
   guint32 nvhandle_max_value;
+
+  /* name -> handle lookups happen without taking the registry lock, using
+   * this insert-only index, which is replaced as a whole when it grows.
+   * Replaced instances are kept around until the registry is freed, as
+   * readers might still be using them. */
+  NVRegistryLookupIndex *lookup_index;
+  GPtrArray *retired_lookup_indexes;
 };
 
 extern const gchar *null_string;
@@ -148,7 +160,9 @@ struct _NVEntry
              referenced: 1,
              unset: 1,
              type_present: 1,
-             __bit_padding: 4;
+             external: 1,
+             native: 1,
+             __bit_padding: 2;
     };
     guint8 flags;
   };
@@ -189,6 +203,54 @@ struct _NVEntry
 
       gchar name[0];
     } vindirect;
+
+    /* the value is stored outside of the NVTable, in memory kept alive by
+     * the owner of the table (see LogMessage->input_chunk).  These entries
+     * are never serialized as they are, nv_table_compact() turns them into
+     * direct ones. */
+    struct
+    {
+      guint32 value_len;
+      /* the entry is only 4 byte aligned, use nv_entry_get_external_value() */
+      gchar value_ptr[sizeof(gpointer)];
+      gchar name[0];
+    } vexternal;
+
+    /* the value is stored in binary form, its string representation is
+     * rendered into the space reserved after the name when it is first
+     * requested.  Never serialized as they are, nv_table_compact() turns
+     * them into direct entries. */
+    struct
+    {
+      guint32 kind;
+      /* the entry is only 4 byte aligned, use nv_entry_get_native_value() */
+      gchar value[sizeof(gint64)];
+      /* the length of the rendered value, 0 until it is rendered, see
+       * nv_entry_get_native_rendered_value() */
+      guint32 value_len;
+      /* variable data, the name of this entry and then the space for the
+       * rendered value, both are NUL terminated */
+      gchar name[0];
+    } vnative;
+  };
+};
+
+typedef enum
+{
+  NVN_INT64,
+  NVN_DOUBLE,
+  NVN_BOOLEAN,
+  /* milliseconds since the epoch */
+  NVN_DATETIME_MSEC,
+} NVNativeKind;
+
+struct _NVNativeValue
+{
+  NVNativeKind kind;
+  union
+  {
+    gint64 i64;
+    gdouble d;
   };
 };
 
@@ -196,16 +258,60 @@ struct _NVEntry
 #define NV_ENTRY_DIRECT_SIZE(name_len, value_len) ((value_len) + NV_ENTRY_DIRECT_HDR + (name_len) + 2)
 #define NV_ENTRY_INDIRECT_HDR (sizeof(NVEntry))
 #define NV_ENTRY_INDIRECT_SIZE(name_len) (NV_ENTRY_INDIRECT_HDR + name_len + 1)
+#define NV_ENTRY_EXTERNAL_HDR ((gsize) (&((NVEntry *) NULL)->vexternal.name))
+#define NV_ENTRY_EXTERNAL_SIZE(name_len) (NV_ENTRY_EXTERNAL_HDR + name_len + 1)
+#define NV_ENTRY_NATIVE_HDR ((gsize) (&((NVEntry *) NULL)->vnative.name))
+#define NV_ENTRY_NATIVE_SIZE(name_len, value_len) (NV_ENTRY_NATIVE_HDR + (name_len) + (value_len) + 2)
 
 static inline const gchar *
 nv_entry_get_name(NVEntry *self)
 {
   if (self->indirect)
     return self->vindirect.name;
+  else if (self->external)
+    return self->vexternal.name;
+  else if (self->native)
+    return self->vnative.name;
   else
     return self->vdirect.data;
 }
 
+static inline const gchar *
+nv_entry_get_external_value(NVEntry *self)
+{
+  const gchar *value;
+
+  memcpy(&value, self->vexternal.value_ptr, sizeof(value));
+  return value;
+}
+
+static inline void
+nv_entry_get_native_value(NVEntry *self, NVNativeValue *value)
+{
+  value->kind = self->vnative.kind;
+  memcpy(&value->i64, self->vnative.value, sizeof(value->i64));
+}
+
+/* "%f" of -DBL_MAX is the longest rendering */
+#define NV_NATIVE_VALUE_FORMAT_MAX 320
+
+gsize nv_native_value_format(const NVNativeValue *value, gchar *buffer, gsize buffer_size);
+gsize nv_native_value_format_bound(const NVNativeValue *value);
+guint32 nv_entry_render_native_value(NVEntry *self);
+
+static inline const gchar *
+nv_entry_get_native_rendered_value(NVEntry *self, gssize *length)
+{
+  guint32 value_len = (guint32) g_atomic_int_get((gint *) &self->vnative.value_len);
+
+  if (G_UNLIKELY(!value_len))
+    value_len = nv_entry_render_native_value(self);
+
+  if (length)
+    *length = value_len;
+  return self->vnative.name + self->name_len + 1;
+}
+
 /*
  * Contains a set of ordered name-value pairs.
  *
@@ -233,6 +339,44 @@ nv_entry_get_name(NVEntry *self)
  *   - a dynamically sized NVIndexEntry array (contains ID + offset)
  *   - dynamic values are sorted by the global ID to make handle->entry lookups fast
  *
+ * Index hash:
+ *   - once the index grows above NV_TABLE_INDEX_HASH_THRESHOLD entries, an
+ *     open addressing hash (handle -> index position) is allocated in the
+ *     name-value area the next time the table is reallocated
+ *   - while the hash is present, new index entries are appended to the
+ *     end of the index instead of being inserted in sorted order, which
+ *     saves the memmove() of the tail of the index and turns the binary
+ *     search into a hash lookup
+ *   - the hash is referenced by index_hash_ofs, which is not serialized:
+ *     tables with a hash are compacted before serialization (which drops
+ *     the hash and sorts the index), so the serialized format is
+ *     unchanged, the hash is rebuilt when the table is deserialized
+ *   - if the hash would need to grow but there's no room for it, the
+ *     index is sorted again and the hash is dropped
+ *
+ * External values:
+ *   - an entry with the "external" flag stores a pointer/length pair
+ *     instead of the value, pointing to memory outside of the table (the
+ *     input buffer the message was parsed from)
+ *   - NVTable does not manage the lifetime of this memory, the owner of the
+ *     table has to keep it around as long as the table (or a clone of it)
+ *     exists
+ *   - external values are NUL terminated, just like direct ones
+ *   - nv_table_compact() turns external entries into direct ones, and it
+ *     is mandatory before serializing a table that has external entries
+ *
+ * Native values:
+ *   - an entry with the "native" flag stores an integer, double, boolean
+ *     or datetime in binary form (NVNativeValue), so that consumers that
+ *     need the number don't have to parse it from a string
+ *   - the string representation is only rendered when nv_table_get_value()
+ *     first asks for it, into space reserved right after the name, so the
+ *     returned pointer has the same lifetime as that of a direct value
+ *   - indirect entries never reference native ones, the referenced slice
+ *     is copied instead
+ *   - like external entries, they are turned into direct ones by
+ *     nv_table_compact() before serialization
+ *
  * Memory allocation
  * =================
  *   - the memory used by NVTable is managed by the caller, sometimes it is
@@ -277,6 +421,10 @@ struct _NVTable
   guint8 ref_cnt: 7,
          borrowed: 1; /* specifies if the memory used by NVTable was borrowed from the container struct */
 
+  /* offset of the index hash in the name-value area, zero if the index is
+   * sorted and there's no hash.  Not serialized, see the comment above */
+  guint32 index_hash_ofs;
+
   /* variable data, see memory layout in the comment above */
   union
   {
@@ -297,6 +445,13 @@ struct _NVTable
  * static values */
 #define NV_TABLE_MIN_BYTES  128
 
+/* the size of the NVTable header fields written by nv_table_serialize(),
+ * index_hash_ofs is not part of it */
+#define NV_TABLE_SERIALIZED_HEADER_SIZE 12
+
+/* number of dynamic entries above which we maintain a hash for the index */
+#define NV_TABLE_INDEX_HASH_THRESHOLD 64
+
 gboolean nv_table_add_value(NVTable *self, NVHandle handle,
                             const gchar *name, gsize name_len,
                             const gchar *value, gsize value_len,
@@ -306,6 +461,15 @@ gboolean nv_table_add_value_indirect(NVTable *self, NVHandle handle,
                                      const gchar *name, gsize name_len,
                                      NVReferencedSlice *referenced_slice,
                                      NVType type, gboolean *new_entry);
+gboolean nv_table_add_value_external(NVTable *self, NVHandle handle,
+                                     const gchar *name, gsize name_len,
+                                     const gchar *value, gsize value_len,
+                                     NVType type, gboolean *new_entry);
+gboolean nv_table_add_value_native(NVTable *self, NVHandle handle,
+                                   const gchar *name, gsize name_len,
+                                   const NVNativeValue *value,
+                                   NVType type, gboolean *new_entry);
+gboolean nv_table_has_unserializable_entries(NVTable *self);
 
 gboolean nv_table_foreach(NVTable *self, NVRegistry *registry, NVTableForeachFunc func, gpointer user_data);
 gboolean nv_table_foreach_entry(NVTable *self, NVTableForeachEntryFunc func, gpointer user_data);
@@ -317,6 +481,8 @@ NVTable *nv_table_compact(NVTable *self);
 NVTable *nv_table_clone(NVTable *self, gint additional_space);
 NVTable *nv_table_ref(NVTable *self);
 void nv_table_unref(NVTable *self);
+gsize nv_table_get_index_hash_alloc_size(gint index_size);
+void nv_table_build_index_hash(NVTable *self);
 
 static inline gboolean
 nv_table_is_handle_static(NVTable *self, NVHandle handle)
@@ -432,13 +598,35 @@ nv_table_get_value(NVTable *self, NVHandle handle, gssize *length, NVType *type)
 
   if (type)
     *type = entry->type;
-  if (!entry->indirect)
+  if (entry->indirect)
+    return nv_table_resolve_indirect(self, entry, length);
+  if (G_UNLIKELY(entry->external))
     {
       if (length)
-        *length = entry->vdirect.value_len;
-      return entry->vdirect.data + entry->name_len + 1;
+        *length = entry->vexternal.value_len;
+      return nv_entry_get_external_value(entry);
     }
-  return nv_table_resolve_indirect(self, entry, length);
+  if (G_UNLIKELY(entry->native))
+    return nv_entry_get_native_rendered_value(entry, length);
+  if (length)
+    *length = entry->vdirect.value_len;
+  return entry->vdirect.data + entry->name_len + 1;
+}
+
+/* returns FALSE unless the value is set and is stored in binary form */
+static inline gboolean
+nv_table_get_native_value(NVTable *self, NVHandle handle, NVNativeValue *value, NVType *type)
+{
+  NVEntry *entry;
+
+  entry = nv_table_get_entry(self, handle, NULL, NULL);
+  if (!entry || entry->unset || !entry->native)
+    return FALSE;
+
+  if (type)
+    *type = entry->type;
+  nv_entry_get_native_value(entry, value);
+  return TRUE;
 }
 
 static inline NVIndexEntry *
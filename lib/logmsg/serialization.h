@@ -30,6 +30,8 @@
 #include "logmsg/logmsg.h"
 #include "timeutils/unixtime.h"
 
+typedef struct _NVNameDict NVNameDict;
+
 typedef struct _LogMessageSerializationState
 {
   guint8 version;
@@ -42,6 +44,7 @@ typedef struct _LogMessageSerializationState
   NVIndexEntry *updated_index;
   const UnixTime *processed;
   guint32 flags;
+  NVNameDict *name_dict;
 } LogMessageSerializationState;
 
 #endif
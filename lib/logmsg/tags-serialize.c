@@ -65,3 +65,49 @@ tags_serialize(LogMessage *msg, SerializeArchive *sa)
 }
 
 
+
+/* the compact format uses varint lengths, tags are terminated by an empty name */
+gboolean
+tags_deserialize_compact(LogMessage *msg, SerializeArchive *sa)
+{
+  ScratchBuffersMarker marker;
+  GString *buf = scratch_buffers_alloc_and_mark(&marker);
+  gboolean success = FALSE;
+  guint32 len;
+
+  while (1)
+    {
+      if (!serialize_read_varint32(sa, &len) || len > G_MAXUINT16)
+        goto exit;
+      if (len == 0)
+        break;
+      g_string_set_size(buf, len);
+      if (!serialize_read_blob(sa, buf->str, len))
+        goto exit;
+      log_msg_set_tag_by_name(msg, buf->str);
+    }
+
+  msg->flags |= LF_STATE_OWN_TAGS;
+  success = TRUE;
+exit:
+  scratch_buffers_reclaim_marked(marker);
+  return success;
+}
+
+static gboolean
+_compact_callback(const LogMessage *msg, LogTagId tag_id, const gchar *name, gpointer user_data)
+{
+  SerializeArchive *sa = (SerializeArchive *) user_data;
+  gsize len = strlen(name);
+
+  serialize_write_varint(sa, len);
+  serialize_write_blob(sa, name, len);
+  return TRUE;
+}
+
+gboolean
+tags_serialize_compact(LogMessage *msg, SerializeArchive *sa)
+{
+  log_msg_tags_foreach(msg, _compact_callback, (gpointer) sa);
+  return serialize_write_varint(sa, 0);
+}
@@ -31,4 +31,7 @@
 gboolean tags_deserialize(LogMessage *msg, SerializeArchive *sa);
 gboolean tags_serialize(LogMessage *msg, SerializeArchive *sa);
 
+gboolean tags_deserialize_compact(LogMessage *msg, SerializeArchive *sa);
+gboolean tags_serialize_compact(LogMessage *msg, SerializeArchive *sa);
+
 #endif
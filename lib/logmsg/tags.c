@@ -29,6 +29,8 @@
 #include "stats/stats-cluster-single.h"
 #include "apphook.h"
 
+#include <string.h>
+
 typedef struct _LogTag
 {
   LogTagId id;
@@ -36,19 +38,63 @@ typedef struct _LogTag
   StatsCounterItem *counter;
 } LogTag;
 
-static GArray *log_tags;
-static GHashTable *log_tags_hash = NULL;
+/*
+ * Registered tags are never removed, which allows lookups without taking
+ * log_tags_lock:
+ *
+ *   - log_tags is a fixed size array indexed by tag id, a LogTag is
+ *     published once it is fully initialized.
+ *
+ *   - log_tags_hash is an open addressing hash table (linear probing) with
+ *     twice as many slots as the maximum number of tags, so it never needs
+ *     to grow.  A slot stores (tag id + 1) and is published after the
+ *     LogTag it refers to.
+ *
+ * log_tags_lock serializes the registration of new tags and the
+ * reinitialization of their counters.
+ */
+#define LOG_TAGS_HASH_SIZE (LOG_TAGS_MAX * 2)
+
+static LogTag **log_tags;
+static guint log_tags_num;
+static guint32 *log_tags_hash = NULL;
 static GMutex log_tags_lock;
 
+static inline LogTag *
+_get_tag(LogTagId id)
+{
+  if (id >= LOG_TAGS_MAX || !log_tags)
+    return NULL;
+  return (LogTag *) g_atomic_pointer_get(&log_tags[id]);
+}
+
+static LogTagId
+_lookup_tag(const gchar *name, guint32 **hash_slot)
+{
+  for (guint32 i = g_str_hash(name) & (LOG_TAGS_HASH_SIZE - 1); ; i = (i + 1) & (LOG_TAGS_HASH_SIZE - 1))
+    {
+      guint32 slot = g_atomic_int_get(&log_tags_hash[i]);
+
+      if (!slot)
+        {
+          if (hash_slot)
+            *hash_slot = &log_tags_hash[i];
+          return LOG_TAGS_UNDEF;
+        }
+
+      LogTag *tag = _get_tag(slot - 1);
+      if (strcmp(tag->name, name) == 0)
+        return tag->id;
+    }
+}
+
 static guint
-_register_tag(const gchar *name, guint id)
+_register_tag(const gchar *name, guint id, guint32 *hash_slot)
 {
-  LogTag new_tag =
-  {
-    .id = id,
-    .name = g_strdup(name),
-    0,
-  };
+  LogTag *new_tag = g_new0(LogTag, 1);
+
+  new_tag->id = id;
+  new_tag->name = g_strdup(name);
 
   /* NOTE: stats-level may not be set for calls that happen during
    * config file parsing, those get fixed up by
@@ -59,26 +105,24 @@ _register_tag(const gchar *name, guint id)
   StatsClusterLabel labels[] = { stats_cluster_label("id", name) };
   stats_cluster_single_key_set(&sc_key, "tagged_events_total", labels, G_N_ELEMENTS(labels));
   stats_cluster_single_key_add_legacy_alias_with_name(&sc_key, SCS_TAG, name, NULL, "processed");
-  stats_register_counter(3, &sc_key, SC_TYPE_SINGLE_VALUE, &new_tag.counter);
+  stats_register_counter(3, &sc_key, SC_TYPE_SINGLE_VALUE, &new_tag->counter);
   stats_unlock();
 
-  if (id >= log_tags->len)
-    g_array_set_size(log_tags, id + 1);
+  g_assert(log_tags[id] == NULL);
+  g_atomic_pointer_set(&log_tags[id], new_tag);
 
-  LogTag *elem = &g_array_index(log_tags, LogTag, id);
+  if (id >= log_tags_num)
+    log_tags_num = id + 1;
 
-  g_assert(elem->id == 0);
-  *elem = new_tag;
-
-  g_hash_table_insert(log_tags_hash, new_tag.name, GUINT_TO_POINTER(id + 1));
+  g_atomic_int_set(hash_slot, id + 1);
   return id;
 }
 
 static guint
-_register_new_tag(const gchar *name)
+_register_new_tag(const gchar *name, guint32 *hash_slot)
 {
-  guint id = log_tags->len;
-  return _register_tag(name, id);
+  guint id = log_tags_num;
+  return _register_tag(name, id, hash_slot);
 }
 
 /*
@@ -102,26 +146,28 @@ log_tags_get_by_name(const gchar *name)
 
      In both cases the return value is 0.
    */
-  guint id = 0;
+  guint32 *hash_slot;
+  LogTagId id;
 
   g_assert(log_tags_hash != NULL);
 
+  /* fast path, the tag is already registered */
+  id = _lookup_tag(name, NULL);
+  if (id != LOG_TAGS_UNDEF)
+    return id;
+
   g_mutex_lock(&log_tags_lock);
 
-  gpointer key = g_hash_table_lookup(log_tags_hash, name);
-  if (!key)
+  id = _lookup_tag(name, &hash_slot);
+  if (id == LOG_TAGS_UNDEF)
     {
-      if (log_tags->len < LOG_TAGS_MAX - 1)
+      if (log_tags_num < LOG_TAGS_MAX - 1)
         {
-          id = _register_new_tag(name);
+          id = _register_new_tag(name, hash_slot);
         }
       else
         id = 0;
     }
-  else
-    {
-      id = GPOINTER_TO_UINT(key) - 1;
-    }
 
   g_mutex_unlock(&log_tags_lock);
 
@@ -131,12 +177,14 @@ log_tags_get_by_name(const gchar *name)
 void
 log_tags_register_predefined_tag(const gchar *name, LogTagId id)
 {
+  guint32 *hash_slot;
+
   g_mutex_lock(&log_tags_lock);
 
-  gpointer key = g_hash_table_lookup(log_tags_hash, name);
-  g_assert(key == NULL);
+  LogTagId existing_id = _lookup_tag(name, &hash_slot);
+  g_assert(existing_id == LOG_TAGS_UNDEF);
 
-  LogTagId rid = _register_tag(name, id);
+  LogTagId rid = _register_tag(name, id, hash_slot);
   g_assert(rid == id);
   g_mutex_unlock(&log_tags_lock);
 }
@@ -156,39 +204,27 @@ log_tags_register_predefined_tag(const gchar *name, LogTagId id)
 const gchar *
 log_tags_get_by_id(LogTagId id)
 {
-  gchar *name = NULL;
-
-  g_mutex_lock(&log_tags_lock);
+  LogTag *tag = _get_tag(id);
 
-  if (id < log_tags->len)
-    name = g_array_index(log_tags, LogTag, id).name;
-
-  g_mutex_unlock(&log_tags_lock);
-
-  return name;
+  return tag ? tag->name : NULL;
 }
 
 void
 log_tags_inc_counter(LogTagId id)
 {
-  g_mutex_lock(&log_tags_lock);
-
-  if (id < log_tags->len)
-    stats_counter_inc(g_array_index(log_tags, LogTag, id).counter);
+  LogTag *tag = _get_tag(id);
 
-  g_mutex_unlock(&log_tags_lock);
+  if (tag)
+    stats_counter_inc(g_atomic_pointer_get(&tag->counter));
 }
 
 void
 log_tags_dec_counter(LogTagId id)
 {
-  /* Reader lock because the log_tag_list is not written */
-  g_mutex_lock(&log_tags_lock);
+  LogTag *tag = _get_tag(id);
 
-  if (id < log_tags->len)
-    stats_counter_dec(g_array_index(log_tags, LogTag, id).counter);
-
-  g_mutex_unlock(&log_tags_lock);
+  if (tag)
+    stats_counter_dec(g_atomic_pointer_get(&tag->counter));
 }
 
 /*
@@ -209,9 +245,12 @@ log_tags_reinit_stats(void)
   g_mutex_lock(&log_tags_lock);
   stats_lock();
 
-  for (id = 0; id < log_tags->len; id++)
+  for (id = 0; id < log_tags_num; id++)
     {
-      LogTag *elem = &g_array_index(log_tags, LogTag, id);
+      LogTag *elem = log_tags[id];
+
+      if (!elem)
+        continue;
 
       StatsClusterKey sc_key;
       StatsClusterLabel labels[] = { stats_cluster_label("id", elem->name) };
@@ -231,8 +270,9 @@ log_tags_reinit_stats(void)
 void
 log_tags_global_init(void)
 {
-  log_tags_hash = g_hash_table_new(g_str_hash, g_str_equal);
-  log_tags = g_array_new(FALSE, TRUE, sizeof(LogTag));
+  log_tags_hash = g_new0(guint32, LOG_TAGS_HASH_SIZE);
+  log_tags = g_new0(LogTag *, LOG_TAGS_MAX);
+  log_tags_num = 0;
 
   register_application_hook(AH_CONFIG_CHANGED, (ApplicationHookFunc) log_tags_reinit_stats, NULL, AHM_RUN_REPEAT);
 }
@@ -240,20 +280,26 @@ log_tags_global_init(void)
 void
 log_tags_global_deinit(void)
 {
-  g_hash_table_destroy(log_tags_hash);
+  g_free(log_tags_hash);
+  log_tags_hash = NULL;
 
   stats_lock();
   StatsClusterKey sc_key;
-  for (guint id = 0; id < log_tags->len; id++)
+  for (guint id = 0; id < log_tags_num; id++)
     {
-      LogTag *elem = &g_array_index(log_tags, LogTag, id);
+      LogTag *elem = log_tags[id];
+
+      if (!elem)
+        continue;
 
       StatsClusterLabel labels[] = { stats_cluster_label("id", elem->name) };
       stats_cluster_single_key_set(&sc_key, "tagged_events_total", labels, G_N_ELEMENTS(labels));
       stats_cluster_single_key_add_legacy_alias_with_name(&sc_key, SCS_TAG, elem->name, NULL, "processed");
       stats_unregister_counter(&sc_key, SC_TYPE_SINGLE_VALUE, &elem->counter);
       g_free(elem->name);
+      g_free(elem);
     }
   stats_unlock();
-  g_array_free(log_tags, TRUE);
+  g_free(log_tags);
+  log_tags = NULL;
 }
@@ -0,0 +1,138 @@
+/*
+ * Copyright (c) 2026 Axoflow
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+/* NOTE: this is not run automatically in make check as it only measures
+ * the v26 and the compact v27 serialization formats side by side, you have
+ * to invoke it manually.
+ */
+
+#include <criterion/criterion.h>
+
+#include "logmsg/logmsg.h"
+#include "logmsg/logmsg-serialize.h"
+#include "logmsg/nvtable-serialize.h"
+#include "apphook.h"
+#include "libtest/stopwatch.h"
+
+#include <stdio.h>
+
+#define ITERATIONS 100000
+
+typedef enum
+{
+  FORMAT_V26,
+  FORMAT_V26_WITH_COMPACTION,
+  FORMAT_V27,
+} SerializationFormat;
+
+static const gchar *format_names[] =
+{
+  [FORMAT_V26] = "v26",
+  [FORMAT_V26_WITH_COMPACTION] = "v26 (with compaction)",
+  [FORMAT_V27] = "v27",
+};
+
+static LogMessage *
+_create_message(void)
+{
+  LogMessage *msg = log_msg_new_empty();
+  gchar name[64];
+
+  log_msg_set_value(msg, LM_V_HOST, "mymachine", -1);
+  log_msg_set_value(msg, LM_V_PROGRAM, "evntslog", -1);
+  log_msg_set_value(msg, LM_V_MESSAGE, "An application event log entry...", -1);
+  log_msg_set_value_by_name(msg, ".SDATA.exampleSDID@0.iut", "3", -1);
+  log_msg_set_value_by_name(msg, ".SDATA.exampleSDID@0.eventSource", "Application", -1);
+  log_msg_set_value_int64(msg, log_msg_get_value_handle("native_int"), 42);
+
+  for (gint i = 0; i < 32; i++)
+    {
+      g_snprintf(name, sizeof(name), ".normal.dynamic.field%d", i);
+      log_msg_set_value_by_name(msg, name, "value", -1);
+    }
+  return msg;
+}
+
+static void
+_serialize(SerializationFormat format, LogMessage *msg, SerializeArchive *sa, NVNameDict *name_dict)
+{
+  switch (format)
+    {
+    case FORMAT_V26:
+      log_msg_serialize(msg, sa, 0);
+      break;
+    case FORMAT_V26_WITH_COMPACTION:
+      log_msg_serialize(msg, sa, LMSF_COMPACTION);
+      break;
+    case FORMAT_V27:
+      log_msg_serialize_compact(msg, sa, name_dict);
+      break;
+    default:
+      g_assert_not_reached();
+    }
+}
+
+static void
+_measure_format(SerializationFormat format)
+{
+  gchar dict_storage[2048] = { 0 };
+  NVNameDict *name_dict = nv_name_dict_new(dict_storage, sizeof(dict_storage));
+  LogMessage *msg = _create_message();
+  GString *stream = g_string_sized_new(512);
+  SerializeArchive *sa = serialize_string_archive_new(stream);
+
+  start_stopwatch();
+  for (gint i = 0; i < ITERATIONS; i++)
+    {
+      g_string_truncate(stream, 0);
+      _serialize(format, msg, sa, name_dict);
+    }
+  stop_stopwatch_and_display_result(ITERATIONS, "%s, serializing %" G_GSIZE_FORMAT " bytes %d times took",
+                                    format_names[format], stream->len, ITERATIONS);
+  nv_name_dict_commit(name_dict);
+
+  start_stopwatch();
+  for (gint i = 0; i < ITERATIONS; i++)
+    {
+      serialize_string_archive_reset(sa);
+      LogMessage *deserialized = log_msg_new_empty();
+      cr_assert(log_msg_deserialize_with_names(deserialized, sa, name_dict));
+      log_msg_unref(deserialized);
+    }
+  stop_stopwatch_and_display_result(ITERATIONS, "%s, deserializing %d times took",
+                                    format_names[format], ITERATIONS);
+
+  serialize_archive_free(sa);
+  g_string_free(stream, TRUE);
+  log_msg_unref(msg);
+  nv_name_dict_free(name_dict);
+}
+
+Test(perf_logmsg_serialize, test_serialization_formats_side_by_side)
+{
+  _measure_format(FORMAT_V26);
+  _measure_format(FORMAT_V26_WITH_COMPACTION);
+  _measure_format(FORMAT_V27);
+}
+
+TestSuite(perf_logmsg_serialize, .init = app_startup, .fini = app_shutdown);
@@ -0,0 +1,161 @@
+/*
+ * Copyright (c) 2026 Axoflow
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+/* NOTE: this is not run automatically in make check as it only measures
+ * the sorted and the hashed NVTable index layouts side by side, and the
+ * NVRegistry lookups of concurrent threads, you have to invoke it manually.
+ */
+
+#include <criterion/criterion.h>
+
+#include "logmsg/nvtable.h"
+#include "apphook.h"
+#include "libtest/stopwatch.h"
+
+#include <string.h>
+
+#define STATIC_VALUES 16
+#define NUM_DYNAMIC_VALUES 1000
+#define ITERATIONS 100
+
+/* a table that is large enough to never be reallocated keeps its sorted
+ * index, while one that has to grow gets its index hashed in
+ * nv_table_realloc() */
+static NVTable *
+_new_table(gboolean hashed)
+{
+  if (hashed)
+    return nv_table_new(STATIC_VALUES, STATIC_VALUES, 256);
+  return nv_table_new(STATIC_VALUES, NUM_DYNAMIC_VALUES, NUM_DYNAMIC_VALUES * 64);
+}
+
+static NVTable *
+_create_table(gboolean hashed, NVHandle *handles)
+{
+  NVTable *tab = _new_table(hashed);
+  gchar name[16], value[16];
+
+  for (gint i = 0; i < NUM_DYNAMIC_VALUES; i++)
+    {
+      g_snprintf(name, sizeof(name), "VAL%d", handles[i]);
+      g_snprintf(value, sizeof(value), "value%d", handles[i]);
+      while (!nv_table_add_value(tab, handles[i], name, strlen(name), value, strlen(value), 0, NULL))
+        cr_assert(nv_table_realloc(tab, &tab));
+    }
+  cr_assert_eq(tab->index_hash_ofs != 0, hashed);
+  return tab;
+}
+
+static void
+_measure_layout(gboolean hashed, const gchar *layout)
+{
+  NVHandle handles[NUM_DYNAMIC_VALUES];
+
+  /* descending order is the worst case for a sorted index, as every
+   * insertion has to move the entire index */
+  for (gint i = 0; i < NUM_DYNAMIC_VALUES; i++)
+    handles[i] = STATIC_VALUES + NUM_DYNAMIC_VALUES - i;
+
+  start_stopwatch();
+  for (gint i = 0; i < ITERATIONS; i++)
+    nv_table_unref(_create_table(hashed, handles));
+  stop_stopwatch_and_display_result(ITERATIONS, "%s index, adding %d dynamic values %d times took",
+                                    layout, NUM_DYNAMIC_VALUES, ITERATIONS);
+
+  NVTable *tab = _create_table(hashed, handles);
+  gint found = 0;
+
+  start_stopwatch();
+  for (gint i = 0; i < ITERATIONS; i++)
+    {
+      for (gint j = 0; j < NUM_DYNAMIC_VALUES; j++)
+        found += nv_table_is_value_set(tab, handles[j]);
+    }
+  stop_stopwatch_and_display_result(ITERATIONS, "%s index, looking up %d dynamic values %d times took",
+                                    layout, NUM_DYNAMIC_VALUES, ITERATIONS);
+  cr_assert_eq(found, NUM_DYNAMIC_VALUES * ITERATIONS);
+  nv_table_unref(tab);
+}
+
+Test(perf_nvtable, test_lookup_performance_of_sorted_and_hashed_index)
+{
+  _measure_layout(FALSE, "sorted");
+  _measure_layout(TRUE, "hashed");
+}
+
+#define REGISTRY_THREADS 8
+#define REGISTRY_NAMES 2000
+
+typedef struct
+{
+  NVRegistry *registry;
+  gint iterations;
+} RegistryThreadData;
+
+static gpointer
+_alloc_handles_in_thread(gpointer user_data)
+{
+  RegistryThreadData *data = (RegistryThreadData *) user_data;
+  gchar name[32];
+
+  for (gint i = 0; i < data->iterations; i++)
+    {
+      for (gint j = 0; j < REGISTRY_NAMES; j++)
+        {
+          g_snprintf(name, sizeof(name), "name.%d", j);
+          nv_registry_alloc_handle(data->registry, name);
+        }
+    }
+  return NULL;
+}
+
+static void
+_run_registry_threads(NVRegistry *reg, gint iterations)
+{
+  RegistryThreadData data = { .registry = reg, .iterations = iterations };
+  GThread *threads[REGISTRY_THREADS];
+
+  for (gint i = 0; i < REGISTRY_THREADS; i++)
+    threads[i] = g_thread_new(NULL, _alloc_handles_in_thread, &data);
+  for (gint i = 0; i < REGISTRY_THREADS; i++)
+    g_thread_join(threads[i]);
+}
+
+Test(perf_nvtable, test_registry_lookup_performance_with_contention)
+{
+  const gchar *builtins[] = { "BUILTIN1", NULL };
+  NVRegistry *reg = nv_registry_new(builtins, NVHANDLE_MAX_VALUE);
+
+  /* allocate the names first, so that we only measure lookups */
+  _run_registry_threads(reg, 1);
+
+  start_stopwatch();
+  _run_registry_threads(reg, ITERATIONS);
+  stop_stopwatch_and_display_result(ITERATIONS * REGISTRY_NAMES,
+                                    "looking up %d names %d times in %d threads took",
+                                    REGISTRY_NAMES, ITERATIONS, REGISTRY_THREADS);
+
+  nv_registry_free(reg);
+}
+
+TestSuite(perf_nvtable, .init = app_startup, .fini = app_shutdown);
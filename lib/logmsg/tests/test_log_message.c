@@ -903,6 +903,161 @@ Test(log_message, test_cow_writing_cloned_message)
 }
 
 
+Test(log_message, test_cow_clone_stores_changed_values_in_an_overlay)
+{
+  LogMessage *msg = _construct_log_message();
+  log_msg_set_value_by_name(msg, "orig_name", "orig_value", -1);
+  log_msg_set_value_by_name(msg, "unset_in_clone", "value", -1);
+
+  LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+  LogMessage *cloned = log_msg_clone_cow(msg, &path_options);
+
+  log_msg_set_value_by_name(cloned, "cloned_name", "cloned_value", -1);
+  cr_assert_eq(cloned->payload_base, msg->payload, "the clone should store its changes in an overlay");
+  cr_assert_lt(cloned->payload->used, msg->payload->used);
+
+  log_msg_unset_value_by_name(cloned, "unset_in_clone");
+  log_msg_set_value_indirect(cloned, log_msg_get_value_handle("indirect_name"),
+                             log_msg_get_value_handle("orig_name"), 0, 4);
+
+  assert_log_message_value_by_name(cloned, "orig_name", "orig_value");
+  assert_log_message_value_by_name(cloned, "cloned_name", "cloned_value");
+  assert_log_message_value_by_name(cloned, "indirect_name", "orig");
+  assert_log_message_value_unset_by_name(cloned, "unset_in_clone");
+  assert_log_message_value_by_name(msg, "unset_in_clone", "value");
+
+  /* a clone of the clone copies the overlay only */
+  LogMessage *cloned_twice = log_msg_clone_cow(cloned, &path_options);
+  log_msg_set_value_by_name(cloned_twice, "orig_name", "modified_value", -1);
+  cr_assert_eq(cloned_twice->payload_base, msg->payload);
+  assert_log_message_value_by_name(cloned_twice, "orig_name", "modified_value");
+  assert_log_message_value_by_name(cloned_twice, "cloned_name", "cloned_value");
+  assert_log_message_value_by_name(cloned, "orig_name", "orig_value");
+
+  log_msg_unref(cloned_twice);
+  log_msg_unref(cloned);
+  log_msg_unref(msg);
+}
+
+static gboolean
+_count_values(NVHandle handle, const gchar *name, const gchar *value, gssize value_len,
+              LogMessageValueType type, gpointer user_data)
+{
+  GHashTable *values = (GHashTable *) user_data;
+
+  cr_assert_null(g_hash_table_lookup(values, name), "value %s is listed twice", name);
+  g_hash_table_insert(values, g_strdup(name), g_strndup(value, value_len));
+  return FALSE;
+}
+
+Test(log_message, test_cow_clone_foreach_merges_the_overlay_with_the_original_values)
+{
+  LogMessage *msg = _construct_log_message();
+  log_msg_set_value_by_name(msg, "orig_name", "orig_value", -1);
+  log_msg_set_value_by_name(msg, "unset_in_clone", "value", -1);
+
+  LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+  LogMessage *cloned = log_msg_clone_cow(msg, &path_options);
+  log_msg_set_value_by_name(cloned, "orig_name", "modified_value", -1);
+  log_msg_unset_value_by_name(cloned, "unset_in_clone");
+
+  GHashTable *values = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+  log_msg_values_foreach(cloned, (NVTableForeachFunc) _count_values, values);
+
+  cr_assert_str_eq(g_hash_table_lookup(values, "orig_name"), "modified_value");
+  cr_assert_null(g_hash_table_lookup(values, "unset_in_clone"));
+  cr_assert_str_eq(g_hash_table_lookup(values, "HOST"), log_msg_get_value(msg, LM_V_HOST, NULL));
+
+  g_hash_table_unref(values);
+  log_msg_unref(cloned);
+  log_msg_unref(msg);
+}
+
+Test(log_message, test_values_in_the_input_chunk_are_referenced_until_the_message_is_freed)
+{
+  const gchar *input = "referenced-value\nshort\n";
+  LogMsgChunk *chunk = log_msg_chunk_new(strlen(input) + 1);
+  gchar *data = (gchar *) chunk->data;
+
+  memcpy(data, input, strlen(input));
+  data[16] = 0;
+  data[22] = 0;
+
+  LogMessage *msg = log_msg_new_empty();
+  log_msg_set_input_chunk(chunk, 8);
+  log_msg_set_value(msg, LM_V_MESSAGE, data, 16);
+  log_msg_set_value(msg, LM_V_PROGRAM, data + 17, 5);
+  log_msg_set_input_chunk(NULL, 0);
+
+  cr_assert_eq(log_msg_get_value(msg, LM_V_MESSAGE, NULL), data, "long values should be referenced");
+  cr_assert_neq(log_msg_get_value(msg, LM_V_PROGRAM, NULL), data + 17, "short values should be copied");
+  cr_assert(log_msg_chunk_is_shared(chunk));
+
+  LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+  LogMessage *cloned = log_msg_clone_cow(msg, &path_options);
+  log_msg_set_value_by_name(cloned, "cloned_name", "cloned_value", -1);
+  cr_assert_str_eq(log_msg_get_value(cloned, LM_V_MESSAGE, NULL), "referenced-value");
+
+  log_msg_unref(msg);
+  cr_assert(log_msg_chunk_is_shared(chunk), "the clone should keep the chunk alive");
+  log_msg_unref(cloned);
+  cr_assert_not(log_msg_chunk_is_shared(chunk));
+
+  log_msg_chunk_unref(chunk);
+}
+
+Test(log_message, test_native_values_are_returned_in_binary_and_rendered_as_strings)
+{
+  LogMessage *msg = log_msg_new_empty();
+  NVHandle int_handle = log_msg_get_value_handle("int");
+  NVHandle bool_handle = log_msg_get_value_handle("bool");
+  NVHandle renamed_handle = log_msg_get_value_handle("renamed");
+  NVNativeValue native;
+  LogMessageValueType type;
+
+  log_msg_set_value_int64(msg, int_handle, 42);
+  log_msg_set_value_boolean(msg, bool_handle, TRUE);
+
+  cr_assert(log_msg_get_native_value(msg, int_handle, &native, &type));
+  cr_assert_eq(native.kind, NVN_INT64);
+  cr_assert_eq(native.i64, 42);
+  cr_assert_eq(type, LM_VT_INTEGER);
+  assert_log_message_value_and_type_by_name(msg, "int", "42", LM_VT_INTEGER);
+  assert_log_message_value_and_type_by_name(msg, "bool", "true", LM_VT_BOOLEAN);
+
+  log_msg_rename_value(msg, int_handle, renamed_handle);
+  cr_assert(log_msg_get_native_value(msg, renamed_handle, &native, &type));
+  cr_assert_eq(native.i64, 42);
+  assert_log_message_value_unset_by_name(msg, "int");
+
+  log_msg_set_value_with_type(msg, bool_handle, "false", -1, LM_VT_BOOLEAN);
+  cr_assert_not(log_msg_get_native_value(msg, bool_handle, &native, &type));
+  assert_log_message_value_and_type_by_name(msg, "bool", "false", LM_VT_BOOLEAN);
+
+  log_msg_unref(msg);
+}
+
+Test(log_message, test_native_values_set_in_cow_clones_do_not_change_the_original)
+{
+  LogMessage *msg = log_msg_new_empty();
+  NVHandle handle = log_msg_get_value_handle("num");
+  NVNativeValue native;
+
+  log_msg_set_value_double(msg, handle, 1.5);
+
+  LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+  LogMessage *cloned = log_msg_clone_cow(msg, &path_options);
+  log_msg_set_value_datetime_msec(cloned, handle, 1653246684123);
+
+  assert_log_message_value_and_type_by_name(msg, "num", "1.500000", LM_VT_DOUBLE);
+  assert_log_message_value_and_type_by_name(cloned, "num", "1653246684.123", LM_VT_DATETIME);
+  cr_assert(log_msg_get_native_value(cloned, handle, &native, NULL));
+  cr_assert_eq(native.i64, 1653246684123);
+
+  log_msg_unref(cloned);
+  log_msg_unref(msg);
+}
+
 Test(log_message, test_cow_make_writable)
 {
   LogMessage *msg = _construct_log_message();
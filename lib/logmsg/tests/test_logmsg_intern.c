@@ -0,0 +1,197 @@
+/*
+ * Copyright (c) 2026 Axoflow
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+#include <criterion/criterion.h>
+
+#include "logmsg/logmsg-intern.h"
+#include "logmsg/logmsg.h"
+#include "logpipe.h"
+#include "apphook.h"
+
+#include <string.h>
+
+#define LONG_HOST "frontend-17.prod.example.com"
+
+Test(logmsg_intern, repeated_values_are_shared_between_messages)
+{
+  LogMessage *msg1 = log_msg_new_empty();
+  LogMessage *msg2 = log_msg_new_empty();
+
+  log_msg_set_value(msg1, LM_V_HOST, LONG_HOST, -1);
+  log_msg_set_value(msg2, LM_V_HOST, LONG_HOST, -1);
+
+  const gchar *value1 = log_msg_get_value(msg1, LM_V_HOST, NULL);
+  const gchar *value2 = log_msg_get_value(msg2, LM_V_HOST, NULL);
+  cr_assert_str_eq(value1, LONG_HOST);
+  cr_assert_eq(value1, value2, "the value should have been stored only once");
+  cr_assert_eq(msg1->interned_page, msg2->interned_page);
+
+  log_msg_unref(msg1);
+  log_msg_unref(msg2);
+}
+
+Test(logmsg_intern, short_values_are_copied)
+{
+  LogMessage *msg1 = log_msg_new_empty();
+  LogMessage *msg2 = log_msg_new_empty();
+
+  log_msg_set_value(msg1, LM_V_PROGRAM, "sshd", -1);
+  log_msg_set_value(msg2, LM_V_PROGRAM, "sshd", -1);
+
+  cr_assert_neq(log_msg_get_value(msg1, LM_V_PROGRAM, NULL), log_msg_get_value(msg2, LM_V_PROGRAM, NULL));
+  cr_assert_null(msg1->interned_page);
+
+  log_msg_unref(msg1);
+  log_msg_unref(msg2);
+}
+
+Test(logmsg_intern, values_that_save_payload_space_are_interned_regardless_of_their_length)
+{
+  LogMessage *msg1 = log_msg_new_empty();
+  LogMessage *msg2 = log_msg_new_empty();
+
+  log_msg_set_value(msg1, LM_V_HOST, "mymachine", -1);
+  log_msg_set_value(msg2, LM_V_HOST, "mymachine", -1);
+
+  cr_assert_eq(log_msg_get_value(msg1, LM_V_HOST, NULL), log_msg_get_value(msg2, LM_V_HOST, NULL));
+  cr_assert_not_null(msg1->interned_page);
+
+  log_msg_unref(msg1);
+  log_msg_unref(msg2);
+}
+
+Test(logmsg_intern, unique_values_stop_being_stored_unless_on_the_allowlist)
+{
+  gchar value[32];
+  gint num_interned_ids = 0;
+
+  for (gint i = 0; i < 1024; i++)
+    {
+      LogMessage *msg = log_msg_new_empty();
+
+      g_snprintf(value, sizeof(value), "request-id-%08d", i);
+      log_msg_set_value_by_name(msg, "request_id", value, -1);
+      if (msg->interned_page)
+        num_interned_ids++;
+      log_msg_unref(msg);
+
+      msg = log_msg_new_empty();
+      g_snprintf(value, sizeof(value), "host-%08d.example.com", i);
+      log_msg_set_value(msg, LM_V_HOST, value, -1);
+      cr_assert_not_null(msg->interned_page, "values on the allowlist should always be interned");
+      log_msg_unref(msg);
+    }
+
+  /* after the initial lookups only every few misses are stored */
+  cr_assert_lt(num_interned_ids, 1024 / 4);
+  cr_assert_gt(num_interned_ids, 0);
+}
+
+Test(logmsg_intern, values_are_copied_if_interning_is_disabled)
+{
+  log_msg_intern_set_enabled(FALSE);
+
+  LogMessage *msg = log_msg_new_empty();
+  log_msg_set_value(msg, LM_V_HOST, LONG_HOST, -1);
+  cr_assert_null(msg->interned_page);
+  cr_assert_str_eq(log_msg_get_value(msg, LM_V_HOST, NULL), LONG_HOST);
+  log_msg_unref(msg);
+}
+
+Test(logmsg_intern, messages_keep_their_page_alive_after_the_dictionary_starts_over)
+{
+  LogMessage *msg = log_msg_new_empty();
+  log_msg_set_value(msg, LM_V_HOST, LONG_HOST, -1);
+
+  /* fill the page with distinct values */
+  LogMessage *filler = log_msg_new_empty();
+  gchar value[64];
+  for (gint i = 0; i < LOG_MSG_INTERN_PAGE_SIZE / 16; i++)
+    {
+      g_snprintf(value, sizeof(value), "filler-value-%08d-xxxxxxxx", i);
+      log_msg_set_value(filler, LM_V_HOST, value, -1);
+    }
+  cr_assert_eq(filler->interned_page, msg->interned_page,
+               "values that don't fit the page of the message should be copied");
+  log_msg_unref(filler);
+
+  /* values already in the page are still found */
+  LogMessage *msg2 = log_msg_new_empty();
+  log_msg_set_value(msg2, LM_V_HOST, LONG_HOST, -1);
+  cr_assert_eq(msg2->interned_page, msg->interned_page);
+
+  /* a new value needs a new page */
+  LogMessage *msg3 = log_msg_new_empty();
+  log_msg_set_value(msg3, LM_V_HOST, "backend-42.prod.example.com", -1);
+  cr_assert_not_null(msg3->interned_page);
+  cr_assert_neq(msg3->interned_page, msg->interned_page);
+
+  /* the value that was hit in the old page was carried over */
+  LogMessage *msg4 = log_msg_new_empty();
+  log_msg_set_value(msg4, LM_V_HOST, LONG_HOST, -1);
+  cr_assert_eq(msg4->interned_page, msg3->interned_page);
+  log_msg_unref(msg4);
+
+  log_msg_intern_thread_deinit();
+  log_msg_intern_thread_init();
+
+  cr_assert_str_eq(log_msg_get_value(msg, LM_V_HOST, NULL), LONG_HOST);
+  cr_assert_str_eq(log_msg_get_value(msg2, LM_V_HOST, NULL), LONG_HOST);
+  cr_assert_str_eq(log_msg_get_value(msg3, LM_V_HOST, NULL), "backend-42.prod.example.com");
+  log_msg_unref(msg);
+  log_msg_unref(msg2);
+  log_msg_unref(msg3);
+}
+
+Test(logmsg_intern, interned_values_of_clones_are_kept_alive_by_the_clone)
+{
+  LogMessage *msg = log_msg_new_empty();
+  log_msg_set_value(msg, LM_V_HOST, LONG_HOST, -1);
+
+  LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+  LogMessage *cloned = log_msg_clone_cow(msg, &path_options);
+  log_msg_set_value_by_name(cloned, "cloned_value", "a-reasonably-long-value", -1);
+  log_msg_unref(msg);
+
+  log_msg_intern_thread_deinit();
+  log_msg_intern_thread_init();
+
+  cr_assert_str_eq(log_msg_get_value(cloned, LM_V_HOST, NULL), LONG_HOST);
+  cr_assert_str_eq(log_msg_get_value_by_name(cloned, "cloned_value", NULL), "a-reasonably-long-value");
+  log_msg_unref(cloned);
+}
+
+static void
+setup(void)
+{
+  app_startup();
+  log_msg_intern_set_enabled(TRUE);
+}
+
+static void
+teardown(void)
+{
+  log_msg_intern_set_enabled(FALSE);
+  app_shutdown();
+}
+
+TestSuite(logmsg_intern, .init = setup, .fini = teardown);
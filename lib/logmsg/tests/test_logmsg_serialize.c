@@ -29,11 +29,13 @@
 #include "libtest/stopwatch.h"
 
 #include "logmsg/logmsg.h"
+#include "logpipe.h"
 #include "msg-format.h"
 #include "apphook.h"
 #include "cfg.h"
 #include "plugin.h"
 #include "logmsg/logmsg-serialize.h"
+#include "logmsg/nvtable-serialize.h"
 
 #define RAW_MSG "<132>1 2006-10-29T01:59:59.156+01:00 mymachine evntslog - - [exampleSDID@0 iut=\"3\" eventSource=\"Application\"] An application event log entry..."
 
@@ -176,6 +178,35 @@ Test(logmsg_serialize, serialize)
   g_string_free(stream, TRUE);
 }
 
+Test(logmsg_serialize, hashed_index_is_rebuilt_after_deserialization)
+{
+  LogMessage *msg = _create_message_to_be_serialized(RAW_MSG, strlen(RAW_MSG));
+  cr_assert_neq(msg->payload->index_hash_ofs, 0, "the test message is expected to have a hashed index");
+
+  GString *stream = g_string_sized_new(512);
+  SerializeArchive *sa = serialize_string_archive_new(stream);
+  log_msg_serialize(msg, sa, 0);
+  log_msg_unref(msg);
+
+  _reset_log_msg_registry();
+  msg = log_msg_new_empty();
+  cr_assert(log_msg_deserialize(msg, sa), ERROR_MSG);
+  cr_assert_neq(msg->payload->index_hash_ofs, 0, "the index hash should have been rebuilt on load");
+
+  _check_deserialized_message_all_fields(msg);
+  for (gint i = 0; i < 32; i++)
+    {
+      gchar value_name[64];
+
+      g_snprintf(value_name, sizeof(value_name), ".normal.dynamic.field%d", i);
+      assert_log_message_value_by_name(msg, value_name, "value");
+    }
+
+  log_msg_unref(msg);
+  serialize_archive_free(sa);
+  g_string_free(stream, TRUE);
+}
+
 static LogMessage *
 _create_message_to_be_serialized_with_ts_processed(const gchar *raw_msg, const int raw_msg_len, UnixTime *processed)
 {
@@ -226,6 +257,37 @@ Test(logmsg_serialize, simple_serialization)
   g_string_free(stream, TRUE);
 }
 
+Test(logmsg_serialize, cloned_message_is_serialized_with_its_overlay_merged)
+{
+  LogMessage *msg = _create_message_to_be_serialized(RAW_MSG, strlen(RAW_MSG));
+  LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+  LogMessage *cloned = log_msg_clone_cow(msg, &path_options);
+
+  log_msg_set_value(cloned, LM_V_PROGRAM, "cloned-program", -1);
+  log_msg_set_value_by_name(cloned, "cloned_name", "cloned_value", -1);
+  log_msg_unset_value(cloned, LM_V_HOST);
+  cr_assert_not_null(cloned->payload_base);
+
+  GString *stream = g_string_sized_new(512);
+  SerializeArchive *sa = serialize_string_archive_new(stream);
+  log_msg_serialize(cloned, sa, 0);
+  log_msg_unref(cloned);
+
+  LogMessage *deserialized = log_msg_new_empty();
+  cr_assert(log_msg_deserialize(deserialized, sa), ERROR_MSG);
+  cr_assert_null(deserialized->payload_base);
+
+  assert_log_message_value(deserialized, LM_V_PROGRAM, "cloned-program");
+  assert_log_message_value_by_name(deserialized, "cloned_name", "cloned_value");
+  assert_log_message_value_unset(deserialized, LM_V_HOST);
+  assert_log_message_value(deserialized, LM_V_MESSAGE, log_msg_get_value(msg, LM_V_MESSAGE, NULL));
+
+  log_msg_unref(deserialized);
+  log_msg_unref(msg);
+  serialize_archive_free(sa);
+  g_string_free(stream, TRUE);
+}
+
 Test(logmsg_serialize, given_ts_processed)
 {
   LogMessage *msg = _create_message_to_be_serialized(RAW_MSG, strlen(RAW_MSG));
@@ -355,6 +417,162 @@ ParameterizedTest(struct iovec *param, logmsg_serialize, test_deserialization_of
   log_msg_unref(msg);
 }
 
+static LogMessage *
+_compact_round_trip(LogMessage *msg, gchar *dict_storage, gsize dict_storage_size, gsize *serialized_len)
+{
+  GString *stream = g_string_sized_new(512);
+  SerializeArchive *sa = serialize_string_archive_new(stream);
+  NVNameDict *name_dict = dict_storage ? nv_name_dict_new(dict_storage, dict_storage_size) : NULL;
+
+  cr_assert(log_msg_serialize_compact(msg, sa, name_dict), ERROR_MSG);
+  if (serialized_len)
+    *serialized_len = stream->len;
+  if (name_dict)
+    {
+      /* the record is "written" */
+      nv_name_dict_commit(name_dict);
+      nv_name_dict_free(name_dict);
+    }
+
+  /* handles are different after a restart, the dictionary is loaded again */
+  _reset_log_msg_registry();
+  name_dict = dict_storage ? nv_name_dict_new(dict_storage, dict_storage_size) : NULL;
+
+  LogMessage *deserialized = log_msg_new_empty();
+  cr_assert(log_msg_deserialize_with_names(deserialized, sa, name_dict), ERROR_MSG);
+
+  if (name_dict)
+    nv_name_dict_free(name_dict);
+  serialize_archive_free(sa);
+  g_string_free(stream, TRUE);
+  return deserialized;
+}
+
+static void
+_check_compact_round_trip(gchar *dict_storage, gsize dict_storage_size)
+{
+  LogMessage *msg = _create_message_to_be_serialized(RAW_MSG, strlen(RAW_MSG));
+  log_msg_set_tag_by_name(msg, "compact-tag");
+  log_msg_set_value_int64(msg, log_msg_get_value_handle("native_int"), -42);
+  log_msg_set_match(msg, 1, "match1", -1);
+
+  GString *sdata = g_string_new("");
+  log_msg_format_sdata(msg, sdata, 0);
+
+  LogMessage *deserialized = _compact_round_trip(msg, dict_storage, dict_storage_size, NULL);
+
+  _check_deserialized_message_all_fields(deserialized);
+  cr_assert(log_msg_is_tag_by_name(deserialized, "compact-tag"));
+  cr_assert_eq(deserialized->num_matches, msg->num_matches);
+  assert_log_message_value(deserialized, log_msg_get_match_handle(1), "match1");
+  cr_assert_eq(deserialized->rcptid, msg->rcptid);
+  cr_assert_eq(deserialized->timestamps[LM_TS_RECVD].ut_sec, msg->timestamps[LM_TS_RECVD].ut_sec);
+  cr_assert_eq(deserialized->timestamps[LM_TS_STAMP].ut_gmtoff, msg->timestamps[LM_TS_STAMP].ut_gmtoff);
+
+  NVNativeValue native;
+  cr_assert(log_msg_get_native_value(deserialized, log_msg_get_value_handle("native_int"), &native, NULL),
+            "native values should be kept in binary form");
+  cr_assert_eq(native.i64, -42);
+
+  GString *deserialized_sdata = g_string_new("");
+  log_msg_format_sdata(deserialized, deserialized_sdata, 0);
+  cr_assert_str_eq(deserialized_sdata->str, sdata->str, "the order of SDATA elements should be kept");
+
+  g_string_free(sdata, TRUE);
+  g_string_free(deserialized_sdata, TRUE);
+  log_msg_unref(deserialized);
+  log_msg_unref(msg);
+}
+
+Test(logmsg_serialize, compact_serialization_with_name_dictionary)
+{
+  gchar dict_storage[2048] = { 0 };
+
+  _check_compact_round_trip(dict_storage, sizeof(dict_storage));
+  cr_assert(dict_storage[0] != 0, "names should have been added to the dictionary");
+}
+
+Test(logmsg_serialize, compact_serialization_names_are_only_stored_when_committed)
+{
+  gchar dict_storage[2048] = { 0 };
+  LogMessage *msg = _create_message_to_be_serialized(RAW_MSG, strlen(RAW_MSG));
+  GString *stream = g_string_sized_new(512);
+  SerializeArchive *sa = serialize_string_archive_new(stream);
+  NVNameDict *name_dict = nv_name_dict_new(dict_storage, sizeof(dict_storage));
+
+  cr_assert(log_msg_serialize_compact(msg, sa, name_dict));
+  cr_assert_eq(dict_storage[0], 0, "names must not be stored before the record is written");
+
+  /* the ids are assigned already, serializing again does not add anything */
+  g_string_truncate(stream, 0);
+  cr_assert(log_msg_serialize_compact(msg, sa, name_dict));
+  nv_name_dict_commit(name_dict);
+  cr_assert_neq(dict_storage[0], 0);
+
+  gsize used = 0;
+  while (dict_storage[used])
+    used += (guint8) dict_storage[used] + 1;
+
+  nv_name_dict_commit(name_dict);
+  cr_assert_eq(dict_storage[used], 0, "committing again should not add anything");
+
+  nv_name_dict_free(name_dict);
+  serialize_archive_free(sa);
+  g_string_free(stream, TRUE);
+  log_msg_unref(msg);
+}
+
+Test(logmsg_serialize, compact_serialization_without_name_dictionary)
+{
+  _check_compact_round_trip(NULL, 0);
+}
+
+Test(logmsg_serialize, compact_serialization_stores_names_inline_once_the_dictionary_is_full)
+{
+  gchar dict_storage[64] = { 0 };
+
+  _check_compact_round_trip(dict_storage, sizeof(dict_storage));
+}
+
+Test(logmsg_serialize, compact_serialization_needs_the_name_dictionary_to_deserialize)
+{
+  gchar dict_storage[2048] = { 0 };
+  LogMessage *msg = _create_message_to_be_serialized(RAW_MSG, strlen(RAW_MSG));
+  GString *stream = g_string_sized_new(512);
+  SerializeArchive *sa = serialize_string_archive_new(stream);
+  NVNameDict *name_dict = nv_name_dict_new(dict_storage, sizeof(dict_storage));
+
+  cr_assert(log_msg_serialize_compact(msg, sa, name_dict));
+
+  LogMessage *deserialized = log_msg_new_empty();
+  cr_assert_not(log_msg_deserialize(deserialized, sa));
+
+  log_msg_unref(deserialized);
+  nv_name_dict_free(name_dict);
+  serialize_archive_free(sa);
+  g_string_free(stream, TRUE);
+  log_msg_unref(msg);
+}
+
+Test(logmsg_serialize, compact_serialization_is_smaller)
+{
+  gchar dict_storage[2048] = { 0 };
+  LogMessage *msg = _create_message_to_be_serialized(RAW_MSG, strlen(RAW_MSG));
+  GString *stream = g_string_sized_new(512);
+  SerializeArchive *sa = serialize_string_archive_new(stream);
+  gsize compact_len;
+
+  log_msg_serialize(msg, sa, LMSF_COMPACTION);
+
+  LogMessage *deserialized = _compact_round_trip(msg, dict_storage, sizeof(dict_storage), &compact_len);
+  cr_assert_lt(compact_len, stream->len / 2);
+
+  log_msg_unref(deserialized);
+  serialize_archive_free(sa);
+  g_string_free(stream, TRUE);
+  log_msg_unref(msg);
+}
+
 Test(logmsg_serialize, serialization_performance)
 {
   LogMessage *msg = _create_message_to_be_serialized(RAW_MSG, strlen(RAW_MSG));
@@ -0,0 +1,121 @@
+/*
+ * Copyright (c) 2026 Axoflow
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+#include <criterion/criterion.h>
+
+#include "logmsg/logmsg-slab.h"
+#include "logmsg/logmsg.h"
+#include "apphook.h"
+
+#include <string.h>
+
+Test(logmsg_slab, freed_blocks_are_reused_by_the_same_thread)
+{
+  gpointer p1 = log_msg_slab_alloc(600);
+  memset(p1, 'x', 600);
+  log_msg_slab_free(p1);
+
+  gpointer p2 = log_msg_slab_alloc(1000);
+  cr_assert_eq(p1, p2, "a block of the same size class should have been reused");
+  log_msg_slab_free(p2);
+}
+
+Test(logmsg_slab, usable_size_is_rounded_up_to_size_class)
+{
+  cr_assert_eq(log_msg_slab_get_usable_size(100), 512);
+  cr_assert_eq(log_msg_slab_get_usable_size(513), 1024);
+  cr_assert_eq(log_msg_slab_get_usable_size(LOG_MSG_SLAB_MAX_SIZE), LOG_MSG_SLAB_MAX_SIZE);
+  cr_assert_eq(log_msg_slab_get_usable_size(LOG_MSG_SLAB_MAX_SIZE + 1), LOG_MSG_SLAB_MAX_SIZE + 1);
+}
+
+Test(logmsg_slab, large_allocations_and_realloc_preserve_contents)
+{
+  gchar *p = log_msg_slab_alloc(256);
+  memset(p, 'a', 256);
+
+  p = log_msg_slab_realloc(p, 4000);
+  for (gint i = 0; i < 256; i++)
+    cr_assert_eq(p[i], 'a');
+
+  p = log_msg_slab_realloc(p, LOG_MSG_SLAB_MAX_SIZE * 4);
+  for (gint i = 0; i < 256; i++)
+    cr_assert_eq(p[i], 'a');
+  log_msg_slab_free(p);
+}
+
+static gpointer
+_free_blocks_in_thread(gpointer user_data)
+{
+  GPtrArray *blocks = (GPtrArray *) user_data;
+
+  for (gint i = 0; i < blocks->len; i++)
+    log_msg_slab_free(g_ptr_array_index(blocks, i));
+  return NULL;
+}
+
+Test(logmsg_slab, blocks_freed_by_other_threads_are_returned_to_the_owner)
+{
+  GPtrArray *blocks = g_ptr_array_new();
+
+  for (gint i = 0; i < 16; i++)
+    g_ptr_array_add(blocks, log_msg_slab_alloc(2048));
+
+  GThread *thread = g_thread_new("slab-free", _free_blocks_in_thread, blocks);
+  g_thread_join(thread);
+
+  /* the remote free list is reclaimed once the local one runs empty */
+  gpointer p = log_msg_slab_alloc(2048);
+  gboolean found = FALSE;
+  for (gint i = 0; i < blocks->len; i++)
+    found |= (g_ptr_array_index(blocks, i) == p);
+  cr_assert(found, "a block freed by another thread should have been reused");
+  log_msg_slab_free(p);
+
+  g_ptr_array_free(blocks, TRUE);
+}
+
+Test(logmsg_slab, log_messages_are_allocated_from_the_slab)
+{
+  LogMessage *msg = log_msg_new_empty();
+  log_msg_set_value(msg, LM_V_MESSAGE, "foobar", -1);
+  log_msg_unref(msg);
+
+  LogMessage *msg2 = log_msg_new_empty();
+  cr_assert_eq(msg, msg2);
+  log_msg_unref(msg2);
+}
+
+static void
+setup(void)
+{
+  app_startup();
+  log_msg_slab_set_enabled(TRUE);
+}
+
+static void
+teardown(void)
+{
+  log_msg_slab_set_enabled(FALSE);
+  app_shutdown();
+}
+
+TestSuite(logmsg_slab, .init = setup, .fini = teardown);
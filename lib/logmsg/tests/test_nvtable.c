@@ -140,6 +140,97 @@ Test(nvtable, test_nv_registry)
   nv_registry_free(reg);
 }
 
+#define REGISTRY_TEST_THREADS 8
+#define REGISTRY_TEST_NAMES 2000
+
+typedef struct
+{
+  NVRegistry *registry;
+  gint iterations;
+  NVHandle handles[REGISTRY_TEST_NAMES];
+} RegistryTestThreadData;
+
+static gpointer
+_alloc_handles_in_thread(gpointer user_data)
+{
+  RegistryTestThreadData *data = (RegistryTestThreadData *) user_data;
+  gchar name[32];
+
+  for (gint i = 0; i < data->iterations; i++)
+    {
+      for (gint j = 0; j < REGISTRY_TEST_NAMES; j++)
+        {
+          g_snprintf(name, sizeof(name), "name.%d", j);
+          data->handles[j] = nv_registry_alloc_handle(data->registry, name);
+        }
+    }
+  return NULL;
+}
+
+static void
+_run_registry_threads(NVRegistry *reg, RegistryTestThreadData *data, gint iterations)
+{
+  GThread *threads[REGISTRY_TEST_THREADS];
+
+  for (gint i = 0; i < REGISTRY_TEST_THREADS; i++)
+    {
+      data[i].registry = reg;
+      data[i].iterations = iterations;
+      threads[i] = g_thread_new(NULL, _alloc_handles_in_thread, &data[i]);
+    }
+  for (gint i = 0; i < REGISTRY_TEST_THREADS; i++)
+    g_thread_join(threads[i]);
+}
+
+Test(nvtable, test_nv_registry_concurrent_allocations_return_the_same_handles)
+{
+  const gchar *builtins[] = { "BUILTIN1", NULL };
+  NVRegistry *reg = nv_registry_new(builtins, NVHANDLE_MAX_VALUE);
+  RegistryTestThreadData *data = g_new0(RegistryTestThreadData, REGISTRY_TEST_THREADS);
+
+  _run_registry_threads(reg, data, 1);
+
+  cr_assert_eq(reg->names->len, REGISTRY_TEST_NAMES + 1);
+  for (gint j = 0; j < REGISTRY_TEST_NAMES; j++)
+    {
+      gchar name[32];
+
+      g_snprintf(name, sizeof(name), "name.%d", j);
+      cr_assert_neq(data[0].handles[j], 0);
+      cr_assert_str_eq(nv_registry_get_handle_name(reg, data[0].handles[j], NULL), name);
+      cr_assert_eq(nv_registry_get_handle(reg, name), data[0].handles[j]);
+      for (gint i = 1; i < REGISTRY_TEST_THREADS; i++)
+        cr_assert_eq(data[i].handles[j], data[0].handles[j]);
+    }
+
+  g_free(data);
+  nv_registry_free(reg);
+}
+
+Test(nvtable, test_nv_registry_concurrent_lookups_return_the_allocated_handles)
+{
+  const gchar *builtins[] = { "BUILTIN1", NULL };
+  NVRegistry *reg = nv_registry_new(builtins, NVHANDLE_MAX_VALUE);
+  RegistryTestThreadData *data = g_new0(RegistryTestThreadData, REGISTRY_TEST_THREADS);
+  NVHandle allocated[REGISTRY_TEST_NAMES];
+
+  _run_registry_threads(reg, data, 1);
+  memcpy(allocated, data[0].handles, sizeof(allocated));
+
+  /* the names exist by now, so these are lookups only */
+  _run_registry_threads(reg, data, 3);
+
+  cr_assert_eq(reg->names->len, REGISTRY_TEST_NAMES + 1);
+  for (gint i = 0; i < REGISTRY_TEST_THREADS; i++)
+    {
+      for (gint j = 0; j < REGISTRY_TEST_NAMES; j++)
+        cr_assert_eq(data[i].handles[j], allocated[j]);
+    }
+
+  g_free(data);
+  nv_registry_free(reg);
+}
+
 /*
  *  - NVTable direct values
  *    - set/get static NV entries
@@ -1166,3 +1257,298 @@ Test(nvtable, test_nvtable_compact_skips_unset_values)
 
   nv_table_unref(tab2);
 }
+
+Test(nvtable, test_nvtable_external_values_are_referenced_and_copied_by_compact)
+{
+  static gchar input[] = "external-value\0";
+  NVTable *tab1, *tab2;
+  gssize size;
+  const gchar *value;
+
+  tab1 = nv_table_new(STATIC_VALUES, STATIC_VALUES, 1024);
+  cr_assert(nv_table_add_value_external(tab1, STATIC_HANDLE, STATIC_NAME, strlen(STATIC_NAME), input, 14, 0, NULL));
+  cr_assert(nv_table_add_value_external(tab1, DYN_HANDLE, DYN_NAME, strlen(DYN_NAME), input + 9, 5, 0, NULL));
+  nv_table_add_value_indirect(tab1, DYN_HANDLE + 1, "indirect-name", 13,
+                              &(NVReferencedSlice)
+  {
+    STATIC_HANDLE, 0, 8
+  }, 0, NULL);
+  cr_assert(nv_table_has_unserializable_entries(tab1));
+
+  value = nv_table_get_value(tab1, STATIC_HANDLE, &size, NULL);
+  cr_assert_eq(value, input);
+  cr_assert_eq(size, 14);
+  value = nv_table_get_value(tab1, DYN_HANDLE, &size, NULL);
+  cr_assert_eq(value, input + 9);
+  cr_assert_eq(size, 5);
+  value = nv_table_get_value(tab1, DYN_HANDLE + 1, &size, NULL);
+  cr_assert_eq(value, input);
+  cr_assert_eq(size, 8);
+
+  tab2 = nv_table_compact(tab1);
+  cr_assert_not(nv_table_has_unserializable_entries(tab2));
+
+  value = nv_table_get_value(tab2, STATIC_HANDLE, &size, NULL);
+  cr_assert_neq(value, input);
+  cr_assert_str_eq(value, "external-value");
+  value = nv_table_get_value(tab2, DYN_HANDLE, &size, NULL);
+  cr_assert_str_eq(value, "value");
+  value = nv_table_get_value(tab2, DYN_HANDLE + 1, &size, NULL);
+  cr_assert(strncmp(value, "external", size) == 0);
+  cr_assert_eq(size, 8);
+
+  /* overwriting the external value makes the indirect one direct */
+  cr_assert(nv_table_add_value(tab1, STATIC_HANDLE, STATIC_NAME, strlen(STATIC_NAME), "foo", 3, 0, NULL));
+  value = nv_table_get_value(tab1, STATIC_HANDLE, &size, NULL);
+  cr_assert_str_eq(value, "foo");
+  value = nv_table_get_value(tab1, DYN_HANDLE + 1, &size, NULL);
+  cr_assert_neq(value, input);
+  cr_assert(strncmp(value, "external", size) == 0);
+
+  nv_table_unset_value(tab1, DYN_HANDLE);
+  cr_assert_not(nv_table_has_unserializable_entries(tab1));
+
+  nv_table_unref(tab1);
+  nv_table_unref(tab2);
+}
+
+static gboolean
+_add_value_native(NVTable *tab, NVHandle handle, const gchar *name, const NVNativeValue *native, NVType type)
+{
+  return nv_table_add_value_native(tab, handle, name, strlen(name), native, type, NULL);
+}
+
+static void
+assert_native_value_rendered_as(NVTable *tab, NVHandle handle, NVNativeKind kind, gint64 i64, const gchar *expected)
+{
+  NVNativeValue native = { .kind = kind, .i64 = i64 };
+  gssize size;
+
+  cr_assert(_add_value_native(tab, handle, DYN_NAME, &native, 0));
+  const gchar *value = nv_table_get_value(tab, handle, &size, NULL);
+  cr_assert_str_eq(value, expected);
+  cr_assert_eq(size, strlen(expected));
+}
+
+Test(nvtable, test_nvtable_native_values_are_rendered_on_demand)
+{
+  NVTable *tab = nv_table_new(STATIC_VALUES, STATIC_VALUES, 1024);
+  NVNativeValue native = { .kind = NVN_DOUBLE, .d = 3.5 };
+  NVType type;
+
+  assert_native_value_rendered_as(tab, DYN_HANDLE, NVN_INT64, -42, "-42");
+  assert_native_value_rendered_as(tab, DYN_HANDLE, NVN_INT64, G_GINT64_CONSTANT(4294967296), "4294967296");
+  assert_native_value_rendered_as(tab, DYN_HANDLE, NVN_BOOLEAN, 1, "true");
+  assert_native_value_rendered_as(tab, DYN_HANDLE, NVN_BOOLEAN, 0, "false");
+  assert_native_value_rendered_as(tab, DYN_HANDLE, NVN_DATETIME_MSEC, 1653246684123, "1653246684.123");
+  assert_native_value_rendered_as(tab, DYN_HANDLE, NVN_DATETIME_MSEC, -1500, "-2.500");
+
+  cr_assert(_add_value_native(tab, STATIC_HANDLE, STATIC_NAME, &native, 3));
+  NVEntry *entry = nv_table_get_entry(tab, STATIC_HANDLE, NULL, NULL);
+  cr_assert_eq(entry->vnative.value_len, 0, "the value should not be rendered until it is requested");
+  cr_assert_str_eq(nv_table_get_value(tab, STATIC_HANDLE, NULL, NULL), "3.500000");
+  cr_assert_eq(entry->vnative.value_len, 8);
+
+  memset(&native, 0, sizeof(native));
+  cr_assert(nv_table_get_native_value(tab, STATIC_HANDLE, &native, &type));
+  cr_assert_eq(native.kind, NVN_DOUBLE);
+  cr_assert_float_eq(native.d, 3.5, 1e-9);
+  cr_assert_eq(type, 3);
+  cr_assert(nv_table_has_unserializable_entries(tab));
+
+  /* overwriting with a string turns it into a direct entry */
+  cr_assert(nv_table_add_value(tab, STATIC_HANDLE, STATIC_NAME, strlen(STATIC_NAME), "foo", 3, 0, NULL));
+  cr_assert_not(nv_table_get_native_value(tab, STATIC_HANDLE, &native, NULL));
+  cr_assert_str_eq(nv_table_get_value(tab, STATIC_HANDLE, NULL, NULL), "foo");
+
+  nv_table_unset_value(tab, DYN_HANDLE);
+  cr_assert_not(nv_table_get_native_value(tab, DYN_HANDLE, &native, NULL));
+  cr_assert_not(nv_table_has_unserializable_entries(tab));
+
+  nv_table_unref(tab);
+}
+
+Test(nvtable, test_nvtable_native_value_renderings_live_as_long_as_the_table)
+{
+  NVTable *tab = nv_table_new(STATIC_VALUES, STATIC_VALUES, 4096);
+  NVNativeValue native = { .kind = NVN_INT64, .i64 = 42 };
+  gchar name[16];
+
+  cr_assert(_add_value_native(tab, DYN_HANDLE, DYN_NAME, &native, 0));
+  const gchar *value = nv_table_get_value(tab, DYN_HANDLE, NULL, NULL);
+
+  /* rendering many other values must not clobber the one returned above */
+  for (gint i = 1; i <= 32; i++)
+    {
+      native.i64 = i;
+      g_snprintf(name, sizeof(name), "VAL%d", DYN_HANDLE + i);
+      cr_assert(_add_value_native(tab, DYN_HANDLE + i, name, &native, 0));
+      nv_table_get_value(tab, DYN_HANDLE + i, NULL, NULL);
+    }
+  cr_assert_str_eq(value, "42");
+
+  /* a longer rendering does not fit into the old entry */
+  native.kind = NVN_DOUBLE;
+  native.d = -G_MAXDOUBLE;
+  cr_assert(_add_value_native(tab, DYN_HANDLE, DYN_NAME, &native, 0));
+  gssize size;
+  value = nv_table_get_value(tab, DYN_HANDLE, &size, NULL);
+  cr_assert_eq(size, strlen(value));
+  cr_assert(g_str_has_prefix(value, "-17976931348623157"));
+  cr_assert(g_str_has_suffix(value, ".000000"));
+
+  nv_table_unref(tab);
+}
+
+Test(nvtable, test_nvtable_native_values_are_copied_by_indirect_entries_and_compact)
+{
+  NVTable *tab1, *tab2;
+  NVNativeValue native = { .kind = NVN_INT64, .i64 = 123456 };
+  gssize size;
+  const gchar *value;
+
+  tab1 = nv_table_new(STATIC_VALUES, STATIC_VALUES, 1024);
+  cr_assert(_add_value_native(tab1, DYN_HANDLE, DYN_NAME, &native, 0));
+  nv_table_add_value_indirect(tab1, DYN_HANDLE + 1, "indirect-name", 13,
+                              &(NVReferencedSlice)
+  {
+    DYN_HANDLE, 1, 3
+  }, 0, NULL);
+
+  value = nv_table_get_value(tab1, DYN_HANDLE + 1, &size, NULL);
+  cr_assert(strncmp(value, "234", size) == 0);
+  cr_assert_eq(size, 3);
+
+  tab2 = nv_table_compact(tab1);
+  cr_assert_not(nv_table_has_unserializable_entries(tab2));
+  cr_assert_not(nv_table_get_native_value(tab2, DYN_HANDLE, &native, NULL));
+  value = nv_table_get_value(tab2, DYN_HANDLE, &size, NULL);
+  cr_assert_str_eq(value, "123456");
+  value = nv_table_get_value(tab2, DYN_HANDLE + 1, &size, NULL);
+  cr_assert(strncmp(value, "234", size) == 0);
+
+  nv_table_unref(tab1);
+  nv_table_unref(tab2);
+}
+
+#define HASHED_INDEX_SIZE 1000
+
+static NVTable *
+_add_value_and_grow(NVTable *tab, NVHandle handle, const gchar *value)
+{
+  gchar name[16];
+
+  g_snprintf(name, sizeof(name), "VAL%d", handle);
+  while (!nv_table_add_value(tab, handle, name, strlen(name), value, strlen(value), 0, NULL))
+    cr_assert(nv_table_realloc(tab, &tab));
+  return tab;
+}
+
+static NVTable *
+_create_table_with_many_dynamic_values(NVHandle *handles, gint num_handles)
+{
+  NVTable *tab = nv_table_new(STATIC_VALUES, STATIC_VALUES, 256);
+  gchar value[16];
+
+  for (gint i = 0; i < num_handles; i++)
+    {
+      g_snprintf(value, sizeof(value), "value%d", handles[i]);
+      tab = _add_value_and_grow(tab, handles[i], value);
+    }
+  return tab;
+}
+
+static void
+_shuffle_dynamic_handles(NVHandle *handles, gint num_handles)
+{
+  for (gint i = 0; i < num_handles; i++)
+    handles[i] = STATIC_VALUES + 1 + i * 3;
+
+  for (gint i = num_handles - 1; i > 0; i--)
+    {
+      gint j = rand() % (i + 1);
+      NVHandle tmp = handles[i];
+
+      handles[i] = handles[j];
+      handles[j] = tmp;
+    }
+}
+
+static void
+_assert_table_contains_values(NVTable *tab, NVHandle *handles, gint num_handles)
+{
+  gchar value[16];
+
+  for (gint i = 0; i < num_handles; i++)
+    {
+      g_snprintf(value, sizeof(value), "value%d", handles[i]);
+      assert_nvtable(tab, handles[i], value, strlen(value));
+    }
+}
+
+Test(nvtable, test_nvtable_hashed_index_lookup)
+{
+  NVHandle handles[HASHED_INDEX_SIZE];
+
+  srand(time(NULL));
+  _shuffle_dynamic_handles(handles, HASHED_INDEX_SIZE);
+  NVTable *tab = _create_table_with_many_dynamic_values(handles, HASHED_INDEX_SIZE);
+
+  cr_assert_eq(tab->index_size, HASHED_INDEX_SIZE);
+  cr_assert_neq(tab->index_hash_ofs, 0, "the index should have been hashed above the threshold");
+  _assert_table_contains_values(tab, handles, HASHED_INDEX_SIZE);
+
+  /* handles in between the ones we added are not present */
+  cr_assert_not(nv_table_is_value_set(tab, STATIC_VALUES + 2));
+  cr_assert_not(nv_table_is_value_set(tab, STATIC_VALUES + 1 + HASHED_INDEX_SIZE * 3));
+
+  /* overwrite an existing value, the index must not grow */
+  tab = _add_value_and_grow(tab, handles[0], "a-much-longer-value-than-before");
+  assert_nvtable(tab, handles[0], "a-much-longer-value-than-before", 31);
+  cr_assert_eq(tab->index_size, HASHED_INDEX_SIZE);
+
+  cr_assert(nv_table_unset_value(tab, handles[1]));
+  cr_assert_null(nv_table_get_value(tab, handles[1], NULL, NULL));
+
+  nv_table_unref(tab);
+}
+
+Test(nvtable, test_nvtable_hashed_index_survives_clone_and_compact)
+{
+  NVHandle handles[HASHED_INDEX_SIZE];
+
+  _shuffle_dynamic_handles(handles, HASHED_INDEX_SIZE);
+  NVTable *tab = _create_table_with_many_dynamic_values(handles, HASHED_INDEX_SIZE);
+
+  NVTable *clone = nv_table_clone(tab, 64);
+  cr_assert_eq(clone->index_hash_ofs, tab->index_hash_ofs);
+  _assert_table_contains_values(clone, handles, HASHED_INDEX_SIZE);
+
+  NVTable *compacted = nv_table_compact(tab);
+  _assert_table_contains_values(compacted, handles, HASHED_INDEX_SIZE);
+
+  nv_table_unref(compacted);
+  nv_table_unref(clone);
+  nv_table_unref(tab);
+}
+
+Test(nvtable, test_nvtable_hashed_index_is_dropped_by_compaction)
+{
+  NVHandle handles[HASHED_INDEX_SIZE];
+
+  _shuffle_dynamic_handles(handles, HASHED_INDEX_SIZE);
+  NVTable *tab = _create_table_with_many_dynamic_values(handles, HASHED_INDEX_SIZE);
+  cr_assert(nv_table_has_unserializable_entries(tab),
+            "tables with a hashed index have to be compacted before serialization");
+
+  NVTable *compacted = nv_table_compact(tab);
+  cr_assert_eq(compacted->index_hash_ofs, 0);
+  cr_assert_not(nv_table_has_unserializable_entries(compacted));
+
+  NVIndexEntry *index_table = nv_table_get_index(compacted);
+  for (gint i = 1; i < HASHED_INDEX_SIZE; i++)
+    cr_assert_lt(index_table[i - 1].handle, index_table[i].handle);
+
+  nv_table_unref(compacted);
+  nv_table_unref(tab);
+}
@@ -225,6 +225,45 @@ Test(tags, test_filters_false)
   log_msg_unref(msg);
 }
 
+#define CONCURRENT_TAG_THREADS 8
+#define CONCURRENT_TAGS 1000
+
+static gpointer
+_get_tags_in_thread(gpointer user_data)
+{
+  LogTagId *ids = (LogTagId *) user_data;
+
+  for (gint i = 0; i < CONCURRENT_TAGS; i++)
+    {
+      gchar *name = g_strdup_printf("concurrent-tag%d", i);
+      ids[i] = log_tags_get_by_name(name);
+      log_tags_inc_counter(ids[i]);
+      g_free(name);
+    }
+  return NULL;
+}
+
+Test(tags, test_concurrent_lookups_return_the_same_ids)
+{
+  LogTagId ids[CONCURRENT_TAG_THREADS][CONCURRENT_TAGS];
+  GThread *threads[CONCURRENT_TAG_THREADS];
+
+  for (gint i = 0; i < CONCURRENT_TAG_THREADS; i++)
+    threads[i] = g_thread_new(NULL, _get_tags_in_thread, ids[i]);
+  for (gint i = 0; i < CONCURRENT_TAG_THREADS; i++)
+    g_thread_join(threads[i]);
+
+  for (gint j = 0; j < CONCURRENT_TAGS; j++)
+    {
+      gchar *name = g_strdup_printf("concurrent-tag%d", j);
+
+      cr_assert_str_eq(log_tags_get_by_id(ids[0][j]), name);
+      for (gint i = 1; i < CONCURRENT_TAG_THREADS; i++)
+        cr_assert_eq(ids[i][j], ids[0][j], "Tag %s got different ids in different threads", name);
+      g_free(name);
+    }
+}
+
 static void
 setup(void)
 {
@@ -74,3 +74,52 @@ timestamp_deserialize(SerializeArchive *sa, UnixTime *timestamps)
   return (timestamp_deserialize_legacy(sa, timestamps) &&
           _read_log_stamp(sa, &timestamps[LM_TS_PROCESSED]));
 }
+
+/* the compact format stores the seconds of the received and processed
+ * timestamps relative to the timestamp of the message, as they are
+ * usually close to each other */
+static gboolean
+_write_log_stamp_compact(SerializeArchive *sa, const UnixTime *stamp, gint64 base_sec)
+{
+  return serialize_write_varint_signed(sa, stamp->ut_sec - base_sec) &&
+         serialize_write_varint(sa, stamp->ut_usec) &&
+         serialize_write_varint_signed(sa, stamp->ut_gmtoff);
+}
+
+static gboolean
+_read_log_stamp_compact(SerializeArchive *sa, UnixTime *stamp, gint64 base_sec)
+{
+  gint64 sec, gmtoff;
+  guint32 usec;
+
+  if (!serialize_read_varint_signed(sa, &sec) ||
+      !serialize_read_varint32(sa, &usec) ||
+      !serialize_read_varint_signed(sa, &gmtoff))
+    return FALSE;
+
+  stamp->ut_sec = sec + base_sec;
+  stamp->ut_usec = usec;
+  stamp->ut_gmtoff = (gint) gmtoff;
+  return TRUE;
+}
+
+gboolean
+timestamp_serialize_compact(SerializeArchive *sa, UnixTime *timestamps)
+{
+  gint64 base_sec = timestamps[LM_TS_STAMP].ut_sec;
+
+  return _write_log_stamp_compact(sa, &timestamps[LM_TS_STAMP], 0) &&
+         _write_log_stamp_compact(sa, &timestamps[LM_TS_RECVD], base_sec) &&
+         _write_log_stamp_compact(sa, &timestamps[LM_TS_PROCESSED], base_sec);
+}
+
+gboolean
+timestamp_deserialize_compact(SerializeArchive *sa, UnixTime *timestamps)
+{
+  if (!_read_log_stamp_compact(sa, &timestamps[LM_TS_STAMP], 0))
+    return FALSE;
+
+  gint64 base_sec = timestamps[LM_TS_STAMP].ut_sec;
+  return _read_log_stamp_compact(sa, &timestamps[LM_TS_RECVD], base_sec) &&
+         _read_log_stamp_compact(sa, &timestamps[LM_TS_PROCESSED], base_sec);
+}
@@ -33,5 +33,8 @@ gboolean timestamp_serialize(SerializeArchive *sa, UnixTime *timestamps);
 gboolean timestamp_deserialize_legacy(SerializeArchive *sa, UnixTime *timestamps);
 gboolean timestamp_deserialize(SerializeArchive *sa, UnixTime *timestamps);
 
+gboolean timestamp_serialize_compact(SerializeArchive *sa, UnixTime *timestamps);
+gboolean timestamp_deserialize_compact(SerializeArchive *sa, UnixTime *timestamps);
+
 
 #endif
@@ -68,6 +68,33 @@ _log_proto_buffered_server_fallback_non_persistent(LogProtoBufferedServer *self)
   return self->persist_state == NULL;
 }
 
+static void
+log_proto_buffered_server_realloc_buffer(LogProtoBufferedServer *self, gsize buffer_size)
+{
+  self->buffer_chunk = log_msg_chunk_realloc(self->buffer_chunk, buffer_size);
+  self->buffer = self->buffer_chunk->data;
+}
+
+/*
+ * Messages parsed from the buffer may reference the data we have already
+ * consumed (see zero-copy-min-size()).  Whenever we are about to reuse
+ * the consumed part of the buffer, we switch to a new chunk instead if
+ * the current one is still referenced.  The contents of the buffer are
+ * not preserved.
+ */
+static void
+log_proto_buffered_server_unshare_buffer(LogProtoBufferedServer *self)
+{
+  if (self->buffer_chunk && log_msg_chunk_is_shared(self->buffer_chunk))
+    {
+      gsize buffer_size = self->buffer_chunk->size;
+
+      log_msg_chunk_unref(self->buffer_chunk);
+      self->buffer_chunk = log_msg_chunk_new(buffer_size);
+      self->buffer = self->buffer_chunk->data;
+    }
+}
+
 static gboolean
 log_proto_buffered_server_convert_from_raw(LogProtoBufferedServer *self, const guchar *raw_buffer, gsize raw_buffer_len)
 {
@@ -131,7 +158,7 @@ log_proto_buffered_server_convert_from_raw(LogProtoBufferedServer *self, const g
                   if (state->buffer_size > self->super.options->super.max_buffer_size)
                     state->buffer_size = self->super.options->super.max_buffer_size;
 
-                  self->buffer = g_realloc(self->buffer, state->buffer_size);
+                  log_proto_buffered_server_realloc_buffer(self, state->buffer_size);
                 }
               else
                 {
@@ -192,9 +219,10 @@ log_proto_buffered_server_apply_state(LogProtoBufferedServer *self, PersistEntry
   if (!self->buffer)
     {
       gssize buffer_size = MAX(state->buffer_size, self->super.options->super.init_buffer_size);
-      self->buffer = g_malloc(buffer_size);
+      log_proto_buffered_server_realloc_buffer(self, buffer_size);
       state->buffer_size = buffer_size;
     }
+  log_proto_buffered_server_unshare_buffer(self);
   state->pending_buffer_end = 0;
 
   if (state->file_inode &&
@@ -413,8 +441,9 @@ log_proto_buffered_server_convert_state(LogProtoBufferedServer *self, guint8 per
       if (!self->buffer || state->buffer_size < buffer_len)
         {
           gsize buffer_size = MAX(self->super.options->super.init_buffer_size, buffer_len);
-          self->buffer = g_realloc(self->buffer, buffer_size);
+          log_proto_buffered_server_realloc_buffer(self, buffer_size);
         }
+      log_proto_buffered_server_unshare_buffer(self);
       serialize_archive_free(archive);
 
       memcpy(self->buffer, buffer, buffer_len);
@@ -686,7 +715,19 @@ log_proto_buffered_server_split_buffer(LogProtoBufferedServer *self, LogProtoBuf
     return;
 
   /* move partial message to the beginning of the buffer to make space for new data */
-  memmove(self->buffer, *buffer_start, buffer_bytes);
+  if (log_msg_chunk_is_shared(self->buffer_chunk))
+    {
+      LogMsgChunk *old_chunk = self->buffer_chunk;
+
+      self->buffer_chunk = log_msg_chunk_new(old_chunk->size);
+      self->buffer = self->buffer_chunk->data;
+      memcpy(self->buffer, *buffer_start, buffer_bytes);
+      log_msg_chunk_unref(old_chunk);
+    }
+  else
+    {
+      memmove(self->buffer, *buffer_start, buffer_bytes);
+    }
   state->pending_buffer_pos = 0;
   state->pending_buffer_end = buffer_bytes;
   *buffer_start = self->buffer;
@@ -714,6 +755,28 @@ log_proto_buffered_server_split_buffer(LogProtoBufferedServer *self, LogProtoBuf
 
 }
 
+/*
+ * Values referenced in the buffer need to be NUL terminated, just like the
+ * ones stored in the NVTable.  If the message is followed by a byte that
+ * was consumed along with it (e.g. the EOL character), we can overwrite
+ * that with a NUL, no-one is going to look at it again.
+ */
+static inline void
+log_proto_buffered_server_terminate_message(LogProtoBufferedServer *self, LogProtoBufferedServerState *state,
+                                            const guchar *msg, gsize msg_len)
+{
+  gint min_size = self->super.options->super.zero_copy_min_size;
+
+  if (min_size <= 0 || msg_len < (gsize) min_size)
+    return;
+
+  if (msg < self->buffer || msg + msg_len >= self->buffer + state->pending_buffer_pos)
+    return;
+
+  ((guchar *) msg)[msg_len] = 0;
+  self->terminated_msg = msg;
+}
+
 static gboolean
 log_proto_buffered_server_fetch_from_buffer(LogProtoBufferedServer *self, const guchar **msg, gsize *msg_len,
                                             LogTransportAuxData *aux)
@@ -741,6 +804,7 @@ log_proto_buffered_server_fetch_from_buffer(LogProtoBufferedServer *self, const
           state->pending_raw_stream_pos += state->pending_raw_buffer_size;
           state->pending_raw_buffer_size = 0;
         }
+      log_proto_buffered_server_unshare_buffer(self);
       state->pending_buffer_pos = state->pending_buffer_end = 0;
       goto exit;
     }
@@ -751,6 +815,10 @@ log_proto_buffered_server_fetch_from_buffer(LogProtoBufferedServer *self, const
     {
       log_proto_buffered_server_split_buffer(self, state, &buffer_start, buffer_bytes);
     }
+  else if (*msg)
+    {
+      log_proto_buffered_server_terminate_message(self, state, *msg, *msg_len);
+    }
 
   if (aux)
     log_transport_aux_data_copy(aux, &self->buffer_aux);
@@ -763,7 +831,7 @@ static inline void
 log_proto_buffered_server_allocate_buffer(LogProtoBufferedServer *self, LogProtoBufferedServerState *state)
 {
   state->buffer_size = self->super.options->super.init_buffer_size;
-  self->buffer = g_malloc(state->buffer_size);
+  log_proto_buffered_server_realloc_buffer(self, state->buffer_size);
 }
 
 static inline gint
@@ -832,6 +900,7 @@ log_proto_buffered_server_fetch_into_buffer(LogProtoBufferedServer *self)
       if (state->raw_buffer_leftover_size > 0)
         {
           msg_error("EOF read on a channel with leftovers from previous character conversion, dropping input");
+          log_proto_buffered_server_unshare_buffer(self);
           state->pending_buffer_pos = state->pending_buffer_end = 0;
         }
       result = G_IO_STATUS_EOF;
@@ -875,6 +944,8 @@ _buffered_server_update_pos(LogProtoServer *s)
 
   if (state->pending_buffer_pos == state->pending_buffer_end)
     {
+      /* NOTE: the message just returned is still in the buffer, we must
+       * not switch chunks here, the next fetch_from_buffer() does that */
       state->pending_buffer_end = 0;
       state->pending_buffer_pos = 0;
       if (self->pos_tracking)
@@ -969,6 +1040,7 @@ log_proto_buffered_server_fetch(LogProtoServer *s, const guchar **msg, gsize *ms
   LogProtoBufferedServer *self = (LogProtoBufferedServer *) s;
   LogProtoStatus result = LPS_SUCCESS;
 
+  self->terminated_msg = NULL;
   if (G_UNLIKELY(self->flush_partial_message))
     {
       log_proto_buffered_server_flush(self, msg, msg_len);
@@ -1039,6 +1111,22 @@ exit:
   return result;
 }
 
+static LogMsgChunk *
+log_proto_buffered_server_get_input_chunk(LogProtoServer *s, const guchar *msg, gsize msg_len)
+{
+  LogProtoBufferedServer *self = (LogProtoBufferedServer *) s;
+  gint min_size = self->super.options->super.zero_copy_min_size;
+
+  if (min_size <= 0 || msg_len < (gsize) min_size)
+    return NULL;
+
+  /* only if log_proto_buffered_server_terminate_message() found it safe */
+  if (!msg || msg != self->terminated_msg)
+    return NULL;
+
+  return self->buffer_chunk;
+}
+
 gboolean
 log_proto_buffered_server_validate_options_method(LogProtoServer *s)
 {
@@ -1065,7 +1153,7 @@ log_proto_buffered_server_free_method(LogProtoServer *s)
 
   log_transport_aux_data_destroy(&self->buffer_aux);
 
-  g_free(self->buffer);
+  log_msg_chunk_unref(self->buffer_chunk);
   if (self->state1)
     {
       g_free(self->state1);
@@ -1085,6 +1173,7 @@ log_proto_buffered_server_init(LogProtoBufferedServer *self, LogTransport *trans
   self->super.free_fn = log_proto_buffered_server_free_method;
   self->super.restart_with_state = log_proto_buffered_server_restart_with_state;
   self->super.validate_options = log_proto_buffered_server_validate_options_method;
+  self->super.get_input_chunk = log_proto_buffered_server_get_input_chunk;
   self->convert = (GIConv) -1;
   self->reverse_convert = (GIConv) -1;
   self->read_data = log_proto_buffered_server_read_data_method;
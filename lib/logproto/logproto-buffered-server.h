@@ -90,7 +90,12 @@ struct _LogProtoBufferedServer
   PersistState *persist_state;
   PersistEntryHandle persist_handle;
   GIConv convert;
+  /* the buffer is allocated as a chunk, so that messages may reference
+   * it, see log_proto_buffered_server_get_input_chunk() */
+  LogMsgChunk *buffer_chunk;
   guchar *buffer;
+  /* the last message returned, if it was NUL terminated in the buffer */
+  const guchar *terminated_msg;
 
   GIConv reverse_convert;
   gchar *reverse_buffer;
@@ -24,14 +24,146 @@
 #include "logproto-dgram-server.h"
 #include "logproto-buffered-server.h"
 
+#include <errno.h>
+
 /* proto that reads the input in datagrams (e.g. the underlying transport
  * determines record sizes, such as UDP) */
 typedef struct _LogProtoDGramServer LogProtoDGramServer;
 struct _LogProtoDGramServer
 {
   LogProtoBufferedServer super;
+
+  /* datagrams received by a single read_batch() of the transport, they
+   * are returned one by one by read_data() */
+  struct
+  {
+    LogTransportDatagram *datagrams;
+    gchar *buffer;
+    gsize slot_size;
+    gint size;
+    gint pos;
+    gint count;
+  } batch;
 };
 
+static inline gboolean
+_has_pending_datagrams(LogProtoDGramServer *self)
+{
+  return self->batch.pos < self->batch.count;
+}
+
+static void
+_allocate_batch(LogProtoDGramServer *self, gsize slot_size)
+{
+  if (self->batch.buffer && self->batch.slot_size >= slot_size)
+    return;
+
+  g_free(self->batch.buffer);
+  self->batch.buffer = g_malloc(self->batch.size * slot_size);
+  self->batch.slot_size = slot_size;
+
+  if (!self->batch.datagrams)
+    {
+      self->batch.datagrams = g_new0(LogTransportDatagram, self->batch.size);
+      for (gint i = 0; i < self->batch.size; i++)
+        log_transport_aux_data_init(&self->batch.datagrams[i].aux);
+    }
+
+  for (gint i = 0; i < self->batch.size; i++)
+    {
+      self->batch.datagrams[i].buf = self->batch.buffer + i * slot_size;
+      self->batch.datagrams[i].buflen = slot_size;
+    }
+}
+
+static gint
+_receive_batch(LogProtoDGramServer *self, LogTransport *transport, gsize len)
+{
+  _allocate_batch(self, len);
+
+  self->batch.pos = self->batch.count = 0;
+  gint rc = log_transport_read_batch(transport, self->batch.datagrams, self->batch.size);
+  if (rc > 0)
+    self->batch.count = rc;
+  return rc;
+}
+
+static gint
+_take_datagram(LogProtoDGramServer *self, guchar *buf, gsize len, LogTransportAuxData *aux)
+{
+  while (_has_pending_datagrams(self))
+    {
+      LogTransportDatagram *datagram = &self->batch.datagrams[self->batch.pos++];
+
+      /* DGRAM sockets should never return EOF, empty datagrams are skipped */
+      if (datagram->len == 0)
+        {
+          log_transport_aux_data_reinit(&datagram->aux);
+          continue;
+        }
+
+      gsize datagram_len = MIN(datagram->len, len);
+      memcpy(buf, datagram->buf, datagram_len);
+      if (aux)
+        {
+          log_transport_aux_data_destroy(aux);
+          log_transport_aux_data_move(aux, &datagram->aux);
+        }
+      else
+        log_transport_aux_data_reinit(&datagram->aux);
+      return datagram_len;
+    }
+
+  errno = EAGAIN;
+  return -1;
+}
+
+static gint
+log_proto_dgram_server_read_data(LogProtoBufferedServer *s, guchar *buf, gsize len, LogTransportAuxData *aux)
+{
+  LogProtoDGramServer *self = (LogProtoDGramServer *) s;
+  LogTransport *transport = log_transport_stack_get_active(&s->super.transport_stack);
+
+  if (_has_pending_datagrams(self))
+    return _take_datagram(self, buf, len, aux);
+
+  if (self->batch.size <= 1 || !log_transport_can_read_batch(transport))
+    return log_transport_stack_read(&s->super.transport_stack, buf, len, aux);
+
+  gint rc = _receive_batch(self, transport, len);
+  if (rc <= 0)
+    return rc;
+
+  return _take_datagram(self, buf, len, aux);
+}
+
+static LogProtoPrepareAction
+log_proto_dgram_server_poll_prepare(LogProtoServer *s, GIOCondition *cond, gint *timeout)
+{
+  LogProtoDGramServer *self = (LogProtoDGramServer *) s;
+
+  /* the datagrams already received do not make the socket readable */
+  if (_has_pending_datagrams(self))
+    return LPPA_FORCE_SCHEDULE_FETCH;
+
+  return log_proto_buffered_server_poll_prepare(s, cond, timeout);
+}
+
+static void
+log_proto_dgram_server_free(LogProtoServer *s)
+{
+  LogProtoDGramServer *self = (LogProtoDGramServer *) s;
+
+  if (self->batch.datagrams)
+    {
+      for (gint i = 0; i < self->batch.size; i++)
+        log_transport_aux_data_destroy(&self->batch.datagrams[i].aux);
+      g_free(self->batch.datagrams);
+    }
+  g_free(self->batch.buffer);
+  log_proto_buffered_server_free_method(s);
+}
+
 static gboolean
 log_proto_dgram_server_fetch_from_buffer(LogProtoBufferedServer *s, const guchar *buffer_start, gsize buffer_bytes,
                                          const guchar **msg, gsize *msg_len)
@@ -55,6 +187,10 @@ log_proto_dgram_server_new(LogTransport *transport, const LogProtoServerOptionsS
 
   log_proto_buffered_server_init(&self->super, transport, options);
   self->super.fetch_from_buffer = log_proto_dgram_server_fetch_from_buffer;
+  self->super.read_data = log_proto_dgram_server_read_data;
   self->super.stream_based = FALSE;
+  self->super.super.poll_prepare = log_proto_dgram_server_poll_prepare;
+  self->super.super.free_fn = log_proto_dgram_server_free;
+  self->batch.size = options->super.dgram_batch_size;
   return &self->super.super;
 }
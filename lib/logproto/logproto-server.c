@@ -176,6 +176,7 @@ log_proto_server_options_defaults(LogProtoServerOptionsStorage *options)
   options->super.trim_large_messages = -1;
   options->super.init_buffer_size = -1;
   options->super.max_buffer_size = -1;
+  options->super.dgram_batch_size = -1;
   options->super.ack_tracker_factory = instant_ack_tracker_bookmarkless_factory_new();
   multi_line_options_defaults(&options->super.multi_line_options);
 }
@@ -211,6 +212,8 @@ log_proto_server_options_init(LogProtoServerOptionsStorage *options, GlobalConfi
     }
   if (options->super.init_buffer_size == -1)
     options->super.init_buffer_size = MIN(options->super.max_msg_size, options->super.max_buffer_size);
+  if (options->super.dgram_batch_size == -1)
+    options->super.dgram_batch_size = LOG_PROTO_SERVER_DEFAULT_DGRAM_BATCH_SIZE;
   multi_line_options_init(&options->super.multi_line_options);
 
   if (options->super.init)
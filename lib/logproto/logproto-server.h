@@ -30,6 +30,7 @@
 #include "transport/transport-aux-data.h"
 #include "ack-tracker/bookmark.h"
 #include "multi-line/multi-line-factory.h"
+#include "logmsg/logmsg-chunk.h"
 
 typedef struct _LogProtoServer LogProtoServer;
 typedef struct _LogProtoServerOptions LogProtoServerOptions;
@@ -43,6 +44,7 @@ typedef enum
 } LogProtoPrepareAction;
 
 #define LOG_PROTO_SERVER_OPTIONS_SIZE 160
+#define LOG_PROTO_SERVER_DEFAULT_DGRAM_BATCH_SIZE 16
 
 struct _LogProtoServerOptions
 {
@@ -55,6 +57,10 @@ struct _LogProtoServerOptions
   /* maximum message length in bytes */
   gint max_msg_size;
   gboolean trim_large_messages;
+  /* messages at least this long are referenced in the input buffer instead of being copied, 0 to disable */
+  gint zero_copy_min_size;
+  /* the number of datagrams received with a single syscall by datagram based protocols */
+  gint dgram_batch_size;
   gint init_buffer_size;
   gint max_buffer_size;
   gint idle_timeout;
@@ -99,6 +105,7 @@ struct _LogProtoServer
   LogProtoStatus (*fetch)(LogProtoServer *s, const guchar **msg, gsize *msg_len, gboolean *may_read,
                           LogTransportAuxData *aux, Bookmark *bookmark);
   gboolean (*validate_options)(LogProtoServer *s);
+  LogMsgChunk *(*get_input_chunk)(LogProtoServer *s, const guchar *msg, gsize msg_len);
   LogProtoStatus (*handshake)(LogProtoServer *s, gboolean *handshake_finished, LogProtoServer **proto_replacement);
   void (*free_fn)(LogProtoServer *s);
 };
@@ -173,6 +180,16 @@ log_proto_server_fetch(LogProtoServer *s, const guchar **msg, gsize *msg_len, gb
   return s->status;
 }
 
+/* Returns the input buffer @msg (as returned by the last fetch) is stored
+ * in, if the message may reference it instead of copying its values. */
+static inline LogMsgChunk *
+log_proto_server_get_input_chunk(LogProtoServer *s, const guchar *msg, gsize msg_len)
+{
+  if (s->get_input_chunk)
+    return s->get_input_chunk(s, msg, msg_len);
+  return NULL;
+}
+
 static inline gint
 log_proto_server_get_fd(LogProtoServer *s)
 {
@@ -182,6 +199,12 @@ log_proto_server_get_fd(LogProtoServer *s)
   return s->transport_stack.fd;
 }
 
+static inline gint
+log_proto_server_get_poll_fd(LogProtoServer *s)
+{
+  return log_transport_stack_get_poll_fd(&s->transport_stack);
+}
+
 static inline void
 log_proto_server_reset_error(LogProtoServer *s)
 {
@@ -156,3 +156,54 @@ Test(log_proto, test_log_proto_dgram_server_eof_handling)
   assert_proto_server_fetch_ignored_eof(proto);
   log_proto_server_free(proto);
 }
+
+static gint read_batch_calls;
+
+static gint
+_mock_read_batch(LogTransport *s, LogTransportDatagram *datagrams, gint count)
+{
+  gint n;
+
+  read_batch_calls++;
+  for (n = 0; n < count; n++)
+    {
+      gssize rc = log_transport_mock_read_method(s, datagrams[n].buf, datagrams[n].buflen, &datagrams[n].aux);
+      if (rc <= 0)
+        break;
+      datagrams[n].len = rc;
+    }
+  return n;
+}
+
+Test(log_proto, test_log_proto_dgram_server_reads_datagrams_in_batches)
+{
+  LogProtoServer *proto;
+  GIOCondition cond;
+  gint timeout;
+
+  proto_server_options.super.max_msg_size = 32;
+  proto_server_options.super.dgram_batch_size = 4;
+  LogTransport *transport = log_transport_mock_endless_records_new(
+                              "first", -1,
+                              "second", -1,
+                              "third", -1,
+                              "fourth", -1,
+                              "fifth", -1,
+                              LTM_EOF);
+  transport->read_batch = _mock_read_batch;
+  read_batch_calls = 0;
+
+  proto = log_proto_dgram_server_new(transport, get_inited_proto_server_options());
+  assert_proto_server_fetch(proto, "first", -1);
+  cr_assert_eq(log_proto_server_poll_prepare(proto, &cond, &timeout), LPPA_FORCE_SCHEDULE_FETCH,
+               "the remaining datagrams of the batch should be fetched without polling");
+  assert_proto_server_fetch(proto, "second", -1);
+  assert_proto_server_fetch(proto, "third", -1);
+  assert_proto_server_fetch(proto, "fourth", -1);
+  cr_assert_eq(read_batch_calls, 1);
+
+  assert_proto_server_fetch(proto, "fifth", -1);
+  cr_assert_eq(read_batch_calls, 2);
+  cr_assert_eq(log_proto_server_poll_prepare(proto, &cond, &timeout), LPPA_POLL_IO);
+  log_proto_server_free(proto);
+}
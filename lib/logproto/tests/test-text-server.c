@@ -177,6 +177,37 @@ Test(log_proto, test_log_proto_text_with_embedded_nuls)
   log_proto_server_free(proto);
 }
 
+Test(log_proto, test_log_proto_text_server_zero_copy_messages_are_terminated_in_the_buffer)
+{
+  LogProtoServer *proto;
+  const guchar *msg;
+  gsize msg_len;
+
+  proto_server_options.super.zero_copy_min_size = 4;
+  proto = construct_test_proto(
+            log_transport_mock_stream_new(
+              "0123456789\nab\n", -1,
+              LTM_EOF));
+
+  cr_assert_eq(proto_server_fetch(proto, &msg, &msg_len), LPS_SUCCESS);
+  cr_assert_eq(msg_len, 10);
+  cr_assert_eq(msg[msg_len], 0, "the EOL character should have been replaced by a NUL");
+
+  LogMsgChunk *chunk = log_proto_server_get_input_chunk(proto, msg, msg_len);
+  cr_assert_not_null(chunk);
+  /* act as a LogMessage referencing the buffer */
+  log_msg_chunk_ref(chunk);
+
+  assert_proto_server_fetch(proto, "ab", -1);
+  cr_assert_null(log_proto_server_get_input_chunk(proto, msg, 2), "short messages are not referenced");
+  assert_proto_server_fetch_failure(proto, LPS_EOF, NULL);
+  log_proto_server_free(proto);
+
+  /* the referenced chunk survives the proto */
+  cr_assert_str_eq((const gchar *) msg, "0123456789");
+  log_msg_chunk_unref(chunk);
+}
+
 Test(log_proto, test_log_proto_text_server_eol_before_eof)
 {
   LogProtoServer *proto;
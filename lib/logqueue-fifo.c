@@ -22,7 +22,7 @@
  *
  */
 
-#include "logqueue.h"
+#include "logqueue-fifo.h"
 #include "logpipe.h"
 #include "messages.h"
 #include "serialize.h"
@@ -30,6 +30,11 @@
 #include "stats/stats-counter.h"
 #include "stats/stats-cluster-single.h"
 #include "mainloop-worker.h"
+#include "atomic-gssize.h"
+#include "scratch-buffers.h"
+#include "syslog-names.h"
+#include "template/templates.h"
+#include "timeutils/unixtime.h"
 
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -56,21 +61,46 @@ QueueType log_queue_fifo_type = "FIFO";
  *
  *    input queue (per-thread) -> wait queue (locked) -> output queue (single-threaded)
  *
+ * Threads that don't have a per-thread input queue (e.g. they are not
+ * main loop workers) put their items on a shared input list instead, which
+ * is lock-free:
+ *
+ *    shared input (multi-producer) -> wait queue (locked) -> output queue (single-threaded)
+ *
  * Fastpath is:
  *   - input threads putting elements on their per-thread queue (lockless)
+ *   - other input threads pushing elements to the shared input (lockless)
  *   - output threads removing elements from the output queue (lockless)
  *
  * Slowpath:
  *   - input queue is overflown (or the input thread goes to sleep), wait
  *     queue mutex is grabbed, all elements are put to the wait queue.
  *
- *   - output queue is depleted, wait queue mutex is grabbed, all elements
- *     on the wait queue is put to the output queue
+ *   - output queue is depleted, wait queue mutex is grabbed, the elements
+ *     of the shared input are taken over in a single atomic operation and
+ *     appended to the wait queue, then all elements on the wait queue are
+ *     put to the output queue.
+ *
+ *   - an element is pushed to an empty shared input, the queue mutex is
+ *     grabbed to notify the output thread.
  *
  * Threading assumptions:
  *   - the head of the queue is only manipulated from the output thread
  *   - the tail of the queue is only manipulated from the input threads
  *
+ * Priority lanes:
+ *   - optionally, the wait and output queues are split into lanes, selected
+ *     by the severity of the message or by a template.  Lane 0 has the
+ *     highest priority.
+ *
+ *   - the output thread serves the highest priority lane first.  It refills
+ *     its lanes from the wait queue not only when they run empty, but also
+ *     when the wait queue has items of a higher priority than what it is
+ *     about to send.
+ *
+ *   - if the queue is full, messages of the lowest priority lane still
+ *     waiting in the wait queue are dropped first.
+ *
  */
 
 typedef struct _InputQueue
@@ -89,27 +119,127 @@ typedef struct _OverflowQueue
   gint non_flow_controlled_len;
 } OverflowQueue;
 
+/*
+ * Multi-producer, single-consumer list of nodes.  Producers push nodes to
+ * the head with a compare-and-swap, linking them through list.next, so the
+ * list is in reverse order.  The consumer takes the whole list over at
+ * once and reverses it.  As nodes are never removed one by one, there's no
+ * ABA problem.
+ */
+typedef struct _SharedInputQueue
+{
+  LogMessageQueueNode *head;
+  gint len;
+  gint non_flow_controlled_len;
+} SharedInputQueue;
+
+typedef struct _LogQueueFifoLaneMetrics
+{
+  StatsClusterKey *events_sc_key;
+  StatsClusterKey *delay_sample_sc_key;
+
+  StatsCounterItem *events;
+  StatsCounterItem *delay_sample;
+  time_t last_delay_update;
+} LogQueueFifoLaneMetrics;
+
 typedef struct _LogQueueFifo
 {
   LogQueue super;
 
-  /* scalable qoverflow implementation */
-  OverflowQueue output_queue;
-  OverflowQueue wait_queue;
+  SharedInputQueue shared_input;
+
+  /* scalable qoverflow implementation, one output and wait queue per lane */
+  OverflowQueue output_queue[LOG_QUEUE_FIFO_MAX_LANES];
+  OverflowQueue wait_queue[LOG_QUEUE_FIFO_MAX_LANES];
   OverflowQueue backlog_queue; /* entries that were sent but not acked yet */
 
+  gint num_lanes;
+  LogTemplate *lane_template;
+
   gint log_fifo_size;
+  gsize log_fifo_size_bytes;
+  /* size of the messages in the queue, excluding the backlog */
+  atomic_gssize memory_usage;
 
   struct
   {
     StatsClusterKey *capacity_sc_key;
     StatsCounterItem *capacity;
+    LogQueueFifoLaneMetrics lanes[LOG_QUEUE_FIFO_MAX_LANES];
   } metrics;
 
   gint num_input_queues;
   InputQueue input_queues[0];
 } LogQueueFifo;
 
+/*
+ * Memory budget shared by all LogQueueFifo instances.  Once the messages
+ * in memory queues take up more than the budget, new messages are
+ * dropped.  With the flow-control policy, messages whose source uses
+ * flow-control are still admitted, their sources are held back by their
+ * window anyway.  With the drop policy, those are dropped too, which caps
+ * memory use at the expense of losing messages.
+ */
+static gsize log_queue_fifo_memory_budget;
+static LogQueueFifoMemoryBudgetPolicy log_queue_fifo_memory_budget_policy;
+static atomic_gssize log_queue_fifo_total_memory_usage;
+
+void
+log_queue_fifo_set_memory_budget(gsize budget_bytes, LogQueueFifoMemoryBudgetPolicy policy)
+{
+  log_queue_fifo_memory_budget = budget_bytes;
+  log_queue_fifo_memory_budget_policy = policy;
+}
+
+gsize
+log_queue_fifo_get_total_memory_usage(void)
+{
+  return atomic_gssize_get_unsigned(&log_queue_fifo_total_memory_usage);
+}
+
+static inline void
+_memory_usage_add(LogQueueFifo *self, gsize value)
+{
+  atomic_gssize_add(&self->memory_usage, value);
+  atomic_gssize_add(&log_queue_fifo_total_memory_usage, value);
+  log_queue_memory_usage_add(&self->super, value);
+}
+
+static inline void
+_memory_usage_sub(LogQueueFifo *self, gsize value)
+{
+  atomic_gssize_sub(&self->memory_usage, value);
+  atomic_gssize_sub(&log_queue_fifo_total_memory_usage, value);
+  log_queue_memory_usage_sub(&self->super, value);
+}
+
+static inline gboolean
+_memory_limits_enabled(LogQueueFifo *self)
+{
+  return self->log_fifo_size_bytes > 0 || log_queue_fifo_memory_budget > 0;
+}
+
+/*
+ * Checks whether a message can be added on top of @pending bytes not yet
+ * accounted for.  Racy, like the length checks, the queue may exceed its
+ * limits by the messages of concurrent producers.
+ */
+static inline gboolean
+_memory_limits_admit(LogQueueFifo *self, gboolean flow_control_requested, gsize pending)
+{
+  if (log_queue_fifo_memory_budget > 0
+      && (!flow_control_requested || log_queue_fifo_memory_budget_policy == LQF_MEMORY_BUDGET_DROP)
+      && atomic_gssize_get_unsigned(&log_queue_fifo_total_memory_usage) + pending >= log_queue_fifo_memory_budget)
+    return FALSE;
+
+  if (self->log_fifo_size_bytes > 0 && !flow_control_requested
+      && atomic_gssize_get_unsigned(&self->memory_usage) + pending >= self->log_fifo_size_bytes)
+    return FALSE;
+
+  return TRUE;
+}
+
 /* NOTE: this is inherently racy. If the LogQueue->lock is taken, then the
  * race is limited to the changes in output_queue queue changes.
  *
@@ -127,7 +257,7 @@ iv_list_update_msg_size(LogQueueFifo *self, struct iv_list_head *head)
   iv_list_for_each_safe(ilh, ilh2, head)
   {
     msg = iv_list_entry(ilh, LogMessageQueueNode, list)->msg;
-    log_queue_memory_usage_add(&self->super, log_msg_get_size(msg));
+    _memory_usage_add(self, log_msg_get_size(msg));
   }
 }
 
@@ -135,14 +265,98 @@ static gint64
 log_queue_fifo_get_length(LogQueue *s)
 {
   LogQueueFifo *self = (LogQueueFifo *) s;
+  gint64 len = g_atomic_int_get(&self->shared_input.len);
 
-  return self->wait_queue.len + self->output_queue.len;
+  for (gint lane = 0; lane < self->num_lanes; lane++)
+    len += self->wait_queue[lane].len + self->output_queue[lane].len;
+  return len;
 }
 
 static gint64
 log_queue_fifo_get_non_flow_controlled_length(LogQueueFifo *self)
 {
-  return self->wait_queue.non_flow_controlled_len + self->output_queue.non_flow_controlled_len;
+  gint64 len = g_atomic_int_get(&self->shared_input.non_flow_controlled_len);
+
+  for (gint lane = 0; lane < self->num_lanes; lane++)
+    len += self->wait_queue[lane].non_flow_controlled_len + self->output_queue[lane].non_flow_controlled_len;
+  return len;
+}
+
+static inline void
+_overflow_queue_push_tail(OverflowQueue *self, LogMessageQueueNode *node)
+{
+  iv_list_add_tail(&node->list, &self->items);
+  self->len++;
+  if (!node->flow_control_requested)
+    self->non_flow_controlled_len++;
+}
+
+static inline void
+_overflow_queue_del(OverflowQueue *self, LogMessageQueueNode *node)
+{
+  iv_list_del_init(&node->list);
+  self->len--;
+  if (!node->flow_control_requested)
+    self->non_flow_controlled_len--;
+}
+
+static inline void
+_overflow_queue_splice_tail(OverflowQueue *self, OverflowQueue *target)
+{
+  iv_list_splice_tail_init(&self->items, &target->items);
+  target->len += self->len;
+  target->non_flow_controlled_len += self->non_flow_controlled_len;
+  self->len = 0;
+  self->non_flow_controlled_len = 0;
+}
+
+/* lane 0 has the highest priority */
+static gint
+_get_lane(LogQueueFifo *self, LogMessage *msg)
+{
+  if (self->num_lanes == 1)
+    return 0;
+
+  if (!self->lane_template)
+    return SYSLOG_PRI(msg->pri) * self->num_lanes / (SYSLOG_PRIMASK + 1);
+
+  ScratchBuffersMarker marker;
+  GString *buffer = scratch_buffers_alloc_and_mark(&marker);
+  LogTemplateEvalOptions options = DEFAULT_TEMPLATE_EVAL_OPTIONS;
+  gchar *end;
+
+  log_template_format(self->lane_template, msg, &options, buffer);
+  gint64 lane = g_ascii_strtoll(buffer->str, &end, 10);
+
+  /* anything that is not a lane number goes to the lowest priority lane */
+  if (end == buffer->str || *end)
+    lane = self->num_lanes - 1;
+  scratch_buffers_reclaim_marked(marker);
+
+  return CLAMP(lane, 0, self->num_lanes - 1);
+}
+
+static inline void
+_lane_events_add(LogQueueFifo *self, gint lane, gssize value)
+{
+  stats_counter_add(self->metrics.lanes[lane].events, value);
+}
+
+static inline void
+_update_lane_delay(LogQueueFifo *self, gint lane, LogMessage *msg)
+{
+  LogQueueFifoLaneMetrics *metrics = &self->metrics.lanes[lane];
+
+  if (!metrics->delay_sample)
+    return;
+
+  UnixTime now;
+  unix_time_set_now(&now);
+  if (metrics->last_delay_update != now.ut_sec)
+    {
+      stats_counter_set_time(metrics->delay_sample, unix_time_diff_in_msec(&now, &msg->timestamps[LM_TS_RECVD]));
+      metrics->last_delay_update = now.ut_sec;
+    }
 }
 
 gboolean
@@ -155,6 +369,10 @@ log_queue_fifo_is_empty_racy(LogQueue *s)
     {
       has_message_in_queue = TRUE;
     }
+  else if (g_atomic_pointer_get(&self->shared_input.head))
+    {
+      has_message_in_queue = TRUE;
+    }
   else
     {
       gint i;
@@ -176,10 +394,27 @@ log_queue_fifo_keep_on_reload(LogQueue *s)
 }
 
 static inline void
-log_queue_fifo_drop_messages_from_input_queue(LogQueueFifo *self, InputQueue *input_queue, gint num_of_messages_to_drop)
+_drop_node_from_input_queue(LogQueueFifo *self, InputQueue *input_queue, LogMessageQueueNode *node)
 {
   LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+  LogMessage *msg = node->msg;
+
+  path_options.ack_needed = node->ack_needed;
+  path_options.flow_control_requested = node->flow_control_requested;
+
+  iv_list_del(&node->list);
+  input_queue->len--;
+  if (!node->flow_control_requested)
+    input_queue->non_flow_controlled_len--;
+  log_queue_message_dropped(&self->super, msg);
+  log_msg_free_queue_node(node);
+
+  log_msg_drop(msg, &path_options, AT_PROCESSED);
+}
 
+static inline void
+log_queue_fifo_drop_messages_from_input_queue(LogQueueFifo *self, InputQueue *input_queue, gint num_of_messages_to_drop)
+{
   struct iv_list_head *item = input_queue->items.next;
   for (gint dropped = 0; dropped < num_of_messages_to_drop;)
     {
@@ -187,22 +422,10 @@ log_queue_fifo_drop_messages_from_input_queue(LogQueueFifo *self, InputQueue *in
 
       item = item->next;
 
-      path_options.ack_needed = node->ack_needed;
-      path_options.flow_control_requested = node->flow_control_requested;
-
-      if (path_options.flow_control_requested)
+      if (node->flow_control_requested)
         continue;
 
-      iv_list_del(&node->list);
-      input_queue->len--;
-      log_queue_dropped_messages_inc(&self->super);
-      log_msg_free_queue_node(node);
-
-      LogMessage *msg = node->msg;
-
-      input_queue->non_flow_controlled_len--;
-      log_msg_drop(msg, &path_options, AT_PROCESSED);
-
+      _drop_node_from_input_queue(self, input_queue, node);
       dropped++;
     }
 
@@ -243,13 +466,113 @@ log_queue_fifo_calculate_num_of_messages_to_drop(LogQueueFifo *self, InputQueue
   return TRUE;
 }
 
+static void
+log_queue_fifo_drop_messages_over_memory_limits(LogQueueFifo *self, InputQueue *input_queue)
+{
+  struct iv_list_head *ilh, *ilh2;
+  gsize pending = 0;
+  gint dropped = 0;
+
+  iv_list_for_each_safe(ilh, ilh2, &input_queue->items)
+  {
+    LogMessageQueueNode *node = iv_list_entry(ilh, LogMessageQueueNode, list);
+
+    if (_memory_limits_admit(self, node->flow_control_requested, pending))
+      {
+        pending += log_msg_get_size(node->msg);
+        continue;
+      }
+
+    _drop_node_from_input_queue(self, input_queue, node);
+    dropped++;
+  }
+
+  if (dropped > 0)
+    msg_debug("Destination queue memory limit reached, dropping messages",
+              evt_tag_long("log_fifo_size_bytes", self->log_fifo_size_bytes),
+              evt_tag_long("memory_budget", log_queue_fifo_memory_budget),
+              evt_tag_int("number_of_dropped_messages", dropped),
+              evt_tag_str("persist_name", self->super.persist_name));
+}
+
+/*
+ * Lock must be held.  Drops the newest message that is not flow-controlled
+ * from the lowest priority lane of the wait queue, considering lanes with
+ * a lower priority than @lane only.
+ */
+static gboolean
+log_queue_fifo_drop_message_from_lowest_lane(LogQueueFifo *self, gint lane)
+{
+  for (gint victim_lane = self->num_lanes - 1; victim_lane > lane; victim_lane--)
+    {
+      OverflowQueue *q = &self->wait_queue[victim_lane];
+      struct iv_list_head *ilh;
+
+      if (q->non_flow_controlled_len == 0)
+        continue;
+
+      for (ilh = q->items.prev; ilh != &q->items; ilh = ilh->prev)
+        {
+          LogMessageQueueNode *node = iv_list_entry(ilh, LogMessageQueueNode, list);
+          LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+          LogMessage *msg = node->msg;
+
+          if (node->flow_control_requested)
+            continue;
+
+          _overflow_queue_del(q, node);
+          _lane_events_add(self, victim_lane, -1);
+          log_queue_queued_messages_dec(&self->super);
+          _memory_usage_sub(self, log_msg_get_size(msg));
+          log_queue_message_dropped(&self->super, msg);
+
+          path_options.ack_needed = node->ack_needed;
+          log_msg_free_queue_node(node);
+          log_msg_drop(msg, &path_options, AT_PROCESSED);
+          return TRUE;
+        }
+    }
+  return FALSE;
+}
+
+static void
+log_queue_fifo_move_input_to_lanes_unlocked(LogQueueFifo *self, InputQueue *input_queue)
+{
+  struct iv_list_head *ilh, *ilh2;
+
+  iv_list_for_each_safe(ilh, ilh2, &input_queue->items)
+  {
+    LogMessageQueueNode *node = iv_list_entry(ilh, LogMessageQueueNode, list);
+
+    iv_list_del(&node->list);
+    _overflow_queue_push_tail(&self->wait_queue[node->lane], node);
+    _lane_events_add(self, node->lane, 1);
+  }
+  input_queue->len = 0;
+  input_queue->non_flow_controlled_len = 0;
+
+  gint dropped = 0;
+  while (log_queue_fifo_get_non_flow_controlled_length(self) > self->log_fifo_size
+         && log_queue_fifo_drop_message_from_lowest_lane(self, -1))
+    dropped++;
+
+  if (dropped > 0)
+    msg_debug("Destination queue full, dropping messages of the lowest priority lanes",
+              evt_tag_int("log_fifo_size", self->log_fifo_size),
+              evt_tag_int("number_of_dropped_messages", dropped),
+              evt_tag_str("persist_name", self->super.persist_name));
+}
+
 /* move items from the per-thread input queue to the lock-protected "wait" queue */
 static void
 log_queue_fifo_move_input_unlocked(LogQueueFifo *self, gint thread_index)
 {
   gint num_of_messages_to_drop;
-  gboolean drop_messages = log_queue_fifo_calculate_num_of_messages_to_drop(self, &self->input_queues[thread_index],
-                           &num_of_messages_to_drop);
+
+  /* with lanes, the lowest priority messages are dropped once the items are in their lanes */
+  gboolean drop_messages = self->num_lanes == 1
+                           && log_queue_fifo_calculate_num_of_messages_to_drop(self, &self->input_queues[thread_index],
+                               &num_of_messages_to_drop);
 
   if (drop_messages)
     {
@@ -257,12 +580,21 @@ log_queue_fifo_move_input_unlocked(LogQueueFifo *self, gint thread_index)
       log_queue_fifo_drop_messages_from_input_queue(self, &self->input_queues[thread_index], num_of_messages_to_drop);
     }
 
+  if (_memory_limits_enabled(self))
+    log_queue_fifo_drop_messages_over_memory_limits(self, &self->input_queues[thread_index]);
+
   log_queue_queued_messages_add(&self->super, self->input_queues[thread_index].len);
   iv_list_update_msg_size(self, &self->input_queues[thread_index].items);
 
-  iv_list_splice_tail_init(&self->input_queues[thread_index].items, &self->wait_queue.items);
-  self->wait_queue.len += self->input_queues[thread_index].len;
-  self->wait_queue.non_flow_controlled_len += self->input_queues[thread_index].non_flow_controlled_len;
+  if (self->num_lanes > 1)
+    {
+      log_queue_fifo_move_input_to_lanes_unlocked(self, &self->input_queues[thread_index]);
+      return;
+    }
+
+  iv_list_splice_tail_init(&self->input_queues[thread_index].items, &self->wait_queue[0].items);
+  self->wait_queue[0].len += self->input_queues[thread_index].len;
+  self->wait_queue[0].non_flow_controlled_len += self->input_queues[thread_index].non_flow_controlled_len;
   self->input_queues[thread_index].len = 0;
   self->input_queues[thread_index].non_flow_controlled_len = 0;
 }
@@ -294,13 +626,158 @@ log_queue_fifo_move_input(gpointer user_data)
 static inline gboolean
 _message_has_to_be_dropped(LogQueueFifo *self, const LogPathOptions *path_options)
 {
+  if (_memory_limits_enabled(self) && !_memory_limits_admit(self, path_options->flow_control_requested, 0))
+    return TRUE;
+
   return !path_options->flow_control_requested
          && log_queue_fifo_get_non_flow_controlled_length(self) >= self->log_fifo_size;
 }
 
+static LogMessageQueueNode *
+_shared_input_take_all(SharedInputQueue *self)
+{
+  LogMessageQueueNode *head;
+
+  do
+    {
+      head = g_atomic_pointer_get(&self->head);
+    }
+  while (head && !g_atomic_pointer_compare_and_exchange(&self->head, head, NULL));
+  return head;
+}
+
+/* returns TRUE if the shared input was empty */
+static gboolean
+_shared_input_push(SharedInputQueue *self, LogMessageQueueNode *node)
+{
+  LogMessageQueueNode *head;
+
+  /* the counters are incremented first, so they never go negative */
+  g_atomic_int_inc(&self->len);
+  if (!node->flow_control_requested)
+    g_atomic_int_inc(&self->non_flow_controlled_len);
+
+  do
+    {
+      head = g_atomic_pointer_get(&self->head);
+      node->list.next = head ? &head->list : NULL;
+    }
+  while (!g_atomic_pointer_compare_and_exchange(&self->head, head, node));
+  return head == NULL;
+}
+
+/*
+ * Items of the shared input always go through the wait queue, whichever
+ * thread takes them over, so that they are never reordered with items
+ * taken over earlier.
+ *
+ * lock must be held
+ */
+static void
+_move_items_from_shared_input_to_wait_queue(LogQueueFifo *self)
+{
+  OverflowQueue *lanes = self->wait_queue;
+  LogMessageQueueNode *node = _shared_input_take_all(&self->shared_input);
+  struct iv_list_head items;
+  gint len = 0, non_flow_controlled_len = 0;
+
+  if (!node)
+    return;
+
+  /* adding each node to the head of the list restores the original order */
+  INIT_IV_LIST_HEAD(&items);
+  while (node)
+    {
+      struct iv_list_head *next = node->list.next;
+
+      iv_list_add(&node->list, &items);
+      len++;
+      if (!node->flow_control_requested)
+        non_flow_controlled_len++;
+      node = next ? iv_list_entry(next, LogMessageQueueNode, list) : NULL;
+    }
+
+  if (self->num_lanes == 1)
+    {
+      iv_list_splice_tail(&items, &lanes[0].items);
+      lanes[0].len += len;
+      lanes[0].non_flow_controlled_len += non_flow_controlled_len;
+    }
+  else
+    {
+      struct iv_list_head *ilh, *ilh2;
+
+      iv_list_for_each_safe(ilh, ilh2, &items)
+      {
+        node = iv_list_entry(ilh, LogMessageQueueNode, list);
+        iv_list_del(&node->list);
+        _overflow_queue_push_tail(&lanes[node->lane], node);
+        _lane_events_add(self, node->lane, 1);
+      }
+    }
+  g_atomic_int_add(&self->shared_input.len, -len);
+  g_atomic_int_add(&self->shared_input.non_flow_controlled_len, -non_flow_controlled_len);
+}
+
+/* makes room for a message of @lane by dropping one of a lower priority */
+static gboolean
+_make_room_in_lower_lanes(LogQueueFifo *self, gint lane)
+{
+  if (self->num_lanes == 1)
+    return FALSE;
+
+  g_mutex_lock(&self->super.lock);
+  _move_items_from_shared_input_to_wait_queue(self);
+  gboolean dropped = log_queue_fifo_drop_message_from_lowest_lane(self, lane);
+  g_mutex_unlock(&self->super.lock);
+  return dropped;
+}
+
+/*
+ * Called from input threads without a per-thread input queue, does not
+ * take the queue lock, unless the output thread needs to be notified.
+ */
+static void
+log_queue_fifo_push_tail_shared(LogQueueFifo *self, LogMessage *msg, const LogPathOptions *path_options)
+{
+  gint lane = _get_lane(self, msg);
+
+  /* racy, the same way the per-thread input queues are, see
+   * log_queue_fifo_calculate_num_of_messages_to_drop() */
+  if (_message_has_to_be_dropped(self, path_options) && !_make_room_in_lower_lanes(self, lane))
+    {
+      log_queue_message_dropped(&self->super, msg);
+      log_msg_drop(msg, path_options, AT_PROCESSED);
+
+      msg_debug("Destination queue full, dropping message",
+                evt_tag_int("queue_len", log_queue_fifo_get_length(&self->super)),
+                evt_tag_int("log_fifo_size", self->log_fifo_size),
+                evt_tag_str("persist_name", self->super.persist_name));
+      return;
+    }
+
+  log_msg_write_protect(msg);
+  LogMessageQueueNode *node = log_msg_alloc_queue_node(msg, path_options);
+  node->lane = lane;
+
+  log_queue_queued_messages_inc(&self->super);
+  _memory_usage_add(self, log_msg_get_size(msg));
+
+  if (_shared_input_push(&self->shared_input, node))
+    {
+      /* the first item after the output thread took over the previous
+       * ones, everyone else can rely on this notification */
+      g_mutex_lock(&self->super.lock);
+      log_queue_push_notify(&self->super);
+      g_mutex_unlock(&self->super.lock);
+    }
+
+  log_msg_unref(msg);
+}
+
 /**
  * Assumed to be called from one of the input threads. If the thread_index
- * cannot be determined, the item is put directly in the wait queue.
+ * cannot be determined, the item is put on the shared input queue.
  *
  * Puts the message to the queue, and logs an error if it caused the
  * queue to be full.
@@ -319,7 +796,7 @@ log_queue_fifo_push_tail(LogQueue *s, LogMessage *msg, const LogPathOptions *pat
   thread_index = main_loop_worker_get_thread_index();
 
   /* if this thread has an ID than the number of input queues we have (due
-   * to a config change), handle the load via the slow path */
+   * to a config change), handle the load via the shared input queue */
 
   if (thread_index >= self->num_input_queues)
     thread_index = -1;
@@ -354,6 +831,7 @@ log_queue_fifo_push_tail(LogQueue *s, LogMessage *msg, const LogPathOptions *pat
 
       log_msg_write_protect(msg);
       node = log_msg_alloc_queue_node(msg, path_options);
+      node->lane = _get_lane(self, msg);
       iv_list_add_tail(&node->list, &self->input_queues[thread_index].items);
       self->input_queues[thread_index].len++;
 
@@ -364,56 +842,68 @@ log_queue_fifo_push_tail(LogQueue *s, LogMessage *msg, const LogPathOptions *pat
       return;
     }
 
-  /* slow path, put the pending item and the whole input queue to the wait_queue */
+  log_queue_fifo_push_tail_shared(self, msg, path_options);
+}
 
+/*
+ * Can only run from the output thread.
+ */
+static inline void
+_move_items_from_wait_queue_to_output_queue(LogQueueFifo *self)
+{
+  /* slow path, get some elements from the wait queue */
   g_mutex_lock(&self->super.lock);
+  _move_items_from_shared_input_to_wait_queue(self);
+  for (gint lane = 0; lane < self->num_lanes; lane++)
+    _overflow_queue_splice_tail(&self->wait_queue[lane], &self->output_queue[lane]);
+  g_mutex_unlock(&self->super.lock);
+}
 
-  if (_message_has_to_be_dropped(self, path_options))
+static inline gint
+_find_output_lane(LogQueueFifo *self)
+{
+  for (gint lane = 0; lane < self->num_lanes; lane++)
     {
-      log_queue_dropped_messages_inc(&self->super);
-      g_mutex_unlock(&self->super.lock);
-
-      log_msg_drop(msg, path_options, AT_PROCESSED);
-
-      msg_debug("Destination queue full, dropping message",
-                evt_tag_int("queue_len", log_queue_fifo_get_length(&self->super)),
-                evt_tag_int("log_fifo_size", self->log_fifo_size),
-                evt_tag_str("persist_name", self->super.persist_name));
-      return;
+      if (self->output_queue[lane].len > 0)
+        return lane;
     }
+  return -1;
+}
 
-  log_msg_write_protect(msg);
-  node = log_msg_alloc_queue_node(msg, path_options);
-
-  iv_list_add_tail(&node->list, &self->wait_queue.items);
-  self->wait_queue.len++;
-
-  if (!path_options->flow_control_requested)
-    self->wait_queue.non_flow_controlled_len++;
-
-  log_queue_push_notify(&self->super);
-  log_queue_queued_messages_inc(&self->super);
-
-  log_queue_memory_usage_add(&self->super, log_msg_get_size(msg));
-  g_mutex_unlock(&self->super.lock);
+/*
+ * Racy, but a lost race only delays the refill until the next message.
+ * Items of the shared input have no lane yet, any of them may be of a
+ * higher priority.
+ */
+static inline gboolean
+_wait_queue_has_items_above_lane(LogQueueFifo *self, gint lane)
+{
+  if (lane > 0 && g_atomic_pointer_get(&self->shared_input.head))
+    return TRUE;
 
-  log_msg_unref(msg);
+  for (gint higher_lane = 0; higher_lane < lane; higher_lane++)
+    {
+      if (self->wait_queue[higher_lane].len > 0)
+        return TRUE;
+    }
+  return FALSE;
 }
 
 /*
- * Can only run from the output thread.
+ * Can only run from the output thread.  Returns the lane to serve next,
+ * or -1 if the queue is empty.
  */
-static inline void
-_move_items_from_wait_queue_to_output_queue(LogQueueFifo *self)
+static inline gint
+_select_output_lane(LogQueueFifo *self)
 {
-  /* slow path, output queue is empty, get some elements from the wait queue */
-  g_mutex_lock(&self->super.lock);
-  iv_list_splice_tail_init(&self->wait_queue.items, &self->output_queue.items);
-  self->output_queue.len = self->wait_queue.len;
-  self->output_queue.non_flow_controlled_len = self->wait_queue.non_flow_controlled_len;
-  self->wait_queue.len = 0;
-  self->wait_queue.non_flow_controlled_len = 0;
-  g_mutex_unlock(&self->super.lock);
+  gint lane = _find_output_lane(self);
+
+  if (lane < 0 || _wait_queue_has_items_above_lane(self, lane))
+    {
+      _move_items_from_wait_queue_to_output_queue(self);
+      lane = _find_output_lane(self);
+    }
+  return lane;
 }
 
 /*
@@ -426,13 +916,11 @@ log_queue_fifo_peek_head(LogQueue *s)
   LogMessageQueueNode *node;
   LogMessage *msg = NULL;
 
-  if (self->output_queue.len == 0)
-    _move_items_from_wait_queue_to_output_queue(self);
-
-  if (self->output_queue.len == 0)
+  gint lane = _select_output_lane(self);
+  if (lane < 0)
     return NULL;
 
-  node = iv_list_entry(self->output_queue.items.next, LogMessageQueueNode, list);
+  node = iv_list_entry(self->output_queue[lane].items.next, LogMessageQueueNode, list);
   msg = node->msg;
 
   return msg;
@@ -450,21 +938,17 @@ log_queue_fifo_pop_head(LogQueue *s, LogPathOptions *path_options)
   LogMessageQueueNode *node;
   LogMessage *msg = NULL;
 
-  if (self->output_queue.len == 0)
-    _move_items_from_wait_queue_to_output_queue(self);
+  gint lane = _select_output_lane(self);
 
-  if (self->output_queue.len > 0)
+  if (lane >= 0)
     {
-      node = iv_list_entry(self->output_queue.items.next, LogMessageQueueNode, list);
+      node = iv_list_entry(self->output_queue[lane].items.next, LogMessageQueueNode, list);
 
       msg = node->msg;
       path_options->ack_needed = node->ack_needed;
-      self->output_queue.len--;
-
-      if (!node->flow_control_requested)
-        self->output_queue.non_flow_controlled_len--;
-
-      iv_list_del_init(&node->list);
+      _overflow_queue_del(&self->output_queue[lane], node);
+      _lane_events_add(self, lane, -1);
+      _update_lane_delay(self, lane, msg);
     }
   else
     {
@@ -479,7 +963,7 @@ log_queue_fifo_pop_head(LogQueue *s, LogPathOptions *path_options)
       return NULL;
     }
   log_queue_queued_messages_dec(&self->super);
-  log_queue_memory_usage_sub(&self->super, log_msg_get_size(msg));
+  _memory_usage_sub(self, log_msg_get_size(msg));
 
   /* push to backlog */
   log_msg_ref(msg);
@@ -492,6 +976,22 @@ log_queue_fifo_pop_head(LogQueue *s, LogPathOptions *path_options)
   return msg;
 }
 
+/*
+ * Can only run from the output thread.
+ *
+ * Only the wait queue needs to be locked to refill the output queue, that
+ * is done at most once per batch, unless the output queue runs empty.
+ */
+static gint
+log_queue_fifo_pop_head_batch(LogQueue *s, LogMessage **msgs, LogPathOptions *path_options, gint max_msgs)
+{
+  gint n = 0;
+
+  while (n < max_msgs && (msgs[n] = log_queue_fifo_pop_head(s, &path_options[n])))
+    n++;
+  return n;
+}
+
 /*
  * Can only run from the output thread.
  */
@@ -539,13 +1039,22 @@ log_queue_fifo_rewind_backlog_all(LogQueue *s)
   LogQueueFifo *self = (LogQueueFifo *) s;
 
   iv_list_update_msg_size(self, &self->backlog_queue.items);
-  iv_list_splice_tail_init(&self->backlog_queue.items, &self->output_queue.items);
-
-  self->output_queue.len += self->backlog_queue.len;
-  self->output_queue.non_flow_controlled_len += self->backlog_queue.non_flow_controlled_len;
   log_queue_queued_messages_add(&self->super, self->backlog_queue.len);
-  self->backlog_queue.len = 0;
-  self->backlog_queue.non_flow_controlled_len = 0;
+
+  if (self->num_lanes == 1)
+    {
+      _overflow_queue_splice_tail(&self->backlog_queue, &self->output_queue[0]);
+      return;
+    }
+
+  while (self->backlog_queue.len > 0)
+    {
+      LogMessageQueueNode *node = iv_list_entry(self->backlog_queue.items.next, LogMessageQueueNode, list);
+
+      _overflow_queue_del(&self->backlog_queue, node);
+      _overflow_queue_push_tail(&self->output_queue[node->lane], node);
+      _lane_events_add(self, node->lane, 1);
+    }
 }
 
 static void
@@ -565,23 +1074,89 @@ log_queue_fifo_rewind_backlog(LogQueue *s, guint rewind_count)
        * and pop_head add ack and ref when it pushes the message into the backlog
        * The rewind must decrease the ack and ref too
        */
+      OverflowQueue *output_queue = &self->output_queue[node->lane];
+
       iv_list_del_init(&node->list);
-      iv_list_add(&node->list, &self->output_queue.items);
+      iv_list_add(&node->list, &output_queue->items);
 
       self->backlog_queue.len--;
-      self->output_queue.len++;
+      output_queue->len++;
 
       if (!node->flow_control_requested)
         {
           self->backlog_queue.non_flow_controlled_len--;
-          self->output_queue.non_flow_controlled_len++;
+          output_queue->non_flow_controlled_len++;
         }
 
+      _lane_events_add(self, node->lane, 1);
       log_queue_queued_messages_inc(&self->super);
-      log_queue_memory_usage_add(&self->super, log_msg_get_size(node->msg));
+      _memory_usage_add(self, log_msg_get_size(node->msg));
     }
 }
 
+/*
+ * Moves at most @max_msgs messages from the wait queue (and the shared
+ * input) of @from to the wait queue of @s, keeping their order.  Messages
+ * already taken by the output thread of @from are not touched.  Used to balance the load among
+ * the queues of threaded destination workers.
+ *
+ * Can only run from the output thread of @s.
+ */
+gint
+log_queue_fifo_steal(LogQueue *s, LogQueue *from, gint max_msgs)
+{
+  LogQueueFifo *self = (LogQueueFifo *) s;
+  LogQueueFifo *victim = (LogQueueFifo *) from;
+  OverflowQueue stolen[LOG_QUEUE_FIFO_MAX_LANES];
+  gint len = 0;
+  gsize memory_usage = 0;
+
+  g_assert(log_queue_has_type(s, log_queue_fifo_type) && log_queue_has_type(from, log_queue_fifo_type));
+  g_assert(self->num_lanes == victim->num_lanes);
+
+  for (gint lane = 0; lane < self->num_lanes; lane++)
+    {
+      INIT_IV_LIST_HEAD(&stolen[lane].items);
+      stolen[lane].len = stolen[lane].non_flow_controlled_len = 0;
+    }
+
+  /* the highest priority messages are taken first */
+  g_mutex_lock(&victim->super.lock);
+  _move_items_from_shared_input_to_wait_queue(victim);
+  for (gint lane = 0; lane < self->num_lanes && len < max_msgs; lane++)
+    {
+      while (len < max_msgs && victim->wait_queue[lane].len > 0)
+        {
+          LogMessageQueueNode *node = iv_list_entry(victim->wait_queue[lane].items.next, LogMessageQueueNode, list);
+
+          _overflow_queue_del(&victim->wait_queue[lane], node);
+          _overflow_queue_push_tail(&stolen[lane], node);
+          len++;
+          memory_usage += log_msg_get_size(node->msg);
+        }
+      _lane_events_add(victim, lane, -stolen[lane].len);
+    }
+  g_mutex_unlock(&victim->super.lock);
+
+  if (len == 0)
+    return 0;
+
+  log_queue_queued_messages_sub(&victim->super, len);
+  _memory_usage_sub(victim, memory_usage);
+
+  g_mutex_lock(&self->super.lock);
+  for (gint lane = 0; lane < self->num_lanes; lane++)
+    {
+      _lane_events_add(self, lane, stolen[lane].len);
+      _overflow_queue_splice_tail(&stolen[lane], &self->wait_queue[lane]);
+    }
+  g_mutex_unlock(&self->super.lock);
+
+  log_queue_queued_messages_add(&self->super, len);
+  _memory_usage_add(self, memory_usage);
+  return len;
+}
+
 static void
 log_queue_fifo_free_queue(struct iv_list_head *q)
 {
@@ -617,10 +1192,40 @@ _register_counters(LogQueueFifo *self, gint stats_level, StatsClusterKeyBuilder
     stats_cluster_key_builder_pop(builder);
   }
 
+  for (gint lane = 0; lane < self->num_lanes && self->num_lanes > 1; lane++)
+    {
+      LogQueueFifoLaneMetrics *metrics = &self->metrics.lanes[lane];
+      gchar lane_str[8];
+
+      g_snprintf(lane_str, sizeof(lane_str), "%d", lane);
+      stats_cluster_key_builder_push(builder);
+      stats_cluster_key_builder_add_label(builder, stats_cluster_label("lane", lane_str));
+
+      stats_cluster_key_builder_set_name(builder, "lane_events");
+      metrics->events_sc_key = stats_cluster_key_builder_build_single(builder);
+
+      stats_cluster_key_builder_set_name(builder, "lane_delay_sample_seconds");
+      stats_cluster_key_builder_set_unit(builder, SCU_MILLISECONDS);
+      metrics->delay_sample_sc_key = stats_cluster_key_builder_build_single(builder);
+
+      stats_cluster_key_builder_pop(builder);
+    }
+
   {
     stats_lock();
     stats_register_counter(stats_level, self->metrics.capacity_sc_key, SC_TYPE_SINGLE_VALUE,
                            &self->metrics.capacity);
+
+    for (gint lane = 0; lane < self->num_lanes; lane++)
+      {
+        LogQueueFifoLaneMetrics *metrics = &self->metrics.lanes[lane];
+
+        if (!metrics->events_sc_key)
+          continue;
+
+        stats_register_counter(stats_level, metrics->events_sc_key, SC_TYPE_SINGLE_VALUE, &metrics->events);
+        stats_register_counter(stats_level, metrics->delay_sample_sc_key, SC_TYPE_SINGLE_VALUE, &metrics->delay_sample);
+      }
     stats_unlock();
   }
 }
@@ -637,6 +1242,21 @@ _unregister_counters(LogQueueFifo *self)
 
         stats_cluster_key_free(self->metrics.capacity_sc_key);
       }
+
+    for (gint lane = 0; lane < self->num_lanes; lane++)
+      {
+        LogQueueFifoLaneMetrics *metrics = &self->metrics.lanes[lane];
+
+        if (!metrics->events_sc_key)
+          continue;
+
+        /* the messages left in the queue are freed without adjusting the counter */
+        stats_counter_set(metrics->events, 0);
+        stats_unregister_counter(metrics->events_sc_key, SC_TYPE_SINGLE_VALUE, &metrics->events);
+        stats_unregister_counter(metrics->delay_sample_sc_key, SC_TYPE_SINGLE_VALUE, &metrics->delay_sample);
+        stats_cluster_key_free(metrics->events_sc_key);
+        stats_cluster_key_free(metrics->delay_sample_sc_key);
+      }
     stats_unlock();
   }
 }
@@ -653,21 +1273,38 @@ log_queue_fifo_free(LogQueue *s)
       log_queue_fifo_free_queue(&self->input_queues[i].items);
     }
 
-  log_queue_fifo_free_queue(&self->wait_queue.items);
-  log_queue_fifo_free_queue(&self->output_queue.items);
+  _move_items_from_shared_input_to_wait_queue(self);
+  for (i = 0; i < self->num_lanes; i++)
+    {
+      log_queue_fifo_free_queue(&self->wait_queue[i].items);
+      log_queue_fifo_free_queue(&self->output_queue[i].items);
+    }
   log_queue_fifo_free_queue(&self->backlog_queue.items);
+  log_template_unref(self->lane_template);
+
+  /* the stats counters are adjusted when they are unregistered */
+  atomic_gssize_sub(&log_queue_fifo_total_memory_usage, atomic_gssize_get(&self->memory_usage));
 
   _unregister_counters(self);
 
   log_queue_free_method(s);
 }
 
+/*
+ * Creates a queue with @num_lanes priority lanes.  Lanes are selected by
+ * @lane_template, which should expand to the number of the lane (0 being
+ * the highest priority), or by the severity of the message if it is NULL.
+ * Takes over the reference of @lane_template.
+ */
 LogQueue *
-log_queue_fifo_new(gint log_fifo_size, const gchar *persist_name, gint stats_level,
-                   StatsClusterKeyBuilder *driver_sck_builder, StatsClusterKeyBuilder *queue_sck_builder)
+log_queue_fifo_new_with_lanes(gint log_fifo_size, gint num_lanes, LogTemplate *lane_template,
+                              const gchar *persist_name, gint stats_level,
+                              StatsClusterKeyBuilder *driver_sck_builder, StatsClusterKeyBuilder *queue_sck_builder)
 {
   LogQueueFifo *self;
 
+  g_assert(num_lanes >= 1 && num_lanes <= LOG_QUEUE_FIFO_MAX_LANES);
+
   gint max_threads = main_loop_worker_get_max_number_of_threads();
   self = g_malloc0(sizeof(LogQueueFifo) + max_threads * sizeof(self->input_queues[0]));
 
@@ -684,6 +1321,7 @@ log_queue_fifo_new(gint log_fifo_size, const gchar *persist_name, gint stats_lev
   self->super.keep_on_reload = log_queue_fifo_keep_on_reload;
   self->super.push_tail = log_queue_fifo_push_tail;
   self->super.pop_head = log_queue_fifo_pop_head;
+  self->super.pop_head_batch = log_queue_fifo_pop_head_batch;
   self->super.peek_head = log_queue_fifo_peek_head;
   self->super.ack_backlog = log_queue_fifo_ack_backlog;
   self->super.rewind_backlog = log_queue_fifo_rewind_backlog;
@@ -699,8 +1337,13 @@ log_queue_fifo_new(gint log_fifo_size, const gchar *persist_name, gint stats_lev
       self->input_queues[i].cb.func = log_queue_fifo_move_input;
       self->input_queues[i].cb.user_data = self;
     }
-  INIT_IV_LIST_HEAD(&self->wait_queue.items);
-  INIT_IV_LIST_HEAD(&self->output_queue.items);
+  self->num_lanes = num_lanes;
+  self->lane_template = lane_template;
+  for (gint lane = 0; lane < self->num_lanes; lane++)
+    {
+      INIT_IV_LIST_HEAD(&self->wait_queue[lane].items);
+      INIT_IV_LIST_HEAD(&self->output_queue[lane].items);
+    }
   INIT_IV_LIST_HEAD(&self->backlog_queue.items);
 
   self->log_fifo_size = log_fifo_size;
@@ -715,6 +1358,27 @@ log_queue_fifo_new(gint log_fifo_size, const gchar *persist_name, gint stats_lev
   return &self->super;
 }
 
+LogQueue *
+log_queue_fifo_new(gint log_fifo_size, const gchar *persist_name, gint stats_level,
+                   StatsClusterKeyBuilder *driver_sck_builder, StatsClusterKeyBuilder *queue_sck_builder)
+{
+  return log_queue_fifo_new_with_lanes(log_fifo_size, 1, NULL, persist_name, stats_level,
+                                       driver_sck_builder, queue_sck_builder);
+}
+
+/*
+ * Limits the size of the messages in the queue, in addition to
+ * log_fifo_size.  Like log_fifo_size, it only applies to messages that are
+ * not flow-controlled.  0 means unlimited.
+ */
+void
+log_queue_fifo_set_log_fifo_size_bytes(LogQueue *s, gsize log_fifo_size_bytes)
+{
+  LogQueueFifo *self = (LogQueueFifo *) s;
+
+  self->log_fifo_size_bytes = log_fifo_size_bytes;
+}
+
 QueueType
 log_queue_fifo_get_type(void)
 {
@@ -26,11 +26,30 @@
 #define LOGQUEUE_FIFO_H_INCLUDED
 
 #include "logqueue.h"
+#include "template/templates.h"
+
+#define LOG_QUEUE_FIFO_MAX_LANES 8
+
+typedef enum
+{
+  LQF_MEMORY_BUDGET_FLOW_CONTROL,
+  LQF_MEMORY_BUDGET_DROP,
+} LogQueueFifoMemoryBudgetPolicy;
 
 LogQueue *log_queue_fifo_new(gint log_fifo_size, const gchar *persist_name, gint stats_level,
                              StatsClusterKeyBuilder *driver_sck_builder,
                              StatsClusterKeyBuilder *queue_sck_builder);
+LogQueue *log_queue_fifo_new_with_lanes(gint log_fifo_size, gint num_lanes, LogTemplate *lane_template,
+                                        const gchar *persist_name, gint stats_level,
+                                        StatsClusterKeyBuilder *driver_sck_builder,
+                                        StatsClusterKeyBuilder *queue_sck_builder);
+
+void log_queue_fifo_set_log_fifo_size_bytes(LogQueue *s, gsize log_fifo_size_bytes);
 
 QueueType log_queue_fifo_get_type(void);
+gint log_queue_fifo_steal(LogQueue *s, LogQueue *from, gint max_msgs);
+
+void log_queue_fifo_set_memory_budget(gsize budget_bytes, LogQueueFifoMemoryBudgetPolicy policy);
+gsize log_queue_fifo_get_total_memory_usage(void);
 
 #endif
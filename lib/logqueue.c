@@ -23,6 +23,7 @@
  */
 
 #include "logqueue.h"
+#include "logpipe.h"
 #include "stats/stats-registry.h"
 #include "stats/stats-cluster-single.h"
 #include "messages.h"
@@ -81,10 +82,22 @@ log_queue_queued_messages_reset(LogQueue *self)
                     stats_counter_get(self->metrics.owned.queued_messages));
 }
 
+/* must be called before the reference of the queue to @msg is released */
 void
-log_queue_dropped_messages_inc(LogQueue *self)
+log_queue_message_dropped(LogQueue *self, LogMessage *msg)
 {
   stats_counter_inc(self->metrics.shared.dropped_messages);
+
+  if (self->drop_notify)
+    self->drop_notify(msg, self->drop_notify_data);
+}
+
+/* not synchronized with the producers, set it before messages are pushed */
+void
+log_queue_set_drop_notify(LogQueue *self, LogQueueDropNotifyFunc drop_notify, gpointer user_data)
+{
+  self->drop_notify = drop_notify;
+  self->drop_notify_data = user_data;
 }
 
 /*
@@ -407,6 +420,7 @@ log_queue_init_instance(LogQueue *self, const gchar *persist_name, gint stats_le
 {
   g_atomic_counter_set(&self->ref_cnt, 1);
   self->free_fn = log_queue_free_method;
+  self->pop_head_batch = log_queue_pop_head_batch_method;
 
   self->persist_name = persist_name ? g_strdup(persist_name) : NULL;
   g_mutex_init(&self->lock);
@@ -414,6 +428,17 @@ log_queue_init_instance(LogQueue *self, const gchar *persist_name, gint stats_le
   _register_counters(self, stats_level, driver_sck_builder, queue_sck_builder);
 }
 
+/* fallback for queues that cannot pop more messages at once */
+gint
+log_queue_pop_head_batch_method(LogQueue *self, LogMessage **msgs, LogPathOptions *path_options, gint max_msgs)
+{
+  gint n = 0;
+
+  while (n < max_msgs && (msgs[n] = self->pop_head(self, &path_options[n])))
+    n++;
+  return n;
+}
+
 void
 log_queue_free_method(LogQueue *self)
 {
@@ -30,6 +30,7 @@
 #include "stats/stats-cluster-key-builder.h"
 
 typedef void (*LogQueuePushNotifyFunc)(gpointer user_data);
+typedef void (*LogQueueDropNotifyFunc)(LogMessage *msg, gpointer user_data);
 
 typedef struct _LogQueue LogQueue;
 
@@ -71,17 +72,27 @@ struct _LogQueue
   LogQueueMetrics metrics;
   gboolean abandoned;
 
+  /* the queue is a view of a queue shared by the workers of a destination,
+   * messages pushed into it can be popped by any of the workers */
+  gboolean shared_by_workers;
+
   GMutex lock;
   LogQueuePushNotifyFunc parallel_push_notify;
   gpointer parallel_push_data;
   GDestroyNotify parallel_push_data_destroy;
 
+  /* called with each message the queue drops by itself (e.g. when it is
+   * full), in the thread dropping it, see log_queue_message_dropped() */
+  LogQueueDropNotifyFunc drop_notify;
+  gpointer drop_notify_data;
+
   /* queue management */
   gboolean (*keep_on_reload)(LogQueue *self);
   gint64 (*get_length)(LogQueue *self);
   gboolean (*is_empty_racy)(LogQueue *self);
   void (*push_tail)(LogQueue *self, LogMessage *msg, const LogPathOptions *path_options);
   LogMessage *(*pop_head)(LogQueue *self, LogPathOptions *path_options);
+  gint (*pop_head_batch)(LogQueue *self, LogMessage **msgs, LogPathOptions *path_options, gint max_msgs);
   LogMessage *(*peek_head)(LogQueue *self);
   void (*ack_backlog)(LogQueue *self, gint n);
   void (*rewind_backlog)(LogQueue *self, guint rewind_count);
@@ -135,6 +146,27 @@ log_queue_pop_head(LogQueue *self, LogPathOptions *path_options)
   return msg;
 }
 
+/*
+ * Pops at most @max_msgs messages, the path options of msgs[i] are stored
+ * in path_options[i].  Returns the number of messages popped, the caller
+ * owns a reference to each of them, just like with log_queue_pop_head().
+ */
+static inline gint
+log_queue_pop_head_batch(LogQueue *self, LogMessage **msgs, LogPathOptions *path_options, gint max_msgs)
+{
+  gint n;
+
+  if (self->throttle)
+    max_msgs = MIN(max_msgs, self->throttle_buckets);
+
+  n = self->pop_head_batch(self, msgs, path_options, max_msgs);
+
+  if (self->throttle_buckets > 0)
+    self->throttle_buckets -= MIN(n, self->throttle_buckets);
+
+  return n;
+}
+
 static inline LogMessage *
 log_queue_peek_head(LogQueue *self)
 {
@@ -211,7 +243,8 @@ void log_queue_queued_messages_inc(LogQueue *self);
 void log_queue_queued_messages_dec(LogQueue *self);
 void log_queue_queued_messages_reset(LogQueue *self);
 
-void log_queue_dropped_messages_inc(LogQueue *self);
+void log_queue_message_dropped(LogQueue *self, LogMessage *msg);
+void log_queue_set_drop_notify(LogQueue *self, LogQueueDropNotifyFunc drop_notify, gpointer user_data);
 
 void log_queue_push_notify(LogQueue *self);
 void log_queue_reset_parallel_push(LogQueue *self);
@@ -227,5 +260,6 @@ void log_queue_init_instance(LogQueue *self, const gchar *persist_name, gint sta
                              StatsClusterKeyBuilder *queue_sck_builder);
 
 void log_queue_free_method(LogQueue *self);
+gint log_queue_pop_head_batch_method(LogQueue *self, LogMessage **msgs, LogPathOptions *path_options, gint max_msgs);
 
 #endif
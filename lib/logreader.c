@@ -514,13 +514,22 @@ static gboolean
 log_reader_handle_line(LogReader *self, const guchar *line, gint length, LogTransportAuxData *aux)
 {
   LogMessage *m;
+  LogMsgChunk *input_chunk = log_proto_server_get_input_chunk(self->proto, line, length);
 
-  m = msg_format_construct_message(&self->options->parse_options, line, length);
+  /* values referencing the input buffer don't need room in the payload */
+  if (input_chunk)
+    m = log_msg_new_empty();
+  else
+    m = msg_format_construct_message(&self->options->parse_options, line, length);
   msg_debug("Incoming log entry",
             evt_tag_mem("input", line, length),
             evt_tag_msg_reference(m));
 
+  if (input_chunk)
+    log_msg_set_input_chunk(input_chunk, self->proto->options->super.zero_copy_min_size);
   msg_format_parse_into(&self->options->parse_options, m, line, length);
+  if (input_chunk)
+    log_msg_set_input_chunk(NULL, 0);
 
   _log_reader_insert_msg_length_stats(self, length);
 
@@ -30,11 +30,14 @@
 #include "scratch-buffers.h"
 #include "template/eval.h"
 #include "mainloop-threaded-worker.h"
+#include "logqueue-fifo.h"
 
 #include <string.h>
 
 #define MAX_RETRIES_ON_ERROR_DEFAULT 3
 #define MAX_RETRIES_BEFORE_SUSPEND_DEFAULT 3
+#define WORKER_STEALING_INTERVAL_MSEC 100
+#define PARTITION_SLOT_OUTSTANDING_MASK (((gsize) 1 << LOG_THREADED_DEST_PARTITION_SLOT_OWNER_SHIFT) - 1)
 
 const gchar *
 log_threaded_result_to_str(LogThreadedResult self)
@@ -98,11 +101,158 @@ log_threaded_dest_driver_process_flag(LogDriver *s, const gchar *flag)
 
 /* LogThreadedDestWorker */
 
+static inline gboolean
+_partition_slots_enabled(LogThreadedDestDriver *self)
+{
+  return self->worker_stealing && self->worker_partition_key && self->num_workers > 1;
+}
+
+static inline gint
+_get_partition_slot(LogThreadedDestDriver *self, LogMessage *msg)
+{
+  LogTemplateEvalOptions options = DEFAULT_TEMPLATE_EVAL_OPTIONS;
+  return log_template_hash(self->worker_partition_key, msg, &options) % LOG_THREADED_DEST_PARTITION_SLOTS;
+}
+
+static inline gsize
+_partition_slot_state(gint owner, gsize outstanding)
+{
+  return ((gsize) owner << LOG_THREADED_DEST_PARTITION_SLOT_OWNER_SHIFT) | outstanding;
+}
+
+static void
+_release_partition_slot(LogThreadedDestDriver *self, gint slot)
+{
+  atomic_gssize *state = &self->partition_slots.state[slot];
+  gsize old_state;
+
+  /* never borrow from the owner, see _track_partition_slot() */
+  do
+    {
+      old_state = atomic_gssize_get_unsigned(state);
+      if ((old_state & PARTITION_SLOT_OUTSTANDING_MASK) == 0)
+        return;
+    }
+  while (!atomic_gssize_compare_and_exchange(state, old_state, old_state - 1));
+}
+
+/* NOTE: runs in the thread dropping the message, see log_queue_message_dropped() */
+static void
+_release_dropped_message(LogMessage *msg, gpointer user_data)
+{
+  LogThreadedDestDriver *self = (LogThreadedDestDriver *) user_data;
+
+  _release_partition_slot(self, _get_partition_slot(self, msg));
+}
+
+/* NOTE: runs in the worker thread
+ *
+ * The untracked messages are the oldest ones in the queue, so they are
+ * popped first.  With priority lanes, some new messages may be popped
+ * before them and be taken for untracked ones, the counters of their
+ * slots are not let to underflow then, see _release_partition_slot().
+ */
+static void
+_track_partition_slot(LogThreadedDestWorker *self, LogMessage *msg)
+{
+  if (!_partition_slots_enabled(self->owner))
+    return;
+
+  gint slot = -1;
+  if (self->stealing.untracked_in_batch < g_atomic_int_get(&self->stealing.untracked))
+    self->stealing.untracked_in_batch++;
+  else
+    slot = _get_partition_slot(self->owner, msg);
+  g_array_append_val(self->stealing.batch_slots, slot);
+}
+
+/* the first @n messages of the batch are done with, see _lookup_worker() */
+static void
+_release_partition_slots(LogThreadedDestWorker *self, gint n)
+{
+  if (!_partition_slots_enabled(self->owner))
+    return;
+
+  n = MIN(n, self->stealing.batch_slots->len);
+  for (gint i = 0; i < n; i++)
+    {
+      gint slot = g_array_index(self->stealing.batch_slots, gint, i);
+
+      if (slot >= 0)
+        {
+          _release_partition_slot(self->owner, slot);
+          continue;
+        }
+      self->stealing.untracked_in_batch--;
+      g_atomic_int_add(&self->stealing.untracked, -1);
+    }
+  g_array_remove_range(self->stealing.batch_slots, 0, n);
+}
+
+/* the last @n messages of the batch are put back to the queue */
+static void
+_forget_partition_slots(LogThreadedDestWorker *self, gint n)
+{
+  if (!_partition_slots_enabled(self->owner))
+    return;
+
+  n = MIN(n, self->stealing.batch_slots->len);
+  for (gint i = self->stealing.batch_slots->len - n; i < self->stealing.batch_slots->len; i++)
+    {
+      if (g_array_index(self->stealing.batch_slots, gint, i) < 0)
+        self->stealing.untracked_in_batch--;
+    }
+  g_array_set_size(self->stealing.batch_slots, self->stealing.batch_slots->len - n);
+}
+
+/* the owners of the slots are stored in the persist file, so that after a
+ * restart, the new messages of a slot are queued behind the ones left in
+ * a disk-buffer */
+typedef struct _PartitionSlotsPersistState
+{
+  guint16 num_workers;
+  guint8 owner[LOG_THREADED_DEST_PARTITION_SLOTS];
+} PartitionSlotsPersistState;
+
+/* the queues keep their messages over a reload, so do the counters */
+typedef struct _PartitionSlotsReloadState
+{
+  gint num_workers;
+  gsize state[LOG_THREADED_DEST_PARTITION_SLOTS];
+  gint untracked[LOG_THREADED_DEST_PARTITION_SLOT_MAX_WORKERS];
+} PartitionSlotsReloadState;
+
+static gchar *
+_format_partition_slots_persist_name(LogThreadedDestDriver *self)
+{
+  static gchar persist_name[256];
+
+  g_snprintf(persist_name, sizeof(persist_name), "%s.partition_slots",
+             self->super.super.super.generate_persist_name((const LogPipe *)self));
+
+  return persist_name;
+}
+
+/* NOTE: runs in the worker thread */
+static void
+_persist_partition_slot_owner(LogThreadedDestDriver *self, gint slot, gint owner)
+{
+  PersistState *state = log_pipe_get_config(&self->super.super.super)->state;
+
+  if (!self->partition_slots.persist_handle)
+    return;
+
+  PartitionSlotsPersistState *persisted = persist_state_map_entry(state, self->partition_slots.persist_handle);
+  persisted->owner[slot] = owner;
+  persist_state_unmap_entry(state, self->partition_slots.persist_handle);
+}
+
 /* this should be used in combination with LTR_EXPLICIT_ACK_MGMT to actually confirm message delivery. */
 void
 log_threaded_dest_worker_ack_messages(LogThreadedDestWorker *self, gint batch_size)
 {
   log_queue_ack_backlog(self->queue, batch_size);
+  _release_partition_slots(self, batch_size);
   stats_counter_add(self->owner->metrics.written_messages, batch_size);
   self->retries_on_error_counter = 0;
   self->batch_size -= batch_size;
@@ -112,15 +262,37 @@ void
 log_threaded_dest_worker_drop_messages(LogThreadedDestWorker *self, gint batch_size)
 {
   log_queue_ack_backlog(self->queue, batch_size);
+  _release_partition_slots(self, batch_size);
   stats_counter_add(self->owner->metrics.dropped_messages, batch_size);
   self->retries_on_error_counter = 0;
   self->batch_size -= batch_size;
 }
 
+/* Messages popped but not yet processed are the last ones in the backlog,
+ * they have to go back to the queue before the ones being rewound.
+ *
+ * NOTE: runs in the worker thread */
+static void
+_rewind_popped_messages(LogThreadedDestWorker *self)
+{
+  gint remaining = self->popped.len - self->popped.pos;
+
+  if (remaining > 0)
+    {
+      log_queue_rewind_backlog(self->queue, remaining);
+      for (gint i = self->popped.pos; i < self->popped.len; i++)
+        log_msg_unref(self->popped.msgs[i]);
+    }
+  self->popped.len = 0;
+  self->popped.pos = 0;
+}
+
 void
 log_threaded_dest_worker_rewind_messages(LogThreadedDestWorker *self, gint batch_size)
 {
+  _rewind_popped_messages(self);
   log_queue_rewind_backlog(self->queue, batch_size);
+  _forget_partition_slots(self, batch_size);
   self->rewound_batch_size = self->batch_size;
   self->batch_size -= batch_size;
 }
@@ -182,6 +354,10 @@ _stop_watches(LogThreadedDestWorker *self)
     {
       iv_timer_unregister(&self->timer_flush);
     }
+  if (iv_timer_registered(&self->stealing.timer))
+    {
+      iv_timer_unregister(&self->stealing.timer);
+    }
 }
 
 /* NOTE: runs in the worker thread in response to a wakeup event being
@@ -436,6 +612,50 @@ _should_flush_due_to_partition_key_change(LogThreadedDestWorker *self, LogMessag
   return should_flush;
 }
 
+static gint
+_get_num_messages_to_pop(LogThreadedDestWorker *self)
+{
+  gint n = 1;
+
+  if (self->enable_batching)
+    n = MAX(self->owner->batch_lines - self->batch_size, 1);
+
+  if (self->rewound_batch_size)
+    n = MIN(n, self->rewound_batch_size);
+
+  return n;
+}
+
+/* Pops the rest of the current batch from the queue, under a single lock
+ * acquisition.  Returns the next message to be processed, without
+ * consuming it, or NULL if the queue is empty. */
+static LogMessage *
+_peek_popped_message(LogThreadedDestWorker *self, LogPathOptions **path_options)
+{
+  if (self->popped.pos == self->popped.len)
+    {
+      gint n = _get_num_messages_to_pop(self);
+
+      if (n > self->popped.size)
+        {
+          self->popped.msgs = g_renew(LogMessage *, self->popped.msgs, n);
+          self->popped.path_options = g_renew(LogPathOptions, self->popped.path_options, n);
+          self->popped.size = n;
+        }
+
+      for (gint i = 0; i < n; i++)
+        self->popped.path_options[i] = (LogPathOptions) LOG_PATH_OPTIONS_INIT;
+
+      self->popped.len = log_queue_pop_head_batch(self->queue, self->popped.msgs, self->popped.path_options, n);
+      self->popped.pos = 0;
+      if (self->popped.len == 0)
+        return NULL;
+    }
+
+  *path_options = &self->popped.path_options[self->popped.pos];
+  return self->popped.msgs[self->popped.pos];
+}
+
 /* NOTE: runs in the worker thread, whenever items on our queue are
  * available. It iterates all elements on the queue, however will terminate
  * if the mainloop requests that we exit. */
@@ -443,7 +663,7 @@ static void
 _perform_inserts(LogThreadedDestWorker *self)
 {
   LogThreadedResult result;
-  LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+  LogPathOptions *path_options;
 
   if (self->batch_size == 0)
     {
@@ -460,15 +680,15 @@ _perform_inserts(LogThreadedDestWorker *self)
       ScratchBuffersMarker mark;
       scratch_buffers_mark(&mark);
 
-      if (G_UNLIKELY(_flush_on_worker_partition_key_change_enabled(self)))
+      LogMessage *msg = _peek_popped_message(self, &path_options);
+      if (!msg)
         {
-          LogMessage *msg = log_queue_peek_head(self->queue);
-          if (!msg)
-            {
-              scratch_buffers_reclaim_marked(mark);
-              break;
-            }
+          scratch_buffers_reclaim_marked(mark);
+          break;
+        }
 
+      if (G_UNLIKELY(_flush_on_worker_partition_key_change_enabled(self)))
+        {
           if (_should_flush_due_to_partition_key_change(self, msg))
             {
               gboolean flush_result = _perform_flush(self);
@@ -477,15 +697,11 @@ _perform_inserts(LogThreadedDestWorker *self)
             }
         }
 
-      LogMessage *msg = log_queue_pop_head(self->queue, &path_options);
-      if (!msg)
-        {
-          scratch_buffers_reclaim_marked(mark);
-          break;
-        }
+      self->popped.pos++;
+      _track_partition_slot(self, msg);
 
       msg_set_context(msg);
-      log_msg_refcache_start_consumer(msg, &path_options);
+      log_msg_refcache_start_consumer(msg, path_options);
 
       self->batch_size++;
       result = log_threaded_dest_worker_insert(self, msg);
@@ -510,6 +726,7 @@ flush_error:
 
       iv_invalidate_now();
     }
+  _rewind_popped_messages(self);
   self->rewound_batch_size = 0;
 }
 
@@ -575,6 +792,114 @@ _schedule_restart_on_throttle_timeout(LogThreadedDestWorker *self, gint timeout_
   iv_timer_register(&self->timer_throttle);
 }
 
+static LogThreadedDestWorker *
+_find_busiest_worker(LogThreadedDestWorker *self)
+{
+  LogThreadedDestDriver *owner = self->owner;
+  LogThreadedDestWorker *busiest = NULL;
+  gint64 busiest_length = 0;
+
+  for (gint i = 0; i < owner->num_workers; i++)
+    {
+      LogThreadedDestWorker *worker = owner->workers[i];
+
+      if (worker == self)
+        continue;
+
+      /* racy, but only a hint */
+      gint64 length = log_queue_get_length(worker->queue);
+      if (length > busiest_length)
+        {
+          busiest = worker;
+          busiest_length = length;
+        }
+    }
+  return busiest;
+}
+
+/* Moves a batch of messages the victim has not started to process yet to
+ * our queue, taking at most half of its messages. */
+static gboolean
+_steal_messages(LogThreadedDestWorker *self, LogThreadedDestWorker *victim)
+{
+  gint max_msgs = MIN(MAX(self->owner->batch_lines, 1), log_queue_get_length(victim->queue) / 2);
+
+  if (max_msgs <= 0)
+    return FALSE;
+
+  gint stolen = log_queue_fifo_steal(self->queue, victim->queue, max_msgs);
+  if (stolen > 0)
+    msg_trace("Stolen messages from another worker",
+              evt_tag_str("driver", self->owner->super.super.id),
+              evt_tag_int("worker_index", self->worker_index),
+              evt_tag_int("victim_worker_index", victim->worker_index),
+              evt_tag_int("stolen", stolen));
+  return stolen > 0;
+}
+
+/* Messages with the same partition key have to be delivered in order,
+ * they cannot be moved while some of them are in flight.  Instead, a slot
+ * without outstanding messages is moved, so new messages of the keys
+ * hashed to it are routed to us.
+ *
+ * The owner and the counter of a slot are changed in one step, so a
+ * message is either counted before the move and makes it fail, or is
+ * routed to us, see _lookup_worker_by_partition_slot().
+ */
+static gboolean
+_steal_partition_slot(LogThreadedDestWorker *self, LogThreadedDestWorker *victim)
+{
+  LogThreadedDestDriver *owner = self->owner;
+
+  /* the slots of the untracked messages are unknown */
+  if (g_atomic_int_get(&victim->stealing.untracked) > 0)
+    return FALSE;
+
+  gsize idle_victim_slot = _partition_slot_state(victim->worker_index, 0);
+  gsize idle_stolen_slot = _partition_slot_state(self->worker_index, 0);
+
+  for (gint slot = 0; slot < LOG_THREADED_DEST_PARTITION_SLOTS; slot++)
+    {
+      if (!atomic_gssize_compare_and_exchange(&owner->partition_slots.state[slot], idle_victim_slot, idle_stolen_slot))
+        continue;
+
+      _persist_partition_slot_owner(owner, slot, self->worker_index);
+
+      msg_trace("Stolen partition slot from another worker",
+                evt_tag_str("driver", self->owner->super.super.id),
+                evt_tag_int("worker_index", self->worker_index),
+                evt_tag_int("victim_worker_index", victim->worker_index),
+                evt_tag_int("slot", slot));
+      return TRUE;
+    }
+  return FALSE;
+}
+
+/* NOTE: runs in the worker thread, when our queue is empty */
+static void
+_steal_work(LogThreadedDestWorker *self)
+{
+  LogThreadedDestWorker *victim = _find_busiest_worker(self);
+
+  if (victim)
+    {
+      if (_partition_slots_enabled(self->owner))
+        {
+          _steal_partition_slot(self, victim);
+        }
+      else if (_steal_messages(self, victim))
+        {
+          iv_task_register(&self->do_work);
+          return;
+        }
+    }
+
+  iv_validate_now();
+  self->stealing.timer.expires = iv_now;
+  timespec_add_msec(&self->stealing.timer.expires, WORKER_STEALING_INTERVAL_MSEC);
+  iv_timer_register(&self->stealing.timer);
+}
+
 static void
 _perform_work(gpointer data)
 {
@@ -656,6 +981,8 @@ _perform_work(gpointer data)
        * here in this very function, as log_queue_check_items() will cancel
        * outstanding parallel push callbacks automatically.
        */
+      if (self->owner->worker_stealing)
+        _steal_work(self);
     }
 }
 
@@ -717,6 +1044,10 @@ _init_watches(LogThreadedDestWorker *self)
   self->timer_flush.cookie = self;
   self->timer_flush.handler = _flush_timer_cb;
 
+  IV_TIMER_INIT(&self->stealing.timer);
+  self->stealing.timer.cookie = self;
+  self->stealing.timer.handler = _perform_work;
+
   IV_TASK_INIT(&self->do_work);
   self->do_work.cookie = self;
   self->do_work.handler = _perform_work;
@@ -982,6 +1313,9 @@ log_threaded_dest_worker_deinit_method(LogThreadedDestWorker *self)
 void
 log_threaded_dest_worker_free_method(LogThreadedDestWorker *self)
 {
+  g_array_free(self->stealing.batch_slots, TRUE);
+  g_free(self->popped.msgs);
+  g_free(self->popped.path_options);
   _unregister_worker_stats(self);
 
   main_loop_threaded_worker_clear(&self->thread);
@@ -1003,6 +1337,7 @@ log_threaded_dest_worker_init_instance(LogThreadedDestWorker *self, LogThreadedD
   self->time_reopen = -1;
 
   self->partitioning.last_key = NULL;
+  self->stealing.batch_slots = g_array_new(FALSE, FALSE, sizeof(gint));
 
   _init_watches(self);
 
@@ -1045,6 +1380,14 @@ log_threaded_dest_driver_set_flush_on_worker_key_change(LogDriver *s, gboolean f
   self->flush_on_key_change = f;
 }
 
+void
+log_threaded_dest_driver_set_worker_stealing(LogDriver *s, gboolean worker_stealing)
+{
+  LogThreadedDestDriver *self = (LogThreadedDestDriver *) s;
+
+  self->worker_stealing = worker_stealing;
+}
+
 /* compatibility bridge between LogThreadedDestWorker */
 
 static gboolean
@@ -1141,9 +1484,24 @@ log_threaded_dest_driver_set_max_retries_on_error(LogDriver *s, gint max_retries
   self->retries_on_error_max = max_retries;
 }
 
+static LogThreadedDestWorker *
+_lookup_worker_by_partition_slot(LogThreadedDestDriver *self, LogMessage *msg)
+{
+  gint slot = _get_partition_slot(self, msg);
+
+  /* the message is counted and the owner is read in one step, the slot
+   * cannot be moved to another worker until the message is acked or
+   * dropped, see _steal_partition_slot() */
+  gsize state = atomic_gssize_inc(&self->partition_slots.state[slot]);
+  return self->workers[state >> LOG_THREADED_DEST_PARTITION_SLOT_OWNER_SHIFT];
+}
+
 LogThreadedDestWorker *
 _lookup_worker(LogThreadedDestDriver *self, LogMessage *msg)
 {
+  if (_partition_slots_enabled(self))
+    return _lookup_worker_by_partition_slot(self, msg);
+
   if (self->worker_partition_key)
     {
       LogTemplateEvalOptions options = DEFAULT_TEMPLATE_EVAL_OPTIONS;
@@ -1374,6 +1732,163 @@ _create_workers(LogThreadedDestDriver *self, gint stats_level, StatsClusterKeyBu
   return TRUE;
 }
 
+static void
+_load_partition_slot_owners(LogThreadedDestDriver *self, gint *owners)
+{
+  PersistState *state = log_pipe_get_config(&self->super.super.super)->state;
+  const gchar *persist_name = _format_partition_slots_persist_name(self);
+  gsize size;
+  guint8 version;
+
+  for (gint slot = 0; slot < LOG_THREADED_DEST_PARTITION_SLOTS; slot++)
+    owners[slot] = slot % self->num_workers;
+
+  self->partition_slots.persist_handle = 0;
+  if (!state)
+    return;
+
+  PersistEntryHandle handle = persist_state_lookup_entry(state, persist_name, &size, &version);
+  gboolean found = handle && size == sizeof(PartitionSlotsPersistState);
+
+  if (!found)
+    handle = persist_state_alloc_entry(state, persist_name, sizeof(PartitionSlotsPersistState));
+  if (!handle)
+    return;
+
+  PartitionSlotsPersistState *persisted = persist_state_map_entry(state, handle);
+  if (found && persisted->num_workers == self->num_workers)
+    {
+      for (gint slot = 0; slot < LOG_THREADED_DEST_PARTITION_SLOTS; slot++)
+        {
+          if (persisted->owner[slot] < self->num_workers)
+            owners[slot] = persisted->owner[slot];
+        }
+    }
+
+  persisted->num_workers = self->num_workers;
+  for (gint slot = 0; slot < LOG_THREADED_DEST_PARTITION_SLOTS; slot++)
+    persisted->owner[slot] = owners[slot];
+  persist_state_unmap_entry(state, handle);
+
+  self->partition_slots.persist_handle = handle;
+}
+
+static void
+_init_partition_slots(LogThreadedDestDriver *self)
+{
+  GlobalConfig *cfg = log_pipe_get_config(&self->super.super.super);
+  PartitionSlotsReloadState *reload_state = cfg_persist_config_fetch(cfg, _format_partition_slots_persist_name(self));
+  gint owners[LOG_THREADED_DEST_PARTITION_SLOTS];
+
+  _load_partition_slot_owners(self, owners);
+
+  if (reload_state && reload_state->num_workers == self->num_workers)
+    {
+      for (gint slot = 0; slot < LOG_THREADED_DEST_PARTITION_SLOTS; slot++)
+        atomic_gssize_set(&self->partition_slots.state[slot], reload_state->state[slot]);
+
+      for (gint i = 0; i < self->num_workers; i++)
+        self->workers[i]->stealing.untracked = reload_state->untracked[i];
+    }
+  else
+    {
+      /* the messages left in the queues are not counted in their slots,
+       * slots are not taken from their workers until they are all acked */
+      for (gint slot = 0; slot < LOG_THREADED_DEST_PARTITION_SLOTS; slot++)
+        atomic_gssize_set(&self->partition_slots.state[slot], _partition_slot_state(owners[slot], 0));
+
+      for (gint i = 0; i < self->num_workers; i++)
+        {
+          LogThreadedDestWorker *worker = self->workers[i];
+
+          log_queue_rewind_backlog_all(worker->queue);
+          worker->stealing.untracked = log_queue_get_length(worker->queue);
+        }
+    }
+  g_free(reload_state);
+
+  for (gint i = 0; i < self->num_workers; i++)
+    log_queue_set_drop_notify(self->workers[i]->queue, _release_dropped_message, self);
+}
+
+static void
+_deinit_partition_slots(LogThreadedDestDriver *self)
+{
+  PartitionSlotsReloadState *reload_state = g_new0(PartitionSlotsReloadState, 1);
+
+  reload_state->num_workers = self->num_workers;
+  for (gint slot = 0; slot < LOG_THREADED_DEST_PARTITION_SLOTS; slot++)
+    reload_state->state[slot] = atomic_gssize_get_unsigned(&self->partition_slots.state[slot]);
+
+  for (gint i = 0; i < self->created_workers; i++)
+    {
+      LogThreadedDestWorker *worker = self->workers[i];
+
+      reload_state->untracked[i] = worker->stealing.untracked;
+      if (worker->queue)
+        log_queue_set_drop_notify(worker->queue, NULL, NULL);
+    }
+
+  cfg_persist_config_add(log_pipe_get_config(&self->super.super.super),
+                         _format_partition_slots_persist_name(self), reload_state, g_free);
+}
+
+static void
+_init_worker_stealing(LogThreadedDestDriver *self)
+{
+  if (self->num_workers <= 1)
+    self->worker_stealing = FALSE;
+
+  if (!self->worker_stealing)
+    return;
+
+  if (_partition_slots_enabled(self))
+    {
+      if (self->num_workers > LOG_THREADED_DEST_PARTITION_SLOT_MAX_WORKERS)
+        {
+          msg_warning("WARNING: worker-stealing() with worker-partition-key() supports at most 256 workers, "
+                      "disabling it",
+                      log_expr_node_location_tag(self->super.super.super.expr_node));
+          self->worker_stealing = FALSE;
+          return;
+        }
+      _init_partition_slots(self);
+      return;
+    }
+
+  for (gint i = 0; i < self->num_workers; i++)
+    {
+      if (!log_queue_has_type(self->workers[i]->queue, log_queue_fifo_get_type()))
+        {
+          msg_warning("WARNING: worker-stealing() without worker-partition-key() only works with memory queues, "
+                      "disabling it",
+                      log_expr_node_location_tag(self->super.super.super.expr_node));
+          self->worker_stealing = FALSE;
+          return;
+        }
+    }
+}
+
+/* messages of a partition have to be delivered by the same worker */
+static gboolean
+_check_worker_queues_are_not_shared(LogThreadedDestDriver *self)
+{
+  if (!self->worker_partition_key && !self->worker_stealing)
+    return TRUE;
+
+  for (gint i = 0; i < self->num_workers; i++)
+    {
+      if (self->workers[i]->queue->shared_by_workers)
+        {
+          msg_error("worker-partition-key() and worker-stealing() can't be used with a queue shared by the workers, "
+                    "e.g. disk-buffer(shared-by-workers(yes))",
+                    log_expr_node_location_tag(self->super.super.super.expr_node));
+          return FALSE;
+        }
+    }
+  return TRUE;
+}
+
 gboolean
 log_threaded_dest_driver_pre_config_init(LogPipe *s)
 {
@@ -1420,6 +1935,14 @@ log_threaded_dest_driver_init_method(LogPipe *s)
       return FALSE;
     }
 
+  if (!_check_worker_queues_are_not_shared(self))
+    {
+      stats_cluster_key_builder_free(driver_sck_builder);
+      return FALSE;
+    }
+
+  _init_worker_stealing(self);
+
   _register_driver_stats(self, driver_sck_builder);
 
   stats_cluster_key_builder_free(driver_sck_builder);
@@ -1471,6 +1994,9 @@ log_threaded_dest_driver_deinit_method(LogPipe *s)
                          _format_seqnum_persist_name(self),
                          GINT_TO_POINTER(self->shared_seq_num), NULL);
 
+  if (_partition_slots_enabled(self))
+    _deinit_partition_slots(self);
+
   _unregister_driver_stats(self);
 
   _destroy_workers(self);
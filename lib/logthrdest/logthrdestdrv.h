@@ -32,6 +32,8 @@
 #include "stats/stats-compat.h"
 #include "stats/stats-cluster-key-builder.h"
 #include "logqueue.h"
+#include "atomic-gssize.h"
+#include "persist-state.h"
 #include "seqnum.h"
 #include "mainloop-threaded-worker.h"
 #include "timeutils/misc.h"
@@ -71,6 +73,13 @@ enum
   /* NOTE: everything >= 0x1000 is driver specific */
 };
 
+#define LOG_THREADED_DEST_PARTITION_SLOTS 256
+
+/* the state of a partition slot holds the index of its owner worker in the
+ * top byte and the number of its outstanding messages below that */
+#define LOG_THREADED_DEST_PARTITION_SLOT_OWNER_SHIFT (8 * sizeof(gsize) - 8)
+#define LOG_THREADED_DEST_PARTITION_SLOT_MAX_WORKERS 256
+
 typedef struct _LogThreadedDestDriver LogThreadedDestDriver;
 typedef struct _LogThreadedDestWorker LogThreadedDestWorker;
 
@@ -104,6 +113,29 @@ struct _LogThreadedDestWorker
     GString *last_key;
   } partitioning;
 
+  /* messages popped from the queue in a single batch, the ones after pos
+   * are not yet processed */
+  struct
+  {
+    LogMessage **msgs;
+    LogPathOptions *path_options;
+    gint size;
+    gint len;
+    gint pos;
+  } popped;
+
+  struct
+  {
+    struct iv_timer timer;
+    /* partition slots of the messages in the current batch, in the order
+     * they were popped, see worker-stealing() */
+    GArray *batch_slots;
+    /* messages queued before the driver was (re)started, which are not
+     * counted in any slot, and the number of them in the current batch */
+    gint untracked;
+    gint untracked_in_batch;
+  } stealing;
+
   struct
   {
     StatsClusterKey *output_event_bytes_sc_key;
@@ -183,6 +215,17 @@ struct _LogThreadedDestDriver
 
   gboolean flush_on_key_change;
   LogTemplate *worker_partition_key;
+
+  /* with worker-stealing(yes) and a worker-partition-key(), keys are
+   * hashed to slots, which can be moved among the workers */
+  gboolean worker_stealing;
+  struct
+  {
+    /* owner and messages queued and not yet acked or dropped, see
+     * LOG_THREADED_DEST_PARTITION_SLOT_OWNER_SHIFT */
+    atomic_gssize state[LOG_THREADED_DEST_PARTITION_SLOTS];
+    PersistEntryHandle persist_handle;
+  } partition_slots;
   gint stats_source;
 
   /* this counter is not thread safe if there are multiple worker threads,
@@ -196,6 +239,20 @@ struct _LogThreadedDestDriver
   const gchar *(*format_stats_key)(LogThreadedDestDriver *s, StatsClusterKeyBuilder *kb);
 };
 
+static inline gint
+log_threaded_dest_driver_get_partition_slot_owner(LogThreadedDestDriver *self, gint slot)
+{
+  return atomic_gssize_get_unsigned(&self->partition_slots.state[slot]) >> LOG_THREADED_DEST_PARTITION_SLOT_OWNER_SHIFT;
+}
+
+static inline gsize
+log_threaded_dest_driver_get_partition_slot_outstanding(LogThreadedDestDriver *self, gint slot)
+{
+  gsize outstanding_mask = ((gsize) 1 << LOG_THREADED_DEST_PARTITION_SLOT_OWNER_SHIFT) - 1;
+
+  return atomic_gssize_get_unsigned(&self->partition_slots.state[slot]) & outstanding_mask;
+}
+
 static inline gboolean
 log_threaded_dest_worker_init(LogThreadedDestWorker *self)
 {
@@ -316,6 +373,7 @@ void log_threaded_dest_driver_set_max_retries_on_error(LogDriver *s, gint max_re
 void log_threaded_dest_driver_set_num_workers(LogDriver *s, gint num_workers);
 void log_threaded_dest_driver_set_worker_partition_key_ref(LogDriver *s, LogTemplate *key);
 void log_threaded_dest_driver_set_flush_on_worker_key_change(LogDriver *s, gboolean f);
+void log_threaded_dest_driver_set_worker_stealing(LogDriver *s, gboolean worker_stealing);
 void log_threaded_dest_driver_set_batch_lines(LogDriver *s, gint batch_lines);
 void log_threaded_dest_driver_set_batch_timeout(LogDriver *s, gint batch_timeout);
 void log_threaded_dest_driver_set_time_reopen(LogDriver *s, time_t time_reopen);
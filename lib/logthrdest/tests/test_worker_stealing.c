@@ -0,0 +1,428 @@
+/*
+ * Copyright (c) 2026 Axoflow
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include <criterion/criterion.h>
+
+#include "logthrdest/logthrdestdrv.h"
+#include "template/eval.h"
+#include "mainloop-worker.h"
+#include "apphook.h"
+
+#include <stdlib.h>
+
+#define NUM_WORKERS 2
+
+/* spins maximum about 10 seconds */
+#define MAX_SPIN_ITERATIONS 10000
+
+/* worker #0 is the busy one: it blocks on its first message until it is
+ * released, and is slow afterwards if requested */
+typedef struct _TestStealingDriver
+{
+  LogThreadedDestDriver super;
+  GMutex lock;
+  GCond cond;
+  gboolean busy_worker_blocked;
+  gboolean busy_worker_released;
+  gboolean busy_worker_slow;
+  gint inserted[NUM_WORKERS];
+  GHashTable *last_seq_by_key;
+  gint order_violations;
+} TestStealingDriver;
+
+static const gchar *
+_generate_persist_name(const LogPipe *s)
+{
+  return "worker-stealing";
+}
+
+static const gchar *
+_format_stats_key(LogThreadedDestDriver *s, StatsClusterKeyBuilder *kb)
+{
+  stats_cluster_key_builder_add_legacy_label(kb, stats_cluster_label("driver", "worker-stealing"));
+  return NULL;
+}
+
+static void
+_check_order(TestStealingDriver *self, LogMessage *msg)
+{
+  const gchar *key = log_msg_get_value_by_name(msg, "key", NULL);
+  gint seq = atoi(log_msg_get_value_by_name(msg, "seq", NULL));
+  gpointer last_seq;
+
+  if (g_hash_table_lookup_extended(self->last_seq_by_key, key, NULL, &last_seq) && GPOINTER_TO_INT(last_seq) >= seq)
+    self->order_violations++;
+  g_hash_table_insert(self->last_seq_by_key, g_strdup(key), GINT_TO_POINTER(seq));
+}
+
+static LogThreadedResult
+_insert(LogThreadedDestWorker *s, LogMessage *msg)
+{
+  TestStealingDriver *owner = (TestStealingDriver *) s->owner;
+
+  g_mutex_lock(&owner->lock);
+  if (s->worker_index == 0)
+    {
+      owner->busy_worker_blocked = TRUE;
+      while (!owner->busy_worker_released)
+        g_cond_wait(&owner->cond, &owner->lock);
+
+      if (owner->busy_worker_slow)
+        {
+          g_mutex_unlock(&owner->lock);
+          g_usleep(1000);
+          g_mutex_lock(&owner->lock);
+        }
+    }
+  _check_order(owner, msg);
+  owner->inserted[s->worker_index]++;
+  g_mutex_unlock(&owner->lock);
+
+  return LTR_SUCCESS;
+}
+
+static LogThreadedDestWorker *
+_construct_worker(LogThreadedDestDriver *s, gint worker_index)
+{
+  LogThreadedDestWorker *worker = g_new0(LogThreadedDestWorker, 1);
+
+  log_threaded_dest_worker_init_instance(worker, s, worker_index);
+  worker->insert = _insert;
+  return worker;
+}
+
+static void
+_free(LogPipe *s)
+{
+  TestStealingDriver *self = (TestStealingDriver *) s;
+
+  g_hash_table_destroy(self->last_seq_by_key);
+  g_cond_clear(&self->cond);
+  g_mutex_clear(&self->lock);
+  log_threaded_dest_driver_free(s);
+}
+
+MainLoop *main_loop;
+TestStealingDriver *dd;
+
+static void
+_construct_driver(const gchar *partition_key, gint log_fifo_size)
+{
+  GlobalConfig *cfg = main_loop_get_current_config(main_loop);
+
+  dd = g_new0(TestStealingDriver, 1);
+  log_threaded_dest_driver_init_instance(&dd->super, cfg);
+  dd->super.super.super.super.generate_persist_name = _generate_persist_name;
+  dd->super.super.super.super.free_fn = _free;
+  dd->super.format_stats_key = _format_stats_key;
+  dd->super.worker.construct = _construct_worker;
+  dd->super.batch_timeout = 0;
+  dd->super.batch_lines = 0;
+  dd->super.super.log_fifo_size = log_fifo_size;
+
+  g_mutex_init(&dd->lock);
+  g_cond_init(&dd->cond);
+  dd->last_seq_by_key = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+
+  log_threaded_dest_driver_set_num_workers(&dd->super.super.super, NUM_WORKERS);
+  log_threaded_dest_driver_set_worker_stealing(&dd->super.super.super, TRUE);
+  if (partition_key)
+    {
+      LogTemplate *key = log_template_new(cfg, NULL);
+      cr_assert(log_template_compile(key, partition_key, NULL));
+      log_threaded_dest_driver_set_worker_partition_key_ref(&dd->super.super.super, key);
+    }
+}
+
+static void
+_start_driver(const gchar *partition_key, gint log_fifo_size)
+{
+  _construct_driver(partition_key, log_fifo_size);
+
+  cr_assert(log_pipe_init(&dd->super.super.super.super));
+  cr_assert(log_pipe_post_config_init(&dd->super.super.super.super));
+}
+
+static void
+_release_busy_worker(gboolean slow)
+{
+  g_mutex_lock(&dd->lock);
+  dd->busy_worker_released = TRUE;
+  dd->busy_worker_slow = slow;
+  g_cond_broadcast(&dd->cond);
+  g_mutex_unlock(&dd->lock);
+}
+
+static LogMessage *
+_create_message(const gchar *key, gint seq)
+{
+  LogMessage *msg = log_msg_new_empty();
+  gchar buf[32];
+
+  g_snprintf(buf, sizeof(buf), "%d", seq);
+  log_msg_set_value_by_name(msg, "key", key, -1);
+  log_msg_set_value_by_name(msg, "seq", buf, -1);
+  return msg;
+}
+
+static void
+_send_messages(const gchar *key, gint first_seq, gint n)
+{
+  LogPathOptions path_options = LOG_PATH_OPTIONS_INIT_NOACK;
+
+  for (gint seq = first_seq; seq < first_seq + n; seq++)
+    log_pipe_queue(&dd->super.super.super.super, _create_message(key, seq), &path_options);
+}
+
+static gint
+_get_partition_slot_of_key(const gchar *key)
+{
+  LogTemplateEvalOptions options = DEFAULT_TEMPLATE_EVAL_OPTIONS;
+  LogMessage *msg = _create_message(key, 0);
+
+  gint slot = log_template_hash(dd->super.worker_partition_key, msg, &options) % LOG_THREADED_DEST_PARTITION_SLOTS;
+  log_msg_unref(msg);
+  return slot;
+}
+
+/* writes a key hashed to @slot into @key */
+static void
+_find_key_of_partition_slot(gint slot, gchar *key, gsize key_size)
+{
+  for (gint i = 0; i < 1000000; i++)
+    {
+      g_snprintf(key, key_size, "key%d", i);
+      if (_get_partition_slot_of_key(key) == slot)
+        return;
+    }
+  cr_assert_fail("no key found for partition slot %d", slot);
+}
+
+static gint
+_get_total_outstanding(void)
+{
+  gint total = 0;
+
+  for (gint slot = 0; slot < LOG_THREADED_DEST_PARTITION_SLOTS; slot++)
+    total += log_threaded_dest_driver_get_partition_slot_outstanding(&dd->super, slot);
+  return total;
+}
+
+static gboolean
+_is_busy_worker_blocked(gpointer user_data)
+{
+  return dd->busy_worker_blocked;
+}
+
+static gboolean
+_has_worker_inserted(gpointer user_data)
+{
+  gint *expected = user_data;
+  return dd->inserted[expected[0]] == expected[1];
+}
+
+static gboolean
+_have_all_messages_been_inserted(gpointer user_data)
+{
+  gint expected = GPOINTER_TO_INT(user_data);
+  return dd->inserted[0] + dd->inserted[1] == expected;
+}
+
+static gboolean
+_have_all_slots_been_released(gpointer user_data)
+{
+  return _get_total_outstanding() == 0;
+}
+
+static void
+_wait_for(gboolean (*condition)(gpointer user_data), gpointer user_data, const gchar *what)
+{
+  for (gint i = 0; i < MAX_SPIN_ITERATIONS; i++)
+    {
+      g_mutex_lock(&dd->lock);
+      gboolean done = condition(user_data);
+      g_mutex_unlock(&dd->lock);
+
+      if (done)
+        return;
+      g_usleep(1000);
+    }
+  cr_assert_fail("timed out waiting for %s", what);
+}
+
+Test(worker_stealing, idle_worker_steals_the_messages_the_busy_worker_has_not_started_to_process)
+{
+  _start_driver(NULL, -1);
+
+  /* round-robin, the first message goes to worker #0 */
+  _send_messages("key", 0, 1);
+  _wait_for(_is_busy_worker_blocked, NULL, "worker #0 to block");
+
+  /* 10 messages to each worker, at least one stays with worker #0 */
+  _send_messages("key", 1, 20);
+  gint expected[] = { 1, 19 };
+  _wait_for(_has_worker_inserted, expected, "worker #1 to steal the messages of worker #0");
+
+  _release_busy_worker(FALSE);
+  _wait_for(_have_all_messages_been_inserted, GINT_TO_POINTER(21), "all messages to be inserted");
+  cr_assert_eq(dd->inserted[0], 2);
+}
+
+Test(worker_stealing, idle_worker_steals_partition_slots_without_outstanding_messages)
+{
+  gchar busy_key[32], stolen_key[32];
+
+  _start_driver("$key", -1);
+
+  _find_key_of_partition_slot(0, busy_key, sizeof(busy_key));
+  cr_assert_eq(log_threaded_dest_driver_get_partition_slot_owner(&dd->super, 0), 0);
+
+  _send_messages(busy_key, 0, 1);
+  _wait_for(_is_busy_worker_blocked, NULL, "worker #0 to block");
+  _send_messages(busy_key, 1, 4);
+
+  gint stolen_slot = -1;
+  for (gint i = 0; i < MAX_SPIN_ITERATIONS && stolen_slot < 0; i++)
+    {
+      for (gint slot = 2; slot < LOG_THREADED_DEST_PARTITION_SLOTS; slot += 2)
+        {
+          if (log_threaded_dest_driver_get_partition_slot_owner(&dd->super, slot) == 1)
+            stolen_slot = slot;
+        }
+      g_usleep(1000);
+    }
+  cr_assert_geq(stolen_slot, 0, "no partition slot has been stolen");
+
+  /* the slot of the busy key has outstanding messages, it stays */
+  cr_assert_eq(log_threaded_dest_driver_get_partition_slot_owner(&dd->super, 0), 0);
+  cr_assert_eq(log_threaded_dest_driver_get_partition_slot_outstanding(&dd->super, 0), 5);
+
+  _find_key_of_partition_slot(stolen_slot, stolen_key, sizeof(stolen_key));
+  _send_messages(stolen_key, 0, 5);
+  gint expected[] = { 1, 5 };
+  _wait_for(_has_worker_inserted, expected, "worker #1 to process the messages of the stolen slot");
+
+  _release_busy_worker(FALSE);
+  _wait_for(_have_all_messages_been_inserted, GINT_TO_POINTER(10), "all messages to be inserted");
+  _wait_for(_have_all_slots_been_released, NULL, "all partition slots to be released");
+  cr_assert_eq(dd->order_violations, 0);
+}
+
+Test(worker_stealing, messages_of_the_same_partition_key_are_delivered_in_order_while_stealing)
+{
+  gchar busy_key[32], key[32];
+
+  _start_driver("$key", -1);
+
+  _find_key_of_partition_slot(0, busy_key, sizeof(busy_key));
+  _send_messages(busy_key, 0, 1);
+  _wait_for(_is_busy_worker_blocked, NULL, "worker #0 to block");
+  _release_busy_worker(TRUE);
+
+  /* worker #0 is slow, worker #1 keeps taking its idle slots over */
+  for (gint seq = 0; seq < 50; seq++)
+    {
+      for (gint i = 0; i < 16; i++)
+        {
+          g_snprintf(key, sizeof(key), "key%d", i);
+          _send_messages(key, seq, 1);
+        }
+      g_usleep(2000);
+    }
+
+  _wait_for(_have_all_messages_been_inserted, GINT_TO_POINTER(1 + 50 * 16), "all messages to be inserted");
+  _wait_for(_have_all_slots_been_released, NULL, "all partition slots to be released");
+  cr_assert_eq(dd->order_violations, 0);
+}
+
+Test(worker_stealing, partition_slots_are_released_when_the_queue_drops_their_messages)
+{
+  gchar busy_key[32];
+
+  _start_driver("$key", 5);
+
+  _find_key_of_partition_slot(0, busy_key, sizeof(busy_key));
+  _send_messages(busy_key, 0, 1);
+  _wait_for(_is_busy_worker_blocked, NULL, "worker #0 to block");
+
+  /* the queue of worker #0 overflows */
+  _send_messages(busy_key, 1, 20);
+
+  _release_busy_worker(FALSE);
+  _wait_for(_have_all_slots_been_released, NULL, "all partition slots to be released");
+  cr_assert_lt(dd->inserted[0], 21);
+  cr_assert_eq(dd->order_violations, 0);
+}
+
+MainLoopOptions main_loop_options = {0};
+
+static LogQueue *(*memory_queue_acquire)(LogDestDriver *s, const gchar *persist_name, gint stats_level,
+                                         StatsClusterKeyBuilder *driver_sck_builder,
+                                         StatsClusterKeyBuilder *queue_sck_builder);
+
+static LogQueue *
+_acquire_queue_shared_by_workers(LogDestDriver *s, const gchar *persist_name, gint stats_level,
+                                 StatsClusterKeyBuilder *driver_sck_builder,
+                                 StatsClusterKeyBuilder *queue_sck_builder)
+{
+  LogQueue *queue = memory_queue_acquire(s, persist_name, stats_level, driver_sck_builder, queue_sck_builder);
+
+  queue->shared_by_workers = TRUE;
+  return queue;
+}
+
+Test(worker_stealing, queues_shared_by_the_workers_are_rejected)
+{
+  _construct_driver("$key", -1);
+  memory_queue_acquire = dd->super.super.acquire_queue;
+  dd->super.super.acquire_queue = _acquire_queue_shared_by_workers;
+
+  cr_assert_not(log_pipe_init(&dd->super.super.super.super));
+}
+
+static void
+setup(void)
+{
+  app_startup();
+
+  main_loop = main_loop_get_instance();
+  main_loop_init(main_loop, &main_loop_options);
+  cfg_set_current_version(main_loop_get_current_config(main_loop));
+
+  main_loop_worker_allocate_thread_space(NUM_WORKERS);
+  main_loop_worker_finalize_thread_space();
+}
+
+static void
+teardown(void)
+{
+  _release_busy_worker(FALSE);
+  main_loop_sync_worker_startup_and_teardown();
+  log_pipe_deinit(&dd->super.super.super.super);
+  log_pipe_unref(&dd->super.super.super.super);
+
+  main_loop_deinit(main_loop);
+  app_shutdown();
+}
+
+TestSuite(worker_stealing, .init = setup, .fini = teardown);
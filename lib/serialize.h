@@ -198,6 +198,74 @@ serialize_read_uint8(SerializeArchive *archive, guint8 *value)
   return FALSE;
 }
 
+/* variable length (LEB128) encoding of integers: 7 bits per byte, the top
+ * bit indicates that more bytes follow. Small values take a single byte. */
+#define SERIALIZE_VARINT_MAX_BYTES 10
+
+static inline gboolean
+serialize_write_varint(SerializeArchive *archive, guint64 value)
+{
+  guint8 buf[SERIALIZE_VARINT_MAX_BYTES];
+  gsize len = 0;
+
+  while (value >= 0x80)
+    {
+      buf[len++] = (value & 0x7F) | 0x80;
+      value >>= 7;
+    }
+  buf[len++] = value;
+  return serialize_archive_write_bytes(archive, (gchar *) buf, len);
+}
+
+static inline gboolean
+serialize_read_varint(SerializeArchive *archive, guint64 *value)
+{
+  guint64 result = 0;
+
+  for (gint shift = 0; shift < SERIALIZE_VARINT_MAX_BYTES * 7; shift += 7)
+    {
+      guint8 b;
+
+      if (!serialize_read_uint8(archive, &b))
+        return FALSE;
+      result |= ((guint64) (b & 0x7F)) << shift;
+      if ((b & 0x80) == 0)
+        {
+          *value = result;
+          return TRUE;
+        }
+    }
+  return FALSE;
+}
+
+/* signed values are zigzag encoded, so that small negative numbers are short too */
+static inline gboolean
+serialize_write_varint_signed(SerializeArchive *archive, gint64 value)
+{
+  return serialize_write_varint(archive, ((guint64) value << 1) ^ (guint64) (value >> 63));
+}
+
+static inline gboolean
+serialize_read_varint_signed(SerializeArchive *archive, gint64 *value)
+{
+  guint64 n;
+
+  if (!serialize_read_varint(archive, &n))
+    return FALSE;
+  *value = (gint64) (n >> 1) ^ -(gint64) (n & 1);
+  return TRUE;
+}
+
+static inline gboolean
+serialize_read_varint32(SerializeArchive *archive, guint32 *value)
+{
+  guint64 n;
+
+  if (!serialize_read_varint(archive, &n) || n > G_MAXUINT32)
+    return FALSE;
+  *value = n;
+  return TRUE;
+}
 
 static inline gboolean
 serialize_write_blob(SerializeArchive *archive, const void *blob, gsize len)
@@ -0,0 +1,120 @@
+/*
+ * Copyright (c) 2026 Axoflow
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+/* NOTE: this is not run automatically in make check as it only measures
+ * the throughput of producers pushing through the shared input of
+ * LogQueueFifo, you have to invoke it manually.  The ordering guarantees
+ * are covered by test_logqueue.
+ */
+
+#include <criterion/criterion.h>
+
+#include "logqueue-fifo.h"
+#include "logmsg/logmsg.h"
+#include "logpipe.h"
+#include "apphook.h"
+#include "cfg.h"
+#include "libtest/stopwatch.h"
+
+#define MESSAGES_PER_PRODUCER 250000
+
+typedef struct _Producer
+{
+  LogQueue *q;
+  gint num_messages;
+} Producer;
+
+static gpointer
+_produce(gpointer args)
+{
+  Producer *producer = args;
+  LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+
+  /* not a main loop worker, so the shared input queue is used */
+  for (gint i = 0; i < producer->num_messages; i++)
+    log_queue_push_tail(producer->q, log_msg_new_empty(), &path_options);
+  return NULL;
+}
+
+static void
+_measure_producers(gint num_producers)
+{
+  gint total = num_producers * MESSAGES_PER_PRODUCER;
+  LogQueue *q = log_queue_fifo_new(total, NULL, STATS_LEVEL0, NULL, NULL);
+  Producer producers[num_producers];
+  GThread *threads[num_producers];
+  gint msg_count = 0;
+
+  start_stopwatch();
+  for (gint i = 0; i < num_producers; i++)
+    {
+      producers[i].q = q;
+      producers[i].num_messages = MESSAGES_PER_PRODUCER;
+      threads[i] = g_thread_new(NULL, _produce, &producers[i]);
+    }
+
+  while (msg_count < total)
+    {
+      LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+      LogMessage *msg = log_queue_pop_head(q, &path_options);
+
+      if (!msg)
+        {
+          g_thread_yield();
+          continue;
+        }
+      log_msg_unref(msg);
+      msg_count++;
+    }
+  stop_stopwatch_and_display_result(msg_count, "%d producer(s), push/pop of %d messages through the shared input",
+                                    num_producers, msg_count);
+
+  for (gint i = 0; i < num_producers; i++)
+    g_thread_join(threads[i]);
+
+  cr_assert_eq(log_queue_get_length(q), 0);
+  log_queue_unref(q);
+}
+
+Test(perf_logqueue_fifo, test_shared_input_throughput)
+{
+  for (gint num_producers = 1; num_producers <= 8; num_producers *= 2)
+    _measure_producers(num_producers);
+}
+
+static void
+setup(void)
+{
+  app_startup();
+  configuration = cfg_new_snippet();
+  cr_assert(cfg_init(configuration), "cfg_init failed!");
+}
+
+static void
+teardown(void)
+{
+  cfg_free(configuration);
+  app_shutdown();
+}
+
+TestSuite(perf_logqueue_fifo, .init = setup, .fini = teardown);
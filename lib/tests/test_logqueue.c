@@ -28,6 +28,7 @@
 
 #include "logqueue.h"
 #include "logqueue-fifo.h"
+#include "syslog-names.h"
 #include "logpipe.h"
 #include "apphook.h"
 #include "plugin.h"
@@ -284,6 +285,77 @@ Test(logqueue, log_queue_fifo_rewind_all_and_memory_usage)
   log_queue_unref(q);
 }
 
+Test(logqueue, log_queue_fifo_pop_head_batch)
+{
+  LogQueue *q = log_queue_fifo_new(OVERFLOW_SIZE, NULL, STATS_LEVEL0, NULL, NULL);
+  LogMessage *msgs[16];
+  LogPathOptions path_options[16];
+
+  fed_messages = 0;
+  acked_messages = 0;
+  feed_some_messages(q, 20);
+
+  gint n = log_queue_pop_head_batch(q, msgs, path_options, 16);
+  cr_assert_eq(n, 16);
+  for (gint i = 0; i < n; i++)
+    log_msg_unref(msgs[i]);
+  log_queue_rewind_backlog(q, 6);
+  cr_assert_eq(log_queue_get_length(q), 10);
+
+  log_queue_set_throttle(q, 4);
+  cr_assert_eq(log_queue_pop_head_batch(q, msgs, path_options, 16), 4,
+               "throttle should limit the number of messages popped");
+  log_queue_set_throttle(q, 0);
+  for (gint i = 0; i < 4; i++)
+    log_msg_unref(msgs[i]);
+
+  n = log_queue_pop_head_batch(q, msgs, path_options, 16);
+  cr_assert_eq(n, 6);
+  for (gint i = 0; i < n; i++)
+    log_msg_unref(msgs[i]);
+  cr_assert_eq(log_queue_pop_head_batch(q, msgs, path_options, 16), 0);
+
+  log_queue_ack_backlog(q, 20);
+  cr_assert_eq(fed_messages, acked_messages,
+               "did not receive enough acknowledgements: fed_messages=%d, acked_messages=%d",
+               fed_messages, acked_messages);
+  log_queue_unref(q);
+}
+
+Test(logqueue, log_queue_fifo_steal_moves_messages_not_yet_taken_by_the_output_thread)
+{
+  LogQueue *victim = log_queue_fifo_new(OVERFLOW_SIZE, NULL, STATS_LEVEL0, NULL, NULL);
+  LogQueue *thief = log_queue_fifo_new(OVERFLOW_SIZE, NULL, STATS_LEVEL0, NULL, NULL);
+  LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+
+  fed_messages = 0;
+  acked_messages = 0;
+  feed_some_messages(victim, 1);
+
+  /* moves the first message to the output queue of the victim */
+  LogMessage *msg = log_queue_peek_head(victim);
+  cr_assert_not_null(msg);
+
+  feed_some_messages(victim, 9);
+  cr_assert_eq(log_queue_fifo_steal(thief, victim, 5), 5);
+  cr_assert_eq(log_queue_get_length(victim), 5);
+  cr_assert_eq(log_queue_get_length(thief), 5);
+
+  cr_assert_eq(log_queue_fifo_steal(thief, victim, 100), 4,
+               "messages already taken by the output thread should not be stolen");
+  cr_assert_eq(log_queue_pop_head(victim, &path_options), msg);
+  log_msg_unref(msg);
+  log_queue_ack_backlog(victim, 1);
+
+  send_some_messages(thief, 9, TRUE);
+  cr_assert_eq(fed_messages, acked_messages,
+               "did not receive enough acknowledgements: fed_messages=%d, acked_messages=%d",
+               fed_messages, acked_messages);
+
+  log_queue_unref(victim);
+  log_queue_unref(thief);
+}
+
 Test(logqueue, log_queue_fifo_should_drop_only_non_flow_controlled_messages,
      .description = "Flow-controlled messages should never be dropped")
 {
@@ -382,6 +454,210 @@ Test(logqueue, log_queue_fifo_should_drop_only_non_flow_controlled_messages_thre
   log_queue_unref(q);
 }
 
+static gsize
+_get_empty_message_size(void)
+{
+  LogMessage *msg = log_msg_new_empty();
+  gsize size = log_msg_get_size(msg);
+
+  log_msg_unref(msg);
+  return size;
+}
+
+static void
+_send_all_messages_and_assert_acked(LogQueue *q)
+{
+  send_some_messages(q, log_queue_get_length(q), TRUE);
+  cr_assert_eq(fed_messages, acked_messages,
+               "did not receive enough acknowledgements: fed_messages=%d, acked_messages=%d",
+               fed_messages, acked_messages);
+}
+
+Test(logqueue, log_queue_fifo_size_bytes_drops_only_non_flow_controlled_messages)
+{
+  LogPathOptions flow_controlled_path = LOG_PATH_OPTIONS_INIT;
+  flow_controlled_path.flow_control_requested = TRUE;
+
+  LogPathOptions non_flow_controlled_path = LOG_PATH_OPTIONS_INIT;
+  non_flow_controlled_path.flow_control_requested = FALSE;
+
+  LogQueue *q = log_queue_fifo_new(OVERFLOW_SIZE, NULL, STATS_LEVEL0, NULL, NULL);
+  log_queue_fifo_set_log_fifo_size_bytes(q, 3 * _get_empty_message_size());
+
+  fed_messages = 0;
+  acked_messages = 0;
+  feed_empty_messages(q, &non_flow_controlled_path, 5);
+  cr_assert_eq(log_queue_get_length(q), 3);
+
+  feed_empty_messages(q, &flow_controlled_path, 2);
+  cr_assert_eq(log_queue_get_length(q), 5);
+
+  /* popped messages no longer count */
+  send_some_messages(q, 3, TRUE);
+  feed_empty_messages(q, &non_flow_controlled_path, 5);
+  cr_assert_eq(log_queue_get_length(q), 2 + 1);
+
+  _send_all_messages_and_assert_acked(q);
+  log_queue_unref(q);
+}
+
+Test(logqueue, log_queue_fifo_memory_budget_is_shared_by_all_queues)
+{
+  LogPathOptions flow_controlled_path = LOG_PATH_OPTIONS_INIT;
+  flow_controlled_path.flow_control_requested = TRUE;
+
+  LogPathOptions non_flow_controlled_path = LOG_PATH_OPTIONS_INIT;
+  non_flow_controlled_path.flow_control_requested = FALSE;
+
+  gsize msg_size = _get_empty_message_size();
+  LogQueue *q1 = log_queue_fifo_new(OVERFLOW_SIZE, NULL, STATS_LEVEL0, NULL, NULL);
+  LogQueue *q2 = log_queue_fifo_new(OVERFLOW_SIZE, NULL, STATS_LEVEL0, NULL, NULL);
+
+  fed_messages = 0;
+  acked_messages = 0;
+  log_queue_fifo_set_memory_budget(log_queue_fifo_get_total_memory_usage() + 4 * msg_size,
+                                   LQF_MEMORY_BUDGET_FLOW_CONTROL);
+  feed_empty_messages(q1, &non_flow_controlled_path, 3);
+  feed_empty_messages(q2, &non_flow_controlled_path, 3);
+  cr_assert_eq(log_queue_get_length(q1), 3);
+  cr_assert_eq(log_queue_get_length(q2), 1);
+
+  /* flow-controlled messages are held back by their sources */
+  feed_empty_messages(q2, &flow_controlled_path, 2);
+  cr_assert_eq(log_queue_get_length(q2), 3);
+
+  log_queue_fifo_set_memory_budget(log_queue_fifo_get_total_memory_usage(), LQF_MEMORY_BUDGET_DROP);
+  feed_empty_messages(q2, &flow_controlled_path, 2);
+  cr_assert_eq(log_queue_get_length(q2), 3);
+
+  log_queue_fifo_set_memory_budget(0, LQF_MEMORY_BUDGET_FLOW_CONTROL);
+
+  _send_all_messages_and_assert_acked(q1);
+  _send_all_messages_and_assert_acked(q2);
+  log_queue_unref(q1);
+  log_queue_unref(q2);
+}
+
+static void
+_feed_message_with_severity(LogQueue *q, const LogPathOptions *path_options, gint severity, gint seq)
+{
+  LogMessage *msg = log_msg_new_empty();
+  gchar pid[16];
+
+  msg->pri = LOG_USER | severity;
+  g_snprintf(pid, sizeof(pid), "%d", seq);
+  log_msg_set_value(msg, LM_V_PID, pid, -1);
+  log_msg_add_ack(msg, path_options);
+  msg->ack_func = test_ack;
+  log_queue_push_tail(q, msg, path_options);
+  fed_messages++;
+}
+
+static void
+_assert_popped_message(LogQueue *q, gint severity, gint seq)
+{
+  LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+  LogMessage *msg = log_queue_pop_head(q, &path_options);
+  gchar pid[16];
+
+  cr_assert_not_null(msg);
+  g_snprintf(pid, sizeof(pid), "%d", seq);
+  cr_assert_eq(SYSLOG_PRI(msg->pri), severity);
+  cr_assert_str_eq(log_msg_get_value(msg, LM_V_PID, NULL), pid);
+  log_msg_ack(msg, &path_options, AT_PROCESSED);
+  log_queue_ack_backlog(q, 1);
+  log_msg_unref(msg);
+}
+
+Test(logqueue, log_queue_fifo_lanes_serve_higher_severities_first)
+{
+  LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+  path_options.ack_needed = TRUE;
+  path_options.flow_control_requested = TRUE;
+
+  LogQueue *q = log_queue_fifo_new_with_lanes(OVERFLOW_SIZE, 2, NULL, NULL, STATS_LEVEL0, NULL, NULL);
+
+  fed_messages = 0;
+  acked_messages = 0;
+  for (gint i = 0; i < 4; i++)
+    {
+      _feed_message_with_severity(q, &path_options, LOG_INFO, i);
+      _feed_message_with_severity(q, &path_options, LOG_CRIT, i);
+    }
+
+  _assert_popped_message(q, LOG_CRIT, 0);
+
+  /* a message arriving later still overtakes the lower lane */
+  _feed_message_with_severity(q, &path_options, LOG_ERR, 4);
+  _assert_popped_message(q, LOG_CRIT, 1);
+  _assert_popped_message(q, LOG_CRIT, 2);
+  _assert_popped_message(q, LOG_CRIT, 3);
+  _assert_popped_message(q, LOG_ERR, 4);
+  for (gint i = 0; i < 4; i++)
+    _assert_popped_message(q, LOG_INFO, i);
+
+  cr_assert_eq(fed_messages, acked_messages);
+  log_queue_unref(q);
+}
+
+Test(logqueue, log_queue_fifo_lanes_drop_the_lowest_lane_first)
+{
+  LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+  path_options.ack_needed = TRUE;
+  path_options.flow_control_requested = FALSE;
+
+  LogQueue *q = log_queue_fifo_new_with_lanes(4, 2, NULL, NULL, STATS_LEVEL0, NULL, NULL);
+
+  fed_messages = 0;
+  acked_messages = 0;
+  for (gint i = 0; i < 4; i++)
+    _feed_message_with_severity(q, &path_options, LOG_DEBUG, i);
+  _feed_message_with_severity(q, &path_options, LOG_ALERT, 4);
+  _feed_message_with_severity(q, &path_options, LOG_ALERT, 5);
+
+  /* no lower lane to make room in */
+  _feed_message_with_severity(q, &path_options, LOG_DEBUG, 6);
+
+  cr_assert_eq(log_queue_get_length(q), 4);
+  cr_assert_eq(stats_counter_get(q->metrics.shared.dropped_messages), 3);
+
+  _assert_popped_message(q, LOG_ALERT, 4);
+  _assert_popped_message(q, LOG_ALERT, 5);
+  _assert_popped_message(q, LOG_DEBUG, 0);
+  _assert_popped_message(q, LOG_DEBUG, 1);
+
+  cr_assert_eq(fed_messages, acked_messages);
+  log_queue_unref(q);
+}
+
+Test(logqueue, log_queue_fifo_lanes_keep_rewound_messages_in_their_lane)
+{
+  LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+  path_options.ack_needed = TRUE;
+  path_options.flow_control_requested = TRUE;
+
+  LogQueue *q = log_queue_fifo_new_with_lanes(OVERFLOW_SIZE, 8, NULL, NULL, STATS_LEVEL0, NULL, NULL);
+
+  fed_messages = 0;
+  acked_messages = 0;
+  _feed_message_with_severity(q, &path_options, LOG_NOTICE, 0);
+  _feed_message_with_severity(q, &path_options, LOG_EMERG, 1);
+  _feed_message_with_severity(q, &path_options, LOG_WARNING, 2);
+
+  LogPathOptions popped_path_options = LOG_PATH_OPTIONS_INIT;
+  for (gint i = 0; i < 2; i++)
+    log_msg_unref(log_queue_pop_head(q, &popped_path_options));
+  log_queue_rewind_backlog_all(q);
+  cr_assert_eq(log_queue_get_length(q), 3);
+
+  _assert_popped_message(q, LOG_EMERG, 1);
+  _assert_popped_message(q, LOG_WARNING, 2);
+  _assert_popped_message(q, LOG_NOTICE, 0);
+
+  cr_assert_eq(fed_messages, acked_messages);
+  log_queue_unref(q);
+}
+
 Test(logqueue, log_queue_fifo_multiple_queues)
 {
   const gint fifo_size = 1;
@@ -438,3 +714,77 @@ Test(logqueue, log_queue_fifo_multiple_queues)
 
   stats_cluster_key_builder_free(driver_sck_builder);
 }
+
+#define SHARED_INPUT_PRODUCERS 4
+#define SHARED_INPUT_MESSAGES_PER_PRODUCER 10000
+
+typedef struct _SharedInputProducer
+{
+  LogQueue *q;
+  gint id;
+} SharedInputProducer;
+
+static gpointer
+_shared_input_produce(gpointer args)
+{
+  SharedInputProducer *producer = args;
+  LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+  gchar value[16];
+
+  /* not a main loop worker, so the shared input queue is used */
+  for (gint i = 0; i < SHARED_INPUT_MESSAGES_PER_PRODUCER; i++)
+    {
+      LogMessage *msg = log_msg_new_empty();
+
+      g_snprintf(value, sizeof(value), "%d", producer->id);
+      log_msg_set_value(msg, LM_V_PROGRAM, value, -1);
+      g_snprintf(value, sizeof(value), "%d", i);
+      log_msg_set_value(msg, LM_V_PID, value, -1);
+      log_queue_push_tail(producer->q, msg, &path_options);
+    }
+  return NULL;
+}
+
+Test(logqueue, log_queue_fifo_producers_without_input_queues_keep_their_order)
+{
+  LogQueue *q = log_queue_fifo_new(SHARED_INPUT_PRODUCERS * SHARED_INPUT_MESSAGES_PER_PRODUCER, NULL,
+                                   STATS_LEVEL0, NULL, NULL);
+  SharedInputProducer producers[SHARED_INPUT_PRODUCERS];
+  GThread *threads[SHARED_INPUT_PRODUCERS];
+  gint next_seq[SHARED_INPUT_PRODUCERS] = { 0 };
+  gint msg_count = 0;
+
+  for (gint i = 0; i < SHARED_INPUT_PRODUCERS; i++)
+    {
+      producers[i].q = q;
+      producers[i].id = i;
+      threads[i] = g_thread_new(NULL, _shared_input_produce, &producers[i]);
+    }
+
+  while (msg_count < SHARED_INPUT_PRODUCERS * SHARED_INPUT_MESSAGES_PER_PRODUCER)
+    {
+      LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+      LogMessage *msg = log_queue_pop_head(q, &path_options);
+
+      if (!msg)
+        {
+          g_thread_yield();
+          continue;
+        }
+
+      gint producer = atoi(log_msg_get_value(msg, LM_V_PROGRAM, NULL));
+      gint seq = atoi(log_msg_get_value(msg, LM_V_PID, NULL));
+      cr_assert_eq(seq, next_seq[producer], "messages of producer %d are out of order", producer);
+      next_seq[producer]++;
+
+      log_msg_unref(msg);
+      msg_count++;
+    }
+
+  for (gint i = 0; i < SHARED_INPUT_PRODUCERS; i++)
+    g_thread_join(threads[i]);
+
+  cr_assert_eq(log_queue_get_length(q), 0);
+  cr_assert_eq(stats_counter_get(q->metrics.shared.dropped_messages), 0);
+  log_queue_unref(q);
+}
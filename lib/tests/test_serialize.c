@@ -56,3 +56,44 @@ Test(serialize, test_serialize)
   serialize_read_string(a, value);
   cr_assert_str_eq(value->str, "tarkabarka");
 }
+
+Test(serialize, test_varints)
+{
+  GString *stream = g_string_new("");
+  guint64 values[] = { 0, 1, 127, 128, 300, G_MAXUINT32, G_MAXUINT64 };
+  gint64 signed_values[] = { 0, -1, 1, -64, 64, G_MININT64, G_MAXINT64 };
+  guint64 num;
+  gint64 signed_num;
+  guint32 num32;
+
+  SerializeArchive *a = serialize_string_archive_new(stream);
+
+  serialize_write_varint(a, 127);
+  cr_assert_eq(stream->len, 1, "small values should be stored in a single byte");
+  serialize_write_varint(a, 128);
+  cr_assert_eq(stream->len, 3);
+  g_string_truncate(stream, 0);
+
+  for (gint i = 0; i < G_N_ELEMENTS(values); i++)
+    serialize_write_varint(a, values[i]);
+  for (gint i = 0; i < G_N_ELEMENTS(signed_values); i++)
+    serialize_write_varint_signed(a, signed_values[i]);
+  serialize_write_varint(a, (guint64) G_MAXUINT32 + 1);
+  serialize_archive_free(a);
+
+  a = serialize_string_archive_new(stream);
+  for (gint i = 0; i < G_N_ELEMENTS(values); i++)
+    {
+      cr_assert(serialize_read_varint(a, &num));
+      cr_assert_eq(num, values[i]);
+    }
+  for (gint i = 0; i < G_N_ELEMENTS(signed_values); i++)
+    {
+      cr_assert(serialize_read_varint_signed(a, &signed_num));
+      cr_assert_eq(signed_num, signed_values[i]);
+    }
+  cr_assert_not(serialize_read_varint32(a, &num32), "values over 32 bits should be rejected");
+  cr_assert_not(serialize_read_varint(a, &num), "reading past the end of the stream should fail");
+  serialize_archive_free(a);
+  g_string_free(stream, TRUE);
+}
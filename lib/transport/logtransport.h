@@ -56,15 +56,32 @@ typedef enum _LogTransportIOCond
 
 typedef struct _LogTransport LogTransport;
 typedef struct _LogTransportStack LogTransportStack;
+
+/* a datagram received by read_batch(), @buf is provided by the caller */
+typedef struct _LogTransportDatagram
+{
+  gpointer buf;
+  gsize buflen;
+  gsize len;
+  LogTransportAuxData aux;
+} LogTransportDatagram;
+
 struct _LogTransport
 {
   gint fd;
   LogTransportIOCond cond;
 
   gssize (*read)(LogTransport *self, gpointer buf, gsize count, LogTransportAuxData *aux);
+  /* optional: receives at most @count datagrams at once, returns the number
+   * of datagrams received or -1 (with errno set) */
+  gint (*read_batch)(LogTransport *self, LogTransportDatagram *datagrams, gint count);
   gssize (*write)(LogTransport *self, const gpointer buf, gsize count);
   gssize (*writev)(LogTransport *self, struct iovec *iov, gint iov_count);
   void (*shutdown)(LogTransport *self);
+  /* optional: the fd to poll for readability if it is not @fd */
+  gint (*get_poll_fd)(LogTransport *self);
+  /* optional: TRUE if data was already received and can be read without polling */
+  gboolean (*has_buffered_data)(LogTransport *self);
   void (*free_fn)(LogTransport *self);
 
   /* read ahead */
@@ -106,9 +123,20 @@ log_transport_poll_prepare(LogTransport *self, GIOCondition *cond)
   if (self->ra.buf_len != self->ra.pos)
     return TRUE;
 
+  if (self->has_buffered_data && self->has_buffered_data(self))
+    return TRUE;
+
   return FALSE;
 }
 
+static inline gint
+log_transport_get_poll_fd(LogTransport *self)
+{
+  if (self->get_poll_fd)
+    return self->get_poll_fd(self);
+  return self->fd;
+}
+
 static inline LogTransportIOCond
 log_transport_get_io_requirement(LogTransport *self)
 {
@@ -153,6 +181,18 @@ log_transport_read(LogTransport *self, gpointer buf, gsize count, LogTransportAu
   return _log_transport_combined_read_with_read_ahead(self, buf, count, aux);
 }
 
+static inline gboolean
+log_transport_can_read_batch(LogTransport *self)
+{
+  return self->read_batch && self->ra.buf_len == 0;
+}
+
+static inline gint
+log_transport_read_batch(LogTransport *self, LogTransportDatagram *datagrams, gint count)
+{
+  return self->read_batch(self, datagrams, count);
+}
+
 gssize log_transport_read_ahead(LogTransport *self, gpointer buf, gsize count, gboolean *moved_forward);
 
 void log_transport_init_instance(LogTransport *s, const gchar *name, gint fd);
@@ -0,0 +1,297 @@
+/*
+ * Copyright (c) 2026 Axoflow
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include <criterion/criterion.h>
+
+#include "transport/tls-context.h"
+#include "stats/stats-cluster-key-builder.h"
+#include "apphook.h"
+
+#include <openssl/ssl.h>
+#include <openssl/err.h>
+#include <sys/socket.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+Test(tls_session_cache, test_client_session_is_stored_per_peer)
+{
+  TLSContext *ctx = tls_context_new(TM_CLIENT, "test");
+  SSL_SESSION *session_a = SSL_SESSION_new();
+  SSL_SESSION *session_b = SSL_SESSION_new();
+
+  cr_assert_null(tls_context_lookup_client_session(ctx, "server-a"));
+
+  tls_context_store_client_session(ctx, "server-a", session_a);
+  tls_context_store_client_session(ctx, "server-b", session_b);
+
+  SSL_SESSION *found = tls_context_lookup_client_session(ctx, "server-a");
+  cr_assert_eq(found, session_a);
+  SSL_SESSION_free(found);
+
+  found = tls_context_lookup_client_session(ctx, "server-b");
+  cr_assert_eq(found, session_b);
+  SSL_SESSION_free(found);
+
+  tls_context_unref(ctx);
+}
+
+Test(tls_session_cache, test_newer_session_replaces_the_previous_one)
+{
+  TLSContext *ctx = tls_context_new(TM_CLIENT, "test");
+  SSL_SESSION *old_session = SSL_SESSION_new();
+  SSL_SESSION *new_session = SSL_SESSION_new();
+
+  tls_context_store_client_session(ctx, "server", old_session);
+  tls_context_store_client_session(ctx, "server", new_session);
+
+  SSL_SESSION *found = tls_context_lookup_client_session(ctx, "server");
+  cr_assert_eq(found, new_session);
+  SSL_SESSION_free(found);
+
+  tls_context_unref(ctx);
+}
+
+Test(tls_session_cache, test_server_context_does_not_cache_client_sessions)
+{
+  TLSContext *ctx = tls_context_new(TM_SERVER, "test");
+
+  tls_context_store_client_session(ctx, "client", SSL_SESSION_new());
+  cr_assert_null(tls_context_lookup_client_session(ctx, "client"));
+
+  tls_context_unref(ctx);
+}
+
+static StatsClusterKeyBuilder *
+_create_stats_key_builder(const gchar *id)
+{
+  StatsClusterKeyBuilder *kb = stats_cluster_key_builder_new();
+  stats_cluster_key_builder_add_label(kb, stats_cluster_label("id", id));
+  return kb;
+}
+
+static void
+_register_stats(TLSContext *ctx, const gchar *id)
+{
+  StatsClusterKeyBuilder *kb = _create_stats_key_builder(id);
+  tls_context_register_stats(ctx, STATS_LEVEL0, kb);
+  stats_cluster_key_builder_free(kb);
+}
+
+static void
+_unregister_stats(TLSContext *ctx, const gchar *id)
+{
+  StatsClusterKeyBuilder *kb = _create_stats_key_builder(id);
+  tls_context_unregister_stats(ctx, kb);
+  stats_cluster_key_builder_free(kb);
+}
+
+static TLSContext *
+_create_server_context(gint session_cache_size)
+{
+  TLSContext *ctx = tls_context_new(TM_SERVER, "server");
+
+  tls_context_set_key_file(ctx, TOP_SRCDIR "/tests/light/shared_files/server.key");
+  tls_context_set_cert_file(ctx, TOP_SRCDIR "/tests/light/shared_files/server.crt");
+  tls_context_set_verify_mode(ctx, TVM_OPTIONAL | TVM_UNTRUSTED);
+  tls_context_set_session_cache_size(ctx, session_cache_size);
+
+  /* TLS 1.3 sessions could only be resumed with session-tickets(yes) */
+  ctx->ssl_options |= TSO_NOTLSv13;
+  return ctx;
+}
+
+static TLSContext *
+_create_client_context(gint session_cache_size)
+{
+  TLSContext *ctx = tls_context_new(TM_CLIENT, "client");
+
+  /* the test certificate is self-signed and expired */
+  tls_context_set_verify_mode(ctx, TVM_OPTIONAL | TVM_UNTRUSTED);
+  tls_context_set_session_cache_size(ctx, session_cache_size);
+  return ctx;
+}
+
+static void
+_setup_contexts(TLSContext *server, TLSContext *client)
+{
+  cr_assert_eq(tls_context_setup_context(server), TLS_CONTEXT_SETUP_OK);
+  cr_assert_eq(tls_context_setup_context(client), TLS_CONTEXT_SETUP_OK);
+
+  _register_stats(server, "server");
+  _register_stats(client, "client");
+}
+
+static void
+_free_contexts(TLSContext *server, TLSContext *client)
+{
+  _unregister_stats(server, "server");
+  _unregister_stats(client, "client");
+
+  tls_context_unref(server);
+  tls_context_unref(client);
+}
+
+static gboolean
+_handshake_step(SSL *ssl)
+{
+  gint ret = SSL_do_handshake(ssl);
+
+  if (ret == 1)
+    return TRUE;
+
+  gint err = SSL_get_error(ssl, ret);
+  cr_assert(err == SSL_ERROR_WANT_READ || err == SSL_ERROR_WANT_WRITE,
+            "TLS handshake failed: %s", ERR_error_string(ERR_get_error(), NULL));
+  return FALSE;
+}
+
+/* connects a client and a server session over a socketpair, returns
+ * whether the client has resumed its previous session */
+static gboolean
+_connect(TLSContext *server, TLSContext *client)
+{
+  TLSSession *server_session = tls_context_setup_session(server);
+  TLSSession *client_session = tls_context_setup_session(client);
+  gint fds[2];
+
+  cr_assert_not_null(server_session);
+  cr_assert_not_null(client_session);
+  tls_session_set_peer(client_session, "server");
+
+  cr_assert(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+  fcntl(fds[0], F_SETFL, O_NONBLOCK);
+  fcntl(fds[1], F_SETFL, O_NONBLOCK);
+  SSL_set_fd(server_session->ssl, fds[0]);
+  SSL_set_fd(client_session->ssl, fds[1]);
+
+  gboolean server_done = FALSE;
+  gboolean client_done = FALSE;
+  for (gint i = 0; i < 100 && !(server_done && client_done); i++)
+    {
+      if (!client_done)
+        client_done = _handshake_step(client_session->ssl);
+      if (!server_done)
+        server_done = _handshake_step(server_session->ssl);
+    }
+  cr_assert(server_done && client_done, "TLS handshake did not finish");
+
+  gboolean resumed = SSL_session_reused(client_session->ssl);
+  cr_assert_eq(SSL_session_reused(server_session->ssl), resumed);
+
+  /* sessions of connections closed without close_notify are not resumable */
+  SSL_shutdown(client_session->ssl);
+  SSL_shutdown(server_session->ssl);
+
+  tls_session_free(server_session);
+  tls_session_free(client_session);
+  close(fds[0]);
+  close(fds[1]);
+
+  return resumed;
+}
+
+static void
+_assert_handshakes(TLSContext *ctx, gsize expected_full, gsize expected_resumed)
+{
+  cr_assert_eq(stats_counter_get(ctx->metrics.handshakes_full), expected_full,
+               "unexpected number of full handshakes on the %s side", ctx->location);
+  cr_assert_eq(stats_counter_get(ctx->metrics.handshakes_resumed), expected_resumed,
+               "unexpected number of resumed handshakes on the %s side", ctx->location);
+}
+
+Test(tls_session_cache, test_second_connection_is_resumed)
+{
+  TLSContext *server = _create_server_context(-1);
+  TLSContext *client = _create_client_context(-1);
+  _setup_contexts(server, client);
+
+  cr_assert_not(_connect(server, client));
+  _assert_handshakes(server, 1, 0);
+  _assert_handshakes(client, 1, 0);
+
+  cr_assert(_connect(server, client), "the second connection should resume the session");
+  _assert_handshakes(server, 1, 1);
+  _assert_handshakes(client, 1, 1);
+
+  _free_contexts(server, client);
+}
+
+Test(tls_session_cache, test_zero_session_cache_size_on_the_server_disables_resumption)
+{
+  TLSContext *server = _create_server_context(0);
+  TLSContext *client = _create_client_context(-1);
+  _setup_contexts(server, client);
+
+  cr_assert_not(_connect(server, client));
+  cr_assert_not(_connect(server, client));
+  _assert_handshakes(server, 2, 0);
+  _assert_handshakes(client, 2, 0);
+
+  _free_contexts(server, client);
+}
+
+Test(tls_session_cache, test_zero_session_cache_size_on_the_client_disables_resumption)
+{
+  TLSContext *server = _create_server_context(-1);
+  TLSContext *client = _create_client_context(0);
+  _setup_contexts(server, client);
+
+  cr_assert_not(_connect(server, client));
+  cr_assert_null(tls_context_lookup_client_session(client, "server"));
+  cr_assert_not(_connect(server, client));
+  _assert_handshakes(server, 2, 0);
+  _assert_handshakes(client, 2, 0);
+
+  _free_contexts(server, client);
+}
+
+Test(tls_session_cache, test_session_is_not_resumed_after_session_timeout)
+{
+  TLSContext *server = _create_server_context(-1);
+  TLSContext *client = _create_client_context(-1);
+  tls_context_set_session_timeout(server, 1);
+  _setup_contexts(server, client);
+
+  cr_assert_eq(SSL_CTX_get_timeout(server->ssl_ctx), 1);
+
+  cr_assert_not(_connect(server, client));
+  sleep(2);
+  cr_assert_not(_connect(server, client), "the session should have expired");
+  _assert_handshakes(server, 2, 0);
+
+  _free_contexts(server, client);
+}
+
+static void
+setup(void)
+{
+  app_startup();
+}
+
+static void
+teardown(void)
+{
+  app_shutdown();
+}
+
+TestSuite(tls_session_cache, .init = setup, .fini = teardown);
@@ -0,0 +1,180 @@
+/*
+ * Copyright (c) 2026 Axoflow
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include <criterion/criterion.h>
+
+#include "transport/transport-io-uring.h"
+#include "apphook.h"
+
+#include <sys/socket.h>
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+
+static gint sv[2];
+
+static LogTransport *
+_construct_transport(void)
+{
+  LogTransport *t = log_transport_io_uring_stream_socket_new(sv[0]);
+
+  if (!t)
+    cr_skip_test("io_uring is not supported by this build or kernel");
+  return t;
+}
+
+static gssize
+_read_with_poll(LogTransport *t, gchar *buf, gsize buflen)
+{
+  gssize rc;
+
+  while ((rc = log_transport_read(t, buf, buflen, NULL)) < 0 && errno == EAGAIN)
+    {
+      struct pollfd pfd = { .fd = log_transport_get_poll_fd(t), .events = POLLIN };
+      cr_assert(poll(&pfd, 1, 5000) == 1, "timed out waiting for io_uring completion");
+    }
+  return rc;
+}
+
+Test(transport_io_uring, test_data_is_received_through_the_ring)
+{
+  LogTransport *t = _construct_transport();
+  gchar buf[64] = {0};
+
+  cr_assert_neq(log_transport_get_poll_fd(t), sv[0], "the ring should be polled, not the socket");
+
+  cr_assert(write(sv[1], "hello world", 11) == 11);
+  gssize rc = _read_with_poll(t, buf, sizeof(buf));
+  cr_assert_eq(rc, 11, "unexpected rc = %zd", rc);
+  cr_assert_str_eq(buf, "hello world");
+
+  close(sv[1]);
+  sv[1] = -1;
+  rc = _read_with_poll(t, buf, sizeof(buf));
+  cr_assert_eq(rc, 0, "EOF expected, rc = %zd", rc);
+
+  log_transport_free(t);
+}
+
+Test(transport_io_uring, test_partially_consumed_completions_are_kept)
+{
+  LogTransport *t = _construct_transport();
+  gchar buf[8] = {0};
+  GIOCondition cond;
+
+  cr_assert(write(sv[1], "0123456789", 10) == 10);
+  gssize rc = _read_with_poll(t, buf, 4);
+  cr_assert_eq(rc, 4, "unexpected rc = %zd", rc);
+  cr_assert(strncmp(buf, "0123", 4) == 0);
+
+  cr_assert(log_transport_poll_prepare(t, &cond), "the rest of the data should be readable without polling");
+
+  memset(buf, 0, sizeof(buf));
+  rc = log_transport_read(t, buf, sizeof(buf), NULL);
+  cr_assert_eq(rc, 6, "unexpected rc = %zd", rc);
+  cr_assert(strncmp(buf, "456789", 6) == 0);
+
+  log_transport_free(t);
+}
+
+Test(transport_io_uring, test_ring_becomes_readable_before_the_first_read)
+{
+  LogTransport *t = _construct_transport();
+  gchar buf[64] = {0};
+
+  cr_assert(write(sv[1], "hello", 5) == 5);
+
+  struct pollfd pfd = { .fd = log_transport_get_poll_fd(t), .events = POLLIN };
+  cr_assert(poll(&pfd, 1, 5000) == 1, "the ring should become readable without a read() arming it");
+
+  gssize rc = log_transport_read(t, buf, sizeof(buf), NULL);
+  cr_assert_eq(rc, 5, "unexpected rc = %zd", rc);
+  cr_assert_str_eq(buf, "hello");
+
+  log_transport_free(t);
+}
+
+Test(transport_io_uring, test_ring_becomes_readable_after_a_read_filling_the_buffer)
+{
+  LogTransport *t = _construct_transport();
+  gchar buf[8] = {0};
+
+  cr_assert(write(sv[1], "0123", 4) == 4);
+  gssize rc = _read_with_poll(t, buf, 4);
+  cr_assert_eq(rc, 4, "unexpected rc = %zd", rc);
+
+  cr_assert(write(sv[1], "4567", 4) == 4);
+  struct pollfd pfd = { .fd = log_transport_get_poll_fd(t), .events = POLLIN };
+  cr_assert(poll(&pfd, 1, 5000) == 1, "the receive request should be rearmed after its completion");
+
+  memset(buf, 0, sizeof(buf));
+  rc = log_transport_read(t, buf, sizeof(buf), NULL);
+  cr_assert_eq(rc, 4, "unexpected rc = %zd", rc);
+  cr_assert(strncmp(buf, "4567", 4) == 0);
+
+  log_transport_free(t);
+}
+
+static gpointer
+_construct_transport_in_thread(gpointer user_data)
+{
+  return log_transport_io_uring_stream_socket_new(sv[0]);
+}
+
+Test(transport_io_uring, test_request_of_an_exited_thread_is_rearmed)
+{
+  /* the receive request is submitted by a thread that exits, just like an
+   * idle worker thread, which cancels the request */
+  GThread *thread = g_thread_new("io-uring-test", _construct_transport_in_thread, NULL);
+  LogTransport *t = g_thread_join(thread);
+  gchar buf[64] = {0};
+
+  if (!t)
+    cr_skip_test("io_uring is not supported by this build or kernel");
+
+  cr_assert(write(sv[1], "hello", 5) == 5);
+  gssize rc = _read_with_poll(t, buf, sizeof(buf));
+  cr_assert_eq(rc, 5, "unexpected rc = %zd, errno = %d", rc, errno);
+  cr_assert_str_eq(buf, "hello");
+
+  log_transport_free(t);
+}
+
+static void
+setup(void)
+{
+  app_startup();
+  cr_assert(socketpair(AF_UNIX, SOCK_STREAM, 0, sv) == 0);
+}
+
+static void
+teardown(void)
+{
+  /* the transport does not close its fd */
+  if (sv[1] >= 0)
+    close(sv[1]);
+  close(sv[0]);
+  app_shutdown();
+}
+
+TestSuite(transport_io_uring, .init = setup, .fini = teardown);
@@ -26,6 +26,8 @@
 #include "compat/openssl_support.h"
 #include "secret-storage/secret-storage.h"
 #include "string-list.h"
+#include "stats/stats-cluster-single.h"
+#include "stats/stats-cluster-key-builder.h"
 
 #include <sys/socket.h>
 #include <arpa/inet.h>
@@ -152,9 +154,55 @@ _setup_keylog_file(TLSContext *self)
 static void
 tls_context_setup_session_tickets(TLSContext *self)
 {
+  /* session-tickets(yes) lifts the TLS 1.3 workaround below, at the
+   * expense of exposing one-way connections to the data loss it avoids */
+  if (self->session_tickets)
+    return;
+
   openssl_ctx_setup_session_tickets(self->ssl_ctx);
 }
 
+static int
+_client_session_new_cb(SSL *ssl, SSL_SESSION *session)
+{
+  TLSSession *tls_session = (TLSSession *) SSL_get_app_data(ssl);
+
+  if (!tls_session || !tls_session->peer)
+    return 0;
+
+  /* returning 1 means we have taken over the reference to @session */
+  tls_context_store_client_session(tls_session->ctx, tls_session->peer, session);
+  return 1;
+}
+
+static void
+tls_context_setup_session_cache(TLSContext *self)
+{
+  if (self->session_timeout > 0)
+    SSL_CTX_set_timeout(self->ssl_ctx, self->session_timeout);
+
+  if (self->mode == TM_CLIENT)
+    {
+      if (self->session_cache_size == 0)
+        return;
+
+      /* sessions are stored per peer in client_sessions, see
+       * tls_context_store_client_session() */
+      SSL_CTX_set_session_cache_mode(self->ssl_ctx, SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+      SSL_CTX_sess_set_new_cb(self->ssl_ctx, _client_session_new_cb);
+      return;
+    }
+
+  if (self->session_cache_size == 0)
+    {
+      /* session tickets would still resume sessions without the cache */
+      SSL_CTX_set_session_cache_mode(self->ssl_ctx, SSL_SESS_CACHE_OFF);
+      SSL_CTX_set_options(self->ssl_ctx, SSL_OP_NO_TICKET);
+    }
+  else if (self->session_cache_size > 0)
+    SSL_CTX_sess_set_cache_size(self->ssl_ctx, self->session_cache_size);
+}
+
 static void
 tls_context_setup_verify_mode(TLSContext *self)
 {
@@ -319,6 +367,21 @@ tls_context_setup_compression(TLSContext *self)
   return TRUE;
 }
 
+static void
+tls_context_setup_ktls(TLSContext *self)
+{
+  if (!self->ktls)
+    return;
+
+#ifdef SSL_OP_ENABLE_KTLS
+  SSL_CTX_set_options(self->ssl_ctx, SSL_OP_ENABLE_KTLS);
+#else
+  msg_warning("WARNING: tls(ktls(yes)) was specified, but the OpenSSL version syslog-ng was compiled with "
+              "does not support kernel TLS offload, falling back to userspace TLS",
+              tls_context_format_location_tag(self));
+#endif
+}
+
 static gboolean
 tls_context_setup_sigalgs(TLSContext *self)
 {
@@ -604,6 +667,7 @@ tls_context_setup_context(TLSContext *self)
 
   if (self->mode == TM_SERVER)
     tls_context_setup_session_tickets(self);
+  tls_context_setup_session_cache(self);
 
   tls_context_setup_verify_mode(self);
   tls_context_setup_ocsp_stapling(self);
@@ -622,6 +686,8 @@ tls_context_setup_context(TLSContext *self)
   if (!tls_context_setup_compression(self))
     goto error;
 
+  tls_context_setup_ktls(self);
+
   if (!tls_context_setup_sigalgs(self))
     goto error;
 
@@ -644,6 +710,89 @@ password_error:
   return TLS_CONTEXT_SETUP_BAD_PASSWORD;
 }
 
+/* returns a new reference to the last session negotiated with @peer, if any */
+SSL_SESSION *
+tls_context_lookup_client_session(TLSContext *self, const gchar *peer)
+{
+  SSL_SESSION *session;
+
+  if (!self->client_sessions.sessions)
+    return NULL;
+
+  g_mutex_lock(&self->client_sessions.lock);
+  session = g_hash_table_lookup(self->client_sessions.sessions, peer);
+  if (session)
+    SSL_SESSION_up_ref(session);
+  g_mutex_unlock(&self->client_sessions.lock);
+
+  return session;
+}
+
+/* takes over the reference to @session */
+void
+tls_context_store_client_session(TLSContext *self, const gchar *peer, SSL_SESSION *session)
+{
+  if (!self->client_sessions.sessions)
+    {
+      SSL_SESSION_free(session);
+      return;
+    }
+
+  g_mutex_lock(&self->client_sessions.lock);
+  g_hash_table_insert(self->client_sessions.sessions, g_strdup(peer), session);
+  g_mutex_unlock(&self->client_sessions.lock);
+}
+
+static StatsClusterKey *
+_build_handshake_stats_key(StatsClusterKeyBuilder *kb, const gchar *type)
+{
+  StatsClusterKey *sc_key;
+
+  stats_cluster_key_builder_push(kb);
+  stats_cluster_key_builder_set_name(kb, "tls_handshakes_total");
+  stats_cluster_key_builder_add_label(kb, stats_cluster_label("type", type));
+  sc_key = stats_cluster_key_builder_build_single(kb);
+  stats_cluster_key_builder_pop(kb);
+
+  return sc_key;
+}
+
+void
+tls_context_register_stats(TLSContext *self, gint level, StatsClusterKeyBuilder *kb)
+{
+  StatsClusterKey *full_key = _build_handshake_stats_key(kb, "full");
+  StatsClusterKey *resumed_key = _build_handshake_stats_key(kb, "resumed");
+
+  stats_lock();
+  stats_register_counter(level, full_key, SC_TYPE_SINGLE_VALUE, &self->metrics.handshakes_full);
+  stats_register_counter(level, resumed_key, SC_TYPE_SINGLE_VALUE, &self->metrics.handshakes_resumed);
+  stats_unlock();
+
+  stats_cluster_key_free(full_key);
+  stats_cluster_key_free(resumed_key);
+}
+
+void
+tls_context_unregister_stats(TLSContext *self, StatsClusterKeyBuilder *kb)
+{
+  StatsClusterKey *full_key = _build_handshake_stats_key(kb, "full");
+  StatsClusterKey *resumed_key = _build_handshake_stats_key(kb, "resumed");
+
+  stats_lock();
+  stats_unregister_counter(full_key, SC_TYPE_SINGLE_VALUE, &self->metrics.handshakes_full);
+  stats_unregister_counter(resumed_key, SC_TYPE_SINGLE_VALUE, &self->metrics.handshakes_resumed);
+  stats_unlock();
+
+  stats_cluster_key_free(full_key);
+  stats_cluster_key_free(resumed_key);
+}
+
+void
+tls_context_count_handshake(TLSContext *self, gboolean resumed)
+{
+  stats_counter_inc(resumed ? self->metrics.handshakes_resumed : self->metrics.handshakes_full);
+}
+
 TLSSession *
 tls_context_setup_session(TLSContext *self)
 {
@@ -883,6 +1032,30 @@ tls_context_set_allow_compress(TLSContext *self, gboolean allow_compress)
   self->allow_compress = allow_compress;
 }
 
+void
+tls_context_set_ktls(TLSContext *self, gboolean ktls)
+{
+  self->ktls = ktls;
+}
+
+void
+tls_context_set_session_cache_size(TLSContext *self, gint session_cache_size)
+{
+  self->session_cache_size = session_cache_size;
+}
+
+void
+tls_context_set_session_timeout(TLSContext *self, gint session_timeout)
+{
+  self->session_timeout = session_timeout;
+}
+
+void
+tls_context_set_session_tickets(TLSContext *self, gboolean session_tickets)
+{
+  self->session_tickets = session_tickets;
+}
+
 gboolean
 tls_context_set_tls13_cipher_suite(TLSContext *self, const gchar *tls13_cipher_suite, GError **error)
 {
@@ -984,8 +1157,15 @@ tls_context_new(TLSMode mode, const gchar *location)
   self->ssl_options = TSO_NOSSLv2;
   self->location = g_strdup(location ? : "n/a");
 
+  self->session_cache_size = -1;
+
   if (self->mode == TM_CLIENT)
-    self->ssl_ctx = SSL_CTX_new(SSLv23_client_method());
+    {
+      self->ssl_ctx = SSL_CTX_new(SSLv23_client_method());
+      g_mutex_init(&self->client_sessions.lock);
+      self->client_sessions.sessions = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+                                                             (GDestroyNotify) SSL_SESSION_free);
+    }
   else
     {
       self->ssl_ctx = SSL_CTX_new(SSLv23_server_method());
@@ -1022,6 +1202,12 @@ _tls_context_free(TLSContext *self)
   if (self->keylog_file)
     fclose(self->keylog_file);
 
+  if (self->client_sessions.sessions)
+    {
+      g_hash_table_unref(self->client_sessions.sessions);
+      g_mutex_clear(&self->client_sessions.lock);
+    }
+
   g_free(self);
 }
 
@@ -26,6 +26,8 @@
 
 #include "transport/tls-verifier.h"
 #include "transport/tls-session.h"
+#include "stats/stats-registry.h"
+#include "stats/stats-cluster-key-builder.h"
 #include "messages.h"
 
 typedef enum
@@ -92,6 +94,23 @@ struct _TLSContext
   gboolean ocsp_stapling_verify;
   gboolean extended_key_usage_verify;
   gboolean allow_compress;
+  gboolean ktls;
+  gint session_cache_size;
+  gint session_timeout;
+  gboolean session_tickets;
+
+  /* client side: the last resumable session per peer */
+  struct
+  {
+    GMutex lock;
+    GHashTable *sessions;
+  } client_sessions;
+
+  struct
+  {
+    StatsCounterItem *handshakes_full;
+    StatsCounterItem *handshakes_resumed;
+  } metrics;
 
   SSL_CTX *ssl_ctx;
   GList *conf_cmds_list;
@@ -129,6 +148,10 @@ void tls_context_set_crl_dir(TLSContext *self, const gchar *crl_dir);
 void tls_context_set_ca_file(TLSContext *self, const gchar *ca_file);
 void tls_context_set_cipher_suite(TLSContext *self, const gchar *cipher_suite);
 void tls_context_set_allow_compress(TLSContext *self, gboolean allow);
+void tls_context_set_ktls(TLSContext *self, gboolean ktls);
+void tls_context_set_session_cache_size(TLSContext *self, gint session_cache_size);
+void tls_context_set_session_timeout(TLSContext *self, gint session_timeout);
+void tls_context_set_session_tickets(TLSContext *self, gboolean session_tickets);
 gboolean tls_context_set_tls13_cipher_suite(TLSContext *self, const gchar *tls13_cipher_suite, GError **error);
 gboolean tls_context_set_sigalgs(TLSContext *self, const gchar *sigalgs, GError **error);
 gboolean tls_context_set_client_sigalgs(TLSContext *self, const gchar *sigalgs, GError **error);
@@ -144,6 +167,13 @@ EVTTAG *tls_context_format_location_tag(TLSContext *self);
 gboolean tls_context_verify_peer(TLSContext *self, X509 *peer_cert, const gchar *peer_name);
 TLSContextSetupResult tls_context_setup_context(TLSContext *self);
 TLSSession *tls_context_setup_session(TLSContext *self);
+
+SSL_SESSION *tls_context_lookup_client_session(TLSContext *self, const gchar *peer);
+void tls_context_store_client_session(TLSContext *self, const gchar *peer, SSL_SESSION *session);
+
+void tls_context_register_stats(TLSContext *self, gint level, StatsClusterKeyBuilder *kb);
+void tls_context_unregister_stats(TLSContext *self, StatsClusterKeyBuilder *kb);
+void tls_context_count_handshake(TLSContext *self, gboolean resumed);
 TLSContext *tls_context_new(TLSMode mode, const gchar *config_location);
 TLSContext *tls_context_ref(TLSContext *self);
 void tls_context_unref(TLSContext *self);
@@ -556,6 +556,24 @@ tls_session_info_callback(const SSL *ssl, int where, int ret)
           X509_free(cert);
         }
     }
+
+  /* with TLS 1.3 this is also signalled after post-handshake messages
+   * (e.g. session tickets), only the first one counts */
+  if ((where & SSL_CB_HANDSHAKE_DONE) && !self->handshake_done)
+    {
+      self->handshake_done = TRUE;
+      tls_context_count_handshake(self->ctx, SSL_session_reused((SSL *) ssl));
+
+#if defined(SSL_OP_ENABLE_KTLS) && defined(BIO_get_ktls_send) && defined(BIO_get_ktls_recv)
+      if (self->ctx->ktls)
+        {
+          msg_debug("TLS handshake finished, kernel TLS offload status",
+                    evt_tag_str("send", BIO_get_ktls_send(SSL_get_wbio(ssl)) ? "enabled" : "disabled"),
+                    evt_tag_str("recv", BIO_get_ktls_recv(SSL_get_rbio(ssl)) ? "enabled" : "disabled"),
+                    tls_context_format_location_tag(self->ctx));
+        }
+#endif
+    }
 }
 
 static gboolean
@@ -600,9 +618,26 @@ tls_session_new(SSL *ssl, TLSContext *ctx)
   return self;
 }
 
+/* offer the session last negotiated with @peer for resumption, new
+ * sessions are then stored under the same name */
+void
+tls_session_set_peer(TLSSession *self, const gchar *peer)
+{
+  g_free(self->peer);
+  self->peer = g_strdup(peer);
+
+  SSL_SESSION *session = tls_context_lookup_client_session(self->ctx, peer);
+  if (session)
+    {
+      SSL_set_session(self->ssl, session);
+      SSL_SESSION_free(session);
+    }
+}
+
 void
 tls_session_free(TLSSession *self)
 {
+  g_free(self->peer);
   tls_context_unref(self->ctx);
   if (self->verifier)
     tls_verifier_unref(self->verifier);
@@ -36,6 +36,9 @@ typedef struct _TLSSession
   SSL *ssl;
   TLSContext *ctx;
   TLSVerifier *verifier;
+  /* client side: identifies the server for session resumption */
+  gchar *peer;
+  gboolean handshake_done;
   struct
   {
     int found;
@@ -49,6 +52,7 @@ typedef struct _TLSSession
 void tls_session_set_trusted_fingerprints(TLSContext *self, GList *fingerprints);
 void tls_session_set_trusted_dn(TLSContext *self, GList *dns);
 void tls_session_set_verifier(TLSSession *self, TLSVerifier *verifier);
+void tls_session_set_peer(TLSSession *self, const gchar *peer);
 
 int tls_session_verify_callback(int ok, X509_STORE_CTX *ctx);
 int tls_session_ocsp_client_verify_callback(SSL *ssl, void *user_data);
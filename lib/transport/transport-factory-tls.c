@@ -26,6 +26,16 @@
 #include "transport/transport-factory-tls.h"
 #include "transport/transport-tls.h"
 
+/* kTLS needs OpenSSL to talk to the socket directly, which we can only do
+ * if nothing was read ahead from it (e.g. while detecting the protocol) */
+static gboolean
+_socket_has_buffered_data(LogTransportStack *stack)
+{
+  LogTransport *base = log_transport_stack_get_transport(stack, LOG_TRANSPORT_SOCKET);
+
+  return base && base->ra.buf_len != base->ra.pos;
+}
+
 static LogTransport *
 _construct_transport(const LogTransportFactory *s, LogTransportStack *stack)
 {
@@ -36,8 +46,13 @@ _construct_transport(const LogTransportFactory *s, LogTransportStack *stack)
     return NULL;
 
   tls_session_set_verifier(tls_session, self->tls_verifier);
+  if (self->peer)
+    tls_session_set_peer(tls_session, self->peer);
 
-  return log_transport_tls_new(tls_session, LOG_TRANSPORT_SOCKET);
+  LogTransport *transport = log_transport_tls_new(tls_session, LOG_TRANSPORT_SOCKET);
+  if (self->tls_context->ktls && !_socket_has_buffered_data(stack))
+    log_transport_tls_use_socket_bio(transport, stack->fd);
+  return transport;
 }
 
 static void
@@ -47,6 +62,16 @@ _free(LogTransportFactory *s)
   tls_context_unref(self->tls_context);
   if (self->tls_verifier)
     tls_verifier_unref(self->tls_verifier);
+  g_free(self->peer);
+}
+
+void
+transport_factory_tls_set_peer(LogTransportFactory *s, const gchar *peer)
+{
+  LogTransportFactoryTLS *self = (LogTransportFactoryTLS *)s;
+
+  g_free(self->peer);
+  self->peer = g_strdup(peer);
 }
 
 LogTransportFactory *
@@ -35,8 +35,10 @@ struct _LogTransportFactoryTLS
   LogTransportFactory super;
   TLSContext *tls_context;
   TLSVerifier *tls_verifier;
+  gchar *peer;
 };
 
 LogTransportFactory *transport_factory_tls_new(TLSContext *ctx, TLSVerifier *tls_verifier);
+void transport_factory_tls_set_peer(LogTransportFactory *s, const gchar *peer);
 
 #endif
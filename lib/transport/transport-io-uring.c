@@ -0,0 +1,332 @@
+/*
+ * Copyright (c) 2026 Axoflow
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+#include "transport/transport-io-uring.h"
+
+#if SYSLOG_NG_ENABLE_IO_URING
+
+#include "transport/transport-socket.h"
+#include "messages.h"
+
+#include <liburing.h>
+#include <errno.h>
+#include <string.h>
+
+/* a single recv request is outstanding at any time */
+#define IO_URING_QUEUE_DEPTH 4
+/* must be a power of 2 */
+#define IO_URING_BUFFER_COUNT 8
+#define IO_URING_BUFFER_SIZE 8192
+#define IO_URING_BUFFER_GROUP 0
+
+/* every connection has a ring of its own, with IO_URING_BUFFER_COUNT *
+ * IO_URING_BUFFER_SIZE bytes (64KiB) of buffers and the SQ/CQ rings mapped
+ * next to it (which count against RLIMIT_MEMLOCK on older kernels), so the
+ * number of rings is capped, connections above that use the plain socket
+ * transport */
+#define IO_URING_MAX_RINGS 1024
+
+static gint active_rings;
+
+typedef struct _LogTransportIOUring
+{
+  LogTransportSocket super;
+  struct io_uring ring;
+  struct io_uring_buf_ring *buf_ring;
+  gchar *buffers;
+  gboolean multishot;
+  gboolean armed;
+
+  /* the completion at the head of the CQ is only marked as seen once all
+   * of its data has been copied out, this is how far we got with it */
+  gsize consumed;
+} LogTransportIOUring;
+
+static gboolean
+_arm_receive(LogTransportIOUring *self)
+{
+  struct io_uring_sqe *sqe = io_uring_get_sqe(&self->ring);
+
+  g_assert(sqe);
+  if (self->multishot)
+    io_uring_prep_recv_multishot(sqe, self->super.super.fd, NULL, 0, 0);
+  else
+    io_uring_prep_recv(sqe, self->super.super.fd, NULL, IO_URING_BUFFER_SIZE, 0);
+  sqe->flags |= IOSQE_BUFFER_SELECT;
+  sqe->buf_group = IO_URING_BUFFER_GROUP;
+
+  gint rc = io_uring_submit(&self->ring);
+  if (rc < 0)
+    {
+      errno = -rc;
+      return FALSE;
+    }
+  self->armed = TRUE;
+  return TRUE;
+}
+
+static void
+_recycle_buffer(LogTransportIOUring *self, guint16 bid)
+{
+  io_uring_buf_ring_add(self->buf_ring, self->buffers + bid * IO_URING_BUFFER_SIZE, IO_URING_BUFFER_SIZE, bid,
+                        io_uring_buf_ring_mask(IO_URING_BUFFER_COUNT), 0);
+  io_uring_buf_ring_advance(self->buf_ring, 1);
+}
+
+static void
+_complete_cqe(LogTransportIOUring *self, struct io_uring_cqe *cqe)
+{
+  gboolean more = (cqe->flags & IORING_CQE_F_MORE);
+  gint res = cqe->res;
+
+  if (cqe->flags & IORING_CQE_F_BUFFER)
+    _recycle_buffer(self, cqe->flags >> IORING_CQE_BUFFER_SHIFT);
+
+  io_uring_cqe_seen(&self->ring, cqe);
+  self->consumed = 0;
+
+  if (more)
+    return;
+
+  /* the request is not going to produce more completions, it has to be
+   * resubmitted right away, as the ring fd is only going to be readable
+   * once it completes.  EOF and errors are handled by the caller. */
+  self->armed = FALSE;
+  if (res > 0 && !_arm_receive(self))
+    msg_debug("io_uring: error rearming receive request, retrying on the next read",
+              evt_tag_int("fd", self->super.super.fd),
+              evt_tag_error(EVT_TAG_OSERROR));
+}
+
+/* returns TRUE if the error was handled by rearming the request */
+static gboolean
+_handle_recv_error(LogTransportIOUring *self, gint error)
+{
+  switch (error)
+    {
+    case ENOBUFS:
+      /* all buffers were in use, they have been recycled by now */
+      return TRUE;
+    case EINVAL:
+      if (!self->multishot)
+        return FALSE;
+
+      msg_debug("io_uring: multishot receive is not supported by the kernel, using single-shot requests",
+                evt_tag_int("fd", self->super.super.fd));
+      self->multishot = FALSE;
+      return TRUE;
+    case ECANCELED:
+      /* the request is owned by the thread that submitted it and is
+       * cancelled when that thread exits, which happens to the idle
+       * threads of the I/O worker pool */
+      msg_debug("io_uring: receive request was cancelled, rearming it",
+                evt_tag_int("fd", self->super.super.fd));
+      return TRUE;
+    case EINTR:
+    case EAGAIN:
+      return TRUE;
+    default:
+      return FALSE;
+    }
+}
+
+static gssize
+log_transport_io_uring_read_method(LogTransport *s, gpointer buf, gsize buflen, LogTransportAuxData *aux)
+{
+  LogTransportIOUring *self = (LogTransportIOUring *) s;
+  struct io_uring_cqe *cqe;
+  gsize copied = 0;
+
+  while (copied < buflen)
+    {
+      if (!self->armed && !_arm_receive(self))
+        break;
+
+      gint rc = io_uring_peek_cqe(&self->ring, &cqe);
+      if (rc == -EAGAIN)
+        {
+          if (copied == 0)
+            errno = EAGAIN;
+          break;
+        }
+      if (rc < 0)
+        {
+          errno = -rc;
+          break;
+        }
+
+      if (cqe->res <= 0)
+        {
+          /* report EOF and errors on their own, the next read() will get them */
+          if (copied > 0)
+            break;
+
+          gint res = cqe->res;
+          _complete_cqe(self, cqe);
+
+          if (res == 0)
+            return 0;
+          if (_handle_recv_error(self, -res))
+            continue;
+          errno = -res;
+          return -1;
+        }
+
+      const gchar *data = self->buffers + (cqe->flags >> IORING_CQE_BUFFER_SHIFT) * IO_URING_BUFFER_SIZE;
+      gsize len = MIN(cqe->res - self->consumed, buflen - copied);
+
+      memcpy((gchar *) buf + copied, data + self->consumed, len);
+      copied += len;
+      self->consumed += len;
+
+      if (self->consumed == cqe->res)
+        _complete_cqe(self, cqe);
+    }
+
+  if (copied == 0)
+    return -1;
+
+  if (aux)
+    aux->proto = self->super.proto;
+  return copied;
+}
+
+static gint
+log_transport_io_uring_get_poll_fd_method(LogTransport *s)
+{
+  LogTransportIOUring *self = (LogTransportIOUring *) s;
+
+  return self->ring.ring_fd;
+}
+
+static gboolean
+log_transport_io_uring_has_buffered_data_method(LogTransport *s)
+{
+  LogTransportIOUring *self = (LogTransportIOUring *) s;
+
+  return io_uring_cq_ready(&self->ring) > 0;
+}
+
+static void
+log_transport_io_uring_free_method(LogTransport *s)
+{
+  LogTransportIOUring *self = (LogTransportIOUring *) s;
+
+  io_uring_free_buf_ring(&self->ring, self->buf_ring, IO_URING_BUFFER_COUNT, IO_URING_BUFFER_GROUP);
+  io_uring_queue_exit(&self->ring);
+  g_free(self->buffers);
+  g_atomic_int_add(&active_rings, -1);
+  log_transport_free_method(s);
+}
+
+static gboolean
+_setup_ring(LogTransportIOUring *self)
+{
+  /* let completions be posted when we look for them instead of
+   * interrupting the thread, peeking the CQ flushes them if needed */
+  gint rc = io_uring_queue_init(IO_URING_QUEUE_DEPTH, &self->ring,
+                                IORING_SETUP_COOP_TASKRUN | IORING_SETUP_TASKRUN_FLAG);
+  if (rc == -EINVAL)
+    rc = io_uring_queue_init(IO_URING_QUEUE_DEPTH, &self->ring, 0);
+  if (rc < 0)
+    {
+      msg_warning_once("WARNING: io_uring is not available, falling back to the plain socket transport",
+                       evt_tag_errno(EVT_TAG_OSERROR, -rc));
+      return FALSE;
+    }
+
+  self->buf_ring = io_uring_setup_buf_ring(&self->ring, IO_URING_BUFFER_COUNT, IO_URING_BUFFER_GROUP, 0, &rc);
+  if (!self->buf_ring)
+    {
+      msg_warning_once("WARNING: the kernel does not support io_uring provided buffer rings, falling back to the plain socket transport",
+                       evt_tag_errno(EVT_TAG_OSERROR, -rc));
+      io_uring_queue_exit(&self->ring);
+      return FALSE;
+    }
+
+  self->buffers = g_malloc(IO_URING_BUFFER_COUNT * IO_URING_BUFFER_SIZE);
+  for (guint16 bid = 0; bid < IO_URING_BUFFER_COUNT; bid++)
+    io_uring_buf_ring_add(self->buf_ring, self->buffers + bid * IO_URING_BUFFER_SIZE, IO_URING_BUFFER_SIZE, bid,
+                          io_uring_buf_ring_mask(IO_URING_BUFFER_COUNT), bid);
+  io_uring_buf_ring_advance(self->buf_ring, IO_URING_BUFFER_COUNT);
+  return TRUE;
+}
+
+static gboolean
+_reserve_ring(void)
+{
+  if (g_atomic_int_add(&active_rings, 1) < IO_URING_MAX_RINGS)
+    return TRUE;
+
+  g_atomic_int_add(&active_rings, -1);
+  msg_warning_once("WARNING: the number of io_uring rings reached its limit, using the plain socket transport "
+                   "for further connections",
+                   evt_tag_int("max_rings", IO_URING_MAX_RINGS));
+  return FALSE;
+}
+
+LogTransport *
+log_transport_io_uring_stream_socket_new(gint fd)
+{
+  if (!_reserve_ring())
+    return NULL;
+
+  LogTransportIOUring *self = g_new0(LogTransportIOUring, 1);
+
+  if (!_setup_ring(self))
+    {
+      g_atomic_int_add(&active_rings, -1);
+      g_free(self);
+      return NULL;
+    }
+
+  log_transport_stream_socket_init_instance(&self->super, fd);
+  self->super.super.name = "io-uring-stream-socket";
+  self->super.super.read = log_transport_io_uring_read_method;
+  self->super.super.get_poll_fd = log_transport_io_uring_get_poll_fd_method;
+  self->super.super.has_buffered_data = log_transport_io_uring_has_buffered_data_method;
+  self->super.super.free_fn = log_transport_io_uring_free_method;
+  self->multishot = TRUE;
+
+  /* the request is armed before the ring fd is first polled, otherwise it
+   * would never become readable */
+  if (!_arm_receive(self))
+    {
+      msg_warning("WARNING: error submitting io_uring receive request, falling back to the plain socket transport",
+                  evt_tag_int("fd", fd),
+                  evt_tag_error(EVT_TAG_OSERROR));
+      log_transport_free(&self->super.super);
+      return NULL;
+    }
+
+  return &self->super.super;
+}
+
+#else
+
+LogTransport *
+log_transport_io_uring_stream_socket_new(gint fd)
+{
+  return NULL;
+}
+
+#endif
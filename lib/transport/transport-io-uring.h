@@ -0,0 +1,45 @@
+/*
+ * Copyright (c) 2026 Axoflow
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+#ifndef TRANSPORT_IO_URING_H_INCLUDED
+#define TRANSPORT_IO_URING_H_INCLUDED
+
+#include "transport/logtransport.h"
+
+/*
+ * A stream socket transport that receives data using io_uring: a
+ * multishot recv request is kept armed on the socket, the kernel picks
+ * buffers from a ring of provided buffers and reports completions, which
+ * read() reaps without entering the kernel.  Writes are done using
+ * send()/writev() on the socket, just like the plain stream transport.
+ *
+ * Each connection has a ring of its own with 64KiB of receive buffers, the
+ * number of rings is capped at 1024 per process.
+ *
+ * Returns NULL if syslog-ng was compiled without io_uring support, if the
+ * running kernel lacks the required features or if the cap is reached, the
+ * caller is expected to fall back to log_transport_stream_socket_new() in
+ * that case.
+ */
+LogTransport *log_transport_io_uring_stream_socket_new(gint fd);
+
+#endif
@@ -233,6 +233,57 @@ log_transport_dgram_socket_read_method(LogTransport *s, gpointer buf, gsize bufl
   return rc;
 }
 
+#if SYSLOG_NG_HAVE_RECVMMSG
+
+#define LOG_TRANSPORT_SOCKET_MAX_READ_BATCH 64
+
+static gint
+log_transport_dgram_socket_read_batch_method(LogTransport *s, LogTransportDatagram *datagrams, gint count)
+{
+  LogTransportSocket *self = (LogTransportSocket *) s;
+  gint rc;
+
+  count = MIN(count, LOG_TRANSPORT_SOCKET_MAX_READ_BATCH);
+
+  struct mmsghdr msgs[count];
+  struct iovec iov[count];
+  struct sockaddr_storage ss[count];
+#if SYSLOG_NG_HAVE_CTRLBUF_IN_MSGHDR
+  gchar ctlbuf[count][256];
+#endif
+
+  memset(msgs, 0, sizeof(msgs));
+  for (gint i = 0; i < count; i++)
+    {
+      iov[i].iov_base = datagrams[i].buf;
+      iov[i].iov_len = datagrams[i].buflen;
+      msgs[i].msg_hdr.msg_iov = &iov[i];
+      msgs[i].msg_hdr.msg_iovlen = 1;
+      msgs[i].msg_hdr.msg_name = (struct sockaddr *) &ss[i];
+      msgs[i].msg_hdr.msg_namelen = sizeof(ss[i]);
+#if SYSLOG_NG_HAVE_CTRLBUF_IN_MSGHDR
+      msgs[i].msg_hdr.msg_control = ctlbuf[i];
+      msgs[i].msg_hdr.msg_controllen = sizeof(ctlbuf[i]);
+#endif
+    }
+
+  do
+    {
+      rc = recvmmsg(self->super.fd, msgs, count, 0, NULL);
+    }
+  while (rc == -1 && errno == EINTR);
+
+  for (gint i = 0; i < rc; i++)
+    {
+      datagrams[i].len = msgs[i].msg_len;
+      _extract_from_msghdr_method(self, &msgs[i].msg_hdr, &datagrams[i].aux);
+    }
+
+  return rc;
+}
+
+#endif
+
 static gssize
 log_transport_dgram_socket_write_method(LogTransport *s, const gpointer buf, gsize buflen)
 {
@@ -260,6 +311,9 @@ log_transport_dgram_socket_init_instance(LogTransportSocket *self, gint fd)
   log_transport_socket_init_instance(self, "dgram-socket", fd);
   self->super.read = log_transport_dgram_socket_read_method;
   self->super.write = log_transport_dgram_socket_write_method;
+#if SYSLOG_NG_HAVE_RECVMMSG
+  self->super.read_batch = log_transport_dgram_socket_read_batch_method;
+#endif
 }
 
 LogTransport *
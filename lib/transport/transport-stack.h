@@ -155,6 +155,15 @@ log_transport_stack_poll_prepare(LogTransportStack *self, GIOCondition *cond)
   return log_transport_poll_prepare(transport, cond);
 }
 
+/* the fd to poll, this may differ from @fd if the active transport is not
+ * readiness based (e.g. io_uring) */
+static inline gint
+log_transport_stack_get_poll_fd(LogTransportStack *self)
+{
+  LogTransport *transport = log_transport_stack_get_active(self);
+  return log_transport_get_poll_fd(transport);
+}
+
 static inline LogTransportIOCond
 log_transport_stack_get_io_requirement(LogTransportStack *self)
 {
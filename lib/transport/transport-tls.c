@@ -384,6 +384,20 @@ log_transport_tls_new(TLSSession *tls_session, LogTransportIndex base)
   return &self->super.super;
 }
 
+/* Replace our LogTransport based BIO with a plain socket BIO.  This makes
+ * it possible for OpenSSL to push the session keys into the kernel once
+ * the handshake is finished (kTLS), after which SSL_read()/SSL_write() map
+ * to plain read()/write() calls on @fd.  The caller must make sure that
+ * the base transport has no data buffered, as that would be bypassed from
+ * now on. */
+void
+log_transport_tls_use_socket_bio(LogTransport *s, gint fd)
+{
+  LogTransportTLS *self = (LogTransportTLS *) s;
+
+  SSL_set_fd(self->tls_session->ssl, fd);
+}
+
 static void
 log_transport_tls_free_method(LogTransport *s)
 {
@@ -29,6 +29,7 @@
 
 LogTransport *log_transport_tls_new(TLSSession *tls_session, LogTransportIndex base_index);
 TLSSession *log_tansport_tls_get_session(LogTransport *s);
+void log_transport_tls_use_socket_bio(LogTransport *s, gint fd);
 
 void log_transport_tls_global_init(void);
 void log_transport_tls_global_deinit(void);
@@ -75,14 +75,14 @@ assert_log_message_value_unset_by_name(LogMessage *self, const gchar *name)
 void
 assert_log_message_value_is_indirect(LogMessage *self, NVHandle handle)
 {
-  NVEntry *entry = nv_table_get_entry(self->payload, handle, NULL, NULL);
+  NVEntry *entry = nv_table_get_entry(log_msg_get_payload_for_handle(self, handle), handle, NULL, NULL);
   cr_assert(entry->indirect);
 }
 
 void
 assert_log_message_value_is_direct(LogMessage *self, NVHandle handle)
 {
-  NVEntry *entry = nv_table_get_entry(self->payload, handle, NULL, NULL);
+  NVEntry *entry = nv_table_get_entry(log_msg_get_payload_for_handle(self, handle), handle, NULL, NULL);
   cr_assert(!entry->indirect);
 }
 
@@ -30,6 +30,7 @@
 extern LogProtoServerOptionsStorage proto_server_options;
 
 
+LogProtoStatus proto_server_fetch(LogProtoServer *proto, const guchar **msg, gsize *msg_len);
 void assert_proto_server_handshake(LogProtoServer **proto);
 void assert_proto_server_handshake_failure(LogProtoServer **proto, LogProtoStatus expected_status);
 void assert_proto_server_status(LogProtoServer *proto, LogProtoStatus status, LogProtoStatus expected_status);
@@ -238,6 +238,9 @@ afinet_dd_setup_tls_verifier(AFInetDestDriver *self)
   TLSVerifier *verifier = tls_verifier_new(afinet_dd_verify_callback, verify_data, afinet_dd_tls_verify_data_free);
 
   transport_mapper_inet_set_tls_verifier(transport_mapper_inet, verifier);
+
+  /* reconnects to the same server resume the previous TLS session */
+  transport_mapper_inet_set_tls_peer(transport_mapper_inet, _afinet_dd_get_hostname(self));
 }
 
 static AFInetDestDriverTLSVerifyData *
@@ -402,6 +405,37 @@ _libnet_destroy_when_spoof_source_enabled(AFInetDestDriver *self)
 #endif
 }
 
+static StatsClusterKeyBuilder *
+afinet_dd_tls_stats_key_builder(AFInetDestDriver *self)
+{
+  StatsClusterKeyBuilder *kb = stats_cluster_key_builder_new();
+
+  stats_cluster_key_builder_add_label(kb, stats_cluster_label("id", self->super.super.super.id));
+  stats_cluster_key_builder_add_label(kb, stats_cluster_label("driver", "afsocket"));
+  stats_cluster_key_builder_add_label(kb, stats_cluster_label("transport", self->super.transport_mapper->transport));
+  return kb;
+}
+
+static void
+afinet_dd_register_tls_stats(AFInetDestDriver *self)
+{
+  TransportMapperInet *transport_mapper_inet = (TransportMapperInet *) self->super.transport_mapper;
+  StatsClusterKeyBuilder *kb = afinet_dd_tls_stats_key_builder(self);
+
+  tls_context_register_stats(transport_mapper_inet->tls_context, STATS_LEVEL1, kb);
+  stats_cluster_key_builder_free(kb);
+}
+
+static void
+afinet_dd_unregister_tls_stats(AFInetDestDriver *self)
+{
+  TransportMapperInet *transport_mapper_inet = (TransportMapperInet *) self->super.transport_mapper;
+  StatsClusterKeyBuilder *kb = afinet_dd_tls_stats_key_builder(self);
+
+  tls_context_unregister_stats(transport_mapper_inet->tls_context, kb);
+  stats_cluster_key_builder_free(kb);
+}
+
 static gboolean
 afinet_dd_deinit(LogPipe *s)
 {
@@ -410,6 +444,9 @@ afinet_dd_deinit(LogPipe *s)
   if (_is_failover_used(self))
     afinet_dd_failover_deinit(self->failover);
 
+  if (_is_tls_used(self))
+    afinet_dd_unregister_tls_stats(self);
+
   _libnet_destroy_when_spoof_source_enabled(self);
 
   return afsocket_dd_deinit(s);
@@ -471,6 +508,9 @@ afinet_dd_init(LogPipe *s)
       afinet_dd_failover_init(self->failover, s->expr_node, &ftm);
     }
 
+  if (_is_tls_used(self))
+    afinet_dd_register_tls_stats(self);
+
   return TRUE;
 }
 
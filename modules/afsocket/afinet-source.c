@@ -62,6 +62,14 @@ afinet_sd_set_tls_context(LogDriver *s, TLSContext *tls_context)
   transport_mapper_inet_set_tls_context((TransportMapperInet *) self->super.transport_mapper, tls_context);
 }
 
+void
+afinet_sd_set_io_uring(LogDriver *s, gboolean io_uring)
+{
+  AFInetSourceDriver *self = (AFInetSourceDriver *) s;
+
+  transport_mapper_inet_set_io_uring((TransportMapperInet *) self->super.transport_mapper, io_uring);
+}
+
 static gboolean
 afinet_sd_setup_addresses(AFSocketSourceDriver *s)
 {
@@ -96,6 +104,45 @@ afinet_sd_setup_addresses(AFSocketSourceDriver *s)
   return TRUE;
 }
 
+static StatsClusterKeyBuilder *
+afinet_sd_tls_stats_key_builder(AFInetSourceDriver *self)
+{
+  StatsClusterKeyBuilder *kb = stats_cluster_key_builder_new();
+
+  stats_cluster_key_builder_add_label(kb, stats_cluster_label("id", self->super.super.super.id));
+  stats_cluster_key_builder_add_label(kb, stats_cluster_label("driver", "afsocket"));
+  stats_cluster_key_builder_add_label(kb, stats_cluster_label("transport", self->super.transport_mapper->transport));
+  return kb;
+}
+
+static void
+afinet_sd_register_tls_stats(AFInetSourceDriver *self)
+{
+  TransportMapperInet *transport_mapper_inet = (TransportMapperInet *) self->super.transport_mapper;
+  StatsClusterKeyBuilder *kb = afinet_sd_tls_stats_key_builder(self);
+
+  tls_context_register_stats(transport_mapper_inet->tls_context, STATS_LEVEL1, kb);
+  stats_cluster_key_builder_free(kb);
+}
+
+static void
+afinet_sd_unregister_tls_stats(AFInetSourceDriver *self)
+{
+  TransportMapperInet *transport_mapper_inet = (TransportMapperInet *) self->super.transport_mapper;
+  StatsClusterKeyBuilder *kb = afinet_sd_tls_stats_key_builder(self);
+
+  tls_context_unregister_stats(transport_mapper_inet->tls_context, kb);
+  stats_cluster_key_builder_free(kb);
+}
+
+static gboolean
+_is_tls_used(const AFInetSourceDriver *self)
+{
+  TransportMapperInet *transport_mapper_inet = (TransportMapperInet *) self->super.transport_mapper;
+
+  return transport_mapper_inet->tls_context != NULL;
+}
+
 gboolean
 afinet_sd_init(LogPipe *s)
 {
@@ -104,9 +151,23 @@ afinet_sd_init(LogPipe *s)
   if (!afsocket_sd_init_method(&self->super.super.super.super))
     return FALSE;
 
+  if (_is_tls_used(self))
+    afinet_sd_register_tls_stats(self);
+
   return TRUE;
 }
 
+static gboolean
+afinet_sd_deinit(LogPipe *s)
+{
+  AFInetSourceDriver *self = (AFInetSourceDriver *) s;
+
+  if (_is_tls_used(self))
+    afinet_sd_unregister_tls_stats(self);
+
+  return afsocket_sd_deinit_method(s);
+}
+
 void
 afinet_sd_free(LogPipe *s)
 {
@@ -127,6 +188,7 @@ afinet_sd_new_instance(TransportMapper *transport_mapper, GlobalConfig *cfg)
                             transport_mapper,
                             cfg);
   self->super.super.super.super.init = afinet_sd_init;
+  self->super.super.super.super.deinit = afinet_sd_deinit;
   self->super.super.super.super.free_fn = afinet_sd_free;
   self->super.setup_addresses = afinet_sd_setup_addresses;
   return self;
@@ -78,6 +78,10 @@ static CfgLexerKeyword afsocket_keywords[] =
   { "ssl_version",        KW_SSL_VERSION },
   { "sni",                KW_SNI },
   { "allow_compress",     KW_ALLOW_COMPRESS },
+  { "ktls",               KW_KTLS },
+  { "session_cache_size", KW_SESSION_CACHE_SIZE },
+  { "session_timeout",    KW_SESSION_TIMEOUT },
+  { "session_tickets",    KW_SESSION_TICKETS },
   { "ocsp_stapling_verify", KW_OCSP_STAPLING_VERIFY },
   { "extended_key_usage_verify", KW_EXTENDED_KEY_USAGE_VERIFY },
   { "openssl_conf_cmds",  KW_CONF_CMDS},
@@ -121,6 +125,8 @@ static CfgLexerKeyword afsocket_keywords[] =
   { "dynamic_window_size", KW_DYNAMIC_WINDOW_SIZE },
   { "dynamic_window_stats_freq", KW_DYNAMIC_WINDOW_STATS_FREQ },
   { "dynamic_window_realloc_ticks", KW_DYNAMIC_WINDOW_REALLOC_TICKS },
+  { "io_uring",           KW_IO_URING },
+  { "listener_threads",   KW_LISTENER_THREADS },
   { NULL }
 };
 
@@ -60,6 +60,8 @@ typedef struct _AFSocketSourceConnection
   struct _AFSocketSourceDriver *owner;
   LogReader *reader;
   int sock;
+  /* index of the SO_REUSEPORT socket in case of listener-threads() */
+  gint shard;
   GSockAddr *peer_addr;
   GSockAddr *local_addr;
 } AFSocketSourceConnection;
@@ -90,6 +92,12 @@ _connections_count_dec(AFSocketSourceDriver *self)
   atomic_gssize_dec(&self->num_connections);
 }
 
+static gboolean
+_is_sharded(AFSocketSourceConnection *self)
+{
+  return !self->peer_addr && self->owner->listener_threads > 1;
+}
+
 static gchar *
 _format_sc_name(AFSocketSourceConnection *self, gint format_type)
 {
@@ -102,6 +110,11 @@ _format_sc_name(AFSocketSourceConnection *self, gint format_type)
       if (self->owner->bind_addr)
         {
           g_sockaddr_format(self->owner->bind_addr, buf, sizeof(buf), format_type);
+          if (_is_sharded(self))
+            {
+              gsize len = strlen(buf);
+              g_snprintf(buf + len, sizeof(buf) - len, "#%d", self->shard);
+            }
           return buf;
         }
       else
@@ -127,6 +140,13 @@ afsocket_sc_format_stats_key(AFSocketSourceConnection *self, StatsClusterKeyBuil
         {
           g_sockaddr_format(self->owner->bind_addr, addr, sizeof(addr), GSA_ADDRESS_ONLY);
           stats_cluster_key_builder_add_legacy_label(kb, stats_cluster_label("address", addr));
+          if (_is_sharded(self))
+            {
+              gchar shard[16];
+
+              g_snprintf(shard, sizeof(shard), "%d", self->shard);
+              stats_cluster_key_builder_add_label(kb, stats_cluster_label("shard", shard));
+            }
           return;
         }
       else
@@ -169,7 +189,7 @@ afsocket_sc_init(LogPipe *s)
 
       self->reader = log_reader_new(s->cfg);
       log_pipe_set_options(&self->reader->super.super, &self->super.options);
-      log_reader_open(self->reader, proto, poll_fd_events_new(self->sock));
+      log_reader_open(self->reader, proto, poll_fd_events_new(log_proto_server_get_poll_fd(proto)));
       log_reader_set_peer_addr(self->reader, self->peer_addr);
       log_reader_set_local_addr(self->reader, self->local_addr);
     }
@@ -263,7 +283,7 @@ afsocket_sc_free(LogPipe *s)
 }
 
 AFSocketSourceConnection *
-afsocket_sc_new(GSockAddr *peer_addr, GSockAddr *local_addr, int fd, GlobalConfig *cfg)
+afsocket_sc_new(GSockAddr *peer_addr, GSockAddr *local_addr, int fd, gint shard, GlobalConfig *cfg)
 {
   AFSocketSourceConnection *self = g_new0(AFSocketSourceConnection, 1);
 
@@ -275,6 +295,7 @@ afsocket_sc_new(GSockAddr *peer_addr, GSockAddr *local_addr, int fd, GlobalConfi
   self->peer_addr = g_sockaddr_ref(peer_addr);
   self->local_addr = g_sockaddr_ref(local_addr);
   self->sock = fd;
+  self->shard = shard;
   return self;
 }
 
@@ -345,6 +366,14 @@ afsocket_sd_set_listen_backlog(LogDriver *s, gint listen_backlog)
   self->listen_backlog = listen_backlog;
 }
 
+void
+afsocket_sd_set_listener_threads(LogDriver *s, gint listener_threads)
+{
+  AFSocketSourceDriver *self = (AFSocketSourceDriver *) s;
+
+  self->listener_threads = listener_threads;
+}
+
 void
 afsocket_sd_set_dynamic_window_size(LogDriver *s, gint dynamic_window_size)
 {
@@ -426,7 +455,8 @@ afsocket_sd_format_dynamic_window_pool_name(const AFSocketSourceDriver *self)
 }
 
 static gboolean
-afsocket_sd_process_connection(AFSocketSourceDriver *self, GSockAddr *client_addr, GSockAddr *local_addr, gint fd)
+afsocket_sd_process_connection(AFSocketSourceDriver *self, GSockAddr *client_addr, GSockAddr *local_addr, gint fd,
+                               gint shard)
 {
   gchar buf[MAX_SOCKADDR_STRING], buf2[MAX_SOCKADDR_STRING];
 #if SYSLOG_NG_ENABLE_TCP_WRAPPER
@@ -453,7 +483,9 @@ afsocket_sd_process_connection(AFSocketSourceDriver *self, GSockAddr *client_add
 
 #endif
 
-  if (_connections_count_get(self) >= atomic_gssize_get(&self->max_connections))
+  /* the sockets of datagram sources are not connections of clients, they
+   * are not limited by max-connections() */
+  if (client_addr && _connections_count_get(self) >= atomic_gssize_get(&self->max_connections))
     {
       msg_error("Number of allowed concurrent connections reached, rejecting connection",
                 evt_tag_str("client", g_sockaddr_format(client_addr, buf, sizeof(buf), GSA_FULL)),
@@ -468,7 +500,7 @@ afsocket_sd_process_connection(AFSocketSourceDriver *self, GSockAddr *client_add
     {
       AFSocketSourceConnection *conn;
 
-      conn = afsocket_sc_new(client_addr, local_addr, fd, self->super.super.super.cfg);
+      conn = afsocket_sc_new(client_addr, local_addr, fd, shard, self->super.super.super.cfg);
       afsocket_sc_set_owner(conn, self);
       if (log_pipe_init(&conn->super))
         {
@@ -519,7 +551,7 @@ afsocket_sd_accept(gpointer s)
       g_fd_set_cloexec(new_fd, TRUE);
 
       local_addr = g_socket_get_local_name(new_fd);
-      res = afsocket_sd_process_connection(self, peer_addr, local_addr, new_fd);
+      res = afsocket_sd_process_connection(self, peer_addr, local_addr, new_fd, 0);
       g_sockaddr_unref(local_addr);
 
       if (res)
@@ -813,18 +845,27 @@ static void
 _on_packet_stats_timer_elapsed(gpointer cookie)
 {
   AFSocketSourceDriver *self = (AFSocketSourceDriver *)cookie;
-  guint32 meminfo[SK_MEMINFO_VARS];
-  socklen_t meminfo_len = sizeof(meminfo);
-  AFSocketSourceConnection *first_connection = self->connections->data;
-  gint sock = first_connection->sock;
+  gsize dropped = 0, receive_buffer_max = 0, receive_buffer_used = 0;
 
-  /* once this getsockopt() fails, we won't try again */
-  if (getsockopt(sock, SOL_SOCKET, SO_MEMINFO, &meminfo, &meminfo_len) < 0)
-    return;
+  /* with listener-threads() the figures are summed up for all sockets */
+  for (GList *l = self->connections; l; l = l->next)
+    {
+      AFSocketSourceConnection *connection = (AFSocketSourceConnection *) l->data;
+      guint32 meminfo[SK_MEMINFO_VARS];
+      socklen_t meminfo_len = sizeof(meminfo);
+
+      /* once this getsockopt() fails, we won't try again */
+      if (getsockopt(connection->sock, SOL_SOCKET, SO_MEMINFO, &meminfo, &meminfo_len) < 0)
+        return;
+
+      dropped += meminfo[SK_MEMINFO_DROPS];
+      receive_buffer_max += meminfo[SK_MEMINFO_RCVBUF];
+      receive_buffer_used += meminfo[SK_MEMINFO_RMEM_ALLOC];
+    }
 
-  stats_counter_set(self->metrics.socket_dropped_packets, meminfo[SK_MEMINFO_DROPS]);
-  stats_counter_set(self->metrics.socket_receive_buffer_max, meminfo[SK_MEMINFO_RCVBUF]);
-  stats_counter_set(self->metrics.socket_receive_buffer_used, meminfo[SK_MEMINFO_RMEM_ALLOC]);
+  stats_counter_set(self->metrics.socket_dropped_packets, dropped);
+  stats_counter_set(self->metrics.socket_receive_buffer_max, receive_buffer_max);
+  stats_counter_set(self->metrics.socket_receive_buffer_used, receive_buffer_used);
   _packet_stats_timer_start(self);
 }
 
@@ -935,6 +976,25 @@ afsocket_sd_setup_reader_options(AFSocketSourceDriver *self)
   return TRUE;
 }
 
+static void
+afsocket_sd_setup_listener_threads(AFSocketSourceDriver *self)
+{
+  if (self->listener_threads <= 1)
+    return;
+
+  if (self->transport_mapper->sock_type != SOCK_DGRAM)
+    {
+      msg_warning("WARNING: listener-threads() only applies to datagram transports, stream connections "
+                  "are processed by the I/O worker threads in parallel anyway, ignoring",
+                  log_pipe_location_tag(&self->super.super.super));
+      self->listener_threads = 1;
+      return;
+    }
+
+  /* the sockets share the same address, the kernel distributes datagrams among them */
+  self->socket_options->so_reuseport = TRUE;
+}
+
 static gboolean
 afsocket_sd_setup_transport(AFSocketSourceDriver *self)
 {
@@ -953,6 +1013,7 @@ afsocket_sd_setup_transport(AFSocketSourceDriver *self)
       return FALSE;
     }
 
+  afsocket_sd_setup_listener_threads(self);
   afsocket_sd_setup_reader_options(self);
   return TRUE;
 }
@@ -1128,22 +1189,100 @@ _sd_open_stream(AFSocketSourceDriver *self)
   return transport_mapper_async_init(self->transport_mapper, _sd_open_stream_finalize, self);
 }
 
+static gboolean
+_is_reuseport_socket(gint sock)
+{
+#ifdef SO_REUSEPORT
+  gint reuseport = 0;
+  socklen_t len = sizeof(reuseport);
+
+  return getsockopt(sock, SOL_SOCKET, SO_REUSEPORT, &reuseport, &len) == 0 && reuseport;
+#else
+  return FALSE;
+#endif
+}
+
+static AFSocketSourceConnection *
+_find_shard(AFSocketSourceDriver *self, gint shard)
+{
+  for (GList *l = self->connections; l; l = l->next)
+    {
+      AFSocketSourceConnection *sc = (AFSocketSourceConnection *) l->data;
+
+      if (sc->shard == shard)
+        return sc;
+    }
+  return NULL;
+}
+
+/*
+ * The sockets restored from the previous configuration are kept as long as
+ * they fit listener-threads(): the ones above it are closed, and if new
+ * sockets are to be opened next to ones that were bound without
+ * SO_REUSEPORT (e.g. listener-threads() was not set before), those are
+ * closed as well, as the new sockets could not be bound to the same
+ * address.
+ */
+static gboolean
+_is_restored_shard_kept(AFSocketSourceDriver *self, AFSocketSourceConnection *sc, gboolean opening_new_shards)
+{
+  if (sc->shard >= self->listener_threads)
+    return FALSE;
+
+  return !opening_new_shards || _is_reuseport_socket(sc->sock);
+}
+
+static void
+_close_restored_shards_not_kept(AFSocketSourceDriver *self)
+{
+  gboolean opening_new_shards = g_list_length(self->connections) < self->listener_threads;
+  GList *next;
+
+  for (GList *l = self->connections; l; l = next)
+    {
+      AFSocketSourceConnection *sc = (AFSocketSourceConnection *) l->data;
+
+      next = l->next;
+      if (_is_restored_shard_kept(self, sc, opening_new_shards))
+        continue;
+
+      msg_verbose("Closing datagram socket restored from the previous configuration, it does not fit listener-threads()",
+                  evt_tag_int("fd", sc->sock),
+                  evt_tag_int("shard", sc->shard),
+                  evt_tag_int("listener_threads", self->listener_threads),
+                  log_pipe_location_tag(&self->super.super.super));
+      self->connections = g_list_delete_link(self->connections, l);
+      afsocket_sd_kill_connection(sc);
+      _connections_count_dec(self);
+    }
+}
+
 static gboolean
 _sd_open_dgram(AFSocketSourceDriver *self)
 {
-  gint sock = -1;
-  if (!self->connections)
+  self->fd = -1;
+
+  /* connections restored from the previous configuration keep their
+   * sockets, we only open the ones that are missing */
+  _close_restored_shards_not_kept(self);
+  for (gint shard = 0; shard < self->listener_threads; shard++)
     {
-      if (!afsocket_sd_acquire_socket(self, &sock))
+      gint sock = -1;
+
+      if (_find_shard(self, shard))
+        continue;
+
+      if (shard == 0 && !afsocket_sd_acquire_socket(self, &sock))
         return self->super.super.optional;
       if (sock == -1 && !afsocket_sd_open_socket(self, &sock))
         return self->super.super.optional;
-    }
-  self->fd = -1;
 
-  /* we either have self->connections != NULL, or sock contains a new fd */
-  if (!(self->connections || afsocket_sd_process_connection(self, NULL, self->bind_addr, sock)))
-    return FALSE;
+      if (!afsocket_sd_process_connection(self, NULL, self->bind_addr, sock, shard))
+        {
+          close(sock);
+          return FALSE;
+        }
+    }
 
   if (!transport_mapper_init(self->transport_mapper))
     return FALSE;
@@ -1419,6 +1558,7 @@ afsocket_sd_init_instance(AFSocketSourceDriver *self,
   self->transport_mapper = transport_mapper;
   atomic_gssize_set(&self->max_connections, 10);
   self->listen_backlog = 255;
+  self->listener_threads = 1;
   self->dynamic_window_stats_freq = DYNAMIC_WINDOW_TIMER_MSECS;
   self->dynamic_window_realloc_ticks = DYNAMIC_WINDOW_REALLOC_TICKS;
   self->connections_kept_alive_across_reloads = TRUE;
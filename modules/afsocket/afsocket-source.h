@@ -67,6 +67,8 @@ struct _AFSocketSourceDriver
   atomic_gssize max_connections;
   atomic_gssize num_connections;
   gint listen_backlog;
+  /* number of SO_REUSEPORT sockets opened for datagram transports */
+  gint listener_threads;
   GList *connections;
   SocketOptions *socket_options;
   TransportMapper *transport_mapper;
@@ -90,6 +92,7 @@ struct _AFSocketSourceDriver
 void afsocket_sd_set_keep_alive(LogDriver *self, gint enable);
 void afsocket_sd_set_max_connections(LogDriver *self, gint max_connections);
 void afsocket_sd_set_listen_backlog(LogDriver *self, gint listen_backlog);
+void afsocket_sd_set_listener_threads(LogDriver *self, gint listener_threads);
 void afsocket_sd_set_dynamic_window_size(LogDriver *self, gint dynamic_window_size);
 void afsocket_sd_set_dynamic_window_stats_freq(LogDriver *self, gdouble stats_freq);
 void afsocket_sd_set_dynamic_window_realloc_ticks(LogDriver *self, gint realloc_ticks);
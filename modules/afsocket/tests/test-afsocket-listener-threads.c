@@ -0,0 +1,278 @@
+/*
+ * Copyright (c) 2026 Axoflow
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include <criterion/criterion.h>
+
+#include "afinet-source.h"
+#include "afsocket-source.h"
+#include "cfg.h"
+#include "cfg-persist.h"
+#include "gsockaddr.h"
+#include "stats/stats-registry.h"
+#include "apphook.h"
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <string.h>
+#include <unistd.h>
+
+static gchar port[16];
+
+static void
+_pick_free_udp_port(void)
+{
+  struct sockaddr_in sin = { .sin_family = AF_INET, .sin_addr.s_addr = htonl(INADDR_LOOPBACK) };
+  socklen_t len = sizeof(sin);
+  gint sock = socket(AF_INET, SOCK_DGRAM, 0);
+
+  cr_assert(sock >= 0);
+  cr_assert(bind(sock, (struct sockaddr *) &sin, sizeof(sin)) == 0);
+  cr_assert(getsockname(sock, (struct sockaddr *) &sin, &len) == 0);
+  close(sock);
+
+  g_snprintf(port, sizeof(port), "%d", ntohs(sin.sin_port));
+}
+
+static AFSocketSourceDriver *
+_create_source(AFInetSourceDriver *(*new_driver)(GlobalConfig *cfg), gint listener_threads)
+{
+  AFInetSourceDriver *self = new_driver(configuration);
+  LogDriver *driver = &self->super.super.super;
+
+  driver->id = g_strdup("s_test");
+  afinet_sd_set_localip(driver, "127.0.0.1");
+  afinet_sd_set_localport(driver, port);
+  afsocket_sd_set_listener_threads(driver, listener_threads);
+  return &self->super;
+}
+
+static AFSocketSourceDriver *
+_start_udp_source(gint listener_threads)
+{
+  AFSocketSourceDriver *self = _create_source(afinet_sd_new_udp, listener_threads);
+
+  cr_assert(log_pipe_init(&self->super.super.super), "initializing the source failed");
+  return self;
+}
+
+/* deinitializing keeps the sockets in the persist config, like a reload does */
+static void
+_stop_source(AFSocketSourceDriver *self)
+{
+  cr_assert(log_pipe_deinit(&self->super.super.super));
+  log_pipe_unref(&self->super.super.super);
+}
+
+typedef struct _ClusterLookup
+{
+  const gchar *label_name;
+  const gchar *label_value;
+  const gchar *legacy_instance;
+  gboolean found;
+} ClusterLookup;
+
+static void
+_match_cluster(StatsCluster *sc, gpointer user_data)
+{
+  ClusterLookup *lookup = (ClusterLookup *) user_data;
+
+  /* the clusters of the previous configuration are kept, without counters */
+  if (sc->use_count == 0)
+    return;
+
+  if (lookup->legacy_instance)
+    {
+      if (sc->key.legacy.set && g_strcmp0(sc->key.legacy.instance, lookup->legacy_instance) == 0)
+        lookup->found = TRUE;
+      return;
+    }
+
+  if (g_strcmp0(sc->key.name, "input_events_total") != 0)
+    return;
+
+  for (gsize i = 0; i < sc->key.labels_len; i++)
+    {
+      if (strcmp(sc->key.labels[i].name, lookup->label_name) == 0
+          && g_strcmp0(sc->key.labels[i].value, lookup->label_value) == 0)
+        lookup->found = TRUE;
+    }
+}
+
+static gboolean
+_is_cluster_registered(ClusterLookup *lookup)
+{
+  stats_lock();
+  stats_foreach_cluster(_match_cluster, lookup, NULL);
+  stats_unlock();
+
+  return lookup->found;
+}
+
+static gboolean
+_has_shard_label(gint shard)
+{
+  gchar value[16];
+  ClusterLookup lookup = { .label_name = "shard", .label_value = value };
+
+  g_snprintf(value, sizeof(value), "%d", shard);
+  return _is_cluster_registered(&lookup);
+}
+
+static gboolean
+_has_sharded_instance(AFSocketSourceDriver *self, gint shard)
+{
+  gchar addr[MAX_SOCKADDR_STRING];
+  gchar instance[MAX_SOCKADDR_STRING + 16];
+  ClusterLookup lookup = { .legacy_instance = instance };
+
+  g_snprintf(instance, sizeof(instance), "%s#%d",
+             g_sockaddr_format(self->bind_addr, addr, sizeof(addr), GSA_FULL), shard);
+  return _is_cluster_registered(&lookup);
+}
+
+static void
+_assert_shards(AFSocketSourceDriver *self, gint num_shards)
+{
+  cr_assert_eq(g_list_length(self->connections), num_shards);
+  for (gint shard = 0; shard < num_shards; shard++)
+    {
+      cr_assert(_has_shard_label(shard), "no stats cluster with shard=%d", shard);
+      cr_assert(_has_sharded_instance(self, shard), "no stats cluster with instance #%d", shard);
+    }
+  cr_assert_not(_has_shard_label(num_shards), "stats cluster of a closed shard: %d", num_shards);
+}
+
+Test(afsocket_listener_threads, a_socket_is_opened_for_each_listener_thread)
+{
+  AFSocketSourceDriver *self = _start_udp_source(4);
+
+  cr_assert_eq(self->listener_threads, 4);
+  cr_assert(self->socket_options->so_reuseport, "SO_REUSEPORT should be turned on for the shards");
+  _assert_shards(self, 4);
+
+  _stop_source(self);
+}
+
+Test(afsocket_listener_threads, a_single_socket_is_not_labelled_as_a_shard)
+{
+  AFSocketSourceDriver *self = _start_udp_source(1);
+  gchar addr[MAX_SOCKADDR_STRING];
+  ClusterLookup lookup = { .legacy_instance = g_sockaddr_format(self->bind_addr, addr, sizeof(addr), GSA_FULL) };
+
+  cr_assert_eq(g_list_length(self->connections), 1);
+  cr_assert_not(_has_shard_label(0));
+  cr_assert(_is_cluster_registered(&lookup), "the instance name should not have a shard suffix");
+
+  _stop_source(self);
+}
+
+Test(afsocket_listener_threads, shards_are_not_limited_by_max_connections)
+{
+  AFSocketSourceDriver *self = _create_source(afinet_sd_new_udp, 4);
+
+  afsocket_sd_set_max_connections(&self->super.super, 1);
+  cr_assert(log_pipe_init(&self->super.super.super));
+  _assert_shards(self, 4);
+
+  _stop_source(self);
+}
+
+Test(afsocket_listener_threads, stream_transports_are_not_sharded)
+{
+  AFSocketSourceDriver *self = _create_source(afinet_sd_new_tcp, 4);
+
+  cr_assert(log_pipe_init(&self->super.super.super));
+  cr_assert_eq(self->listener_threads, 1);
+  cr_assert_not(_has_shard_label(0));
+
+  _stop_source(self);
+}
+
+Test(afsocket_listener_threads, raising_listener_threads_on_reload_opens_the_missing_shards)
+{
+  _stop_source(_start_udp_source(2));
+
+  AFSocketSourceDriver *self = _start_udp_source(4);
+  _assert_shards(self, 4);
+
+  _stop_source(self);
+}
+
+Test(afsocket_listener_threads, lowering_listener_threads_on_reload_closes_the_surplus_shards)
+{
+  _stop_source(_start_udp_source(4));
+
+  AFSocketSourceDriver *self = _start_udp_source(2);
+  _assert_shards(self, 2);
+  cr_assert_not(_has_sharded_instance(self, 2));
+  cr_assert_not(_has_sharded_instance(self, 3));
+
+  _stop_source(self);
+}
+
+Test(afsocket_listener_threads, sockets_without_reuseport_are_closed_when_shards_are_added_on_reload)
+{
+  /* the socket of a single listener is bound without SO_REUSEPORT, the
+   * new shards could not be bound next to it */
+  _stop_source(_start_udp_source(1));
+
+  AFSocketSourceDriver *self = _start_udp_source(3);
+  _assert_shards(self, 3);
+
+  _stop_source(self);
+}
+
+Test(afsocket_listener_threads, sockets_are_closed_when_sharding_is_turned_off_on_reload)
+{
+  _stop_source(_start_udp_source(3));
+
+  AFSocketSourceDriver *self = _start_udp_source(1);
+  cr_assert_eq(g_list_length(self->connections), 1);
+  cr_assert_not(_has_shard_label(1));
+
+  _stop_source(self);
+}
+
+static void
+setup(void)
+{
+  app_startup();
+
+  configuration = cfg_new_snippet();
+  configuration->stats_options.level = 4;
+  configuration->persist = persist_config_new();
+  cfg_init(configuration);
+
+  _pick_free_udp_port();
+}
+
+static void
+teardown(void)
+{
+  /* closes the sockets kept by the last source */
+  persist_config_free(configuration->persist);
+  configuration->persist = NULL;
+  cfg_free(configuration);
+  app_shutdown();
+}
+
+TestSuite(afsocket_listener_threads, .init = setup, .fini = teardown);
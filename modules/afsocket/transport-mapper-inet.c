@@ -32,6 +32,7 @@
 #include "transport/transport-factory-haproxy.h"
 #include "transport/transport-socket.h"
 #include "transport/transport-udp-socket.h"
+#include "transport/transport-io-uring.h"
 #include "secret-storage/secret-storage.h"
 
 #include <sys/types.h>
@@ -64,6 +65,27 @@ transport_mapper_inet_validate_tls_options(TransportMapperInet *self)
   return TRUE;
 }
 
+/* TLS and haproxy transports read the socket directly, io_uring would
+ * steal their data */
+static void
+transport_mapper_inet_validate_io_uring(TransportMapperInet *self)
+{
+  if (!self->io_uring)
+    return;
+
+#if SYSLOG_NG_ENABLE_IO_URING
+  if (self->super.sock_type != SOCK_STREAM || self->tls_context || self->proxied)
+    {
+      msg_warning("WARNING: io-uring() is only supported with plain (non-TLS, non-proxied) stream transports, ignoring",
+                  evt_tag_str("transport", self->super.transport));
+      self->io_uring = FALSE;
+    }
+#else
+  msg_warning("WARNING: io-uring() was specified, but syslog-ng was compiled without io_uring support, ignoring");
+  self->io_uring = FALSE;
+#endif
+}
+
 static gboolean
 transport_mapper_inet_apply_transport_method(TransportMapper *s, GlobalConfig *cfg)
 {
@@ -72,7 +94,23 @@ transport_mapper_inet_apply_transport_method(TransportMapper *s, GlobalConfig *c
   if (!transport_mapper_apply_transport_method(s, cfg))
     return FALSE;
 
-  return transport_mapper_inet_validate_tls_options(self);
+  if (!transport_mapper_inet_validate_tls_options(self))
+    return FALSE;
+
+  transport_mapper_inet_validate_io_uring(self);
+  return TRUE;
+}
+
+static LogTransport *
+_construct_stream_socket_transport(TransportMapperInet *self, gint fd)
+{
+  if (self->io_uring)
+    {
+      LogTransport *transport = log_transport_io_uring_stream_socket_new(fd);
+      if (transport)
+        return transport;
+    }
+  return log_transport_stream_socket_new(fd);
 }
 
 static gboolean
@@ -81,14 +119,17 @@ _setup_socket_transport(TransportMapperInet *self, LogTransportStack *stack)
   log_transport_stack_add_transport(stack, LOG_TRANSPORT_SOCKET,
                                     self->super.sock_type == SOCK_DGRAM
                                     ? log_transport_udp_socket_new(stack->fd)
-                                    : log_transport_stream_socket_new(stack->fd));
+                                    : _construct_stream_socket_transport(self, stack->fd));
   return TRUE;
 }
 
 static gboolean
 _setup_tls_transport(TransportMapperInet *self, LogTransportStack *stack)
 {
-  log_transport_stack_add_factory(stack, transport_factory_tls_new(self->tls_context, self->tls_verifier));
+  LogTransportFactory *factory = transport_factory_tls_new(self->tls_context, self->tls_verifier);
+
+  transport_factory_tls_set_peer(factory, self->tls_peer);
+  log_transport_stack_add_factory(stack, factory);
   return TRUE;
 }
 
@@ -269,6 +310,7 @@ transport_mapper_inet_free_method(TransportMapper *s)
 
   if (self->tls_verifier)
     tls_verifier_unref(self->tls_verifier);
+  g_free(self->tls_peer);
   if (self->tls_context)
     tls_context_unref(self->tls_context);
 
@@ -476,6 +518,7 @@ transport_mapper_network_apply_transport(TransportMapper *s, GlobalConfig *cfg)
   if (!transport_mapper_inet_validate_tls_options(self))
     return FALSE;
 
+  transport_mapper_inet_validate_io_uring(self);
   return TRUE;
 }
 
@@ -608,6 +651,7 @@ transport_mapper_syslog_apply_transport(TransportMapper *s, GlobalConfig *cfg)
   if (!transport_mapper_inet_validate_tls_options(self))
     return FALSE;
 
+  transport_mapper_inet_validate_io_uring(self);
   return TRUE;
 }
 
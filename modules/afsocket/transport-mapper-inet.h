@@ -57,8 +57,12 @@ typedef struct _TransportMapperInet
   gboolean proxied;
   /* switch to TLS after plaintext haproxy negotiation */
   gboolean proxied_passthrough;
+  /* receive using io_uring on plain stream connections */
+  gboolean io_uring;
   TLSContext *tls_context;
   TLSVerifier *tls_verifier;
+  /* the server we connect to, used to resume TLS sessions */
+  gchar *tls_peer;
   gpointer secret_store_cb_data;
 } TransportMapperInet;
 
@@ -88,6 +92,12 @@ transport_mapper_inet_set_tls_context(TransportMapperInet *self, TLSContext *tls
   self->tls_context = tls_context;
 }
 
+static inline void
+transport_mapper_inet_set_io_uring(TransportMapperInet *self, gboolean io_uring)
+{
+  self->io_uring = io_uring;
+}
+
 static inline void
 transport_mapper_inet_set_tls_verifier(TransportMapperInet *self, TLSVerifier *tls_verifier)
 {
@@ -95,6 +105,13 @@ transport_mapper_inet_set_tls_verifier(TransportMapperInet *self, TLSVerifier *t
   self->tls_verifier = tls_verifier;
 }
 
+static inline void
+transport_mapper_inet_set_tls_peer(TransportMapperInet *self, const gchar *tls_peer)
+{
+  g_free(self->tls_peer);
+  self->tls_peer = g_strdup(tls_peer);
+}
+
 void transport_mapper_inet_init_instance(TransportMapperInet *self, const gchar *transport);
 TransportMapper *transport_mapper_tcp_new(void);
 TransportMapper *transport_mapper_tcp6_new(void);
@@ -58,6 +58,95 @@ disk_queue_options_compaction_set(DiskQueueOptions *self, gboolean compaction)
   self->compaction = compaction;
 }
 
+void
+disk_queue_options_compact_serialization_set(DiskQueueOptions *self, gboolean compact_serialization)
+{
+  self->compact_serialization = compact_serialization;
+}
+
+void
+disk_queue_options_writer_thread_set(DiskQueueOptions *self, gboolean writer_thread)
+{
+  self->writer_thread = writer_thread;
+}
+
+void
+disk_queue_options_write_batch_bytes_set(DiskQueueOptions *self, gint write_batch_bytes)
+{
+  self->write_batch_bytes = write_batch_bytes;
+}
+
+gboolean
+disk_queue_options_sync_policy_set(DiskQueueOptions *self, const gchar *sync_policy)
+{
+  if (strcmp(sync_policy, "never") == 0)
+    self->sync_policy = DQSP_NEVER;
+  else if (strcmp(sync_policy, "batch") == 0)
+    self->sync_policy = DQSP_BATCH;
+  else if (strcmp(sync_policy, "interval") == 0)
+    self->sync_policy = DQSP_INTERVAL;
+  else
+    return FALSE;
+
+  return TRUE;
+}
+
+void
+disk_queue_options_sync_interval_set(DiskQueueOptions *self, gint sync_interval)
+{
+  self->sync_interval = sync_interval;
+}
+
+gboolean
+disk_queue_options_compression_set(DiskQueueOptions *self, const gchar *compression)
+{
+  if (strcmp(compression, "none") == 0)
+    {
+      self->compression = DQC_NONE;
+      return TRUE;
+    }
+
+  if (strcmp(compression, "zstd") == 0)
+    {
+#if SYSLOG_NG_HAVE_ZSTD
+      self->compression = DQC_ZSTD;
+      return TRUE;
+#else
+      msg_error("compression(zstd) is not supported, syslog-ng was compiled without zstd");
+      return FALSE;
+#endif
+    }
+
+  return FALSE;
+}
+
+void
+disk_queue_options_compression_dictionary_set(DiskQueueOptions *self, const gchar *compression_dictionary)
+{
+  g_free(self->compression_dictionary);
+  self->compression_dictionary = g_strdup(compression_dictionary);
+}
+
+void
+disk_queue_options_segment_size_set(DiskQueueOptions *self, gint64 segment_size)
+{
+  if (segment_size > 0 && segment_size < MIN_SEGMENT_SIZE)
+    {
+      msg_warning("WARNING: The configured disk buffer segment size is smaller than the minimum allowed",
+                  evt_tag_long("configured_segment_size", segment_size),
+                  evt_tag_long("minimum_allowed_segment_size", MIN_SEGMENT_SIZE),
+                  evt_tag_long("new_segment_size", MIN_SEGMENT_SIZE));
+      segment_size = MIN_SEGMENT_SIZE;
+    }
+  self->segment_size = segment_size;
+}
+
+void
+disk_queue_options_shared_by_workers_set(DiskQueueOptions *self, gboolean shared_by_workers)
+{
+  self->shared_by_workers = shared_by_workers;
+}
+
 void
 disk_queue_options_flow_control_window_bytes_set(DiskQueueOptions *self, gint flow_control_window_bytes)
 {
@@ -129,6 +218,15 @@ disk_queue_options_set_default_options(DiskQueueOptions *self)
   self->capacity_bytes = -1;
   self->flow_control_window_size = -1;
   self->reliable = FALSE;
+  self->compact_serialization = FALSE;
+  self->writer_thread = FALSE;
+  self->write_batch_bytes = 0;
+  self->sync_policy = DQSP_NEVER;
+  self->sync_interval = DEFAULT_SYNC_INTERVAL;
+  self->compression = DQC_NONE;
+  self->compression_dictionary = NULL;
+  self->segment_size = 0;
+  self->shared_by_workers = FALSE;
   self->flow_control_window_bytes = -1;
   self->front_cache_size = -1;
   self->dir = g_strdup(get_installation_path_for(SYSLOG_NG_PATH_LOCALSTATEDIR));
@@ -144,4 +242,7 @@ disk_queue_options_destroy(DiskQueueOptions *self)
       g_free(self->dir);
       self->dir = NULL;
     }
+
+  g_free(self->compression_dictionary);
+  self->compression_dictionary = NULL;
 }
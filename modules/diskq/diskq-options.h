@@ -28,6 +28,22 @@
 #include "logmsg/logmsg-serialize.h"
 
 #define MIN_CAPACITY_BYTES (1024*1024)
+#define MIN_SEGMENT_SIZE (64*1024)
+#define DEFAULT_SYNC_INTERVAL 1000
+
+typedef enum
+{
+  DQSP_NEVER,
+  DQSP_BATCH,
+  DQSP_INTERVAL,
+} DiskQueueSyncPolicy;
+
+/* stored in the header of the disk-buffer files, do not renumber */
+typedef enum
+{
+  DQC_NONE = 0,
+  DQC_ZSTD = 1,
+} DiskQueueCompression;
 
 typedef struct _DiskQueueOptions
 {
@@ -36,6 +52,15 @@ typedef struct _DiskQueueOptions
   gboolean read_only;
   gboolean reliable;
   gboolean compaction;
+  gboolean compact_serialization;
+  gboolean writer_thread;
+  gint write_batch_bytes;
+  DiskQueueSyncPolicy sync_policy;
+  gint sync_interval;
+  DiskQueueCompression compression;
+  gchar *compression_dictionary;
+  gint64 segment_size;
+  gboolean shared_by_workers;
   gint flow_control_window_bytes;
   gint flow_control_window_size;
   gchar *dir;
@@ -47,6 +72,15 @@ void disk_queue_options_front_cache_size_set(DiskQueueOptions *self, gint front_
 void disk_queue_options_capacity_bytes_set(DiskQueueOptions *self, gint64 capacity_bytes);
 void disk_queue_options_reliable_set(DiskQueueOptions *self, gboolean reliable);
 void disk_queue_options_compaction_set(DiskQueueOptions *self, gboolean compaction);
+void disk_queue_options_compact_serialization_set(DiskQueueOptions *self, gboolean compact_serialization);
+void disk_queue_options_writer_thread_set(DiskQueueOptions *self, gboolean writer_thread);
+void disk_queue_options_write_batch_bytes_set(DiskQueueOptions *self, gint write_batch_bytes);
+gboolean disk_queue_options_sync_policy_set(DiskQueueOptions *self, const gchar *sync_policy);
+void disk_queue_options_sync_interval_set(DiskQueueOptions *self, gint sync_interval);
+gboolean disk_queue_options_compression_set(DiskQueueOptions *self, const gchar *compression);
+void disk_queue_options_compression_dictionary_set(DiskQueueOptions *self, const gchar *compression_dictionary);
+void disk_queue_options_segment_size_set(DiskQueueOptions *self, gint64 segment_size);
+void disk_queue_options_shared_by_workers_set(DiskQueueOptions *self, gboolean shared_by_workers);
 void disk_queue_options_flow_control_window_bytes_set(DiskQueueOptions *self, gint flow_control_window_bytes);
 void disk_queue_options_flow_control_window_size_set(DiskQueueOptions *self, gint flow_control_window_size);
 void disk_queue_options_check_plugin_settings(DiskQueueOptions *self);
@@ -37,6 +37,15 @@ static CfgLexerKeyword diskq_keywords[] =
   { "capacity_bytes",    KW_CAPACITY_BYTES },
   { "reliable",          KW_RELIABLE },
   { "compaction",        KW_COMPACTION },
+  { "compact_serialization", KW_COMPACT_SERIALIZATION },
+  { "writer_thread",     KW_WRITER_THREAD },
+  { "write_batch_bytes", KW_WRITE_BATCH_BYTES },
+  { "sync_policy",       KW_SYNC_POLICY },
+  { "sync_interval",     KW_SYNC_INTERVAL },
+  { "compression",       KW_COMPRESSION },
+  { "compression_dictionary", KW_COMPRESSION_DICTIONARY },
+  { "segment_size",      KW_SEGMENT_SIZE },
+  { "shared_by_workers", KW_SHARED_BY_WORKERS },
   { "mem_buf_size",              KW_FLOW_CONTROL_WINDOW_BYTES },
   { "flow_control_window_bytes", KW_FLOW_CONTROL_WINDOW_BYTES },
   { "qout_size",         KW_FRONT_CACHE_SIZE },
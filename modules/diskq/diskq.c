@@ -32,6 +32,7 @@
 #include "logqueue-disk.h"
 #include "logqueue-disk-reliable.h"
 #include "logqueue-disk-non-reliable.h"
+#include "logqueue-disk-consumers.h"
 #include "persist-state.h"
 
 #define DISKQ_PLUGIN_NAME "diskq"
@@ -40,6 +41,7 @@ struct _DiskQDestPlugin
 {
   LogDriverPlugin super;
   DiskQueueOptions options;
+  LogQueueDiskConsumers *consumers;
 };
 
 static gboolean
@@ -135,10 +137,9 @@ _create_and_start_disk_queue_with_new_filename(DiskQDestPlugin *self, const gcha
 }
 
 static LogQueue *
-_acquire_queue(LogDestDriver *dd, const gchar *persist_name, gint stats_level,
-               StatsClusterKeyBuilder *driver_sck_builder, StatsClusterKeyBuilder *queue_sck_builder)
+_acquire_disk_queue(DiskQDestPlugin *self, LogDestDriver *dd, const gchar *persist_name, gint stats_level,
+                    StatsClusterKeyBuilder *driver_sck_builder, StatsClusterKeyBuilder *queue_sck_builder)
 {
-  DiskQDestPlugin *self = log_driver_get_plugin(&dd->super, DiskQDestPlugin, DISKQ_PLUGIN_NAME);
   GlobalConfig *cfg = log_pipe_get_config(&dd->super.super);
   LogQueue *queue;
   gchar *persist_qfile_name, *new_qfile_name = NULL;
@@ -159,8 +160,6 @@ _acquire_queue(LogDestDriver *dd, const gchar *persist_name, gint stats_level,
 exit:
   if (queue)
     {
-      log_queue_set_throttle(queue, dd->throttle);
-
       const gchar *qfile_name = log_queue_disk_get_filename(queue);
       diskq_global_metrics_file_acquired(qfile_name);
       if (persist_name && qfile_name)
@@ -173,12 +172,107 @@ exit:
   return queue;
 }
 
+/*
+ * The other workers had a disk-buffer of their own with
+ * shared-by-workers(no).  Their files are kept (and are picked up again if
+ * the option is turned off), but the messages in them are not delivered
+ * until then.
+ */
+static void
+_warn_about_disk_queue_of_worker(LogDestDriver *dd, const gchar *persist_name)
+{
+  GlobalConfig *cfg = log_pipe_get_config(&dd->super.super);
+
+  if (!persist_name)
+    return;
+
+  gchar *qfile_name = persist_state_lookup_string(cfg->state, persist_name, NULL, NULL);
+  if (qfile_name && g_file_test(qfile_name, G_FILE_TEST_EXISTS))
+    {
+      msg_warning("WARNING: The disk-buffer file of a destination worker is not used with shared-by-workers(yes), "
+                  "the messages in it are delivered only after setting shared-by-workers(no) again",
+                  evt_tag_str(EVT_TAG_FILENAME, qfile_name),
+                  evt_tag_str("persist_name", persist_name),
+                  log_pipe_location_tag(&dd->super.super));
+    }
+  g_free(qfile_name);
+}
+
+/*
+ * With shared-by-workers(yes), the workers of the destination don't get a
+ * disk-buffer each, the first acquisition (worker #0, with the legacy
+ * persist name) opens the disk-buffer and every worker gets a consumer of
+ * it.
+ */
+static LogQueue *
+_acquire_consumer(DiskQDestPlugin *self, LogDestDriver *dd, const gchar *persist_name, gint stats_level,
+                  StatsClusterKeyBuilder *driver_sck_builder, StatsClusterKeyBuilder *queue_sck_builder)
+{
+  if (!self->consumers)
+    {
+      LogQueue *queue = _acquire_disk_queue(self, dd, persist_name, stats_level, driver_sck_builder, queue_sck_builder);
+      if (!queue)
+        return NULL;
+
+      self->consumers = log_queue_disk_consumers_new(queue);
+    }
+  else
+    {
+      _warn_about_disk_queue_of_worker(dd, persist_name);
+    }
+
+  return log_queue_disk_consumers_add_consumer(self->consumers);
+}
+
+static LogQueue *
+_acquire_queue(LogDestDriver *dd, const gchar *persist_name, gint stats_level,
+               StatsClusterKeyBuilder *driver_sck_builder, StatsClusterKeyBuilder *queue_sck_builder)
+{
+  DiskQDestPlugin *self = log_driver_get_plugin(&dd->super, DiskQDestPlugin, DISKQ_PLUGIN_NAME);
+  LogQueue *queue;
+
+  if (self->options.shared_by_workers)
+    queue = _acquire_consumer(self, dd, persist_name, stats_level, driver_sck_builder, queue_sck_builder);
+  else
+    queue = _acquire_disk_queue(self, dd, persist_name, stats_level, driver_sck_builder, queue_sck_builder);
+
+  if (queue)
+    log_queue_set_throttle(queue, dd->throttle);
+
+  return queue;
+}
+
+/* returns the disk-buffer to be released, once its last consumer is released */
+static LogQueue *
+_release_consumer(DiskQDestPlugin *self, LogQueue *consumer)
+{
+  gboolean last_consumer = log_queue_disk_consumers_remove_consumer(self->consumers, consumer);
+
+  log_queue_unref(consumer);
+  if (!last_consumer)
+    return NULL;
+
+  LogQueue *queue = log_queue_ref(log_queue_disk_consumers_get_queue(self->consumers));
+  log_queue_disk_consumers_unref(self->consumers);
+  self->consumers = NULL;
+
+  return queue;
+}
+
 void
 _release_queue(LogDestDriver *dd, LogQueue *queue)
 {
+  DiskQDestPlugin *self = log_driver_get_plugin(&dd->super, DiskQDestPlugin, DISKQ_PLUGIN_NAME);
   GlobalConfig *cfg = log_pipe_get_config(&dd->super.super);
   gboolean persistent;
 
+  if (log_queue_has_type(queue, log_queue_disk_consumer_type))
+    {
+      queue = _release_consumer(self, queue);
+      if (!queue)
+        return;
+    }
+
   log_queue_disk_stop(queue, &persistent);
   diskq_global_metrics_file_released(log_queue_disk_get_filename(queue));
 
@@ -51,6 +51,7 @@ gboolean relocate_all;
 gboolean display_version;
 gboolean assign_help;
 gboolean truncate_confirm;
+gchar *compression_dictionary;
 
 static GOptionEntry cat_options[] =
 {
@@ -58,17 +59,29 @@ static GOptionEntry cat_options[] =
     "template",  't', 0, G_OPTION_ARG_STRING, &template_string,
     "Template to format the serialized messages", "<template>"
   },
+  {
+    "compression-dictionary", 'd', 0, G_OPTION_ARG_STRING, &compression_dictionary,
+    "compression-dictionary() of the disk-buffer", "<dictionary>"
+  },
   { NULL, 0, 0, G_OPTION_ARG_NONE, NULL, NULL }
 };
 
 static GOptionEntry info_options[] =
 {
+  {
+    "compression-dictionary", 'd', 0, G_OPTION_ARG_STRING, &compression_dictionary,
+    "compression-dictionary() of the disk-buffer", "<dictionary>"
+  },
   { NULL, 0, 0, G_OPTION_ARG_NONE, NULL, NULL }
 };
 
 static GOptionEntry truncate_options[] =
 {
   { "force", 'f', 0, G_OPTION_ARG_NONE, &truncate_confirm },
+  {
+    "compression-dictionary", 'd', 0, G_OPTION_ARG_STRING, &compression_dictionary,
+    "compression-dictionary() of the disk-buffer", "<dictionary>"
+  },
   { NULL, 0, 0, G_OPTION_ARG_NONE, NULL, NULL }
 };
 
@@ -111,6 +124,8 @@ open_queue(char *filename, LogQueue **lq, DiskQueueOptions *options, gboolean re
 {
   options->read_only = read_only;
   options->reliable = FALSE;
+  if (compression_dictionary)
+    disk_queue_options_compression_dictionary_set(options, compression_dictionary);
   FILE *f = fopen(filename, "rb");
   if (f)
     {
@@ -426,6 +441,26 @@ _move_file(const gchar *from, const gchar *to)
     }
 }
 
+/* segments are moved after the file, they are only looked up by its name */
+static gboolean
+_move_diskq_file(const gchar *from, const gchar *to)
+{
+  GList *segment_filenames = qdisk_get_segment_filenames(from);
+  gboolean result = _move_file(from, to);
+
+  for (GList *l = segment_filenames; l && result; l = l->next)
+    {
+      const gchar *segment_filename = l->data;
+      gchar *new_segment_filename = g_strconcat(to, segment_filename + strlen(from), NULL);
+
+      result = _move_file(segment_filename, new_segment_filename);
+      g_free(new_segment_filename);
+    }
+
+  g_list_free_full(segment_filenames, g_free);
+  return result;
+}
+
 static gboolean
 _file_is_diskq(const gchar *filename)
 {
@@ -498,7 +533,7 @@ _relocate_qfile(PersistState *state, const gchar *name)
           goto exit;
         }
 
-      if (_move_file(qfile, relocated_qfile))
+      if (_move_diskq_file(qfile, relocated_qfile))
         {
           printf("new qfile_path: %s\n", relocated_qfile);
           persist_state_alloc_string(state, name, relocated_qfile, -1);
@@ -0,0 +1,574 @@
+/*
+ * Copyright (c) 2026 Axoflow
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "logqueue-disk-consumers.h"
+#include "logqueue-disk.h"
+#include "logpipe.h"
+
+/*
+ * Consumers of a disk-buffer shared by the workers of a destination
+ *
+ * Each worker of a threaded destination gets its own LogQueue, which is a
+ * view of the shared disk-buffer here.  Workers pop their batches through
+ * their view and acknowledge or rewind them independently of each other,
+ * so a backlog accumulated in the disk-buffer is drained by all the
+ * workers, not only by the one that owns the file.
+ *
+ * Every message popped from the disk-buffer gets an entry in the
+ * in_flight list of the group, in the order it was popped.  The disk-buffer
+ * only knows about a single backlog, which can be acknowledged from its
+ * oldest end, so acknowledging a batch just marks its entries, and the
+ * disk-buffer is acknowledged as soon as the oldest in-flight entries are
+ * all acked.  Rewound messages are not returned to the disk-buffer (as
+ * newer messages might already be in flight), they are kept in the
+ * redeliver list and are popped by the next consumer before anything
+ * else.
+ *
+ * Only the records are popped from the disk-buffer under the lock of the
+ * group, each consumer deserializes its batch after releasing it, so
+ * that the consumers don't wait for each other's deserialization.
+ *
+ * Lock order: consumers_lock -> the lock of a view -> lock of the group.
+ */
+
+QueueType log_queue_disk_consumer_type = "DISK-CONSUMER";
+
+typedef struct _InFlightEntry
+{
+  gint64 id;
+  LogMessage *msg;
+  LogPathOptions path_options;
+  gboolean acked;
+} InFlightEntry;
+
+struct _LogQueueDiskConsumers
+{
+  GAtomicCounter ref_cnt;
+  LogQueue *queue;
+
+  GMutex lock;
+  GQueue *in_flight;
+  GQueue *redeliver;
+  gint64 next_id;
+
+  GMutex consumers_lock;
+  GList *consumers;
+};
+
+typedef struct _LogQueueDiskConsumer
+{
+  LogQueue super;
+  LogQueueDiskConsumers *consumers;
+
+  /* entries popped by this consumer, oldest first */
+  GQueue *in_flight;
+} LogQueueDiskConsumer;
+
+static LogQueueDiskConsumers *
+_consumers_ref(LogQueueDiskConsumers *self)
+{
+  g_atomic_counter_inc(&self->ref_cnt);
+  return self;
+}
+
+static void
+_consumers_free(LogQueueDiskConsumers *self)
+{
+  g_assert(self->consumers == NULL);
+
+  g_queue_free(self->in_flight);
+  g_queue_free(self->redeliver);
+  g_mutex_clear(&self->lock);
+  g_mutex_clear(&self->consumers_lock);
+  log_queue_unref(self->queue);
+  g_free(self);
+}
+
+static gint
+_compare_entries(gconstpointer a, gconstpointer b, gpointer user_data)
+{
+  const InFlightEntry *entry_a = (const InFlightEntry *) a;
+  const InFlightEntry *entry_b = (const InFlightEntry *) b;
+
+  return (entry_a->id > entry_b->id) - (entry_a->id < entry_b->id);
+}
+
+/*
+ * Wakes up the consumers waiting for messages (the ones that registered a
+ * push notification of their own), or only the first of them if
+ * @wake_up_all is FALSE.  Returns TRUE if there are consumers that are
+ * still waiting.
+ */
+static gboolean
+_wake_up_consumers(LogQueueDiskConsumers *self, gboolean wake_up_all)
+{
+  gboolean woken_up = FALSE;
+  gboolean still_waiting = FALSE;
+
+  g_mutex_lock(&self->consumers_lock);
+  for (GList *l = self->consumers; l && !still_waiting; l = l->next)
+    {
+      LogQueue *consumer = (LogQueue *) l->data;
+
+      g_mutex_lock(&consumer->lock);
+      if (consumer->parallel_push_notify)
+        {
+          if (wake_up_all || !woken_up)
+            {
+              log_queue_push_notify(consumer);
+              woken_up = TRUE;
+            }
+          else
+            {
+              still_waiting = TRUE;
+            }
+        }
+      g_mutex_unlock(&consumer->lock);
+    }
+  g_mutex_unlock(&self->consumers_lock);
+
+  return still_waiting;
+}
+
+static void _arm_push_notify(LogQueueDiskConsumers *self);
+
+/*
+ * The notification of the disk-buffer is one-shot, it is armed by the
+ * consumers that are about to wait for messages (see _get_length()), and
+ * a push wakes up only one of them.  It is re-armed for the next push only
+ * if other consumers are still waiting, so a busy disk-buffer doesn't wake
+ * up the consumers for every single message.
+ */
+static void
+_queue_push_notify(gpointer user_data)
+{
+  LogQueueDiskConsumers *self = (LogQueueDiskConsumers *) user_data;
+
+  if (_wake_up_consumers(self, FALSE))
+    _arm_push_notify(self);
+}
+
+static void
+_arm_push_notify(LogQueueDiskConsumers *self)
+{
+  log_queue_set_parallel_push(self->queue, _queue_push_notify, self, NULL);
+}
+
+/* called with self->consumers->lock held */
+static InFlightEntry *
+_track_popped_message(LogQueueDiskConsumer *self, LogMessage *msg, const LogPathOptions *path_options)
+{
+  LogQueueDiskConsumers *consumers = self->consumers;
+  InFlightEntry *entry = g_new0(InFlightEntry, 1);
+
+  entry->id = consumers->next_id++;
+  entry->msg = msg;
+  entry->path_options = *path_options;
+  g_queue_push_tail(consumers->in_flight, entry);
+  return entry;
+}
+
+/* called with self->consumers->lock held */
+static gint
+_pop_redelivered_locked(LogQueueDiskConsumer *self, LogMessage **msgs, LogPathOptions *path_options, gint max_msgs)
+{
+  LogQueueDiskConsumers *consumers = self->consumers;
+  gint n = 0;
+
+  while (n < max_msgs && !g_queue_is_empty(consumers->redeliver))
+    {
+      InFlightEntry *entry = g_queue_pop_head(consumers->redeliver);
+
+      g_queue_push_tail(self->in_flight, entry);
+      msgs[n] = log_msg_ref(entry->msg);
+      path_options[n] = entry->path_options;
+      n++;
+    }
+
+  if (n > 0)
+    log_queue_queued_messages_sub(consumers->queue, n);
+  return n;
+}
+
+static void _ack_contiguous_entries_locked(LogQueueDiskConsumers *self);
+
+/* called with self->consumers->lock held */
+static void
+_ack_in_flight_message_locked(LogQueueDiskConsumer *self, LogMessage *msg)
+{
+  for (GList *l = self->in_flight->tail; l; l = l->prev)
+    {
+      InFlightEntry *entry = (InFlightEntry *) l->data;
+
+      if (entry->msg != msg)
+        continue;
+
+      g_queue_delete_link(self->in_flight, l);
+      entry->acked = TRUE;
+      log_msg_unref(entry->msg);
+      entry->msg = NULL;
+      break;
+    }
+  _ack_contiguous_entries_locked(self->consumers);
+}
+
+/*
+ * Deserializes the messages of the batch that were popped as records.  The
+ * ones that can't be deserialized are acked and removed from the batch,
+ * just like the disk-buffer skips them when it deserializes them itself.
+ * Returns the number of messages remaining in the batch.
+ */
+static gint
+_deserialize_popped_messages(LogQueueDiskConsumer *self, LogMessage **msgs, LogPathOptions *path_options,
+                             GString **records, gint n)
+{
+  LogQueueDiskConsumers *consumers = self->consumers;
+  gint remaining = 0;
+
+  for (gint i = 0; i < n; i++)
+    {
+      if (!records[i] || log_queue_disk_deserialize_popped_msg(consumers->queue, msgs[i], records[i]))
+        {
+          msgs[remaining] = msgs[i];
+          path_options[remaining] = path_options[i];
+          remaining++;
+        }
+      else
+        {
+          g_mutex_lock(&consumers->lock);
+          _ack_in_flight_message_locked(self, msgs[i]);
+          g_mutex_unlock(&consumers->lock);
+          log_msg_unref(msgs[i]);
+        }
+
+      if (records[i])
+        g_string_free(records[i], TRUE);
+    }
+
+  return remaining;
+}
+
+static gint
+_pop_head_batch(LogQueue *s, LogMessage **msgs, LogPathOptions *path_options, gint max_msgs)
+{
+  LogQueueDiskConsumer *self = (LogQueueDiskConsumer *) s;
+  LogQueueDiskConsumers *consumers = self->consumers;
+  GString **records = NULL;
+  gint popped = 0;
+
+  g_mutex_lock(&consumers->lock);
+
+  gint n = _pop_redelivered_locked(self, msgs, path_options, max_msgs);
+  if (n < max_msgs)
+    {
+      records = g_new0(GString *, max_msgs - n);
+      popped = log_queue_disk_pop_head_batch_serialized(consumers->queue, &msgs[n], records, &path_options[n],
+                                                         max_msgs - n);
+
+      for (gint i = n; i < n + popped; i++)
+        {
+          InFlightEntry *entry = _track_popped_message(self, msgs[i], &path_options[i]);
+
+          g_queue_push_tail(self->in_flight, entry);
+          log_msg_ref(entry->msg);
+        }
+    }
+
+  g_mutex_unlock(&consumers->lock);
+
+  if (popped > 0)
+    n += _deserialize_popped_messages(self, &msgs[n], &path_options[n], records, popped);
+  g_free(records);
+
+  return n;
+}
+
+static LogMessage *
+_pop_head(LogQueue *s, LogPathOptions *path_options)
+{
+  LogMessage *msg;
+
+  if (_pop_head_batch(s, &msg, path_options, 1) == 0)
+    return NULL;
+  return msg;
+}
+
+static LogMessage *
+_peek_head(LogQueue *s)
+{
+  LogQueueDiskConsumer *self = (LogQueueDiskConsumer *) s;
+  LogQueueDiskConsumers *consumers = self->consumers;
+  LogMessage *msg;
+
+  g_mutex_lock(&consumers->lock);
+  InFlightEntry *entry = g_queue_peek_head(consumers->redeliver);
+  msg = entry ? entry->msg : log_queue_peek_head(consumers->queue);
+  g_mutex_unlock(&consumers->lock);
+
+  return msg;
+}
+
+static void
+_push_tail(LogQueue *s, LogMessage *msg, const LogPathOptions *path_options)
+{
+  LogQueueDiskConsumer *self = (LogQueueDiskConsumer *) s;
+
+  log_queue_push_tail(self->consumers->queue, msg, path_options);
+}
+
+/* called with consumers->lock held */
+static gint64
+_get_length_locked(LogQueueDiskConsumers *consumers)
+{
+  return log_queue_get_length(consumers->queue) + g_queue_get_length(consumers->redeliver);
+}
+
+/*
+ * log_queue_check_items() registers the consumer to wait for messages if
+ * this returns 0, so the notification of the disk-buffer is armed first,
+ * and the length is checked again, so that a message pushed in between is
+ * not missed.  The notification can't fire before the registration, as it
+ * wakes up the consumers under their lock, which is held by the caller.
+ */
+static gint64
+_get_length(LogQueue *s)
+{
+  LogQueueDiskConsumer *self = (LogQueueDiskConsumer *) s;
+  LogQueueDiskConsumers *consumers = self->consumers;
+
+  g_mutex_lock(&consumers->lock);
+  gint64 length = _get_length_locked(consumers);
+  if (length == 0)
+    {
+      _arm_push_notify(consumers);
+      length = _get_length_locked(consumers);
+    }
+  g_mutex_unlock(&consumers->lock);
+
+  return length;
+}
+
+/* called with self->consumers->lock held */
+static void
+_ack_contiguous_entries_locked(LogQueueDiskConsumers *self)
+{
+  gint n = 0;
+
+  while (!g_queue_is_empty(self->in_flight))
+    {
+      InFlightEntry *entry = g_queue_peek_head(self->in_flight);
+
+      if (!entry->acked)
+        break;
+
+      g_queue_pop_head(self->in_flight);
+      g_free(entry);
+      n++;
+    }
+
+  if (n > 0)
+    log_queue_ack_backlog(self->queue, n);
+}
+
+static void
+_ack_backlog(LogQueue *s, gint num_msg_to_ack)
+{
+  LogQueueDiskConsumer *self = (LogQueueDiskConsumer *) s;
+  LogQueueDiskConsumers *consumers = self->consumers;
+
+  g_mutex_lock(&consumers->lock);
+
+  for (gint i = 0; i < num_msg_to_ack && !g_queue_is_empty(self->in_flight); i++)
+    {
+      InFlightEntry *entry = g_queue_pop_head(self->in_flight);
+
+      entry->acked = TRUE;
+      log_msg_unref(entry->msg);
+      entry->msg = NULL;
+    }
+  _ack_contiguous_entries_locked(consumers);
+
+  g_mutex_unlock(&consumers->lock);
+}
+
+static guint
+_rewind_in_flight(LogQueueDiskConsumer *self, guint rewind_count)
+{
+  LogQueueDiskConsumers *consumers = self->consumers;
+  guint n = 0;
+
+  g_mutex_lock(&consumers->lock);
+
+  while (n < rewind_count && !g_queue_is_empty(self->in_flight))
+    {
+      InFlightEntry *entry = g_queue_pop_tail(self->in_flight);
+
+      g_queue_insert_sorted(consumers->redeliver, entry, _compare_entries, NULL);
+      n++;
+    }
+
+  if (n > 0)
+    log_queue_queued_messages_add(consumers->queue, n);
+
+  g_mutex_unlock(&consumers->lock);
+  return n;
+}
+
+static void
+_rewind_backlog(LogQueue *s, guint rewind_count)
+{
+  LogQueueDiskConsumer *self = (LogQueueDiskConsumer *) s;
+
+  if (_rewind_in_flight(self, rewind_count) > 0)
+    _wake_up_consumers(self->consumers, TRUE);
+}
+
+static void
+_rewind_backlog_all(LogQueue *s)
+{
+  _rewind_backlog(s, G_MAXUINT);
+}
+
+static void
+_free(LogQueue *s)
+{
+  LogQueueDiskConsumer *self = (LogQueueDiskConsumer *) s;
+
+  g_assert(g_queue_is_empty(self->in_flight));
+  g_queue_free(self->in_flight);
+  log_queue_disk_consumers_unref(self->consumers);
+  log_queue_free_method(s);
+}
+
+static LogQueue *
+log_queue_disk_consumer_new(LogQueueDiskConsumers *consumers)
+{
+  LogQueueDiskConsumer *self = g_new0(LogQueueDiskConsumer, 1);
+
+  log_queue_init_instance(&self->super, NULL, STATS_LEVEL0, NULL, NULL);
+  self->super.type = log_queue_disk_consumer_type;
+  self->super.shared_by_workers = TRUE;
+  self->super.get_length = _get_length;
+  self->super.push_tail = _push_tail;
+  self->super.pop_head = _pop_head;
+  self->super.pop_head_batch = _pop_head_batch;
+  self->super.peek_head = _peek_head;
+  self->super.ack_backlog = _ack_backlog;
+  self->super.rewind_backlog = _rewind_backlog;
+  self->super.rewind_backlog_all = _rewind_backlog_all;
+  self->super.free_fn = _free;
+
+  self->consumers = _consumers_ref(consumers);
+  self->in_flight = g_queue_new();
+  return &self->super;
+}
+
+LogQueue *
+log_queue_disk_consumers_add_consumer(LogQueueDiskConsumers *self)
+{
+  LogQueue *consumer = log_queue_disk_consumer_new(self);
+
+  g_mutex_lock(&self->consumers_lock);
+  self->consumers = g_list_append(self->consumers, log_queue_ref(consumer));
+  g_mutex_unlock(&self->consumers_lock);
+
+  return consumer;
+}
+
+/*
+ * The messages the consumer has not acknowledged are rewound, so that the
+ * remaining consumers deliver them.  When the last consumer is removed,
+ * everything that is not acknowledged is rewound to the disk-buffer
+ * itself, so that it can be stopped (and saved) as usual.  Returns TRUE
+ * if it was the last consumer.
+ */
+gboolean
+log_queue_disk_consumers_remove_consumer(LogQueueDiskConsumers *self, LogQueue *consumer)
+{
+  _rewind_in_flight((LogQueueDiskConsumer *) consumer, G_MAXUINT);
+
+  g_mutex_lock(&self->consumers_lock);
+  GList *link = g_list_find(self->consumers, consumer);
+  g_assert(link);
+  self->consumers = g_list_delete_link(self->consumers, link);
+  gboolean last_consumer = (self->consumers == NULL);
+  g_mutex_unlock(&self->consumers_lock);
+
+  log_queue_unref(consumer);
+
+  if (!last_consumer)
+    {
+      _wake_up_consumers(self, TRUE);
+      return FALSE;
+    }
+
+  log_queue_reset_parallel_push(self->queue);
+
+  g_mutex_lock(&self->lock);
+  /* rewind_backlog_all() counts the redelivered messages again */
+  log_queue_queued_messages_sub(self->queue, g_queue_get_length(self->redeliver));
+  g_queue_clear(self->redeliver);
+  while (!g_queue_is_empty(self->in_flight))
+    {
+      InFlightEntry *entry = g_queue_pop_head(self->in_flight);
+
+      if (entry->msg)
+        log_msg_unref(entry->msg);
+      g_free(entry);
+    }
+  log_queue_rewind_backlog_all(self->queue);
+  g_mutex_unlock(&self->lock);
+
+  return TRUE;
+}
+
+LogQueue *
+log_queue_disk_consumers_get_queue(LogQueueDiskConsumers *self)
+{
+  return self->queue;
+}
+
+/* takes over the reference of @queue */
+LogQueueDiskConsumers *
+log_queue_disk_consumers_new(LogQueue *queue)
+{
+  LogQueueDiskConsumers *self = g_new0(LogQueueDiskConsumers, 1);
+
+  g_atomic_counter_set(&self->ref_cnt, 1);
+  self->queue = queue;
+  g_mutex_init(&self->lock);
+  self->in_flight = g_queue_new();
+  self->redeliver = g_queue_new();
+  g_mutex_init(&self->consumers_lock);
+
+  /* the backlog of a previous run is delivered again by any of the consumers */
+  log_queue_rewind_backlog_all(self->queue);
+
+  return self;
+}
+
+void
+log_queue_disk_consumers_unref(LogQueueDiskConsumers *self)
+{
+  if (g_atomic_counter_dec_and_test(&self->ref_cnt))
+    _consumers_free(self);
+}
@@ -0,0 +1,38 @@
+/*
+ * Copyright (c) 2026 Axoflow
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#ifndef LOGQUEUE_DISK_CONSUMERS_H_INCLUDED
+#define LOGQUEUE_DISK_CONSUMERS_H_INCLUDED
+
+#include "logqueue.h"
+
+typedef struct _LogQueueDiskConsumers LogQueueDiskConsumers;
+
+extern QueueType log_queue_disk_consumer_type;
+
+LogQueueDiskConsumers *log_queue_disk_consumers_new(LogQueue *queue);
+LogQueue *log_queue_disk_consumers_get_queue(LogQueueDiskConsumers *self);
+LogQueue *log_queue_disk_consumers_add_consumer(LogQueueDiskConsumers *self);
+gboolean log_queue_disk_consumers_remove_consumer(LogQueueDiskConsumers *self, LogQueue *consumer);
+void log_queue_disk_consumers_unref(LogQueueDiskConsumers *self);
+
+#endif
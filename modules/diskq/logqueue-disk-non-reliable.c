@@ -151,6 +151,8 @@ _move_messages_from_overflow(LogQueueDiskNonReliable *self)
             }
         }
     }
+
+  log_queue_disk_schedule_flush(&self->super);
 }
 
 static gboolean
@@ -162,7 +164,7 @@ _move_messages_from_disk_to_front_cache(LogQueueDiskNonReliable *self)
         break;
 
       LogPathOptions path_options;
-      LogMessage *msg = log_queue_disk_read_message(&self->super, &path_options);
+      LogMessage *msg = log_queue_disk_read_message(&self->super, &path_options, NULL);
 
       if (!msg)
         return FALSE;
@@ -177,15 +179,20 @@ _move_messages_from_disk_to_front_cache(LogQueueDiskNonReliable *self)
   return TRUE;
 }
 
+/*
+ * The front cache is not refilled from the disk for consumers that
+ * deserialize the messages themselves, it would deserialize them under the
+ * lock.  They pop the messages from the disk instead, in the same order.
+ */
 static inline gboolean
-_maybe_move_messages_among_queue_segments(LogQueueDiskNonReliable *self)
+_maybe_move_messages_among_queue_segments(LogQueueDiskNonReliable *self, gboolean refill_front_cache)
 {
   gboolean ret = TRUE;
 
   if (qdisk_is_read_only(self->super.qdisk))
     return TRUE;
 
-  if (self->front_cache->length == 0 && self->front_cache_size > 0)
+  if (refill_front_cache && self->front_cache->length == 0 && self->front_cache_size > 0)
     ret = _move_messages_from_disk_to_front_cache(self);
 
   if (self->flow_control_window->length > 0)
@@ -302,14 +309,16 @@ success:
   return msg;
 }
 
+/* must be called with the queue's lock held, see log_queue_disk_read_message() about @record */
 static LogMessage *
-_pop_head(LogQueue *s, LogPathOptions *path_options)
+_pop_head_locked(LogQueue *s, LogPathOptions *path_options, GString **record)
 {
   LogQueueDiskNonReliable *self = (LogQueueDiskNonReliable *)s;
   LogMessage *msg = NULL;
   gboolean stats_update = TRUE;
 
-  g_mutex_lock(&s->lock);
+  if (record)
+    *record = NULL;
 
   if (self->front_cache->length > 0)
     {
@@ -318,7 +327,7 @@ _pop_head(LogQueue *s, LogPathOptions *path_options)
         goto success;
     }
 
-  msg = log_queue_disk_read_message(&self->super, path_options);
+  msg = log_queue_disk_read_message(&self->super, path_options, record);
   if (msg)
     goto success;
 
@@ -326,19 +335,15 @@ _pop_head(LogQueue *s, LogPathOptions *path_options)
     msg = _pop_head_flow_control_window(self, path_options);
 
   if (!msg)
-    {
-      g_mutex_unlock(&s->lock);
-      return NULL;
-    }
+    return NULL;
 
 success:
-  if (!_maybe_move_messages_among_queue_segments(self))
+  if (!_maybe_move_messages_among_queue_segments(self, record == NULL))
     {
       stats_update = FALSE;
     }
 
   log_queue_disk_update_disk_related_counters(&self->super);
-  g_mutex_unlock(&s->lock);
 
   _push_tail_backlog(self, msg, path_options);
 
@@ -348,6 +353,43 @@ success:
   return msg;
 }
 
+static LogMessage *
+_pop_head(LogQueue *s, LogPathOptions *path_options)
+{
+  g_mutex_lock(&s->lock);
+  LogMessage *msg = _pop_head_locked(s, path_options, NULL);
+  g_mutex_unlock(&s->lock);
+
+  return msg;
+}
+
+static gint
+_pop_head_batch(LogQueue *s, LogMessage **msgs, LogPathOptions *path_options, gint max_msgs)
+{
+  gint n = 0;
+
+  g_mutex_lock(&s->lock);
+  while (n < max_msgs && (msgs[n] = _pop_head_locked(s, &path_options[n], NULL)))
+    n++;
+  g_mutex_unlock(&s->lock);
+
+  return n;
+}
+
+static gint
+_pop_head_batch_serialized(LogQueueDisk *s, LogMessage **msgs, GString **records,
+                           LogPathOptions *path_options, gint max_msgs)
+{
+  gint n = 0;
+
+  g_mutex_lock(&s->super.lock);
+  while (n < max_msgs && (msgs[n] = _pop_head_locked(&s->super, &path_options[n], &records[n])))
+    n++;
+  g_mutex_unlock(&s->super.lock);
+
+  return n;
+}
+
 /* _is_msg_serialization_needed_hint() must be called without holding the queue's lock.
  * This can only be used _as a hint_ for performance considerations, because as soon as the lock
  * is released, there will be no guarantee that the result of this function remain correct. */
@@ -415,6 +457,7 @@ _push_tail_disk(LogQueueDiskNonReliable *self, LogMessage *msg, const LogPathOpt
   gboolean result = _ensure_serialized_and_write_to_disk(self, msg, serialized_msg);
   if (result)
     {
+      log_queue_disk_schedule_flush(&self->super);
       log_msg_ack(msg, path_options, AT_PROCESSED);
       log_msg_unref(msg);
     }
@@ -424,29 +467,27 @@ _push_tail_disk(LogQueueDiskNonReliable *self, LogMessage *msg, const LogPathOpt
   return result;
 }
 
-static void
-_push_tail(LogQueue *s, LogMessage *msg, const LogPathOptions *path_options)
+static gboolean
+_serialize_msg(LogQueueDiskNonReliable *self, LogMessage *msg, const LogPathOptions *path_options,
+               GString *serialized_msg)
 {
-  LogQueueDiskNonReliable *self = (LogQueueDiskNonReliable *)s;
-
-  ScratchBuffersMarker marker;
-  GString *serialized_msg = NULL;
-
-  if (_is_msg_serialization_needed_hint(self))
+  if (!log_queue_disk_serialize_msg(&self->super, msg, serialized_msg))
     {
-      serialized_msg = scratch_buffers_alloc_and_mark(&marker);
-      if (!log_queue_disk_serialize_msg(&self->super, msg, serialized_msg))
-        {
-          msg_error("Failed to serialize message for non-reliable disk-buffer, dropping message",
-                    evt_tag_str("filename", qdisk_get_filename(self->super.qdisk)),
-                    evt_tag_str("persist_name", s->persist_name));
-          log_queue_disk_drop_message(&self->super, msg, path_options);
-          scratch_buffers_reclaim_marked(marker);
-          return;
-        }
+      msg_error("Failed to serialize message for non-reliable disk-buffer, dropping message",
+                evt_tag_str("filename", qdisk_get_filename(self->super.qdisk)),
+                evt_tag_str("persist_name", self->super.super.persist_name));
+      log_queue_disk_drop_message(&self->super, msg, path_options);
+      return FALSE;
     }
+  return TRUE;
+}
 
-  g_mutex_lock(&s->lock);
+/* lock must be held, returns FALSE if the message was dropped */
+static gboolean
+_push_tail_unlocked(LogQueueDiskNonReliable *self, LogMessage *msg, const LogPathOptions *path_options,
+                    GString *serialized_msg)
+{
+  LogQueue *s = &self->super.super;
 
   /* we push messages into queue segments in the following order: flow_control_window, disk, front_cache */
   if (_can_push_to_front_cache(self))
@@ -470,23 +511,82 @@ _push_tail(LogQueue *s, LogMessage *msg, const LogPathOptions *path_options)
                 evt_tag_long("capacity_bytes", qdisk_get_maximum_size(self->super.qdisk)),
                 evt_tag_str("persist_name", s->persist_name));
       log_queue_disk_drop_message(&self->super, msg, path_options);
-      goto exit;
+      return FALSE;
     }
 
 queued:
   log_queue_queued_messages_inc(s);
+  return TRUE;
+}
 
-  /* this releases the queue's lock for a short time, which may violate the
-   * consistency of the disk-buffer, so it must be the last call under lock in this function
-   */
-  log_queue_push_notify(s);
+static void
+_push_tail(LogQueue *s, LogMessage *msg, const LogPathOptions *path_options)
+{
+  LogQueueDiskNonReliable *self = (LogQueueDiskNonReliable *)s;
 
-exit:
+  ScratchBuffersMarker marker;
+  GString *serialized_msg = NULL;
+
+  if (_is_msg_serialization_needed_hint(self))
+    {
+      serialized_msg = scratch_buffers_alloc_and_mark(&marker);
+      if (!_serialize_msg(self, msg, path_options, serialized_msg))
+        {
+          scratch_buffers_reclaim_marked(marker);
+          return;
+        }
+    }
+
+  g_mutex_lock(&s->lock);
+  if (_push_tail_unlocked(self, msg, path_options, serialized_msg))
+    {
+      /* this releases the queue's lock for a short time, which may violate the
+       * consistency of the disk-buffer, so it must be the last call under lock in this function
+       */
+      log_queue_push_notify(s);
+    }
   g_mutex_unlock(&s->lock);
+
   if (serialized_msg)
     scratch_buffers_reclaim_marked(marker);
 }
 
+/* the hint is taken once for the whole batch, messages that turn out to be
+ * serialized needlessly go to memory, the others are serialized under the lock */
+static void
+_push_tail_batch(LogQueueDisk *s, LogMessage **msgs, const LogPathOptions *path_options, gint n)
+{
+  LogQueueDiskNonReliable *self = (LogQueueDiskNonReliable *)s;
+  GString **serialized_msgs = g_new0(GString *, n);
+  gboolean *dropped = g_new0(gboolean, n);
+  gboolean pushed = FALSE;
+
+  ScratchBuffersMarker marker;
+  scratch_buffers_mark(&marker);
+  if (_is_msg_serialization_needed_hint(self))
+    {
+      for (gint i = 0; i < n; i++)
+        {
+          serialized_msgs[i] = scratch_buffers_alloc();
+          dropped[i] = !_serialize_msg(self, msgs[i], &path_options[i], serialized_msgs[i]);
+        }
+    }
+
+  g_mutex_lock(&s->super.lock);
+  for (gint i = 0; i < n; i++)
+    {
+      if (!dropped[i])
+        pushed |= _push_tail_unlocked(self, msgs[i], &path_options[i], serialized_msgs[i]);
+    }
+  if (pushed)
+    log_queue_push_notify(&s->super);
+  g_mutex_unlock(&s->super.lock);
+
+  scratch_buffers_reclaim_marked(marker);
+  g_free(dropped);
+  g_free(serialized_msgs);
+}
+
 static void
 _empty_queue(LogQueueDiskNonReliable *self, GQueue *q)
 {
@@ -569,6 +669,7 @@ _set_logqueue_virtual_functions(LogQueue *s)
   s->rewind_backlog = _rewind_backlog;
   s->rewind_backlog_all = _rewind_backlog_all;
   s->pop_head = _pop_head;
+  s->pop_head_batch = _pop_head_batch;
   s->peek_head = _peek_head;
   s->push_tail = _push_tail;
   s->free_fn = _free;
@@ -580,6 +681,8 @@ _set_logqueue_disk_virtual_functions(LogQueueDisk *s)
   s->start = _start;
   s->stop = _stop;
   s->stop_corrupted = _stop_corrupted;
+  s->push_tail_batch = _push_tail_batch;
+  s->pop_head_batch_serialized = _pop_head_batch_serialized;
 }
 
 static inline void
@@ -603,6 +706,7 @@ log_queue_disk_non_reliable_new(DiskQueueOptions *options, const gchar *filename
   self->flow_control_window = g_queue_new();
   self->front_cache_size = options->front_cache_size;
   self->flow_control_window_size = options->flow_control_window_size;
+  self->super.keeps_popped_messages = TRUE;
   _set_virtual_functions(self);
   return &self->super.super;
 }
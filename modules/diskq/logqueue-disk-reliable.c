@@ -253,14 +253,16 @@ exit:
   return msg;
 }
 
+/* must be called with the queue's lock held, see log_queue_disk_read_message() about @record */
 static LogMessage *
-_pop_head(LogQueue *s, LogPathOptions *path_options)
+_pop_head_locked(LogQueue *s, LogPathOptions *path_options, GString **record)
 {
   LogQueueDiskReliable *self = (LogQueueDiskReliable *)s;
   LogMessage *msg = NULL;
   gboolean qdisk_corrupt = FALSE;
 
-  g_mutex_lock(&s->lock);
+  if (record)
+    *record = NULL;
 
   if (_is_next_message_in_flow_control_window(self))
     {
@@ -294,14 +296,11 @@ _pop_head(LogQueue *s, LogPathOptions *path_options)
       goto exit;
     }
 
-  msg = log_queue_disk_read_message(&self->super, path_options);
+  msg = log_queue_disk_read_message(&self->super, path_options, record);
 
 exit:
   if (!msg)
-    {
-      g_mutex_unlock(&s->lock);
-      return NULL;
-    }
+    return NULL;
 
   log_queue_disk_update_disk_related_counters(&self->super);
   log_queue_queued_messages_dec(s);
@@ -309,10 +308,46 @@ exit:
   if (qdisk_corrupt)
     log_queue_disk_restart_corrupted(&self->super);
 
+  return msg;
+}
+
+static LogMessage *
+_pop_head(LogQueue *s, LogPathOptions *path_options)
+{
+  g_mutex_lock(&s->lock);
+  LogMessage *msg = _pop_head_locked(s, path_options, NULL);
   g_mutex_unlock(&s->lock);
+
   return msg;
 }
 
+static gint
+_pop_head_batch(LogQueue *s, LogMessage **msgs, LogPathOptions *path_options, gint max_msgs)
+{
+  gint n = 0;
+
+  g_mutex_lock(&s->lock);
+  while (n < max_msgs && (msgs[n] = _pop_head_locked(s, &path_options[n], NULL)))
+    n++;
+  g_mutex_unlock(&s->lock);
+
+  return n;
+}
+
+static gint
+_pop_head_batch_serialized(LogQueueDisk *s, LogMessage **msgs, GString **records,
+                           LogPathOptions *path_options, gint max_msgs)
+{
+  gint n = 0;
+
+  g_mutex_lock(&s->super.lock);
+  while (n < max_msgs && (msgs[n] = _pop_head_locked(&s->super, &path_options[n], &records[n])))
+    n++;
+  g_mutex_unlock(&s->super.lock);
+
+  return n;
+}
+
 static inline gboolean
 _is_reserved_buffer_size_reached(LogQueueDiskReliable *self)
 {
@@ -326,24 +361,27 @@ _is_space_available_in_front_cache(LogQueueDiskReliable *self)
   return num_of_messages_in_front_cache < self->front_cache_size;
 }
 
-static void
-_push_tail(LogQueue *s, LogMessage *msg, const LogPathOptions *path_options)
+static gboolean
+_serialize_msg(LogQueueDiskReliable *self, LogMessage *msg, const LogPathOptions *path_options,
+               GString *serialized_msg)
 {
-  LogQueueDiskReliable *self = (LogQueueDiskReliable *)s;
-
-  ScratchBuffersMarker marker;
-  GString *serialized_msg = scratch_buffers_alloc_and_mark(&marker);
   if (!log_queue_disk_serialize_msg(&self->super, msg, serialized_msg))
     {
       msg_error("Failed to serialize message for reliable disk-buffer, dropping message",
                 evt_tag_str("filename", qdisk_get_filename(self->super.qdisk)),
-                evt_tag_str("persist_name", s->persist_name));
+                evt_tag_str("persist_name", self->super.super.persist_name));
       log_queue_disk_drop_message(&self->super, msg, path_options);
-      scratch_buffers_reclaim_marked(marker);
-      return;
+      return FALSE;
     }
+  return TRUE;
+}
 
-  g_mutex_lock(&s->lock);
+/* lock must be held, returns FALSE if the message was dropped */
+static gboolean
+_push_tail_unlocked(LogQueueDiskReliable *self, LogMessage *msg, const LogPathOptions *path_options,
+                    GString *serialized_msg)
+{
+  LogQueue *s = &self->super.super;
 
   gint64 message_position = qdisk_get_next_tail_position(self->super.qdisk);
   if (!qdisk_push_tail(self->super.qdisk, serialized_msg))
@@ -365,15 +403,12 @@ _push_tail(LogQueue *s, LogMessage *msg, const LogPathOptions *path_options)
                 suggestion);
 
       log_queue_disk_drop_message(&self->super, msg, path_options);
-      scratch_buffers_reclaim_marked(marker);
-      g_mutex_unlock(&s->lock);
-      return;
+      return FALSE;
     }
 
+  log_queue_disk_schedule_flush(&self->super);
   log_queue_disk_update_disk_related_counters(&self->super);
 
-  scratch_buffers_reclaim_marked(marker);
-
   if (_is_reserved_buffer_size_reached(self))
     {
       /*
@@ -384,7 +419,8 @@ _push_tail(LogQueue *s, LogMessage *msg, const LogPathOptions *path_options)
       goto exit;
     }
 
-  log_msg_ack(msg, path_options, AT_PROCESSED);
+  /* with batched writes the message is acked once its record is written */
+  log_queue_disk_ack_when_written(&self->super, msg, path_options);
 
   if (_is_space_available_in_front_cache(self))
     {
@@ -404,12 +440,64 @@ _push_tail(LogQueue *s, LogMessage *msg, const LogPathOptions *path_options)
 
 exit:
   log_queue_queued_messages_inc(s);
+  return TRUE;
+}
 
-  /* this releases the queue's lock for a short time, which may violate the
-   * consistency of the disk-buffer, so it must be the last call under lock in this function
-   */
-  log_queue_push_notify(s);
+static void
+_push_tail(LogQueue *s, LogMessage *msg, const LogPathOptions *path_options)
+{
+  LogQueueDiskReliable *self = (LogQueueDiskReliable *)s;
+
+  ScratchBuffersMarker marker;
+  GString *serialized_msg = scratch_buffers_alloc_and_mark(&marker);
+  if (!_serialize_msg(self, msg, path_options, serialized_msg))
+    {
+      scratch_buffers_reclaim_marked(marker);
+      return;
+    }
+
+  g_mutex_lock(&s->lock);
+  if (_push_tail_unlocked(self, msg, path_options, serialized_msg))
+    {
+      /* this releases the queue's lock for a short time, which may violate the
+       * consistency of the disk-buffer, so it must be the last call under lock in this function
+       */
+      log_queue_push_notify(s);
+    }
   g_mutex_unlock(&s->lock);
+
+  scratch_buffers_reclaim_marked(marker);
+}
+
+/* the messages are serialized first, then pushed under a single lock */
+static void
+_push_tail_batch(LogQueueDisk *s, LogMessage **msgs, const LogPathOptions *path_options, gint n)
+{
+  LogQueueDiskReliable *self = (LogQueueDiskReliable *)s;
+  GString **serialized_msgs = g_new(GString *, n);
+  gboolean pushed = FALSE;
+
+  ScratchBuffersMarker marker;
+  scratch_buffers_mark(&marker);
+  for (gint i = 0; i < n; i++)
+    {
+      serialized_msgs[i] = scratch_buffers_alloc();
+      if (!_serialize_msg(self, msgs[i], &path_options[i], serialized_msgs[i]))
+        serialized_msgs[i] = NULL;
+    }
+
+  g_mutex_lock(&s->super.lock);
+  for (gint i = 0; i < n; i++)
+    {
+      if (serialized_msgs[i])
+        pushed |= _push_tail_unlocked(self, msgs[i], &path_options[i], serialized_msgs[i]);
+    }
+  if (pushed)
+    log_queue_push_notify(&s->super);
+  g_mutex_unlock(&s->super.lock);
+
+  scratch_buffers_reclaim_marked(marker);
+  g_free(serialized_msgs);
 }
 
 static void
@@ -470,6 +558,7 @@ _set_logqueue_virtual_functions(LogQueue *s)
   s->rewind_backlog = _rewind_backlog;
   s->rewind_backlog_all = _rewind_backlog_all;
   s->pop_head = _pop_head;
+  s->pop_head_batch = _pop_head_batch;
   s->peek_head = _peek_head;
   s->push_tail = _push_tail;
   s->free_fn = _free;
@@ -480,6 +569,8 @@ _set_logqueue_disk_virtual_functions(LogQueueDisk *s)
 {
   s->start = _start;
   s->stop = _stop;
+  s->push_tail_batch = _push_tail_batch;
+  s->pop_head_batch_serialized = _pop_head_batch_serialized;
 }
 
 static inline void
@@ -0,0 +1,236 @@
+/*
+ * Copyright (c) 2026 Axoflow
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include "logqueue-disk-writer.h"
+#include "logpipe.h"
+#include "apphook.h"
+
+/*
+ * Writer thread of a disk-buffer
+ *
+ * Pushing a message to a disk-buffer serializes it and writes it to the
+ * file, which is expensive to do in the source threads.  With a writer
+ * thread, source threads only append the message to a pending batch, and
+ * the writer thread takes the whole batch at once and pushes it to the
+ * disk-buffer under a single lock, so writes remain sequential.
+ *
+ * Source threads never wait for the writer.  Flow-controlled messages are
+ * always accepted: they are acked only when the writer pushes them, so
+ * their number is bounded by the windows of the sources.  Other messages
+ * are dropped once queue_size messages are pending, like the messages
+ * pushed to a full disk-buffer.
+ *
+ * Consumers find the pending messages through
+ * log_queue_disk_writer_get_length() and may write them themselves with
+ * log_queue_disk_writer_write_pending(), writes are serialized by
+ * write_lock, so the order of the messages is kept.
+ *
+ * The queue is flushed after each batch, so batched writes are written
+ * with a single syscall.
+ */
+
+typedef struct _LogQueueDiskWriterBatch
+{
+  GArray *msgs;
+  GArray *path_options;
+} LogQueueDiskWriterBatch;
+
+struct _LogQueueDiskWriter
+{
+  LogQueue *queue;
+  LogQueueDiskWriterPushFunc push;
+  LogQueueDiskWriterFlushFunc flush;
+  LogQueueDiskWriterDropFunc drop;
+
+  GThread *thread;
+  GMutex lock;
+  GCond items_available;
+  gboolean exit_requested;
+  gint size;
+
+  /* pending messages, protected by lock */
+  LogQueueDiskWriterBatch pending;
+  gint num_not_flow_controlled;
+
+  /* pending messages and the ones being written */
+  gint len;
+
+  /* the batch being written, protected by write_lock */
+  GMutex write_lock;
+  LogQueueDiskWriterBatch batch;
+};
+
+static void
+_batch_init(LogQueueDiskWriterBatch *batch, gint size)
+{
+  batch->msgs = g_array_sized_new(FALSE, FALSE, sizeof(LogMessage *), size);
+  batch->path_options = g_array_sized_new(FALSE, FALSE, sizeof(LogPathOptions), size);
+}
+
+static void
+_batch_clear(LogQueueDiskWriterBatch *batch)
+{
+  g_assert(batch->msgs->len == 0);
+  g_array_free(batch->msgs, TRUE);
+  g_array_free(batch->path_options, TRUE);
+}
+
+/* returns TRUE if a batch was written */
+gboolean
+log_queue_disk_writer_write_pending(LogQueueDiskWriter *self)
+{
+  g_mutex_lock(&self->write_lock);
+
+  g_mutex_lock(&self->lock);
+  LogQueueDiskWriterBatch batch = self->batch;
+  self->batch = self->pending;
+  self->pending = batch;
+  self->num_not_flow_controlled = 0;
+  g_mutex_unlock(&self->lock);
+
+  gint n = self->batch.msgs->len;
+  if (n > 0)
+    {
+      self->push(self->queue, (LogMessage **) self->batch.msgs->data,
+                 (LogPathOptions *) self->batch.path_options->data, n);
+      if (self->flush)
+        self->flush(self->queue);
+
+      g_array_set_size(self->batch.msgs, 0);
+      g_array_set_size(self->batch.path_options, 0);
+      g_atomic_int_add(&self->len, -n);
+    }
+
+  g_mutex_unlock(&self->write_lock);
+  return n > 0;
+}
+
+static gpointer
+_writer_thread(gpointer user_data)
+{
+  LogQueueDiskWriter *self = (LogQueueDiskWriter *) user_data;
+
+  app_thread_start();
+
+  while (TRUE)
+    {
+      g_mutex_lock(&self->lock);
+      while (self->pending.msgs->len == 0 && !self->exit_requested)
+        g_cond_wait(&self->items_available, &self->lock);
+      gboolean exit_requested = self->exit_requested;
+      g_mutex_unlock(&self->lock);
+
+      /* pending messages are written before exiting */
+      if (!log_queue_disk_writer_write_pending(self) && exit_requested)
+        break;
+    }
+
+  app_thread_stop();
+  return NULL;
+}
+
+/* NOTE: consumes the reference passed by the caller, like log_queue_push_tail() */
+void
+log_queue_disk_writer_push(LogQueueDiskWriter *self, LogMessage *msg, const LogPathOptions *path_options)
+{
+  g_mutex_lock(&self->lock);
+  if (!path_options->flow_control_requested)
+    {
+      if (self->num_not_flow_controlled >= self->size)
+        {
+          g_mutex_unlock(&self->lock);
+          self->drop(self->queue, msg, path_options);
+          return;
+        }
+      self->num_not_flow_controlled++;
+    }
+
+  g_array_append_val(self->pending.msgs, msg);
+  g_array_append_vals(self->pending.path_options, path_options, 1);
+  g_atomic_int_inc(&self->len);
+
+  /* the writer only needs to be woken up if it may be sleeping */
+  if (self->pending.msgs->len == 1)
+    g_cond_signal(&self->items_available);
+  g_mutex_unlock(&self->lock);
+}
+
+gint
+log_queue_disk_writer_get_length(LogQueueDiskWriter *self)
+{
+  return g_atomic_int_get(&self->len);
+}
+
+LogQueueDiskWriter *
+log_queue_disk_writer_new(LogQueue *queue, LogQueueDiskWriterPushFunc push,
+                          LogQueueDiskWriterFlushFunc flush, LogQueueDiskWriterDropFunc drop, gint queue_size)
+{
+  LogQueueDiskWriter *self = g_new0(LogQueueDiskWriter, 1);
+
+  self->queue = queue;
+  self->push = push;
+  self->flush = flush;
+  self->drop = drop;
+  self->size = queue_size;
+  _batch_init(&self->pending, queue_size);
+  _batch_init(&self->batch, queue_size);
+
+  g_mutex_init(&self->lock);
+  g_mutex_init(&self->write_lock);
+  g_cond_init(&self->items_available);
+
+  self->thread = g_thread_new("diskq-writer", _writer_thread, self);
+  return self;
+}
+
+/* writes the pending messages and stops the writer thread */
+void
+log_queue_disk_writer_stop(LogQueueDiskWriter *self)
+{
+  if (!self->thread)
+    return;
+
+  g_mutex_lock(&self->lock);
+  self->exit_requested = TRUE;
+  g_cond_signal(&self->items_available);
+  g_mutex_unlock(&self->lock);
+
+  g_thread_join(self->thread);
+  self->thread = NULL;
+
+  /* messages pushed while the thread was exiting */
+  log_queue_disk_writer_write_pending(self);
+}
+
+void
+log_queue_disk_writer_free(LogQueueDiskWriter *self)
+{
+  log_queue_disk_writer_stop(self);
+
+  g_assert(log_queue_disk_writer_get_length(self) == 0);
+  g_cond_clear(&self->items_available);
+  g_mutex_clear(&self->write_lock);
+  g_mutex_clear(&self->lock);
+  _batch_clear(&self->batch);
+  _batch_clear(&self->pending);
+  g_free(self);
+}
@@ -0,0 +1,45 @@
+/*
+ * Copyright (c) 2026 Axoflow
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#ifndef LOGQUEUE_DISK_WRITER_H_INCLUDED
+#define LOGQUEUE_DISK_WRITER_H_INCLUDED
+
+#include "logqueue.h"
+
+#define LOG_QUEUE_DISK_WRITER_QUEUE_SIZE 1024
+
+typedef void (*LogQueueDiskWriterPushFunc)(LogQueue *queue, LogMessage **msgs, const LogPathOptions *path_options,
+                                           gint n);
+typedef void (*LogQueueDiskWriterFlushFunc)(LogQueue *queue);
+typedef void (*LogQueueDiskWriterDropFunc)(LogQueue *queue, LogMessage *msg, const LogPathOptions *path_options);
+typedef struct _LogQueueDiskWriter LogQueueDiskWriter;
+
+LogQueueDiskWriter *log_queue_disk_writer_new(LogQueue *queue, LogQueueDiskWriterPushFunc push,
+                                              LogQueueDiskWriterFlushFunc flush, LogQueueDiskWriterDropFunc drop,
+                                              gint queue_size);
+void log_queue_disk_writer_push(LogQueueDiskWriter *self, LogMessage *msg, const LogPathOptions *path_options);
+gboolean log_queue_disk_writer_write_pending(LogQueueDiskWriter *self);
+gint log_queue_disk_writer_get_length(LogQueueDiskWriter *self);
+void log_queue_disk_writer_stop(LogQueueDiskWriter *self);
+void log_queue_disk_writer_free(LogQueueDiskWriter *self);
+
+#endif
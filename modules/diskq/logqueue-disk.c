@@ -31,6 +31,7 @@
 #include "reloc.h"
 #include "qdisk.h"
 #include "scratch-buffers.h"
+#include "timeutils/misc.h"
 
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -46,12 +47,313 @@
 
 QueueType log_queue_disk_type = "DISK";
 
+static void
+_push_tail_via_writer(LogQueue *s, LogMessage *msg, const LogPathOptions *path_options)
+{
+  LogQueueDisk *self = (LogQueueDisk *) s;
+
+  log_queue_disk_writer_push(self->writer, msg, path_options);
+}
+
+static void
+_push_tail_batch(LogQueue *s, LogMessage **msgs, const LogPathOptions *path_options, gint n)
+{
+  LogQueueDisk *self = (LogQueueDisk *) s;
+
+  self->push_tail_batch(self, msgs, path_options, n);
+}
+
+static void
+_drop_message(LogQueue *s, LogMessage *msg, const LogPathOptions *path_options)
+{
+  log_queue_disk_drop_message((LogQueueDisk *) s, msg, path_options);
+}
+
+/* messages waiting for the writer thread are part of the queue */
+static gint64
+_get_length_via_writer(LogQueue *s)
+{
+  LogQueueDisk *self = (LogQueueDisk *) s;
+
+  return self->direct.get_length(s) + log_queue_disk_writer_get_length(self->writer);
+}
+
+/*
+ * A consumer that finds only messages waiting for the writer thread writes
+ * them itself, otherwise it would spin on the non-zero length until the
+ * writer thread wakes up.
+ */
+static gboolean
+_write_pending_messages(LogQueueDisk *self)
+{
+  if (log_queue_disk_writer_get_length(self->writer) == 0)
+    return FALSE;
+
+  log_queue_disk_writer_write_pending(self->writer);
+  return TRUE;
+}
+
+static LogMessage *
+_pop_head_via_writer(LogQueue *s, LogPathOptions *path_options)
+{
+  LogQueueDisk *self = (LogQueueDisk *) s;
+
+  LogMessage *msg = self->direct.pop_head(s, path_options);
+  if (!msg && _write_pending_messages(self))
+    msg = self->direct.pop_head(s, path_options);
+  return msg;
+}
+
+static gint
+_pop_head_batch_via_writer(LogQueue *s, LogMessage **msgs, LogPathOptions *path_options, gint max_msgs)
+{
+  LogQueueDisk *self = (LogQueueDisk *) s;
+
+  gint n = self->direct.pop_head_batch(s, msgs, path_options, max_msgs);
+  if (n == 0 && _write_pending_messages(self))
+    n = self->direct.pop_head_batch(s, msgs, path_options, max_msgs);
+  return n;
+}
+
+static LogMessage *
+_peek_head_via_writer(LogQueue *s)
+{
+  LogQueueDisk *self = (LogQueueDisk *) s;
+
+  LogMessage *msg = self->direct.peek_head(s);
+  if (!msg && _write_pending_messages(self))
+    msg = self->direct.peek_head(s);
+  return msg;
+}
+
+static void
+_start_writer(LogQueueDisk *self)
+{
+  g_assert(self->push_tail_batch);
+
+  self->direct.push_tail = self->super.push_tail;
+  self->direct.get_length = self->super.get_length;
+  self->direct.pop_head = self->super.pop_head;
+  self->direct.pop_head_batch = self->super.pop_head_batch;
+  self->direct.peek_head = self->super.peek_head;
+
+  self->writer = log_queue_disk_writer_new(&self->super, _push_tail_batch, log_queue_disk_flush, _drop_message,
+                                           LOG_QUEUE_DISK_WRITER_QUEUE_SIZE);
+
+  self->super.push_tail = _push_tail_via_writer;
+  self->super.get_length = _get_length_via_writer;
+  self->super.pop_head = _pop_head_via_writer;
+  self->super.pop_head_batch = _pop_head_batch_via_writer;
+  self->super.peek_head = _peek_head_via_writer;
+}
+
+static void
+_stop_writer(LogQueueDisk *self)
+{
+  if (!self->writer)
+    return;
+
+  /* pending messages are written to the queue before it is stopped */
+  log_queue_disk_writer_stop(self->writer);
+
+  self->super.push_tail = self->direct.push_tail;
+  self->super.get_length = self->direct.get_length;
+  self->super.pop_head = self->direct.pop_head;
+  self->super.pop_head_batch = self->direct.pop_head_batch;
+  self->super.peek_head = self->direct.peek_head;
+
+  log_queue_disk_writer_free(self->writer);
+  self->writer = NULL;
+}
+
+static void
+_ack_deferred_messages(LogQueueDisk *self, AckType ack_type)
+{
+  while (!g_queue_is_empty(self->deferred_acks))
+    {
+      LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+      LogMessage *msg = g_queue_pop_head(self->deferred_acks);
+
+      POINTER_TO_LOG_PATH_OPTIONS(g_queue_pop_head(self->deferred_acks), &path_options);
+      log_msg_ack(msg, &path_options, ack_type);
+      log_msg_unref(msg);
+    }
+}
+
+/* lock must be held */
+static void
+_flush_unlocked(LogQueueDisk *self)
+{
+  /* write and sync errors are logged by qdisk, the records are retried by
+   * the next flush, until then their messages stay unacked */
+  if (qdisk_flush(self->qdisk))
+    _ack_deferred_messages(self, AT_PROCESSED);
+  log_queue_disk_update_disk_related_counters(self);
+}
+
+void
+log_queue_disk_flush(LogQueue *s)
+{
+  LogQueueDisk *self = (LogQueueDisk *) s;
+
+  g_mutex_lock(&s->lock);
+  _flush_unlocked(self);
+  g_mutex_unlock(&s->lock);
+}
+
+static gboolean
+_is_sync_timer_needed(LogQueueDisk *self)
+{
+  DiskQueueOptions *options = qdisk_get_options(self->qdisk);
+
+  return options->reliable && options->sync_policy == DQSP_INTERVAL;
+}
+
+static void
+_sync_timer_arm(LogQueueDisk *self)
+{
+  iv_validate_now();
+  self->sync.timer.expires = iv_now;
+  timespec_add_msec(&self->sync.timer.expires, qdisk_get_options(self->qdisk)->sync_interval);
+  iv_timer_register(&self->sync.timer);
+}
+
+static void
+_sync_timer_start(LogQueueDisk *self)
+{
+  if (!_is_sync_timer_needed(self))
+    return;
+
+  self->sync.running = TRUE;
+  _sync_timer_arm(self);
+}
+
+static void
+_sync_timer_stop(LogQueueDisk *self)
+{
+  self->sync.running = FALSE;
+  if (iv_timer_registered(&self->sync.timer))
+    iv_timer_unregister(&self->sync.timer);
+}
+
+/* the records are synced by an I/O worker, so that fsync() does not block the main loop */
+static void
+_sync_timer_expired(gpointer s)
+{
+  LogQueueDisk *self = (LogQueueDisk *) s;
+
+  g_mutex_lock(&self->super.lock);
+  gboolean needs_sync = qdisk_started(self->qdisk) && qdisk_needs_flush(self->qdisk);
+  g_mutex_unlock(&self->super.lock);
+
+  if (!needs_sync || !main_loop_io_worker_job_submit(&self->sync.job, NULL))
+    _sync_timer_arm(self);
+}
+
+static void
+_sync_in_io_worker(gpointer s, gpointer arg)
+{
+  LogQueueDisk *self = (LogQueueDisk *) s;
+
+  g_mutex_lock(&self->super.lock);
+  if (qdisk_sync(self->qdisk))
+    _ack_deferred_messages(self, AT_PROCESSED);
+  log_queue_disk_update_disk_related_counters(self);
+  g_mutex_unlock(&self->super.lock);
+}
+
+static void
+_sync_completed(gpointer s, gpointer arg)
+{
+  LogQueueDisk *self = (LogQueueDisk *) s;
+
+  /* the queue may have been stopped while the job was running */
+  if (self->sync.running)
+    _sync_timer_arm(self);
+}
+
+static void
+_sync_job_engage(gpointer s)
+{
+  log_queue_ref((LogQueue *) s);
+}
+
+static void
+_sync_job_release(gpointer s)
+{
+  log_queue_unref((LogQueue *) s);
+}
+
+static gpointer
+_flush_at_the_end_of_batch(gpointer user_data)
+{
+  LogQueueDisk *self = (LogQueueDisk *) user_data;
+  gint thread_index = main_loop_worker_get_thread_index();
+  g_assert(thread_index >= 0);
+
+  log_queue_disk_flush(&self->super);
+  self->flush_callbacks[thread_index].registered = FALSE;
+  log_queue_unref(&self->super);
+  return NULL;
+}
+
+/*
+ * Records buffered by qdisk (see write-batch-bytes()) are written once the
+ * pushing worker thread finishes its batch, so that a whole batch is
+ * written with a single syscall.  Threads other than the main loop workers
+ * don't have batches, their records are written right away.
+ *
+ * lock must be held
+ */
+void
+log_queue_disk_schedule_flush(LogQueueDisk *self)
+{
+  if (!qdisk_needs_flush(self->qdisk))
+    return;
+
+  /* the writer thread flushes after each of its batches */
+  if (self->writer)
+    return;
+
+  gint thread_index = main_loop_worker_get_thread_index();
+  if (thread_index < 0 || thread_index >= self->num_flush_callbacks)
+    {
+      _flush_unlocked(self);
+      return;
+    }
+
+  if (self->flush_callbacks[thread_index].registered)
+    return;
+
+  /* the callback holds a reference, like the input queues of LogQueueFifo */
+  main_loop_worker_register_batch_callback(&self->flush_callbacks[thread_index].cb);
+  self->flush_callbacks[thread_index].registered = TRUE;
+  log_queue_ref(&self->super);
+}
+
+/* lock must be held */
+void
+log_queue_disk_ack_when_written(LogQueueDisk *self, LogMessage *msg, const LogPathOptions *path_options)
+{
+  if (!qdisk_needs_flush(self->qdisk))
+    {
+      log_msg_ack(msg, path_options, AT_PROCESSED);
+      return;
+    }
+
+  g_queue_push_tail(self->deferred_acks, log_msg_ref(msg));
+  g_queue_push_tail(self->deferred_acks, LOG_PATH_OPTIONS_TO_POINTER(path_options));
+}
+
 gboolean
 log_queue_disk_stop(LogQueue *s, gboolean *persistent)
 {
   LogQueueDisk *self = (LogQueueDisk *) s;
   g_assert(self->stop);
 
+  _sync_timer_stop(self);
+  _stop_writer(self);
+
   if (!qdisk_started(self->qdisk))
     {
       *persistent = FALSE;
@@ -59,7 +361,12 @@ log_queue_disk_stop(LogQueue *s, gboolean *persistent)
     }
 
   log_queue_queued_messages_sub(s, log_queue_get_length(s));
-  return self->stop(self, persistent);
+
+  /* stopping writes the buffered records, the messages of records that
+   * could not be written are aborted */
+  gboolean result = self->stop(self, persistent);
+  _ack_deferred_messages(self, result ? AT_PROCESSED : AT_ABORTED);
+  return result;
 }
 
 gboolean
@@ -76,6 +383,10 @@ log_queue_disk_start(LogQueue *s)
       log_queue_queued_messages_add(s, log_queue_get_length(s));
       log_queue_disk_update_disk_related_counters(self);
       stats_counter_set(self->metrics.capacity, B_TO_KiB(qdisk_get_max_useful_space(self->qdisk)));
+
+      if (self->writer_thread)
+        _start_writer(self);
+      _sync_timer_start(self);
       return TRUE;
     }
 
@@ -117,6 +428,38 @@ _unregister_counters(LogQueueDisk *self)
 
         stats_cluster_key_free(self->metrics.disk_allocated_sc_key);
       }
+
+    if (self->metrics.write_syscalls_sc_key)
+      {
+        stats_unregister_counter(self->metrics.write_syscalls_sc_key, SC_TYPE_SINGLE_VALUE,
+                                 &self->metrics.write_syscalls);
+
+        stats_cluster_key_free(self->metrics.write_syscalls_sc_key);
+      }
+
+    if (self->metrics.write_bytes_per_syscall_sc_key)
+      {
+        stats_unregister_counter(self->metrics.write_bytes_per_syscall_sc_key, SC_TYPE_SINGLE_VALUE,
+                                 &self->metrics.write_bytes_per_syscall);
+
+        stats_cluster_key_free(self->metrics.write_bytes_per_syscall_sc_key);
+      }
+
+    if (self->metrics.read_syscalls_sc_key)
+      {
+        stats_unregister_counter(self->metrics.read_syscalls_sc_key, SC_TYPE_SINGLE_VALUE,
+                                 &self->metrics.read_syscalls);
+
+        stats_cluster_key_free(self->metrics.read_syscalls_sc_key);
+      }
+
+    if (self->metrics.compression_ratio_sc_key)
+      {
+        stats_unregister_counter(self->metrics.compression_ratio_sc_key, SC_TYPE_SINGLE_VALUE,
+                                 &self->metrics.compression_ratio);
+
+        stats_cluster_key_free(self->metrics.compression_ratio_sc_key);
+      }
   }
   stats_unlock();
 }
@@ -127,6 +470,11 @@ log_queue_disk_free_method(LogQueueDisk *self)
   g_assert(!qdisk_started(self->qdisk));
   qdisk_free(self->qdisk);
 
+  g_assert(g_queue_is_empty(self->deferred_acks));
+  g_queue_free(self->deferred_acks);
+  g_free(self->flush_callbacks);
+  g_rw_lock_clear(&self->name_dict_lock);
+
   _unregister_counters(self);
 
   log_queue_free_method(&self->super);
@@ -137,10 +485,21 @@ log_queue_disk_update_disk_related_counters(LogQueueDisk *self)
 {
   stats_counter_set(self->metrics.disk_usage, B_TO_KiB(qdisk_get_used_useful_space(self->qdisk)));
   stats_counter_set(self->metrics.disk_allocated, B_TO_KiB(qdisk_get_file_size(self->qdisk)));
+
+  guint64 write_syscalls = qdisk_get_write_syscalls(self->qdisk);
+  stats_counter_set(self->metrics.write_syscalls, write_syscalls);
+  if (write_syscalls > 0)
+    stats_counter_set(self->metrics.write_bytes_per_syscall, qdisk_get_written_bytes(self->qdisk) / write_syscalls);
+  stats_counter_set(self->metrics.read_syscalls, qdisk_get_read_syscalls(self->qdisk));
+
+  guint64 compressed_bytes = qdisk_get_compressed_bytes(self->qdisk);
+  if (compressed_bytes > 0)
+    stats_counter_set(self->metrics.compression_ratio,
+                      qdisk_get_uncompressed_bytes(self->qdisk) * 100 / compressed_bytes);
 }
 
 static gboolean
-_pop_disk(LogQueueDisk *self, LogMessage **msg)
+_pop_disk(LogQueueDisk *self, LogMessage **msg, GString **record)
 {
   if (!qdisk_started(self->qdisk))
     return FALSE;
@@ -159,7 +518,13 @@ _pop_disk(LogQueueDisk *self, LogMessage **msg)
       return FALSE;
     }
 
-  if (!log_queue_disk_deserialize_msg(self, read_serialized, msg))
+  if (record)
+    {
+      /* deserialized by the caller, see log_queue_disk_deserialize_popped_msg() */
+      *record = g_string_new_len(read_serialized->str, read_serialized->len);
+      *msg = log_msg_new_empty();
+    }
+  else if (!log_queue_disk_deserialize_msg(self, read_serialized, msg))
     {
       msg_error("Cannot read correct message from disk-queue file",
                 evt_tag_str("filename", qdisk_get_filename(self->qdisk)),
@@ -205,8 +570,13 @@ _peek_disk(LogQueueDisk *self, LogMessage **msg)
   return TRUE;
 }
 
+/*
+ * If @record is not NULL, the record of the message is returned there, and
+ * the message returned is an empty one, which is filled in by
+ * log_queue_disk_deserialize_popped_msg() later.
+ */
 LogMessage *
-log_queue_disk_read_message(LogQueueDisk *self, LogPathOptions *path_options)
+log_queue_disk_read_message(LogQueueDisk *self, LogPathOptions *path_options, GString **record)
 {
   LogMessage *msg = NULL;
   do
@@ -215,7 +585,7 @@ log_queue_disk_read_message(LogQueueDisk *self, LogPathOptions *path_options)
         {
           break;
         }
-      if (!_pop_disk(self, &msg))
+      if (!_pop_disk(self, &msg, record))
         {
           msg_error("Error reading from disk-queue file, dropping disk queue",
                     evt_tag_str("filename", qdisk_get_filename(self->qdisk)));
@@ -271,7 +641,7 @@ log_queue_disk_peek_message(LogQueueDisk *self)
 void
 log_queue_disk_drop_message(LogQueueDisk *self, LogMessage *msg, const LogPathOptions *path_options)
 {
-  log_queue_dropped_messages_inc(&self->super);
+  log_queue_message_dropped(&self->super, msg);
 
   if (path_options->flow_control_requested)
     log_msg_drop(msg, path_options, AT_SUSPENDED);
@@ -302,6 +672,29 @@ _get_next_corrupted_filename(const gchar *filename)
   return NULL;
 }
 
+/* the segments are moved along with the file, so a new file with the
+ * same name doesn't pick them up */
+static void
+_rename_segments(const gchar *filename, const gchar *new_filename)
+{
+  GList *segment_filenames = qdisk_get_segment_filenames(filename);
+
+  for (GList *l = segment_filenames; l; l = l->next)
+    {
+      const gchar *segment_filename = l->data;
+      gchar *new_segment_filename = g_strconcat(new_filename, segment_filename + strlen(filename), NULL);
+
+      if (rename(segment_filename, new_segment_filename) < 0)
+        {
+          msg_error("Moving segment of corrupt disk-queue failed",
+                    evt_tag_str(EVT_TAG_FILENAME, segment_filename),
+                    evt_tag_error(EVT_TAG_OSERROR));
+        }
+      g_free(new_segment_filename);
+    }
+  g_list_free_full(segment_filenames, g_free);
+}
+
 static void
 _restart_diskq(LogQueueDisk *self)
 {
@@ -335,6 +728,10 @@ _restart_diskq(LogQueueDisk *self)
                 evt_tag_str(EVT_TAG_FILENAME, filename),
                 evt_tag_error(EVT_TAG_OSERROR));
     }
+  else
+    {
+      _rename_segments(filename, new_file);
+    }
   g_free(new_file);
 
   if (!self->start(self))
@@ -346,7 +743,9 @@ _restart_diskq(LogQueueDisk *self)
 void
 log_queue_disk_restart_corrupted(LogQueueDisk *self)
 {
+  g_rw_lock_writer_lock(&self->name_dict_lock);
   _restart_diskq(self);
+  g_rw_lock_writer_unlock(&self->name_dict_lock);
   log_queue_queued_messages_reset(&self->super);
   log_queue_disk_update_disk_related_counters(self);
   stats_counter_set(self->metrics.capacity, B_TO_KiB(qdisk_get_max_useful_space(self->qdisk)));
@@ -374,6 +773,33 @@ _register_counters(LogQueueDisk *self, gint stats_level, StatsClusterKeyBuilder
   }
   stats_cluster_key_builder_pop(builder);
 
+  stats_cluster_key_builder_push(builder);
+  {
+    stats_cluster_key_builder_set_name(builder, "write_syscalls_total");
+    self->metrics.write_syscalls_sc_key = stats_cluster_key_builder_build_single(builder);
+
+    stats_cluster_key_builder_set_name(builder, "read_syscalls_total");
+    self->metrics.read_syscalls_sc_key = stats_cluster_key_builder_build_single(builder);
+
+    /* average over the lifetime of the queue, shows how well writes are batched */
+    stats_cluster_key_builder_set_unit(builder, SCU_BYTES);
+    stats_cluster_key_builder_set_name(builder, "write_bytes_per_syscall");
+    self->metrics.write_bytes_per_syscall_sc_key = stats_cluster_key_builder_build_single(builder);
+  }
+  stats_cluster_key_builder_pop(builder);
+
+  if (qdisk_get_options(self->qdisk)->compression != DQC_NONE)
+    {
+      stats_cluster_key_builder_push(builder);
+      {
+        /* uncompressed size of the records relative to their stored size
+         * over the lifetime of the queue, 300 means 3:1 */
+        stats_cluster_key_builder_set_name(builder, "compression_ratio_percent");
+        self->metrics.compression_ratio_sc_key = stats_cluster_key_builder_build_single(builder);
+      }
+      stats_cluster_key_builder_pop(builder);
+    }
+
   stats_lock();
   {
     stats_register_counter(stats_level, self->metrics.capacity_sc_key, SC_TYPE_SINGLE_VALUE,
@@ -382,6 +808,15 @@ _register_counters(LogQueueDisk *self, gint stats_level, StatsClusterKeyBuilder
                            &self->metrics.disk_usage);
     stats_register_counter(stats_level, self->metrics.disk_allocated_sc_key, SC_TYPE_SINGLE_VALUE,
                            &self->metrics.disk_allocated);
+    stats_register_counter(stats_level, self->metrics.write_syscalls_sc_key, SC_TYPE_SINGLE_VALUE,
+                           &self->metrics.write_syscalls);
+    stats_register_counter(stats_level, self->metrics.write_bytes_per_syscall_sc_key, SC_TYPE_SINGLE_VALUE,
+                           &self->metrics.write_bytes_per_syscall);
+    stats_register_counter(stats_level, self->metrics.read_syscalls_sc_key, SC_TYPE_SINGLE_VALUE,
+                           &self->metrics.read_syscalls);
+    if (self->metrics.compression_ratio_sc_key)
+      stats_register_counter(stats_level, self->metrics.compression_ratio_sc_key, SC_TYPE_SINGLE_VALUE,
+                             &self->metrics.compression_ratio);
   }
   stats_unlock();
 }
@@ -405,6 +840,30 @@ log_queue_disk_init_instance(LogQueueDisk *self, DiskQueueOptions *options, cons
   self->super.type = log_queue_disk_type;
 
   self->compaction = options->compaction;
+  self->compact_serialization = options->compact_serialization;
+  self->writer_thread = options->writer_thread;
+  self->deferred_acks = g_queue_new();
+  g_rw_lock_init(&self->name_dict_lock);
+
+  self->num_flush_callbacks = main_loop_worker_get_max_number_of_threads();
+  self->flush_callbacks = g_malloc0_n(self->num_flush_callbacks, sizeof(*self->flush_callbacks));
+  for (gint i = 0; i < self->num_flush_callbacks; i++)
+    {
+      worker_batch_callback_init(&self->flush_callbacks[i].cb);
+      self->flush_callbacks[i].cb.func = _flush_at_the_end_of_batch;
+      self->flush_callbacks[i].cb.user_data = self;
+    }
+
+  IV_TIMER_INIT(&self->sync.timer);
+  self->sync.timer.handler = _sync_timer_expired;
+  self->sync.timer.cookie = self;
+
+  main_loop_io_worker_job_init(&self->sync.job);
+  self->sync.job.user_data = self;
+  self->sync.job.work = _sync_in_io_worker;
+  self->sync.job.completion = _sync_completed;
+  self->sync.job.engage = _sync_job_engage;
+  self->sync.job.release = _sync_job_release;
 
   self->qdisk = qdisk_new(options, qdisk_file_id, filename);
   _register_counters(self, stats_level, queue_sck_builder);
@@ -419,6 +878,8 @@ _serialize_msg(SerializeArchive *sa, gpointer user_data)
   LogQueueDisk *self = ((gpointer *) user_data)[0];
   LogMessage *msg = ((gpointer *) user_data)[1];
 
+  if (self->compact_serialization)
+    return log_msg_serialize_compact(msg, sa, qdisk_get_name_dict(self->qdisk));
   return log_msg_serialize(msg, sa, self->compaction ? LMSF_COMPACTION : 0);
 }
 
@@ -443,16 +904,19 @@ log_queue_disk_serialize_msg(LogQueueDisk *self, LogMessage *msg, GString *seria
 static gboolean
 _deserialize_msg(SerializeArchive *sa, gpointer user_data)
 {
-  LogMessage *msg = user_data;
+  LogQueueDisk *self = ((gpointer *) user_data)[0];
+  LogMessage *msg = ((gpointer *) user_data)[1];
 
-  return log_msg_deserialize(msg, sa);
+  /* the name dictionary of the file is used regardless of the current
+   * setting, the file may contain records in both formats */
+  return log_msg_deserialize_with_names(msg, sa, qdisk_get_name_dict(self->qdisk));
 }
 
 gboolean
 log_queue_disk_deserialize_msg(LogQueueDisk *self, GString *serialized, LogMessage **msg)
 {
   LogMessage *local_msg = log_msg_new_empty();
-  gpointer user_data = local_msg;
+  gpointer user_data[] = { self, local_msg };
   GError *error = NULL;
 
   if (!qdisk_deserialize(serialized, _deserialize_msg, user_data, &error))
@@ -469,3 +933,66 @@ log_queue_disk_deserialize_msg(LogQueueDisk *self, GString *serialized, LogMessa
 
   return TRUE;
 }
+
+/*
+ * Pops the messages like pop_head_batch() does, but the messages read from
+ * the disk are not deserialized under the lock of the queue: they are
+ * returned as empty messages, and their records are returned in @records
+ * (NULL for messages that were popped from the memory).  The caller
+ * deserializes them with log_queue_disk_deserialize_popped_msg() and frees
+ * the records.
+ */
+gint
+log_queue_disk_pop_head_batch_serialized(LogQueue *s, LogMessage **msgs, GString **records,
+                                         LogPathOptions *path_options, gint max_msgs)
+{
+  LogQueueDisk *self = (LogQueueDisk *) s;
+
+  gint n = self->pop_head_batch_serialized(self, msgs, records, path_options, max_msgs);
+  if (n == 0 && self->writer && _write_pending_messages(self))
+    n = self->pop_head_batch_serialized(self, msgs, records, path_options, max_msgs);
+  return n;
+}
+
+/*
+ * Deserializes @record into @msg, popped by
+ * log_queue_disk_pop_head_batch_serialized().  Can be called without the
+ * lock of the queue, by several threads at once.  If it fails, @msg stays
+ * in the backlog of the queue, and the caller has to ack it as if it was
+ * delivered.
+ */
+gboolean
+log_queue_disk_deserialize_popped_msg(LogQueue *s, LogMessage *msg, GString *record)
+{
+  LogQueueDisk *self = (LogQueueDisk *) s;
+  gpointer user_data[] = { self, msg };
+  GError *error = NULL;
+  gsize empty_size = log_msg_get_size(msg);
+
+  g_rw_lock_reader_lock(&self->name_dict_lock);
+  gboolean success = qdisk_deserialize(record, _deserialize_msg, user_data, &error);
+  g_rw_lock_reader_unlock(&self->name_dict_lock);
+
+  /* acking the message subtracts its current size */
+  if (self->keeps_popped_messages)
+    {
+      gsize size = log_msg_get_size(msg);
+
+      if (size > empty_size)
+        log_queue_memory_usage_add(s, size - empty_size);
+      else
+        log_queue_memory_usage_sub(s, empty_size - size);
+    }
+
+  if (!success)
+    {
+      msg_error("Error deserializing message from the disk-queue file",
+                evt_tag_str("error", error->message),
+                evt_tag_str("filename", qdisk_get_filename(self->qdisk)),
+                evt_tag_str("persist-name", self->super.persist_name));
+      g_error_free(error);
+      return FALSE;
+    }
+
+  return TRUE;
+}
@@ -28,6 +28,11 @@
 #include "logqueue.h"
 #include "qdisk.h"
 #include "logmsg/logmsg-serialize.h"
+#include "logqueue-disk-writer.h"
+#include "mainloop-worker.h"
+#include "mainloop-io-worker.h"
+
+#include <iv.h>
 
 typedef struct _LogQueueDisk LogQueueDisk;
 
@@ -46,16 +51,66 @@ struct _LogQueueDisk
     StatsClusterKey *capacity_sc_key;
     StatsClusterKey *disk_usage_sc_key;
     StatsClusterKey *disk_allocated_sc_key;
+    StatsClusterKey *write_syscalls_sc_key;
+    StatsClusterKey *write_bytes_per_syscall_sc_key;
+    StatsClusterKey *read_syscalls_sc_key;
+    StatsClusterKey *compression_ratio_sc_key;
 
     StatsCounterItem *capacity;
     StatsCounterItem *disk_usage;
     StatsCounterItem *disk_allocated;
+    StatsCounterItem *write_syscalls;
+    StatsCounterItem *write_bytes_per_syscall;
+    StatsCounterItem *read_syscalls;
+    StatsCounterItem *compression_ratio;
   } metrics;
 
   gboolean compaction;
+  gboolean compact_serialization;
+  gboolean writer_thread;
+  LogQueueDiskWriter *writer;
+  /* methods of the queue itself, wrapped while the writer thread runs */
+  struct
+  {
+    void (*push_tail)(LogQueue *s, LogMessage *msg, const LogPathOptions *path_options);
+    gint64 (*get_length)(LogQueue *s);
+    LogMessage *(*pop_head)(LogQueue *s, LogPathOptions *path_options);
+    gint (*pop_head_batch)(LogQueue *s, LogMessage **msgs, LogPathOptions *path_options, gint max_msgs);
+    LogMessage *(*peek_head)(LogQueue *s);
+  } direct;
+
+  /* batched writes are flushed when the pushing worker finishes its batch */
+  struct
+  {
+    WorkerBatchCallback cb;
+    gboolean registered;
+  } *flush_callbacks;
+  gint num_flush_callbacks;
+  /* messages acked only after their record is written and synced */
+  GQueue *deferred_acks;
+  /* syncs the last records of sync-policy(interval) once no flush follows them */
+  struct
+  {
+    struct iv_timer timer;
+    MainLoopIOWorkerJob job;
+    gboolean running;
+  } sync;
+
+  /* the popped messages are kept in memory until they are acked */
+  gboolean keeps_popped_messages;
+  /* records popped for deserialization refer to the name dictionary of
+   * the file, which is replaced when a corrupted file is restarted */
+  GRWLock name_dict_lock;
+
   gboolean (*start)(LogQueueDisk *s);
   gboolean (*stop)(LogQueueDisk *s, gboolean *persistent);
   gboolean (*stop_corrupted)(LogQueueDisk *s);
+  /* pushes the messages under a single lock, used by the writer thread */
+  void (*push_tail_batch)(LogQueueDisk *s, LogMessage **msgs, const LogPathOptions *path_options, gint n);
+  /* pops the messages read from the disk as records to be deserialized by the caller, see
+   * log_queue_disk_pop_head_batch_serialized() */
+  gint (*pop_head_batch_serialized)(LogQueueDisk *s, LogMessage **msgs, GString **records,
+                                    LogPathOptions *path_options, gint max_msgs);
 };
 
 extern QueueType log_queue_disk_type;
@@ -71,10 +126,17 @@ void log_queue_disk_restart_corrupted(LogQueueDisk *self);
 void log_queue_disk_free_method(LogQueueDisk *self);
 
 void log_queue_disk_update_disk_related_counters(LogQueueDisk *self);
-LogMessage *log_queue_disk_read_message(LogQueueDisk *self, LogPathOptions *path_options);
+void log_queue_disk_schedule_flush(LogQueueDisk *self);
+void log_queue_disk_flush(LogQueue *s);
+void log_queue_disk_ack_when_written(LogQueueDisk *self, LogMessage *msg, const LogPathOptions *path_options);
+LogMessage *log_queue_disk_read_message(LogQueueDisk *self, LogPathOptions *path_options, GString **record);
 LogMessage *log_queue_disk_peek_message(LogQueueDisk *self);
 void log_queue_disk_drop_message(LogQueueDisk *self, LogMessage *msg, const LogPathOptions *path_options);
 gboolean log_queue_disk_serialize_msg(LogQueueDisk *self, LogMessage *msg, GString *serialized);
 gboolean log_queue_disk_deserialize_msg(LogQueueDisk *self, GString *serialized, LogMessage **msg);
 
+gint log_queue_disk_pop_head_batch_serialized(LogQueue *s, LogMessage **msgs, GString **records,
+                                              LogPathOptions *path_options, gint max_msgs);
+gboolean log_queue_disk_deserialize_popped_msg(LogQueue *s, LogMessage *msg, GString *record);
+
 #endif
@@ -26,6 +26,7 @@
 #include "messages.h"
 #include "serialize.h"
 #include "logmsg/logmsg-serialize.h"
+#include "logmsg/nvtable-serialize.h"
 #include "stats/stats-registry.h"
 #include "reloc.h"
 #include "compat/lfs.h"
@@ -41,6 +42,10 @@
 #include <sys/types.h>
 #include <sys/file.h>
 
+#if SYSLOG_NG_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
 /* MADV_RANDOM not defined on legacy Linux systems. Could be removed in the
  * future, when support for Glibc 2.1.X drops.*/
 #ifndef MADV_RANDOM
@@ -49,9 +54,34 @@
 
 #define MAX_RECORD_LENGTH 100 * 1024 * 1024
 
+/* the top bit of the length of a record marks that its payload is
+ * compressed with the codec in the header */
+#define QDISK_RECORD_COMPRESSED 0x80000000
+#define QDISK_ZSTD_COMPRESSION_LEVEL 1
+
+#define QDISK_READ_AHEAD_SIZE (1024 * 1024)
+
+/* open segment files of segmented disk-buffers: the writer, the reader and the backlog */
+#define QDISK_SEGMENT_FDS 4
+
 #define PATH_QDISK              PATH_LOCALSTATEDIR
 
-#define QDISK_HDR_VERSION_CURRENT 3
+/* version 3 added capacity_bytes, files of older versions are upgraded
+ * when loaded */
+#define QDISK_HDR_VERSION_CAPACITY_BYTES 3
+/* records may use the compact serialization format, with their names in
+ * name_dict, see compact-serialization() */
+#define QDISK_HDR_VERSION_NAME_DICT 4
+/* records may be compressed, flagged by the top bit of their length, see
+ * compression() */
+#define QDISK_HDR_VERSION_COMPRESSION 5
+/* records are stored in segment files instead of the ring, see
+ * segment-size() */
+#define QDISK_HDR_VERSION_SEGMENTS 6
+/* records may be compressed with the dictionary identified by
+ * compression_dictionary_id, see compression-dictionary() */
+#define QDISK_HDR_VERSION_COMPRESSION_DICTIONARY 7
+#define QDISK_HDR_VERSION_CURRENT QDISK_HDR_VERSION_COMPRESSION_DICTIONARY
 
 #define QDISK_FILENAME_PREFIX "syslog-ng-"
 #define QDISK_FILENAME_IDX_FMT "%05d"
@@ -90,6 +120,22 @@ typedef union _QDiskFileHeader
 
     guint8 use_v1_wrap_condition;
     gint64 capacity_bytes;
+
+    /* names of the values in records using the compact serialization
+     * format, see NVNameDict.  Zero filled in files of older versions */
+    gchar name_dict[QDISK_NAME_DICT_SIZE];
+
+    /* DiskQueueCompression of the compressed records, zero (none) in
+     * files of older versions */
+    guint8 compression;
+
+    /* records are stored in segment files of this size instead of the
+     * ring in this file, zero in files of older versions */
+    gint64 segment_size;
+
+    /* zstd dictionary id of the dictionary the records are compressed
+     * with, zero if they are compressed without one */
+    guint32 compression_dictionary_id;
   };
   gchar _pad2[QDISK_RESERVED_SPACE];
 } QDiskFileHeader;
@@ -101,7 +147,63 @@ struct _QDisk
   gint fd;
   gint64 cached_file_size;
   QDiskFileHeader *hdr;
+  /* the tail of the queue, including the records that are not on the disk
+   * yet, the header only describes those that are, see qdisk_flush() */
+  gint64 write_head;
+  gint64 length;
+  NVNameDict *name_dict;
   DiskQueueOptions *options;
+
+  /* records pushed, but not yet written to the file, see write-batch-bytes() */
+  struct
+  {
+    GString *buffer;
+    gint64 position;
+  } write_batch;
+  gboolean unsynced_writes;
+  gint64 last_sync;
+  guint64 write_syscalls;
+  guint64 written_bytes;
+
+  /* a contiguous chunk of the file following the last read position, so
+   * that records are not read one by one */
+  struct
+  {
+    GString *buffer;
+    gint64 position;
+  } read_ahead;
+  guint64 read_syscalls;
+
+  /* segmented disk-buffers, see segment-size(): positions grow
+   * monotonically and are mapped to <filename>.<segment index> files,
+   * which are deleted once the backlog head leaves them */
+  struct
+  {
+    gint64 first;
+    struct
+    {
+      gint64 index;
+      gint fd;
+    } fds[QDISK_SEGMENT_FDS];
+    gint next_fd;
+  } segments;
+
+  /* payload size of the records pushed with compression enabled, before
+   * and after compressing them, see qdisk_get_uncompressed_bytes() */
+  guint64 uncompressed_bytes;
+  guint64 compressed_bytes;
+
+#if SYSLOG_NG_HAVE_ZSTD
+  ZSTD_CCtx *zstd_cctx;
+  ZSTD_DCtx *zstd_dctx;
+  /* see compression-dictionary(), loaded once and referenced by the contexts */
+  struct
+  {
+    ZSTD_CDict *cdict;
+    ZSTD_DDict *ddict;
+    guint32 id;
+  } zstd_dictionary;
+#endif
 };
 
 #define QDISK_ERROR qdisk_error_quark()
@@ -138,6 +240,453 @@ pwrite_strict(gint fd, const void *buf, size_t count, off_t offset)
   return result;
 }
 
+static inline gboolean
+_is_segmented(QDisk *self)
+{
+  return self->hdr->segment_size > 0;
+}
+
+static inline gint64
+_get_segment_index(QDisk *self, gint64 position)
+{
+  return (position - QDISK_RESERVED_SPACE) / self->hdr->segment_size;
+}
+
+static inline gint64
+_get_segment_offset(QDisk *self, gint64 position)
+{
+  return (position - QDISK_RESERVED_SPACE) % self->hdr->segment_size;
+}
+
+static inline gint64
+_get_segment_start(QDisk *self, gint64 segment)
+{
+  return QDISK_RESERVED_SPACE + segment * self->hdr->segment_size;
+}
+
+static gchar *
+_get_segment_filename(QDisk *self, gint64 segment)
+{
+  return g_strdup_printf("%s.%08" G_GINT64_FORMAT, self->filename, segment);
+}
+
+/* a segment is (re)created when the writer reaches its start, so that
+ * stale data of a previous file with the same name is not kept */
+static gint
+_open_segment(QDisk *self, gint64 segment, gboolean create)
+{
+  gchar *segment_filename = _get_segment_filename(self, segment);
+  gint flags = O_LARGEFILE | (self->options->read_only ? O_RDONLY : O_RDWR) | (create ? O_CREAT | O_TRUNC : 0);
+
+  gint fd = open(segment_filename, flags, 0600);
+  if (fd < 0)
+    msg_error("Error opening disk-queue segment file",
+              evt_tag_str("filename", segment_filename),
+              evt_tag_error("error"));
+
+  g_free(segment_filename);
+  return fd;
+}
+
+static gint
+_get_segment_fd(QDisk *self, gint64 segment, gboolean create)
+{
+  for (gint i = 0; i < QDISK_SEGMENT_FDS; i++)
+    {
+      if (self->segments.fds[i].fd >= 0 && self->segments.fds[i].index == segment)
+        return self->segments.fds[i].fd;
+    }
+
+  gint fd = _open_segment(self, segment, create);
+  if (fd < 0)
+    return -1;
+
+  gint slot = self->segments.next_fd;
+  self->segments.next_fd = (slot + 1) % QDISK_SEGMENT_FDS;
+
+  if (self->segments.fds[slot].fd >= 0)
+    {
+      /* unsynced writes would not be covered by the next sync */
+      if (self->unsynced_writes)
+        fsync(self->segments.fds[slot].fd);
+      close(self->segments.fds[slot].fd);
+    }
+
+  self->segments.fds[slot].index = segment;
+  self->segments.fds[slot].fd = fd;
+  return fd;
+}
+
+static void
+_close_segment_fd(QDisk *self, gint i)
+{
+  if (self->segments.fds[i].fd < 0)
+    return;
+
+  close(self->segments.fds[i].fd);
+  self->segments.fds[i].fd = -1;
+  self->segments.fds[i].index = -1;
+}
+
+static void
+_close_segment_fds(QDisk *self)
+{
+  for (gint i = 0; i < QDISK_SEGMENT_FDS; i++)
+    _close_segment_fd(self, i);
+}
+
+static gboolean
+_sync_segments(QDisk *self)
+{
+  gboolean result = TRUE;
+
+  for (gint i = 0; i < QDISK_SEGMENT_FDS; i++)
+    {
+      if (self->segments.fds[i].fd >= 0 && fsync(self->segments.fds[i].fd) < 0)
+        result = FALSE;
+    }
+
+  return result;
+}
+
+/* writes are split at segment boundaries, records may span segments */
+static gboolean
+_write_to_segments(QDisk *self, const gchar *buf, gsize count, gint64 position)
+{
+  while (count > 0)
+    {
+      gint64 offset = _get_segment_offset(self, position);
+      gsize chunk = MIN(count, self->hdr->segment_size - offset);
+
+      gint fd = _get_segment_fd(self, _get_segment_index(self, position), offset == 0);
+      if (fd < 0)
+        return FALSE;
+
+      self->write_syscalls++;
+      if (!pwrite_strict(fd, buf, chunk, offset))
+        return FALSE;
+
+      buf += chunk;
+      count -= chunk;
+      position += chunk;
+    }
+
+  return TRUE;
+}
+
+static gssize
+_read_from_segments(QDisk *self, gchar *buf, gsize count, gint64 position)
+{
+  gsize bytes_read = 0;
+
+  while (bytes_read < count)
+    {
+      gint64 offset = _get_segment_offset(self, position + bytes_read);
+      gsize chunk = MIN(count - bytes_read, self->hdr->segment_size - offset);
+
+      gint fd = _get_segment_fd(self, _get_segment_index(self, position + bytes_read), FALSE);
+      if (fd < 0)
+        return bytes_read > 0 ? bytes_read : -1;
+
+      self->read_syscalls++;
+      gssize result = pread(fd, buf + bytes_read, chunk, offset);
+      if (result < 0)
+        return bytes_read > 0 ? bytes_read : -1;
+
+      bytes_read += result;
+      if ((gsize) result < chunk)
+        break;
+    }
+
+  return bytes_read;
+}
+
+static gboolean
+_pwrite_records(QDisk *self, const gchar *buf, gsize count, gint64 position)
+{
+  if (_is_segmented(self))
+    return _write_to_segments(self, buf, count, position);
+
+  self->write_syscalls++;
+  return pwrite_strict(self->fd, buf, count, position);
+}
+
+static gssize
+_pread_records(QDisk *self, gchar *buf, gsize count, gint64 position)
+{
+  if (_is_segmented(self))
+    return _read_from_segments(self, buf, count, position);
+
+  self->read_syscalls++;
+  return pread(self->fd, buf, count, position);
+}
+
+/* segments wholly before the backlog head are not needed anymore */
+static void
+_release_consumed_segments(QDisk *self)
+{
+  if (!_is_segmented(self) || self->options->read_only)
+    return;
+
+  gint64 first_used_segment = _get_segment_index(self, self->hdr->backlog_head);
+
+  for (; self->segments.first < first_used_segment; self->segments.first++)
+    {
+      for (gint i = 0; i < QDISK_SEGMENT_FDS; i++)
+        {
+          if (self->segments.fds[i].index == self->segments.first)
+            _close_segment_fd(self, i);
+        }
+
+      gchar *segment_filename = _get_segment_filename(self, self->segments.first);
+      if (unlink(segment_filename) < 0 && errno != ENOENT)
+        msg_error("Error deleting disk-queue segment file",
+                  evt_tag_str("filename", segment_filename),
+                  evt_tag_error("error"));
+      g_free(segment_filename);
+    }
+}
+
+static inline void
+_invalidate_read_ahead_buffer(QDisk *self, gint64 position, gsize count)
+{
+  if (!self->read_ahead.buffer)
+    return;
+
+  if (position < self->read_ahead.position + (gint64) self->read_ahead.buffer->len
+      && position + (gint64) count > self->read_ahead.position)
+    g_string_truncate(self->read_ahead.buffer, 0);
+}
+
+static gboolean
+_write_to_disk(QDisk *self, const gchar *buf, gsize count, gint64 position)
+{
+  _invalidate_read_ahead_buffer(self, position, count);
+
+  if (!_pwrite_records(self, buf, count, position))
+    {
+      msg_error("Error writing disk-queue file",
+                evt_tag_str("filename", self->filename),
+                evt_tag_error("error"));
+      return FALSE;
+    }
+
+  /* names used by the records just written become persistent along with
+   * them, before the header is advanced over the records */
+  if (self->name_dict)
+    nv_name_dict_commit(self->name_dict);
+
+  self->written_bytes += count;
+  if (self->options->reliable && self->options->sync_policy != DQSP_NEVER)
+    self->unsynced_writes = TRUE;
+  return TRUE;
+}
+
+static inline gboolean
+_has_pending_writes(QDisk *self)
+{
+  return self->write_batch.buffer && self->write_batch.buffer->len > 0;
+}
+
+static gboolean
+_write_pending_records(QDisk *self)
+{
+  if (!_has_pending_writes(self))
+    return TRUE;
+
+  /* on failure the records are kept, so the next flush retries them */
+  if (!_write_to_disk(self, self->write_batch.buffer->str, self->write_batch.buffer->len,
+                      self->write_batch.position))
+    return FALSE;
+
+  g_string_truncate(self->write_batch.buffer, 0);
+  return TRUE;
+}
+
+static inline gboolean
+_is_sync_due(QDisk *self)
+{
+  if (!self->unsynced_writes)
+    return FALSE;
+
+  if (self->options->sync_policy == DQSP_INTERVAL)
+    return g_get_monotonic_time() - self->last_sync >= (gint64) self->options->sync_interval * 1000;
+
+  return self->options->sync_policy == DQSP_BATCH;
+}
+
+static gboolean
+_sync_file(QDisk *self)
+{
+  if (fsync(self->fd) < 0 || (_is_segmented(self) && !_sync_segments(self)))
+    {
+      msg_error("Error syncing disk-queue file",
+                evt_tag_str("filename", self->filename),
+                evt_tag_error("error"));
+      return FALSE;
+    }
+
+  self->unsynced_writes = FALSE;
+  self->last_sync = g_get_monotonic_time();
+  return TRUE;
+}
+
+/* the header is mapped to the file, so it is only advanced over records
+ * that are already on the disk, a crash never leaves it pointing to
+ * records that were not written */
+static inline void
+_advance_header_over_written_records(QDisk *self)
+{
+  self->hdr->write_head = self->write_head;
+  self->hdr->length = self->length;
+}
+
+/* the buffered records are written with a single syscall, then the file is
+ * synced if the sync-policy() of a reliable queue requires it.  The header
+ * is only advanced over the records if both succeed */
+static gboolean
+_flush(QDisk *self, gboolean sync)
+{
+  if (!qdisk_started(self))
+    return TRUE;
+
+  if (!_write_pending_records(self))
+    return FALSE;
+
+  if (sync && !_sync_file(self))
+    return FALSE;
+
+  _advance_header_over_written_records(self);
+  return TRUE;
+}
+
+gboolean
+qdisk_flush(QDisk *self)
+{
+  return _flush(self, _is_sync_due(self));
+}
+
+/* used when the sync-interval() expires, so that the last records are not
+ * left unsynced when no further flush happens */
+gboolean
+qdisk_sync(QDisk *self)
+{
+  return _flush(self, self->unsynced_writes);
+}
+
+/* records are only consumed once the header is advanced over them, so the
+ * read head stored in the header never passes its write head */
+static inline gboolean
+_flush_before_consuming_unflushed_records(QDisk *self)
+{
+  if (self->hdr->length > 0 || self->length == 0)
+    return TRUE;
+
+  return qdisk_flush(self);
+}
+
+gboolean
+qdisk_needs_flush(QDisk *self)
+{
+  return _has_pending_writes(self) || self->unsynced_writes;
+}
+
+static gboolean
+_write_record(QDisk *self, GString *record)
+{
+  gint64 position = self->write_head;
+  gsize write_batch_bytes = MAX(self->options->write_batch_bytes, 0);
+
+  if (record->len >= write_batch_bytes)
+    return _write_pending_records(self) && _write_to_disk(self, record->str, record->len, position);
+
+  /* only consecutive records can be written at once, the write head might have wrapped */
+  if (_has_pending_writes(self)
+      && (self->write_batch.position + self->write_batch.buffer->len != position
+          || self->write_batch.buffer->len + record->len > write_batch_bytes))
+    {
+      if (!_write_pending_records(self))
+        return FALSE;
+    }
+
+  if (!self->write_batch.buffer)
+    self->write_batch.buffer = g_string_sized_new(write_batch_bytes);
+
+  if (self->write_batch.buffer->len == 0)
+    self->write_batch.position = position;
+  g_string_append_len(self->write_batch.buffer, record->str, record->len);
+  return TRUE;
+}
+
+/* records are read from the file, so those still in the write batch have to be written first */
+static inline void
+_write_pending_records_before_reading(QDisk *self, gint64 position)
+{
+  if (!_has_pending_writes(self))
+    return;
+
+  if (position >= self->write_batch.position
+      && position < self->write_batch.position + (gint64) self->write_batch.buffer->len)
+    _write_pending_records(self);
+}
+
+static inline gboolean
+_is_in_read_ahead_buffer(QDisk *self, gint64 position, gsize count)
+{
+  return self->read_ahead.buffer
+         && position >= self->read_ahead.position
+         && position + (gint64) count <= self->read_ahead.position + (gint64) self->read_ahead.buffer->len;
+}
+
+/* only data that is already on the disk can be read ahead: up to the
+ * write head, or up to the end of the file if the write head has wrapped
+ * around, but not into the records still in the write batch */
+static gint64
+_get_read_ahead_limit(QDisk *self, gint64 position)
+{
+  gint64 limit = position < self->write_head ? self->write_head : G_MAXINT64;
+
+  if (_has_pending_writes(self) && self->write_batch.position >= position)
+    limit = MIN(limit, self->write_batch.position);
+
+  return limit;
+}
+
+static void
+_fill_read_ahead_buffer(QDisk *self, gint64 position, gsize count)
+{
+  gint64 limit = _get_read_ahead_limit(self, position);
+  gsize size = MAX(count, MIN(QDISK_READ_AHEAD_SIZE, MAX(limit - position, 0)));
+
+  if (!self->read_ahead.buffer)
+    self->read_ahead.buffer = g_string_sized_new(QDISK_READ_AHEAD_SIZE);
+
+  g_string_set_size(self->read_ahead.buffer, size);
+  gssize bytes_read = _pread_records(self, self->read_ahead.buffer->str, size, position);
+
+  self->read_ahead.position = position;
+  g_string_set_size(self->read_ahead.buffer, MAX(bytes_read, 0));
+}
+
+/* only the sequential reads of the read head fill the read-ahead buffer,
+ * the reads of the backlog head (acks) would thrash it */
+static gssize
+_read_from_disk(QDisk *self, gchar *buf, gsize count, gint64 position, gboolean read_ahead)
+{
+  _write_pending_records_before_reading(self, position);
+
+  if (read_ahead && !_is_in_read_ahead_buffer(self, position, count))
+    _fill_read_ahead_buffer(self, position, count);
+
+  if (!_is_in_read_ahead_buffer(self, position, count))
+    {
+      /* short read or error, read again, so that the caller can report it */
+      return _pread_records(self, buf, count, position);
+    }
+
+  memcpy(buf, self->read_ahead.buffer->str + (position - self->read_ahead.position), count);
+  return count;
+}
 
 static inline gboolean
 _has_position_reached_max_size(QDisk *self, gint64 position)
@@ -148,6 +697,10 @@ _has_position_reached_max_size(QDisk *self, gint64 position)
 static inline guint64
 _correct_position_if_max_size_is_reached(QDisk *self, gint64 position)
 {
+  /* segments are appended, positions never wrap around */
+  if (_is_segmented(self))
+    return position;
+
   if (G_UNLIKELY(self->hdr->use_v1_wrap_condition))
     {
       gboolean position_is_eof = position >= self->cached_file_size;
@@ -280,14 +833,59 @@ qdisk_get_next_filename(const gchar *dir, gboolean reliable)
       return NULL;
     }
 
-  if (!_create_file(filename))
+  if (!_create_file(filename))
+    {
+      _release_dirlock(dirlock_fd);
+      return NULL;
+    }
+
+  _release_dirlock(dirlock_fd);
+  return filename;
+}
+
+static gboolean
+_is_segment_suffix(const gchar *suffix)
+{
+  if (suffix[0] != '.' || strlen(suffix + 1) < 8)
+    return FALSE;
+
+  for (const gchar *c = suffix + 1; *c; c++)
+    {
+      if (!g_ascii_isdigit(*c))
+        return FALSE;
+    }
+  return TRUE;
+}
+
+/*
+ * Returns the segment files of @filename that exist, named like
+ * <filename>.00000042, see segment-size().  The names are returned as
+ * @filename followed by their suffix, so the segments of a renamed file are
+ * named by appending the same suffix to the new name.
+ */
+GList *
+qdisk_get_segment_filenames(const gchar *filename)
+{
+  gchar *dir = g_path_get_dirname(filename);
+  gchar *base = g_path_get_basename(filename);
+  gsize base_len = strlen(base);
+  GList *segment_filenames = NULL;
+
+  GDir *d = g_dir_open(dir, 0, NULL);
+  if (d)
     {
-      _release_dirlock(dirlock_fd);
-      return NULL;
+      const gchar *entry;
+      while ((entry = g_dir_read_name(d)))
+        {
+          if (strncmp(entry, base, base_len) == 0 && _is_segment_suffix(entry + base_len))
+            segment_filenames = g_list_prepend(segment_filenames, g_strconcat(filename, entry + base_len, NULL));
+        }
+      g_dir_close(d);
     }
 
-  _release_dirlock(dirlock_fd);
-  return filename;
+  g_free(base);
+  g_free(dir);
+  return g_list_sort(segment_filenames, (GCompareFunc) strcmp);
 }
 
 gboolean
@@ -310,8 +908,9 @@ qdisk_is_file_a_disk_buffer_file(const gchar *filename)
         return FALSE;
     }
 
-  if (strncmp(&filename[extension_start], QDISK_FILENAME_REL_EXT, strlen(QDISK_FILENAME_REL_EXT)) != 0 &&
-      strncmp(&filename[extension_start], QDISK_FILENAME_NON_REL_EXT, strlen(QDISK_FILENAME_NON_REL_EXT)) != 0)
+  /* segment files of segmented disk-buffers have a suffix after the extension */
+  if (strcmp(&filename[extension_start], QDISK_FILENAME_REL_EXT) != 0 &&
+      strcmp(&filename[extension_start], QDISK_FILENAME_NON_REL_EXT) != 0)
     {
       return FALSE;
     }
@@ -351,13 +950,13 @@ qdisk_started(QDisk *self)
 static inline gboolean
 _does_backlog_head_precede_write_head(QDisk *self)
 {
-  return self->hdr->backlog_head <= self->hdr->write_head;
+  return self->hdr->backlog_head <= self->write_head;
 }
 
 static inline gboolean
 _is_write_head_less_than_max_size(QDisk *self)
 {
-  return self->hdr->write_head < self->hdr->capacity_bytes;
+  return self->write_head < self->hdr->capacity_bytes;
 }
 
 static inline gboolean
@@ -370,7 +969,7 @@ static inline gboolean
 _is_free_space_between_write_head_and_backlog_head(QDisk *self, gint msg_len)
 {
   /* this forces 1 byte of empty space between backlog and write */
-  return self->hdr->write_head + msg_len < self->hdr->backlog_head;
+  return self->write_head + msg_len < self->hdr->backlog_head;
 }
 
 static inline gboolean
@@ -383,12 +982,15 @@ _is_free_space_at_the_beginning_of_qdisk(QDisk *self, gint msg_len)
 gboolean
 qdisk_is_file_empty(QDisk *self)
 {
-  return self->hdr->length == 0 && self->hdr->backlog_len == 0;
+  return self->length == 0 && self->hdr->backlog_len == 0;
 }
 
 gboolean
 qdisk_is_space_avail(QDisk *self, gint at_least)
 {
+  if (_is_segmented(self))
+    return qdisk_get_used_useful_space(self) + at_least <= qdisk_get_max_useful_space(self);
+
   if (_does_backlog_head_precede_write_head(self))
     {
       /* no exact size-check is needed in this case, because writing after
@@ -530,9 +1132,31 @@ qdisk_get_lowest_used_queue_offset(QDisk *self)
   return lowest_offset < G_MAXINT64 ? lowest_offset : 0;
 }
 
+static void
+_truncate_file_to_header(QDisk *self)
+{
+  if (ftruncate(self->fd, QDISK_RESERVED_SPACE) < 0)
+    {
+      msg_error("Error truncating disk-queue file",
+                evt_tag_error("error"),
+                evt_tag_str("filename", self->filename),
+                evt_tag_int("fd", self->fd));
+      return;
+    }
+
+  self->cached_file_size = QDISK_RESERVED_SPACE;
+}
+
 static void
 _maybe_truncate_file_to_minimal(QDisk *self)
 {
+  /* records are in the segments, the loaded queues are not needed in the file anymore */
+  if (_is_segmented(self))
+    {
+      _truncate_file_to_header(self);
+      return;
+    }
+
   if (qdisk_is_file_empty(self))
     {
       _maybe_truncate_file(self, QDISK_RESERVED_SPACE);
@@ -555,6 +1179,10 @@ qdisk_get_max_useful_space(QDisk *self)
 gint64
 qdisk_get_empty_space(QDisk *self)
 {
+  /* the capacity of a segmented disk-buffer might have been decreased below its usage */
+  if (_is_segmented(self))
+    return MAX(qdisk_get_max_useful_space(self) - qdisk_get_used_useful_space(self), 0);
+
   gint64 wpos = qdisk_get_writer_head(self);
   gint64 bpos = qdisk_get_backlog_head(self);
   gint64 capacity_bytes = qdisk_get_maximum_size(self);
@@ -580,7 +1208,7 @@ qdisk_get_empty_space(QDisk *self)
           // 0   RESERVED            B=W   DBS   FS
           // |---|------- ... -------|-----|-----|
           //      ^^^^^^^^^^^^^^^^^^^^^^^^^
-          g_assert(self->hdr->length == 0);
+          g_assert(self->length == 0);
           return capacity_bytes - QDISK_RESERVED_SPACE;
         }
     }
@@ -621,7 +1249,7 @@ qdisk_get_empty_space(QDisk *self)
           // 0   RESERVED          DBS=B=W       FS
           // |---|------ ... ------|-------------|
           //      ^^^^^^^^^^^^^^^^^
-          g_assert(self->hdr->length == 0);
+          g_assert(self->length == 0);
           return capacity_bytes - QDISK_RESERVED_SPACE;
         }
     }
@@ -669,13 +1297,17 @@ qdisk_get_empty_space(QDisk *self)
 gint64
 qdisk_get_used_useful_space(QDisk *self)
 {
+  if (_is_segmented(self))
+    return self->write_head - self->hdr->backlog_head;
+
   return qdisk_get_max_useful_space(self) - qdisk_get_empty_space(self);
 }
 
 static inline gboolean
 _could_not_wrap_write_head_last_push_but_now_can(QDisk *self)
 {
-  return _has_position_reached_max_size(self, self->hdr->write_head)
+  return !_is_segmented(self)
+         && _has_position_reached_max_size(self, self->write_head)
          && _is_able_to_reset_write_head_to_beginning_of_qdisk(self);
 }
 
@@ -685,15 +1317,215 @@ qdisk_get_next_tail_position(QDisk *self)
   if (_could_not_wrap_write_head_last_push_but_now_can(self))
     return QDISK_RESERVED_SPACE;
 
-  return self->hdr->write_head;
+  return self->write_head;
 }
 
-gboolean
-qdisk_push_tail(QDisk *self, GString *record)
+static const gchar *
+_get_compression_name(guint8 compression)
 {
-  if (!qdisk_started(self))
+  switch (compression)
+    {
+    case DQC_NONE:
+      return "none";
+    case DQC_ZSTD:
+      return "zstd";
+    default:
+      return "unknown";
+    }
+}
+
+static inline gboolean
+_is_compression_enabled(QDisk *self)
+{
+  return self->options->compression != DQC_NONE && self->options->compression == self->hdr->compression;
+}
+
+#if SYSLOG_NG_HAVE_ZSTD
+
+/* records are compressed one by one, so short records compress well only
+ * with a dictionary trained on similar ones (zstd --train) */
+static gboolean
+_load_zstd_dictionary(QDisk *self)
+{
+  if (self->zstd_dictionary.cdict || !self->options->compression_dictionary)
+    return TRUE;
+
+  gchar *dictionary;
+  gsize dictionary_len;
+  GError *error = NULL;
+  if (!g_file_get_contents(self->options->compression_dictionary, &dictionary, &dictionary_len, &error))
+    {
+      msg_error("Error reading compression-dictionary() of disk-queue file",
+                evt_tag_str("filename", self->filename),
+                evt_tag_str("error", error->message));
+      g_clear_error(&error);
+      return FALSE;
+    }
+
+  /* raw content dictionaries have no id, which is what the header refers to */
+  guint32 id = ZSTD_getDictID_fromDict(dictionary, dictionary_len);
+  if (id == 0)
+    {
+      msg_error("compression-dictionary() is not a zstd dictionary, create one with zstd --train",
+                evt_tag_str("filename", self->filename),
+                evt_tag_str("compression_dictionary", self->options->compression_dictionary));
+      g_free(dictionary);
+      return FALSE;
+    }
+
+  self->zstd_dictionary.cdict = ZSTD_createCDict(dictionary, dictionary_len, QDISK_ZSTD_COMPRESSION_LEVEL);
+  self->zstd_dictionary.ddict = ZSTD_createDDict(dictionary, dictionary_len);
+  self->zstd_dictionary.id = id;
+  g_free(dictionary);
+
+  if (!self->zstd_dictionary.cdict || !self->zstd_dictionary.ddict)
+    {
+      msg_error("Error loading compression-dictionary() of disk-queue file",
+                evt_tag_str("filename", self->filename),
+                evt_tag_str("compression_dictionary", self->options->compression_dictionary));
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
+static void
+_free_zstd_dictionary(QDisk *self)
+{
+  ZSTD_freeCDict(self->zstd_dictionary.cdict);
+  ZSTD_freeDDict(self->zstd_dictionary.ddict);
+  self->zstd_dictionary.cdict = NULL;
+  self->zstd_dictionary.ddict = NULL;
+  self->zstd_dictionary.id = 0;
+}
+
+static gboolean
+_check_zstd_dictionary(QDisk *self)
+{
+  guint32 file_id = self->hdr->compression_dictionary_id;
+
+  if (self->hdr->compression != DQC_ZSTD || file_id == self->zstd_dictionary.id)
+    return TRUE;
+
+  /* the records can be read without a dictionary, new ones are compressed
+   * like the existing ones */
+  if (file_id == 0)
+    {
+      msg_warning("WARNING: compression-dictionary() has changed since the last syslog-ng run. The records "
+                  "of existing disk-queue files are compressed without a dictionary. Continuing without one",
+                  evt_tag_str("filename", self->filename));
+      return TRUE;
+    }
+
+  msg_error("Error loading disk-queue file, its records are compressed with a compression-dictionary() "
+            "other than the configured one",
+            evt_tag_str("filename", self->filename),
+            evt_tag_long("dictionary_id", file_id),
+            evt_tag_long("configured_dictionary_id", self->zstd_dictionary.id));
+  return FALSE;
+}
+
+/* the contexts reference the dictionary of the file they were created for */
+static void
+_free_zstd_contexts(QDisk *self)
+{
+  ZSTD_freeCCtx(self->zstd_cctx);
+  ZSTD_freeDCtx(self->zstd_dctx);
+  self->zstd_cctx = NULL;
+  self->zstd_dctx = NULL;
+}
+
+static ZSTD_CCtx *
+_get_zstd_cctx(QDisk *self)
+{
+  if (self->zstd_cctx)
+    return self->zstd_cctx;
+
+  self->zstd_cctx = ZSTD_createCCtx();
+  ZSTD_CCtx_setParameter(self->zstd_cctx, ZSTD_c_compressionLevel, QDISK_ZSTD_COMPRESSION_LEVEL);
+  if (self->hdr->compression_dictionary_id)
+    ZSTD_CCtx_refCDict(self->zstd_cctx, self->zstd_dictionary.cdict);
+  return self->zstd_cctx;
+}
+
+static ZSTD_DCtx *
+_get_zstd_dctx(QDisk *self)
+{
+  if (self->zstd_dctx)
+    return self->zstd_dctx;
+
+  self->zstd_dctx = ZSTD_createDCtx();
+  if (self->hdr->compression_dictionary_id)
+    ZSTD_DCtx_refDDict(self->zstd_dctx, self->zstd_dictionary.ddict);
+  return self->zstd_dctx;
+}
+
+#endif
+
+/* compresses the payload of a framed record, returns FALSE if the record
+ * should be stored as is.  Each record is a separate zstd frame, so that
+ * records can be read one by one */
+static gboolean
+_compress_record(QDisk *self, GString *record, GString *compressed)
+{
+#if SYSLOG_NG_HAVE_ZSTD
+  const gchar *payload = record->str + sizeof(guint32);
+  gsize payload_len = record->len - sizeof(guint32);
+  gsize bound = ZSTD_compressBound(payload_len);
+
+  g_string_set_size(compressed, sizeof(guint32) + bound);
+  gsize compressed_len = ZSTD_compress2(_get_zstd_cctx(self), compressed->str + sizeof(guint32), bound,
+                                        payload, payload_len);
+  if (ZSTD_isError(compressed_len) || compressed_len >= payload_len)
     return FALSE;
 
+  g_string_set_size(compressed, sizeof(guint32) + compressed_len);
+  guint32 frame = GUINT32_TO_BE(compressed_len | QDISK_RECORD_COMPRESSED);
+  memcpy(compressed->str, &frame, sizeof(frame));
+  return TRUE;
+#else
+  return FALSE;
+#endif
+}
+
+static gboolean
+_decompress_record(QDisk *self, GString *compressed, GString *record)
+{
+#if SYSLOG_NG_HAVE_ZSTD
+  if (self->hdr->compression == DQC_ZSTD)
+    {
+      unsigned long long record_length = ZSTD_getFrameContentSize(compressed->str, compressed->len);
+      if (record_length == ZSTD_CONTENTSIZE_ERROR || record_length == ZSTD_CONTENTSIZE_UNKNOWN
+          || record_length > MAX_RECORD_LENGTH)
+        {
+          msg_error("Disk-queue file contains an invalid compressed record",
+                    evt_tag_str("filename", self->filename));
+          return FALSE;
+        }
+
+      g_string_set_size(record, record_length);
+      gsize decompressed_len = ZSTD_decompressDCtx(_get_zstd_dctx(self), record->str, record_length,
+                                                   compressed->str, compressed->len);
+      if (ZSTD_isError(decompressed_len) || decompressed_len != record_length)
+        {
+          msg_error("Error decompressing record of disk-queue file",
+                    evt_tag_str("filename", self->filename),
+                    evt_tag_str("error", ZSTD_isError(decompressed_len) ? ZSTD_getErrorName(decompressed_len) : "short record"));
+          return FALSE;
+        }
+      return TRUE;
+    }
+#endif
+
+  msg_error("Disk-queue file contains compressed records, but their compression is not supported",
+            evt_tag_str("filename", self->filename),
+            evt_tag_str("compression", _get_compression_name(self->hdr->compression)));
+  return FALSE;
+}
+
+static gboolean
+_push_record(QDisk *self, GString *record)
+{
   if (_could_not_wrap_write_head_last_push_but_now_can(self))
     {
       /*
@@ -701,20 +1533,16 @@ qdisk_push_tail(QDisk *self, GString *record)
        * not sure, if this message will have space. We move the write_head
        * then check the available space compared to the new position.
        */
-      self->hdr->write_head = QDISK_RESERVED_SPACE;
+      self->write_head = QDISK_RESERVED_SPACE;
     }
 
   if (!qdisk_is_space_avail(self, record->len))
     return FALSE;
 
-  if (!pwrite_strict(self->fd, record->str, record->len, self->hdr->write_head))
-    {
-      msg_error("Error writing disk-queue file",
-                evt_tag_error("error"));
-      return FALSE;
-    }
+  if (!_write_record(self, record))
+    return FALSE;
 
-  self->hdr->write_head = self->hdr->write_head + record->len;
+  self->write_head = self->write_head + record->len;
 
 
   /* NOTE: we only wrap around if the read head is before the write,
@@ -738,20 +1566,20 @@ qdisk_push_tail(QDisk *self, GString *record)
    * */
 
   /* NOTE: if these were equal, that'd mean the queue is empty, so we spoiled something */
-  g_assert(self->hdr->write_head != self->hdr->backlog_head);
+  g_assert(self->write_head != self->hdr->backlog_head);
 
-  if (self->hdr->write_head > MAX(self->hdr->backlog_head, self->hdr->read_head))
+  if (!_is_segmented(self) && self->write_head > MAX(self->hdr->backlog_head, self->hdr->read_head))
     {
-      if (self->cached_file_size > self->hdr->write_head)
+      if (self->cached_file_size > self->write_head)
         {
-          _maybe_truncate_file(self, self->hdr->write_head);
+          _maybe_truncate_file(self, self->write_head);
         }
       else
         {
-          self->cached_file_size = self->hdr->write_head;
+          self->cached_file_size = self->write_head;
         }
 
-      if (_has_position_reached_max_size(self, self->hdr->write_head)
+      if (_has_position_reached_max_size(self, self->write_head)
           && _is_able_to_reset_write_head_to_beginning_of_qdisk(self))
         {
           /* we were appending to the file, we are over the limit, and space
@@ -762,17 +1590,45 @@ qdisk_push_tail(QDisk *self, GString *record)
            * This way we guarantee, that only a part of 1 message is written after
            * capacity_bytes.
            */
-          self->hdr->write_head = QDISK_RESERVED_SPACE;
+          self->write_head = QDISK_RESERVED_SPACE;
         }
     }
-  self->hdr->length++;
+  self->length++;
+
+  /* otherwise qdisk_flush() advances the header */
+  if (!qdisk_needs_flush(self))
+    _advance_header_over_written_records(self);
   return TRUE;
 }
 
+gboolean
+qdisk_push_tail(QDisk *self, GString *record)
+{
+  if (!qdisk_started(self))
+    return FALSE;
+
+  if (!_is_compression_enabled(self))
+    return _push_record(self, record);
+
+  ScratchBuffersMarker marker;
+  GString *compressed = scratch_buffers_alloc_and_mark(&marker);
+
+  GString *stored = _compress_record(self, record, compressed) ? compressed : record;
+  gboolean result = _push_record(self, stored);
+  if (result)
+    {
+      self->uncompressed_bytes += record->len - sizeof(guint32);
+      self->compressed_bytes += stored->len - sizeof(guint32);
+    }
+
+  scratch_buffers_reclaim_marked(marker);
+  return result;
+}
+
 static inline gssize
-_read_record_length_from_disk(QDisk *self, gint64 position, guint32 *record_length)
+_read_record_length_from_disk(QDisk *self, gint64 position, guint32 *record_length, gboolean read_ahead)
 {
-  gssize bytes_read = pread(self->fd, (gchar *)record_length, sizeof(guint32), position);
+  gssize bytes_read = _read_from_disk(self, (gchar *)record_length, sizeof(guint32), position, read_ahead);
 
   *record_length = GUINT32_FROM_BE(*record_length);
 
@@ -818,25 +1674,32 @@ _is_record_length_valid(QDisk *self, gssize bytes_read, guint32 record_length, g
   return TRUE;
 }
 
+/* record_length is the length of the record in the file, which is the
+ * compressed length for compressed records */
 static inline gboolean
-_try_reading_record_length(QDisk *self, gint64 position, guint32 *record_length)
+_try_reading_record_length(QDisk *self, gint64 position, guint32 *record_length, gboolean *compressed,
+                           gboolean read_ahead)
 {
-  guint32 read_record_length;
-  gssize bytes_read = _read_record_length_from_disk(self, position, &read_record_length);
+  guint32 frame;
+  gssize bytes_read = _read_record_length_from_disk(self, position, &frame, read_ahead);
+  guint32 read_record_length = frame & ~QDISK_RECORD_COMPRESSED;
 
   if (!_is_record_length_valid(self, bytes_read, read_record_length, position))
     return FALSE;
 
   *record_length = read_record_length;
+  if (compressed)
+    *compressed = !!(frame & QDISK_RECORD_COMPRESSED);
   return TRUE;
 }
 
 static inline gboolean
-_read_record_from_disk(QDisk *self, GString *record, guint32 record_length)
+_read_stored_record_from_disk(QDisk *self, GString *record, guint32 record_length)
 {
   g_string_set_size(record, record_length);
 
-  gssize bytes_read = pread(self->fd, record->str, record_length, self->hdr->read_head + sizeof(record_length));
+  gssize bytes_read = _read_from_disk(self, record->str, record_length, self->hdr->read_head + sizeof(record_length),
+                                      TRUE);
   if (bytes_read != record_length)
     {
       msg_error("Error reading disk-queue file",
@@ -850,6 +1713,22 @@ _read_record_from_disk(QDisk *self, GString *record, guint32 record_length)
   return TRUE;
 }
 
+static inline gboolean
+_read_record_from_disk(QDisk *self, GString *record, guint32 record_length, gboolean compressed)
+{
+  if (!compressed)
+    return _read_stored_record_from_disk(self, record, record_length);
+
+  ScratchBuffersMarker marker;
+  GString *compressed_record = scratch_buffers_alloc_and_mark(&marker);
+
+  gboolean result = _read_stored_record_from_disk(self, compressed_record, record_length)
+                    && _decompress_record(self, compressed_record, record);
+
+  scratch_buffers_reclaim_marked(marker);
+  return result;
+}
+
 static inline void
 _maybe_apply_non_reliable_corrections(QDisk *self)
 {
@@ -867,7 +1746,7 @@ _update_position_after_read(QDisk *self, guint32 record_length, gint64 *position
 {
   gint64 new_position = *position + record_length + sizeof(record_length);
 
-  if (new_position > self->hdr->write_head)
+  if (new_position > self->write_head)
     new_position = _correct_position_if_max_size_is_reached(self, new_position);
 
   *position = new_position;
@@ -877,7 +1756,7 @@ gint64
 qdisk_get_next_head_position(QDisk *self)
 {
   gint64 next_read_head_position = self->hdr->read_head;
-  if (next_read_head_position > self->hdr->write_head)
+  if (next_read_head_position > self->write_head)
     next_read_head_position = _correct_position_if_max_size_is_reached(self, next_read_head_position);
 
   return next_read_head_position;
@@ -886,17 +1765,18 @@ qdisk_get_next_head_position(QDisk *self)
 gboolean
 qdisk_peek_head(QDisk *self, GString *record)
 {
-  if (self->hdr->read_head == self->hdr->write_head)
+  if (self->hdr->read_head == self->write_head)
     return FALSE;
 
-  if (self->hdr->read_head > self->hdr->write_head)
+  if (self->hdr->read_head > self->write_head)
     self->hdr->read_head = _correct_position_if_max_size_is_reached(self, self->hdr->read_head);
 
   guint32 record_length;
-  if (!_try_reading_record_length(self, self->hdr->read_head, &record_length))
+  gboolean compressed;
+  if (!_try_reading_record_length(self, self->hdr->read_head, &record_length, &compressed, TRUE))
     return FALSE;
 
-  if (!_read_record_from_disk(self, record, record_length))
+  if (!_read_record_from_disk(self, record, record_length, compressed))
     return FALSE;
 
   return TRUE;
@@ -905,20 +1785,25 @@ qdisk_peek_head(QDisk *self, GString *record)
 gboolean
 qdisk_pop_head(QDisk *self, GString *record)
 {
-  if (self->hdr->read_head == self->hdr->write_head)
+  if (self->hdr->read_head == self->write_head)
+    return FALSE;
+
+  if (!_flush_before_consuming_unflushed_records(self))
     return FALSE;
 
-  if (self->hdr->read_head > self->hdr->write_head)
+  if (self->hdr->read_head > self->write_head)
     self->hdr->read_head = _correct_position_if_max_size_is_reached(self, self->hdr->read_head);
 
   guint32 record_length;
-  if (!_try_reading_record_length(self, self->hdr->read_head, &record_length))
+  gboolean compressed;
+  if (!_try_reading_record_length(self, self->hdr->read_head, &record_length, &compressed, TRUE))
     return FALSE;
 
-  if (!_read_record_from_disk(self, record, record_length))
+  if (!_read_record_from_disk(self, record, record_length, compressed))
     return FALSE;
 
   _update_position_after_read(self, record_length, &self->hdr->read_head);
+  self->length--;
   self->hdr->length--;
   self->hdr->backlog_len++;
 
@@ -929,16 +1814,16 @@ qdisk_pop_head(QDisk *self, GString *record)
 static gboolean
 _skip_record(QDisk *self, gint64 position, gint64 *new_position)
 {
-  if (position == self->hdr->write_head)
+  if (position == self->write_head)
     return FALSE;
 
-  if (position > self->hdr->write_head)
+  if (position > self->write_head)
     position = _correct_position_if_max_size_is_reached(self, position);
 
   *new_position = position;
 
   guint32 record_length;
-  if (!_try_reading_record_length(self, *new_position, &record_length))
+  if (!_try_reading_record_length(self, *new_position, &record_length, NULL, FALSE))
     return FALSE;
 
   _update_position_after_read(self, record_length, new_position);
@@ -948,10 +1833,14 @@ _skip_record(QDisk *self, gint64 position, gint64 *new_position)
 gboolean
 qdisk_remove_head(QDisk *self)
 {
+  if (!_flush_before_consuming_unflushed_records(self))
+    return FALSE;
+
   gboolean success = _skip_record(self, self->hdr->read_head, &self->hdr->read_head);
 
   if (success)
     {
+      self->length--;
       self->hdr->length--;
       self->hdr->backlog_len++;
       _maybe_apply_non_reliable_corrections(self);
@@ -973,6 +1862,7 @@ qdisk_ack_backlog(QDisk *self)
     }
 
   self->hdr->backlog_len--;
+  _release_consumed_segments(self);
   return TRUE;
 }
 
@@ -998,6 +1888,7 @@ qdisk_rewind_backlog(QDisk *self, guint rewind_count)
 
   self->hdr->backlog_len = number_of_messages_stay_in_backlog;
   self->hdr->read_head = new_read_head;
+  self->length = self->length + rewind_count;
   self->hdr->length = self->hdr->length + rewind_count;
   return TRUE;
 }
@@ -1007,6 +1898,7 @@ qdisk_empty_backlog(QDisk *self)
 {
   self->hdr->backlog_head = self->hdr->read_head;
   self->hdr->backlog_len = 0;
+  _release_consumed_segments(self);
 }
 
 static gboolean
@@ -1132,6 +2024,18 @@ _load_queue(QDisk *self, GQueue *q, gint64 q_ofs, guint32 q_len, guint32 q_count
   return TRUE;
 }
 
+/* the in-memory queues are saved to the end of the file, past the records
+ * of the ring.  The records of segmented files are in the segments, their
+ * file only contains the header, so write_head is not in the file */
+static inline gint64
+_get_saved_queues_min_offset(QDisk *self)
+{
+  if (_is_segmented(self))
+    return QDISK_RESERVED_SPACE;
+
+  return self->write_head;
+}
+
 static gboolean
 _try_to_load_queue(QDisk *self, GQueue *queue, QDiskQueuePosition *pos, gchar *type)
 {
@@ -1142,7 +2046,7 @@ _try_to_load_queue(QDisk *self, GQueue *queue, QDiskQueuePosition *pos, gchar *t
   len = pos->len;
   ofs = pos->ofs;
 
-  if (!(ofs > 0 && ofs < self->hdr->write_head))
+  if (!(ofs > 0 && ofs < _get_saved_queues_min_offset(self)))
     {
       if (!_load_queue(self, queue, ofs, len, count))
         return !self->options->read_only;
@@ -1151,10 +2055,10 @@ _try_to_load_queue(QDisk *self, GQueue *queue, QDiskQueuePosition *pos, gchar *t
     {
       msg_error("Inconsistent header data in disk-queue file, ignoring queue",
                 evt_tag_str("filename", self->filename),
-                evt_tag_long("write_head", self->hdr->write_head),
+                evt_tag_long("write_head", self->write_head),
                 evt_tag_str("type", type),
                 evt_tag_long("ofs", ofs),
-                evt_tag_long("qdisk_length",  self->hdr->length));
+                evt_tag_long("qdisk_length",  self->length));
     }
 
   return TRUE;
@@ -1182,11 +2086,11 @@ _number_of_messages(QDisk *self)
 {
   if (self->options->reliable)
     {
-      return self->hdr->length + self->hdr->backlog_len;
+      return self->length + self->hdr->backlog_len;
     }
   else
     {
-      return self->hdr->length +
+      return self->length +
              self->hdr->backlog_pos.count +
              self->hdr->front_cache_pos.count +
              self->hdr->flow_control_window_pos.count;
@@ -1330,11 +2234,11 @@ _save_state(QDisk *self, GQueue *front_cache, GQueue *backlog, GQueue *flow_cont
              evt_tag_long("front_cache_length", front_cache_pos.count),
              evt_tag_long("backlog_length", backlog_pos.count),
              evt_tag_long("flow_control_window_length", flow_control_window_pos.count),
-             evt_tag_long("qdisk_length", self->hdr->length));
+             evt_tag_long("qdisk_length", self->length));
   else
     msg_info("Reliable disk-buffer state saved",
              evt_tag_str("filename", self->filename),
-             evt_tag_long("qdisk_length", self->hdr->length));
+             evt_tag_long("qdisk_length", self->length));
 
   return TRUE;
 }
@@ -1342,6 +2246,12 @@ _save_state(QDisk *self, GQueue *front_cache, GQueue *backlog, GQueue *flow_cont
 static void
 _close_file(QDisk *self)
 {
+  if (self->name_dict)
+    {
+      nv_name_dict_free(self->name_dict);
+      self->name_dict = NULL;
+    }
+
   if (self->hdr)
     {
       if (self->options->read_only)
@@ -1358,6 +2268,13 @@ _close_file(QDisk *self)
       self->fd = -1;
     }
 
+  if (self->read_ahead.buffer)
+    {
+      g_string_free(self->read_ahead.buffer, TRUE);
+      self->read_ahead.buffer = NULL;
+    }
+
+  _close_segment_fds(self);
   self->cached_file_size = 0;
 }
 
@@ -1382,6 +2299,8 @@ _ensure_header_byte_order(QDisk *self)
       self->hdr->backlog_head = GUINT64_SWAP_LE_BE(self->hdr->backlog_head);
       self->hdr->backlog_len = GUINT64_SWAP_LE_BE(self->hdr->backlog_len);
       self->hdr->capacity_bytes = GUINT64_SWAP_LE_BE(self->hdr->capacity_bytes);
+      self->hdr->segment_size = GUINT64_SWAP_LE_BE(self->hdr->segment_size);
+      self->hdr->compression_dictionary_id = GUINT32_SWAP_LE_BE(self->hdr->compression_dictionary_id);
       self->hdr->big_endian = (G_BYTE_ORDER == G_BIG_ENDIAN);
     }
 }
@@ -1415,6 +2334,24 @@ _open_file(const gchar *filename, gboolean read_only, gint *fd)
   return TRUE;
 }
 
+/* the oldest header version that describes the file with the current options */
+static guint8
+_get_required_header_version(QDisk *self)
+{
+  if (self->hdr->compression_dictionary_id
+      || (self->hdr->compression == DQC_NONE && self->options->compression == DQC_ZSTD
+          && self->options->compression_dictionary))
+    return QDISK_HDR_VERSION_COMPRESSION_DICTIONARY;
+  /* the layout of existing files is kept, see _check_segment_size() */
+  if (self->hdr->segment_size > 0)
+    return QDISK_HDR_VERSION_SEGMENTS;
+  if (self->options->compression != DQC_NONE)
+    return QDISK_HDR_VERSION_COMPRESSION;
+  if (self->options->compact_serialization)
+    return QDISK_HDR_VERSION_NAME_DICT;
+  return QDISK_HDR_VERSION_CAPACITY_BYTES;
+}
+
 static gboolean
 _create_header(QDisk *self)
 {
@@ -1442,7 +2379,8 @@ _create_header(QDisk *self)
 
   memcpy(self->hdr->magic, self->file_id, sizeof(self->hdr->magic));
 
-  self->hdr->version = QDISK_HDR_VERSION_CURRENT;
+  self->hdr->segment_size = self->options->segment_size;
+  self->hdr->version = _get_required_header_version(self);
   self->hdr->big_endian = (G_BYTE_ORDER == G_BIG_ENDIAN);
 
   self->hdr->read_head = QDISK_RESERVED_SPACE;
@@ -1451,17 +2389,13 @@ _create_header(QDisk *self)
   self->hdr->backlog_len = 0;
   self->hdr->length = 0;
   self->hdr->use_v1_wrap_condition = FALSE;
+  self->write_head = self->hdr->write_head;
+  self->length = 0;
   self->hdr->capacity_bytes = self->options->capacity_bytes;
 
   return TRUE;
 }
 
-static inline gboolean
-_is_header_version_current(QDisk *self)
-{
-  return self->hdr->version == QDISK_HDR_VERSION_CURRENT;
-}
-
 static void
 _upgrade_header(QDisk *self)
 {
@@ -1483,7 +2417,19 @@ _upgrade_header(QDisk *self)
       self->hdr->capacity_bytes = self->options->capacity_bytes;
     }
 
-  self->hdr->version = QDISK_HDR_VERSION_CURRENT;
+  self->hdr->version = QDISK_HDR_VERSION_CAPACITY_BYTES;
+}
+
+/* files are only marked with a newer version once they may contain data
+ * that older readers would misinterpret, and the version is never lowered,
+ * as the file may still contain such records */
+static void
+_raise_header_version_if_needed(QDisk *self)
+{
+  guint8 required_version = _get_required_header_version(self);
+
+  if (!self->options->read_only && self->hdr->version < required_version)
+    self->hdr->version = required_version;
 }
 
 static gboolean
@@ -1512,8 +2458,19 @@ _load_header(QDisk *self)
       self->hdr = hdr_mmapped;
     }
 
-  if (!_is_header_version_current(self))
+  /* the file is left alone, so that the newer version can still load it */
+  if (self->hdr->version > QDISK_HDR_VERSION_CURRENT)
+    {
+      msg_error("Error loading disk-queue file, it was written by a newer version of syslog-ng",
+                evt_tag_str("filename", self->filename),
+                evt_tag_int("version", self->hdr->version),
+                evt_tag_int("max_supported_version", QDISK_HDR_VERSION_CURRENT));
+      return FALSE;
+    }
+
+  if (self->hdr->version < QDISK_HDR_VERSION_CAPACITY_BYTES)
     _upgrade_header(self);
+  _raise_header_version_if_needed(self);
 
   _ensure_header_byte_order(self);
 
@@ -1524,6 +2481,11 @@ _load_header(QDisk *self)
       return FALSE;
     }
 
+#if SYSLOG_NG_HAVE_ZSTD
+  if (!_check_zstd_dictionary(self))
+    return FALSE;
+#endif
+
   if (qdisk_header_is_inconsistent(self))
     {
       msg_error("Inconsistent header data in disk-queue file, ignoring",
@@ -1534,6 +2496,8 @@ _load_header(QDisk *self)
       return FALSE;
     }
 
+  self->write_head = self->hdr->write_head;
+  self->length = self->hdr->length;
   return TRUE;
 }
 
@@ -1556,16 +2520,17 @@ _load_state(QDisk *self, GQueue *front_cache, GQueue *backlog, GQueue *flow_cont
 
       msg_info("Disk-buffer state loaded",
                evt_tag_str("filename", self->filename),
-               evt_tag_long("number_of_messages", _number_of_messages(self)));
+               evt_tag_long("number_of_messages", _number_of_messages(self)),
+               evt_tag_str("compression", _get_compression_name(self->hdr->compression)));
 
       msg_debug("Disk-buffer internal state",
                 evt_tag_str("filename", self->filename),
                 evt_tag_long("front_cache_length", self->hdr->front_cache_pos.count),
                 evt_tag_long("backlog_length", self->hdr->backlog_pos.count),
                 evt_tag_long("flow_control_window_length", self->hdr->flow_control_window_pos.count),
-                evt_tag_long("qdisk_length", self->hdr->length),
+                evt_tag_long("qdisk_length", self->length),
                 evt_tag_long("read_head", self->hdr->read_head),
-                evt_tag_long("write_head", self->hdr->write_head),
+                evt_tag_long("write_head", self->write_head),
                 evt_tag_long("capacity_bytes", self->hdr->capacity_bytes));
 
       _reset_queue_pointers(self);
@@ -1577,15 +2542,16 @@ _load_state(QDisk *self, GQueue *front_cache, GQueue *backlog, GQueue *flow_cont
       self->cached_file_size = st.st_size;
       msg_info("Reliable disk-buffer state loaded",
                evt_tag_str("filename", self->filename),
-               evt_tag_long("number_of_messages", _number_of_messages(self)));
+               evt_tag_long("number_of_messages", _number_of_messages(self)),
+               evt_tag_str("compression", _get_compression_name(self->hdr->compression)));
 
       msg_debug("Reliable disk-buffer internal state",
                 evt_tag_str("filename", self->filename),
-                evt_tag_long("queue_length", self->hdr->length),
+                evt_tag_long("queue_length", self->length),
                 evt_tag_long("backlog_len", self->hdr->backlog_len),
                 evt_tag_long("backlog_head", self->hdr->backlog_head),
                 evt_tag_long("read_head", self->hdr->read_head),
-                evt_tag_long("write_head", self->hdr->write_head),
+                evt_tag_long("write_head", self->write_head),
                 evt_tag_long("capacity_bytes", self->hdr->capacity_bytes));
     }
 
@@ -1616,7 +2582,7 @@ _autodetect_capacity_bytes(QDisk *self)
       return TRUE;
     }
 
-  if (self->hdr->write_head > MAX(self->hdr->backlog_head, self->hdr->read_head))
+  if (self->write_head > MAX(self->hdr->backlog_head, self->hdr->read_head))
     {
       self->hdr->capacity_bytes = (gint64) st.st_size;
 
@@ -1639,6 +2605,18 @@ _ensure_capacity_bytes(QDisk *self)
   if (self->hdr->capacity_bytes == -1 && !_autodetect_capacity_bytes(self))
     return FALSE;
 
+  /* the capacity of segmented disk-buffers is only a limit, it can be changed freely */
+  if (_is_segmented(self) && !self->options->read_only
+      && self->options->capacity_bytes != -1 && self->hdr->capacity_bytes != self->options->capacity_bytes)
+    {
+      msg_info("capacity-bytes() of the segmented disk-buffer has changed",
+               evt_tag_str("filename", self->filename),
+               evt_tag_long("old_capacity_bytes", self->hdr->capacity_bytes),
+               evt_tag_long("new_capacity_bytes", self->options->capacity_bytes));
+      self->hdr->capacity_bytes = self->options->capacity_bytes;
+      return TRUE;
+    }
+
   if (self->options->capacity_bytes != -1 && self->hdr->capacity_bytes != self->options->capacity_bytes)
     {
       msg_warning("WARNING: capacity-bytes() has changed since the last syslog-ng run. syslog-ng currently does "
@@ -1651,6 +2629,19 @@ _ensure_capacity_bytes(QDisk *self)
   return TRUE;
 }
 
+static void
+_check_segment_size(QDisk *self)
+{
+  if (!self->options->read_only && self->hdr->segment_size != self->options->segment_size)
+    {
+      msg_warning("WARNING: segment-size() has changed since the last syslog-ng run. The layout of existing "
+                  "disk-queue files cannot be changed. Continuing with the old one",
+                  evt_tag_str("filename", self->filename),
+                  evt_tag_long("active_old_segment_size", self->hdr->segment_size),
+                  evt_tag_long("ignored_new_segment_size", self->options->segment_size));
+    }
+}
+
 static gboolean
 _load_qdisk_file(QDisk *self, GQueue *front_cache, GQueue *backlog, GQueue *flow_control_window)
 {
@@ -1663,6 +2654,7 @@ _load_qdisk_file(QDisk *self, GQueue *front_cache, GQueue *backlog, GQueue *flow
   if (!_ensure_capacity_bytes(self))
     goto error;
 
+  _check_segment_size(self);
   return TRUE;
 
 error:
@@ -1676,7 +2668,8 @@ _init_qdisk_file(QDisk *self)
   if (!_create_header(self))
     return FALSE;
 
-  if (self->options->prealloc && !_preallocate_qdisk_file(self, self->options->capacity_bytes))
+  if (self->options->prealloc && !_is_segmented(self)
+      && !_preallocate_qdisk_file(self, self->options->capacity_bytes))
     return FALSE;
 
   return TRUE;
@@ -1726,12 +2719,9 @@ error:
   return FALSE;
 }
 
-gboolean
-qdisk_start(QDisk *self, GQueue *front_cache, GQueue *backlog, GQueue *flow_control_window)
+static gboolean
+_open_qdisk_file(QDisk *self, GQueue *front_cache, GQueue *backlog, GQueue *flow_control_window)
 {
-  g_assert(!qdisk_started(self));
-  g_assert(self->filename);
-
   struct stat st;
   gboolean file_exists = stat(self->filename, &st) != -1;
 
@@ -1744,13 +2734,56 @@ qdisk_start(QDisk *self, GQueue *front_cache, GQueue *backlog, GQueue *flow_cont
   return _init_qdisk_file_from_empty_file(self);
 }
 
+gboolean
+qdisk_start(QDisk *self, GQueue *front_cache, GQueue *backlog, GQueue *flow_control_window)
+{
+  g_assert(!qdisk_started(self));
+  g_assert(self->filename);
+
+#if SYSLOG_NG_HAVE_ZSTD
+  _free_zstd_contexts(self);
+  if (!_load_zstd_dictionary(self))
+    return FALSE;
+#endif
+
+  if (!_open_qdisk_file(self, front_cache, backlog, flow_control_window))
+    return FALSE;
+
+  /* records of a file are compressed with a single codec and dictionary,
+   * the ones in its header, set when compression is first enabled for the
+   * file */
+  if (!self->options->read_only && self->hdr->compression == DQC_NONE)
+    {
+      self->hdr->compression = self->options->compression;
+#if SYSLOG_NG_HAVE_ZSTD
+      if (self->hdr->compression == DQC_ZSTD)
+        self->hdr->compression_dictionary_id = self->zstd_dictionary.id;
+#endif
+    }
+
+  if (_is_segmented(self))
+    self->segments.first = _get_segment_index(self, self->hdr->backlog_head);
+
+  self->name_dict = nv_name_dict_new(self->hdr->name_dict, sizeof(self->hdr->name_dict));
+  return TRUE;
+}
+
 gboolean
 qdisk_stop(QDisk *self, GQueue *front_cache, GQueue *backlog, GQueue *flow_control_window)
 {
   gboolean result = TRUE;
 
   if (!self->options->read_only)
-    result = _save_state(self, front_cache, backlog, flow_control_window);
+    {
+      result = _write_pending_records(self);
+      result = _save_state(self, front_cache, backlog, flow_control_window) && result;
+
+      if (self->unsynced_writes && !_sync_file(self))
+        result = FALSE;
+
+      if (result)
+        _advance_header_over_written_records(self);
+    }
 
   _close_file(self);
 
@@ -1760,16 +2793,26 @@ qdisk_stop(QDisk *self, GQueue *front_cache, GQueue *backlog, GQueue *flow_contr
 void
 qdisk_reset_file_if_empty(QDisk *self)
 {
-  if (!qdisk_is_file_empty(self))
+  /* segmented disk-buffers are not reset, their segments are deleted as they are consumed */
+  if (!qdisk_is_file_empty(self) || _is_segmented(self))
     return;
 
   self->hdr->read_head = QDISK_RESERVED_SPACE;
   self->hdr->write_head = QDISK_RESERVED_SPACE;
+  self->write_head = QDISK_RESERVED_SPACE;
   self->hdr->backlog_head = QDISK_RESERVED_SPACE;
 
+  if (self->read_ahead.buffer)
+    g_string_truncate(self->read_ahead.buffer, 0);
   _maybe_truncate_file(self, QDISK_RESERVED_SPACE);
 }
 
+NVNameDict *
+qdisk_get_name_dict(QDisk *self)
+{
+  return self->name_dict;
+}
+
 DiskQueueOptions *
 qdisk_get_options(QDisk *self)
 {
@@ -1779,7 +2822,7 @@ qdisk_get_options(QDisk *self)
 gint64
 qdisk_get_length(QDisk *self)
 {
-  return self->hdr->length;
+  return self->length;
 }
 
 gint64
@@ -1797,13 +2840,16 @@ qdisk_get_filename(QDisk *self)
 gint64
 qdisk_get_file_size(QDisk *self)
 {
+  if (_is_segmented(self))
+    return self->cached_file_size + self->write_head - _get_segment_start(self, self->segments.first);
+
   return self->cached_file_size;
 }
 
 gint64
 qdisk_get_writer_head(QDisk *self)
 {
-  return self->hdr->write_head;
+  return self->write_head;
 }
 
 gint64
@@ -1836,10 +2882,46 @@ qdisk_is_read_only(QDisk *self)
   return self->options->read_only;
 }
 
+guint64
+qdisk_get_write_syscalls(QDisk *self)
+{
+  return self->write_syscalls;
+}
+
+guint64
+qdisk_get_written_bytes(QDisk *self)
+{
+  return self->written_bytes;
+}
+
+guint64
+qdisk_get_read_syscalls(QDisk *self)
+{
+  return self->read_syscalls;
+}
+
+guint64
+qdisk_get_uncompressed_bytes(QDisk *self)
+{
+  return self->uncompressed_bytes;
+}
+
+guint64
+qdisk_get_compressed_bytes(QDisk *self)
+{
+  return self->compressed_bytes;
+}
+
 void
 qdisk_free(QDisk *self)
 {
   self->options = NULL;
+  if (self->write_batch.buffer)
+    g_string_free(self->write_batch.buffer, TRUE);
+#if SYSLOG_NG_HAVE_ZSTD
+  _free_zstd_contexts(self);
+  _free_zstd_dictionary(self);
+#endif
   g_free(self->filename);
   g_free(self);
 }
@@ -1853,6 +2935,12 @@ qdisk_new(DiskQueueOptions *options, const gchar *file_id, const gchar *filename
   self->cached_file_size = 0;
   self->options = options;
 
+  for (gint i = 0; i < QDISK_SEGMENT_FDS; i++)
+    {
+      self->segments.fds[i].index = -1;
+      self->segments.fds[i].fd = -1;
+    }
+
   self->file_id = file_id;
   self->filename = g_strdup(filename);
 
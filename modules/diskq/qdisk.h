@@ -29,6 +29,7 @@
 
 #define LOG_PATH_OPTIONS_FOR_BACKLOG GINT_TO_POINTER(0x80000000)
 #define QDISK_RESERVED_SPACE 4096
+#define QDISK_NAME_DICT_SIZE 2048
 #define LOG_PATH_OPTIONS_TO_POINTER(lpo) GUINT_TO_POINTER(0x80000000 | (lpo)->ack_needed)
 
 /* NOTE: this must not evaluate ptr multiple times, otherwise the code that
@@ -61,6 +62,9 @@ gint64 qdisk_get_max_useful_space(QDisk *self);
 gint64 qdisk_get_empty_space(QDisk *self);
 gint64 qdisk_get_used_useful_space(QDisk *self);
 gboolean qdisk_push_tail(QDisk *self, GString *record);
+gboolean qdisk_flush(QDisk *self);
+gboolean qdisk_sync(QDisk *self);
+gboolean qdisk_needs_flush(QDisk *self);
 gboolean qdisk_pop_head(QDisk *self, GString *record);
 gboolean qdisk_peek_head(QDisk *self, GString *record);
 gboolean qdisk_remove_head(QDisk *self);
@@ -76,6 +80,7 @@ gboolean qdisk_started(QDisk *self);
 void qdisk_free(QDisk *self);
 
 DiskQueueOptions *qdisk_get_options(QDisk *self);
+NVNameDict *qdisk_get_name_dict(QDisk *self);
 gint64 qdisk_get_length(QDisk *self);
 gint64 qdisk_get_maximum_size(QDisk *self);
 gint64 qdisk_get_writer_head(QDisk *self);
@@ -86,9 +91,15 @@ gint qdisk_get_flow_control_window_bytes(QDisk *self);
 gboolean qdisk_is_read_only(QDisk *self);
 const gchar *qdisk_get_filename(QDisk *self);
 gint64 qdisk_get_file_size(QDisk *self);
+guint64 qdisk_get_write_syscalls(QDisk *self);
+guint64 qdisk_get_written_bytes(QDisk *self);
+guint64 qdisk_get_read_syscalls(QDisk *self);
+guint64 qdisk_get_uncompressed_bytes(QDisk *self);
+guint64 qdisk_get_compressed_bytes(QDisk *self);
 
 gchar *qdisk_get_next_filename(const gchar *dir, gboolean reliable);
 gboolean qdisk_is_file_a_disk_buffer_file(const gchar *filename);
+GList *qdisk_get_segment_filenames(const gchar *filename);
 gboolean qdisk_is_disk_buffer_file_reliable(const gchar *filename, gboolean *reliable);
 
 gboolean qdisk_serialize(GString *serialized, QDiskSerializeFunc serialize_func, gpointer user_data, GError **error);
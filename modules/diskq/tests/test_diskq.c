@@ -540,6 +540,92 @@ qdisk_get_next_filename(const gchar *dir, gboolean reliable)
   return NULL;
 }
 
+#define BATCH_SIZE 32
+
+static void
+_pop_batch_and_ack(LogQueue *q, gint expected_num)
+{
+  LogMessage *msgs[BATCH_SIZE];
+  LogPathOptions path_options[BATCH_SIZE];
+
+  gint n = log_queue_pop_head_batch(q, msgs, path_options, BATCH_SIZE);
+  cr_assert_eq(n, expected_num);
+
+  for (gint i = 0; i < n; i++)
+    {
+      if (path_options[i].ack_needed)
+        log_msg_ack(msgs[i], &path_options[i], AT_PROCESSED);
+      log_msg_unref(msgs[i]);
+    }
+  log_queue_ack_backlog(q, n);
+}
+
+static void
+_assert_batches_can_be_popped_and_rewound(LogQueue *q)
+{
+  LogMessage *msgs[BATCH_SIZE];
+  LogPathOptions path_options[BATCH_SIZE];
+
+  fed_messages = 0;
+  acked_messages = 0;
+  feed_some_messages(q, 50);
+
+  gint n = log_queue_pop_head_batch(q, msgs, path_options, BATCH_SIZE);
+  cr_assert_eq(n, BATCH_SIZE);
+  for (gint i = 0; i < n; i++)
+    log_msg_unref(msgs[i]);
+  log_queue_rewind_backlog(q, n);
+  cr_assert_eq(log_queue_get_length(q), 50);
+
+  _pop_batch_and_ack(q, BATCH_SIZE);
+  _pop_batch_and_ack(q, 50 - BATCH_SIZE);
+  _pop_batch_and_ack(q, 0);
+
+  cr_assert_eq(log_queue_get_length(q), 0);
+  cr_assert_eq(fed_messages, acked_messages,
+               "did not receive enough acknowledgements: fed_messages=%d, acked_messages=%d",
+               fed_messages, acked_messages);
+}
+
+Test(diskq, testcase_pop_head_batch_reliable)
+{
+  DiskQueueOptions options = {0};
+  const gchar *filename = "test-pop_head_batch_reliable.rqf";
+
+  _construct_options(&options, 10000000, 100000, TRUE);
+  unlink(filename);
+  LogQueue *q = log_queue_disk_reliable_new(&options, filename, NULL, STATS_LEVEL0, NULL, NULL);
+  log_queue_disk_start(q);
+
+  _assert_batches_can_be_popped_and_rewound(q);
+
+  gboolean persistent;
+  log_queue_disk_stop(q, &persistent);
+  log_queue_unref(q);
+  unlink(filename);
+  disk_queue_options_destroy(&options);
+}
+
+Test(diskq, testcase_pop_head_batch_non_reliable)
+{
+  DiskQueueOptions options = {0};
+  const gchar *filename = "test-pop_head_batch_non_reliable.qf";
+
+  _construct_options(&options, 10000000, 100000, FALSE);
+  options.front_cache_size = 10;
+  unlink(filename);
+  LogQueue *q = log_queue_disk_non_reliable_new(&options, filename, NULL, STATS_LEVEL0, NULL, NULL);
+  log_queue_disk_start(q);
+
+  _assert_batches_can_be_popped_and_rewound(q);
+
+  gboolean persistent;
+  log_queue_disk_stop(q, &persistent);
+  log_queue_unref(q);
+  unlink(filename);
+  disk_queue_options_destroy(&options);
+}
+
 Test(diskq, test_no_next_filename_in_acquire)
 {
   const gchar *queue_persist_name = "test_no_next_filename_in_acquire";
@@ -0,0 +1,354 @@
+/*
+ * Copyright (c) 2026 Axoflow
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As an additional exemption you are allowed to compile & link against the
+ * OpenSSL libraries as published by the OpenSSL project. See the file
+ * COPYING for details.
+ *
+ */
+
+#include <criterion/criterion.h>
+#include "test_diskq_tools.h"
+
+#include "logqueue-disk-consumers.h"
+#include "logqueue-disk-reliable.h"
+#include "logqueue-disk-non-reliable.h"
+#include "logqueue-disk.h"
+#include "qdisk.h"
+#include "logpipe.h"
+#include "apphook.h"
+
+#include <unistd.h>
+
+#define TEST_FILENAME "test_diskq_consumers.rqf"
+#define TEST_CAPACITY (1024 * 1024)
+
+static DiskQueueOptions options;
+static gint num_of_ack;
+
+static void
+_counting_ack(LogMessage *msg, AckType ack_type)
+{
+  num_of_ack++;
+}
+
+static LogQueueDiskConsumers *
+_create_consumers(void)
+{
+  _construct_options(&options, TEST_CAPACITY, TEST_CAPACITY, TRUE);
+  unlink(TEST_FILENAME);
+
+  LogQueue *queue = log_queue_disk_reliable_new(&options, TEST_FILENAME, NULL, STATS_LEVEL0, NULL, NULL);
+  cr_assert(log_queue_disk_start(queue));
+  return log_queue_disk_consumers_new(queue);
+}
+
+static void
+_destroy_consumers(LogQueueDiskConsumers *consumers)
+{
+  gboolean persistent;
+  LogQueue *queue = log_queue_ref(log_queue_disk_consumers_get_queue(consumers));
+
+  log_queue_disk_consumers_unref(consumers);
+  log_queue_disk_stop(queue, &persistent);
+  log_queue_unref(queue);
+  unlink(TEST_FILENAME);
+  disk_queue_options_destroy(&options);
+}
+
+static void
+_push_messages(LogQueueDiskConsumers *consumers, gint n)
+{
+  LogQueue *queue = log_queue_disk_consumers_get_queue(consumers);
+
+  for (gint i = 0; i < n; i++)
+    {
+      LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+      LogMessage *msg = log_msg_new_mark();
+
+      msg->ack_func = _counting_ack;
+      log_msg_add_ack(msg, &path_options);
+      log_queue_push_tail(queue, msg, &path_options);
+    }
+}
+
+static gint
+_pop_messages(LogQueue *consumer, LogMessage **msgs, gint n)
+{
+  LogPathOptions path_options[n];
+
+  return log_queue_pop_head_batch(consumer, msgs, path_options, n);
+}
+
+static void
+_unref_messages(LogMessage **msgs, gint n)
+{
+  for (gint i = 0; i < n; i++)
+    log_msg_unref(msgs[i]);
+}
+
+static QDisk *
+_get_qdisk(LogQueueDiskConsumers *consumers)
+{
+  return ((LogQueueDisk *) log_queue_disk_consumers_get_queue(consumers))->qdisk;
+}
+
+Test(diskq_consumers, consumers_pop_different_messages)
+{
+  LogQueueDiskConsumers *consumers = _create_consumers();
+  LogQueue *consumer1 = log_queue_disk_consumers_add_consumer(consumers);
+  LogQueue *consumer2 = log_queue_disk_consumers_add_consumer(consumers);
+  LogMessage *msgs1[2], *msgs2[2];
+
+  _push_messages(consumers, 4);
+  cr_assert_eq(log_queue_get_length(consumer1), 4);
+  cr_assert_eq(log_queue_get_length(consumer2), 4);
+
+  cr_assert_eq(_pop_messages(consumer1, msgs1, 2), 2);
+  cr_assert_eq(_pop_messages(consumer2, msgs2, 2), 2);
+  cr_assert_neq(msgs1[0], msgs2[0]);
+  cr_assert_neq(msgs1[1], msgs2[1]);
+  cr_assert_eq(log_queue_get_length(consumer1), 0);
+
+  log_queue_ack_backlog(consumer1, 2);
+  log_queue_ack_backlog(consumer2, 2);
+  cr_assert_eq(num_of_ack, 4);
+
+  _unref_messages(msgs1, 2);
+  _unref_messages(msgs2, 2);
+  cr_assert(!log_queue_disk_consumers_remove_consumer(consumers, consumer1));
+  cr_assert(log_queue_disk_consumers_remove_consumer(consumers, consumer2));
+  log_queue_unref(consumer1);
+  log_queue_unref(consumer2);
+  _destroy_consumers(consumers);
+}
+
+Test(diskq_consumers, backlog_is_acked_only_when_the_oldest_messages_are_acked)
+{
+  LogQueueDiskConsumers *consumers = _create_consumers();
+  LogQueue *consumer1 = log_queue_disk_consumers_add_consumer(consumers);
+  LogQueue *consumer2 = log_queue_disk_consumers_add_consumer(consumers);
+  LogMessage *msgs1[1], *msgs2[2];
+
+  _push_messages(consumers, 3);
+  cr_assert_eq(_pop_messages(consumer1, msgs1, 1), 1);
+  cr_assert_eq(_pop_messages(consumer2, msgs2, 2), 2);
+  cr_assert_eq(qdisk_get_backlog_count(_get_qdisk(consumers)), 3);
+
+  log_queue_ack_backlog(consumer2, 2);
+  cr_assert_eq(num_of_ack, 0, "newer messages must not be acknowledged before the older ones");
+  cr_assert_eq(qdisk_get_backlog_count(_get_qdisk(consumers)), 3);
+
+  log_queue_ack_backlog(consumer1, 1);
+  cr_assert_eq(num_of_ack, 3);
+  cr_assert_eq(qdisk_get_backlog_count(_get_qdisk(consumers)), 0);
+
+  _unref_messages(msgs1, 1);
+  _unref_messages(msgs2, 2);
+  log_queue_disk_consumers_remove_consumer(consumers, consumer1);
+  log_queue_disk_consumers_remove_consumer(consumers, consumer2);
+  log_queue_unref(consumer1);
+  log_queue_unref(consumer2);
+  _destroy_consumers(consumers);
+}
+
+Test(diskq_consumers, rewound_messages_are_redelivered_by_other_consumers_in_order)
+{
+  LogQueueDiskConsumers *consumers = _create_consumers();
+  LogQueue *consumer1 = log_queue_disk_consumers_add_consumer(consumers);
+  LogQueue *consumer2 = log_queue_disk_consumers_add_consumer(consumers);
+  LogMessage *msgs1[3], *msgs2[3];
+
+  _push_messages(consumers, 3);
+  cr_assert_eq(_pop_messages(consumer1, msgs1, 3), 3);
+  log_queue_rewind_backlog(consumer1, 1);
+  log_queue_rewind_backlog(consumer1, 1);
+  cr_assert_eq(log_queue_get_length(consumer2), 2);
+
+  cr_assert_eq(_pop_messages(consumer2, msgs2, 3), 2);
+  cr_assert_eq(msgs2[0], msgs1[1]);
+  cr_assert_eq(msgs2[1], msgs1[2]);
+
+  log_queue_ack_backlog(consumer2, 2);
+  cr_assert_eq(num_of_ack, 0);
+  log_queue_ack_backlog(consumer1, 1);
+  cr_assert_eq(num_of_ack, 3);
+
+  _unref_messages(msgs1, 3);
+  _unref_messages(msgs2, 2);
+  log_queue_disk_consumers_remove_consumer(consumers, consumer1);
+  log_queue_disk_consumers_remove_consumer(consumers, consumer2);
+  log_queue_unref(consumer1);
+  log_queue_unref(consumer2);
+  _destroy_consumers(consumers);
+}
+
+Test(diskq_consumers, unacked_messages_are_returned_to_the_queue_when_the_consumers_are_removed)
+{
+  LogQueueDiskConsumers *consumers = _create_consumers();
+  LogQueue *consumer1 = log_queue_disk_consumers_add_consumer(consumers);
+  LogQueue *consumer2 = log_queue_disk_consumers_add_consumer(consumers);
+  LogMessage *msgs[2];
+
+  _push_messages(consumers, 3);
+  cr_assert_eq(_pop_messages(consumer1, msgs, 2), 2);
+  _unref_messages(msgs, 2);
+
+  cr_assert(!log_queue_disk_consumers_remove_consumer(consumers, consumer1));
+  log_queue_unref(consumer1);
+  cr_assert_eq(log_queue_get_length(consumer2), 3);
+
+  cr_assert_eq(_pop_messages(consumer2, msgs, 1), 1);
+  _unref_messages(msgs, 1);
+  cr_assert(log_queue_disk_consumers_remove_consumer(consumers, consumer2));
+  log_queue_unref(consumer2);
+
+  cr_assert_eq(log_queue_get_length(log_queue_disk_consumers_get_queue(consumers)), 3);
+  cr_assert_eq(num_of_ack, 0);
+  _destroy_consumers(consumers);
+}
+
+static void
+_count_wake_ups(gpointer user_data)
+{
+  gint *wake_ups = (gint *) user_data;
+
+  (*wake_ups)++;
+}
+
+Test(diskq_consumers, a_push_wakes_up_only_one_waiting_consumer)
+{
+  LogQueueDiskConsumers *consumers = _create_consumers();
+  LogQueue *consumer1 = log_queue_disk_consumers_add_consumer(consumers);
+  LogQueue *consumer2 = log_queue_disk_consumers_add_consumer(consumers);
+  gint wake_ups1 = 0, wake_ups2 = 0;
+  gint timeout;
+
+  cr_assert_not(log_queue_check_items(consumer1, &timeout, _count_wake_ups, &wake_ups1, NULL));
+  cr_assert_not(log_queue_check_items(consumer2, &timeout, _count_wake_ups, &wake_ups2, NULL));
+
+  _push_messages(consumers, 1);
+  cr_assert_eq(wake_ups1 + wake_ups2, 1);
+
+  _push_messages(consumers, 1);
+  cr_assert_eq(wake_ups1, 1);
+  cr_assert_eq(wake_ups2, 1);
+
+  /* nobody is waiting, the notification is not re-armed */
+  _push_messages(consumers, 1);
+  cr_assert_eq(wake_ups1 + wake_ups2, 2);
+
+  cr_assert(!log_queue_disk_consumers_remove_consumer(consumers, consumer1));
+  log_queue_unref(consumer1);
+  cr_assert(log_queue_disk_consumers_remove_consumer(consumers, consumer2));
+  log_queue_unref(consumer2);
+  _destroy_consumers(consumers);
+}
+
+static LogQueue *
+_create_disk_queue(gboolean reliable)
+{
+  LogQueue *queue;
+
+  if (reliable)
+    queue = log_queue_disk_reliable_new(&options, TEST_FILENAME, NULL, STATS_LEVEL0, NULL, NULL);
+  else
+    queue = log_queue_disk_non_reliable_new(&options, TEST_FILENAME, NULL, STATS_LEVEL0, NULL, NULL);
+  cr_assert(log_queue_disk_start(queue));
+  return queue;
+}
+
+/* the messages are read back from the disk, none of them are kept in the memory */
+static LogQueueDiskConsumers *
+_create_consumers_with_messages_on_disk(gboolean reliable, gint n)
+{
+  gboolean persistent;
+
+  _construct_options(&options, TEST_CAPACITY, TEST_CAPACITY, reliable);
+  unlink(TEST_FILENAME);
+
+  LogQueue *queue = _create_disk_queue(reliable);
+  for (gint i = 0; i < n; i++)
+    {
+      LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+      LogMessage *msg = log_msg_new_empty();
+      gchar message[32];
+
+      g_snprintf(message, sizeof(message), "message #%d", i);
+      log_msg_set_value(msg, LM_V_MESSAGE, message, -1);
+      msg->ack_func = _counting_ack;
+      log_msg_add_ack(msg, &path_options);
+      log_queue_push_tail(queue, msg, &path_options);
+    }
+  log_queue_disk_stop(queue, &persistent);
+  log_queue_unref(queue);
+
+  return log_queue_disk_consumers_new(_create_disk_queue(reliable));
+}
+
+static void
+_assert_consumers_deserialize_the_messages_read_from_the_disk(gboolean reliable)
+{
+  LogQueueDiskConsumers *consumers = _create_consumers_with_messages_on_disk(reliable, 4);
+  LogQueue *consumer1 = log_queue_disk_consumers_add_consumer(consumers);
+  LogQueue *consumer2 = log_queue_disk_consumers_add_consumer(consumers);
+  LogMessage *msgs1[2], *msgs2[2];
+
+  cr_assert_eq(_pop_messages(consumer1, msgs1, 2), 2);
+  cr_assert_eq(_pop_messages(consumer2, msgs2, 2), 2);
+
+  cr_assert_str_eq(log_msg_get_value(msgs1[0], LM_V_MESSAGE, NULL), "message #0");
+  cr_assert_str_eq(log_msg_get_value(msgs1[1], LM_V_MESSAGE, NULL), "message #1");
+  cr_assert_str_eq(log_msg_get_value(msgs2[0], LM_V_MESSAGE, NULL), "message #2");
+  cr_assert_str_eq(log_msg_get_value(msgs2[1], LM_V_MESSAGE, NULL), "message #3");
+
+  log_queue_ack_backlog(consumer2, 2);
+  log_queue_ack_backlog(consumer1, 2);
+  cr_assert_eq(qdisk_get_backlog_count(_get_qdisk(consumers)), 0);
+
+  _unref_messages(msgs1, 2);
+  _unref_messages(msgs2, 2);
+  log_queue_disk_consumers_remove_consumer(consumers, consumer1);
+  log_queue_disk_consumers_remove_consumer(consumers, consumer2);
+  log_queue_unref(consumer1);
+  log_queue_unref(consumer2);
+  _destroy_consumers(consumers);
+}
+
+Test(diskq_consumers, consumers_deserialize_the_messages_read_from_a_reliable_disk_buffer)
+{
+  _assert_consumers_deserialize_the_messages_read_from_the_disk(TRUE);
+}
+
+Test(diskq_consumers, consumers_deserialize_the_messages_read_from_a_non_reliable_disk_buffer)
+{
+  _assert_consumers_deserialize_the_messages_read_from_the_disk(FALSE);
+}
+
+static void
+setup(void)
+{
+  app_startup();
+  num_of_ack = 0;
+}
+
+static void
+teardown(void)
+{
+  app_shutdown();
+}
+
+TestSuite(diskq_consumers, .init = setup, .fini = teardown);
@@ -26,6 +26,7 @@
 #include "test_diskq_tools.h"
 
 #include <unistd.h>
+#include <string.h>
 #include <fcntl.h>
 #include <sys/stat.h>
 #include "apphook.h"
@@ -416,6 +417,214 @@ Test(logqueue_disk, restart_corrupted_with_multiple_queues)
   stop_grabbing_messages();
 }
 
+static LogQueue *
+_create_non_reliable_queue_with_compact_serialization(DiskQueueOptions *options, const gchar *filename)
+{
+  disk_queue_options_set_default_options(options);
+  disk_queue_options_capacity_bytes_set(options, MIN_CAPACITY_BYTES);
+  disk_queue_options_flow_control_window_size_set(options, 0);
+  disk_queue_options_front_cache_size_set(options, 0);
+  disk_queue_options_compact_serialization_set(options, TRUE);
+
+  LogQueue *queue = log_queue_disk_non_reliable_new(options, filename, "compact_serialization", STATS_LEVEL0,
+                                                    NULL, NULL);
+  cr_assert(log_queue_disk_start(queue));
+  return queue;
+}
+
+Test(logqueue_disk, compact_serialization_stores_names_in_the_file_header)
+{
+  const gchar *filename = "compact_serialization.qf";
+  DiskQueueOptions options = {0};
+  LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+  gboolean persistent;
+
+  LogQueue *queue = _create_non_reliable_queue_with_compact_serialization(&options, filename);
+  LogMessage *msg = log_msg_new_empty();
+  log_msg_set_value_by_name(msg, "compact_serialization_name", "value", -1);
+  log_queue_push_tail(queue, msg, &path_options);
+  cr_assert_eq(qdisk_get_length(((LogQueueDisk *) queue)->qdisk), 1);
+  log_queue_disk_stop(queue, &persistent);
+  log_queue_unref(queue);
+
+  gchar *contents;
+  gsize length;
+  cr_assert(g_file_get_contents(filename, &contents, &length, NULL));
+  cr_assert(memmem(contents, QDISK_RESERVED_SPACE, "compact_serialization_name", 26),
+            "the name should have been stored in the header");
+  g_free(contents);
+
+  queue = _create_non_reliable_queue_with_compact_serialization(&options, filename);
+  msg = log_queue_pop_head(queue, &path_options);
+  cr_assert_not_null(msg);
+  cr_assert_str_eq(log_msg_get_value_by_name(msg, "compact_serialization_name", NULL), "value");
+  log_msg_unref(msg);
+
+  log_queue_disk_stop(queue, &persistent);
+  log_queue_unref(queue);
+  disk_queue_options_destroy(&options);
+  unlink(filename);
+}
+
+static LogQueue *
+_create_non_reliable_queue_with_writer_thread(DiskQueueOptions *options, const gchar *filename,
+                                              gboolean writer_thread)
+{
+  disk_queue_options_set_default_options(options);
+  disk_queue_options_capacity_bytes_set(options, MIN_CAPACITY_BYTES);
+  disk_queue_options_flow_control_window_size_set(options, 0);
+  disk_queue_options_front_cache_size_set(options, 0);
+  disk_queue_options_writer_thread_set(options, writer_thread);
+
+  LogQueue *queue = log_queue_disk_non_reliable_new(options, filename, "writer_thread", STATS_LEVEL0,
+                                                    NULL, NULL);
+  cr_assert(log_queue_disk_start(queue));
+  return queue;
+}
+
+Test(logqueue_disk, writer_thread_writes_pending_messages_in_order_before_stopping)
+{
+  const gchar *filename = "writer_thread.qf";
+  const gint num_messages = LOG_QUEUE_DISK_WRITER_QUEUE_SIZE * 2;
+  DiskQueueOptions options = {0};
+  LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+  gboolean persistent;
+  gchar seq[16];
+
+  /* flow-controlled messages are never dropped by the writer */
+  path_options.flow_control_requested = TRUE;
+
+  LogQueue *queue = _create_non_reliable_queue_with_writer_thread(&options, filename, TRUE);
+  cr_assert_not_null(((LogQueueDisk *) queue)->writer);
+  for (gint i = 0; i < num_messages; i++)
+    {
+      LogMessage *msg = log_msg_new_empty();
+      g_snprintf(seq, sizeof(seq), "%d", i);
+      log_msg_set_value(msg, LM_V_PID, seq, -1);
+      log_queue_push_tail(queue, msg, &path_options);
+    }
+  log_queue_disk_stop(queue, &persistent);
+  cr_assert_null(((LogQueueDisk *) queue)->writer);
+  log_queue_unref(queue);
+  disk_queue_options_destroy(&options);
+
+  queue = _create_non_reliable_queue_with_writer_thread(&options, filename, FALSE);
+  cr_assert_eq(log_queue_get_length(queue), num_messages);
+  for (gint i = 0; i < num_messages; i++)
+    {
+      LogMessage *msg = log_queue_pop_head(queue, &path_options);
+      cr_assert_not_null(msg);
+      g_snprintf(seq, sizeof(seq), "%d", i);
+      cr_assert_str_eq(log_msg_get_value(msg, LM_V_PID, NULL), seq);
+      log_msg_unref(msg);
+    }
+
+  log_queue_disk_stop(queue, &persistent);
+  log_queue_unref(queue);
+  disk_queue_options_destroy(&options);
+  unlink(filename);
+}
+
+Test(logqueue_disk, writer_thread_pending_messages_are_visible_to_consumers)
+{
+  const gchar *filename = "writer_thread_pending.qf";
+  const gint num_messages = 100;
+  DiskQueueOptions options = {0};
+  LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+  gboolean persistent;
+  gchar seq[16];
+
+  LogQueue *queue = _create_non_reliable_queue_with_writer_thread(&options, filename, TRUE);
+  for (gint i = 0; i < num_messages; i++)
+    {
+      LogMessage *msg = log_msg_new_empty();
+      g_snprintf(seq, sizeof(seq), "%d", i);
+      log_msg_set_value(msg, LM_V_PID, seq, -1);
+      log_queue_push_tail(queue, msg, &path_options);
+    }
+
+  /* regardless of the progress of the writer thread */
+  cr_assert_eq(log_queue_get_length(queue), num_messages);
+  for (gint i = 0; i < num_messages; i++)
+    {
+      LogMessage *msg = log_queue_pop_head(queue, &path_options);
+      cr_assert_not_null(msg);
+      g_snprintf(seq, sizeof(seq), "%d", i);
+      cr_assert_str_eq(log_msg_get_value(msg, LM_V_PID, NULL), seq);
+      log_msg_unref(msg);
+    }
+  cr_assert_eq(log_queue_get_length(queue), 0);
+
+  log_queue_disk_stop(queue, &persistent);
+  log_queue_unref(queue);
+  disk_queue_options_destroy(&options);
+  unlink(filename);
+}
+
+static LogQueue *
+_create_segmented_non_reliable_queue(DiskQueueOptions *options, const gchar *filename)
+{
+  disk_queue_options_set_default_options(options);
+  disk_queue_options_capacity_bytes_set(options, MIN_CAPACITY_BYTES);
+  disk_queue_options_flow_control_window_size_set(options, 0);
+  disk_queue_options_front_cache_size_set(options, 10);
+  disk_queue_options_segment_size_set(options, MIN_SEGMENT_SIZE);
+
+  LogQueue *queue = log_queue_disk_non_reliable_new(options, filename, "segmented_non_reliable", STATS_LEVEL0,
+                                                    NULL, NULL);
+  cr_assert(log_queue_disk_start(queue));
+  return queue;
+}
+
+Test(logqueue_disk, segmented_non_reliable_queue_loads_its_front_cache_back)
+{
+  const gchar *filename = "segmented_non_reliable.qf";
+  const gint num_front_cache_messages = 10;
+  const gint num_messages = 200;
+  DiskQueueOptions options = {0};
+  LogPathOptions path_options = LOG_PATH_OPTIONS_INIT;
+  gboolean persistent;
+  gchar seq[16];
+
+  /* the first messages go to the front cache, the rest to the segments,
+   * past the size of the file header */
+  LogQueue *queue = _create_segmented_non_reliable_queue(&options, filename);
+  for (gint i = 0; i < num_messages; i++)
+    {
+      LogMessage *msg = log_msg_new_empty();
+      g_snprintf(seq, sizeof(seq), "%d", i);
+      log_msg_set_value(msg, LM_V_PID, seq, -1);
+      log_queue_push_tail(queue, msg, &path_options);
+    }
+  cr_assert_eq(g_queue_get_length(((LogQueueDiskNonReliable *) queue)->front_cache), num_front_cache_messages * 2);
+  cr_assert_gt(qdisk_get_writer_head(((LogQueueDisk *) queue)->qdisk), QDISK_RESERVED_SPACE);
+  log_queue_disk_stop(queue, &persistent);
+  log_queue_unref(queue);
+  disk_queue_options_destroy(&options);
+
+  queue = _create_segmented_non_reliable_queue(&options, filename);
+  cr_assert_eq(g_queue_get_length(((LogQueueDiskNonReliable *) queue)->front_cache), num_front_cache_messages * 2);
+  cr_assert_eq(log_queue_get_length(queue), num_messages);
+  for (gint i = 0; i < num_messages; i++)
+    {
+      LogMessage *msg = log_queue_pop_head(queue, &path_options);
+      cr_assert_not_null(msg);
+      g_snprintf(seq, sizeof(seq), "%d", i);
+      cr_assert_str_eq(log_msg_get_value(msg, LM_V_PID, NULL), seq);
+      log_msg_unref(msg);
+    }
+
+  log_queue_disk_stop(queue, &persistent);
+  log_queue_unref(queue);
+  disk_queue_options_destroy(&options);
+
+  GList *segment_filenames = qdisk_get_segment_filenames(filename);
+  for (GList *l = segment_filenames; l; l = l->next)
+    unlink(l->data);
+  g_list_free_full(segment_filenames, g_free);
+  unlink(filename);
+}
+
 static void
 setup(void)
 {
@@ -29,8 +29,14 @@
 #include "scratch-buffers.h"
 
 #include <unistd.h>
+#include <stdio.h>
 #include <sys/stat.h>
 #include <errno.h>
+#include <string.h>
+
+#if SYSLOG_NG_HAVE_ZSTD
+#include <zdict.h>
+#endif
 
 /* QDisk-internal: the frame is a 4-byte integer */
 #define FRAME_LENGTH 4
@@ -579,6 +585,557 @@ Test(qdisk, get_empty_space_wrapped)
   cleanup_qdisk(filename, qdisk);
 }
 
+Test(qdisk, write_batch_is_written_with_a_single_syscall_when_flushed)
+{
+  const gchar *filename = "test_qdisk_write_batch.rqf";
+  QDisk *qdisk = create_qdisk(TDISKQ_RELIABLE, filename, MiB(1));
+  disk_queue_options_write_batch_bytes_set(qdisk_get_options(qdisk), 65536);
+  qdisk_start(qdisk, NULL, NULL, NULL);
+
+  guint record_len = 128;
+  for (gint i = 0; i < 10; i++)
+    cr_assert(push_dummy_record(qdisk, record_len));
+
+  cr_assert_eq(qdisk_get_length(qdisk), 10);
+  cr_assert_eq(qdisk_get_write_syscalls(qdisk), 0);
+  cr_assert(qdisk_needs_flush(qdisk));
+
+  cr_assert(qdisk_flush(qdisk));
+  cr_assert_not(qdisk_needs_flush(qdisk));
+  cr_assert_eq(qdisk_get_write_syscalls(qdisk), 1);
+  cr_assert_eq(qdisk_get_written_bytes(qdisk), 10 * (record_len + FRAME_LENGTH));
+
+  GString *popped_data = g_string_new(NULL);
+  for (gint i = 0; i < 10; i++)
+    {
+      cr_assert(reliable_pop_record_without_backlog(qdisk, popped_data));
+      assert_dummy_record(popped_data, record_len);
+    }
+  g_string_free(popped_data, TRUE);
+
+  qdisk_stop(qdisk, NULL, NULL, NULL);
+  cleanup_qdisk(filename, qdisk);
+}
+
+static gint64
+_get_length_stored_in_header(const gchar *filename)
+{
+  QDisk *reader = create_qdisk(TDISKQ_RELIABLE, filename, MiB(1));
+  qdisk_get_options(reader)->read_only = TRUE;
+  cr_assert(qdisk_start(reader, NULL, NULL, NULL));
+
+  gint64 length = qdisk_get_length(reader);
+
+  qdisk_stop(reader, NULL, NULL, NULL);
+  DiskQueueOptions *opts = qdisk_get_options(reader);
+  qdisk_free(reader);
+  disk_queue_options_destroy(opts);
+  g_free(opts);
+  return length;
+}
+
+Test(qdisk, header_is_only_advanced_over_records_once_they_are_flushed)
+{
+  const gchar *filename = "test_qdisk_write_batch_header.rqf";
+  QDisk *qdisk = create_qdisk(TDISKQ_RELIABLE, filename, MiB(1));
+  disk_queue_options_write_batch_bytes_set(qdisk_get_options(qdisk), 65536);
+  qdisk_start(qdisk, NULL, NULL, NULL);
+
+  guint record_len = 128;
+  for (gint i = 0; i < 10; i++)
+    cr_assert(push_dummy_record(qdisk, record_len));
+
+  cr_assert_eq(qdisk_get_length(qdisk), 10);
+  cr_assert_eq(_get_length_stored_in_header(filename), 0);
+
+  cr_assert(qdisk_flush(qdisk));
+  cr_assert_eq(_get_length_stored_in_header(filename), 10);
+
+  qdisk_stop(qdisk, NULL, NULL, NULL);
+  cleanup_qdisk(filename, qdisk);
+}
+
+Test(qdisk, write_batch_is_written_before_reading_its_records)
+{
+  const gchar *filename = "test_qdisk_write_batch_read.rqf";
+  QDisk *qdisk = create_qdisk(TDISKQ_RELIABLE, filename, MiB(1));
+  disk_queue_options_write_batch_bytes_set(qdisk_get_options(qdisk), 65536);
+  qdisk_start(qdisk, NULL, NULL, NULL);
+
+  guint record_len = 128;
+  cr_assert(push_dummy_record(qdisk, record_len));
+  cr_assert(push_dummy_record(qdisk, record_len));
+
+  GString *popped_data = g_string_new(NULL);
+  cr_assert(reliable_pop_record_without_backlog(qdisk, popped_data));
+  assert_dummy_record(popped_data, record_len);
+  cr_assert_eq(qdisk_get_write_syscalls(qdisk), 1);
+
+  cr_assert(reliable_pop_record_without_backlog(qdisk, popped_data));
+  assert_dummy_record(popped_data, record_len);
+  cr_assert_eq(qdisk_get_write_syscalls(qdisk), 1);
+  g_string_free(popped_data, TRUE);
+
+  qdisk_stop(qdisk, NULL, NULL, NULL);
+  cleanup_qdisk(filename, qdisk);
+}
+
+Test(qdisk, write_batch_is_written_when_it_reaches_its_size)
+{
+  const gchar *filename = "test_qdisk_write_batch_size.rqf";
+  QDisk *qdisk = create_qdisk(TDISKQ_RELIABLE, filename, MiB(1));
+  disk_queue_options_write_batch_bytes_set(qdisk_get_options(qdisk), 1024);
+  qdisk_start(qdisk, NULL, NULL, NULL);
+
+  /* 7 records fit into the batch, the 8th one starts a new one */
+  guint record_len = 128;
+  for (gint i = 0; i < 10; i++)
+    cr_assert(push_dummy_record(qdisk, record_len));
+  cr_assert_eq(qdisk_get_write_syscalls(qdisk), 1);
+  cr_assert_eq(qdisk_get_written_bytes(qdisk), 7 * (record_len + FRAME_LENGTH));
+
+  cr_assert(qdisk_stop(qdisk, NULL, NULL, NULL));
+  cr_assert_eq(qdisk_get_write_syscalls(qdisk), 2);
+  cr_assert_eq(qdisk_get_written_bytes(qdisk), 10 * (record_len + FRAME_LENGTH));
+
+  qdisk_start(qdisk, NULL, NULL, NULL);
+  cr_assert_eq(qdisk_get_length(qdisk), 10);
+  GString *popped_data = g_string_new(NULL);
+  for (gint i = 0; i < 10; i++)
+    {
+      cr_assert(reliable_pop_record_without_backlog(qdisk, popped_data));
+      assert_dummy_record(popped_data, record_len);
+    }
+  g_string_free(popped_data, TRUE);
+
+  qdisk_stop(qdisk, NULL, NULL, NULL);
+  cleanup_qdisk(filename, qdisk);
+}
+
+Test(qdisk, sync_interval_leaves_the_last_records_unsynced_until_synced)
+{
+  const gchar *filename = "test_qdisk_sync_interval.rqf";
+  QDisk *qdisk = create_qdisk(TDISKQ_RELIABLE, filename, MiB(1));
+  cr_assert(disk_queue_options_sync_policy_set(qdisk_get_options(qdisk), "interval"));
+  disk_queue_options_sync_interval_set(qdisk_get_options(qdisk), 3600 * 1000);
+  disk_queue_options_write_batch_bytes_set(qdisk_get_options(qdisk), 65536);
+  qdisk_start(qdisk, NULL, NULL, NULL);
+
+  /* the first flush is synced, the interval starts from there */
+  guint record_len = 128;
+  cr_assert(push_dummy_record(qdisk, record_len));
+  cr_assert(qdisk_flush(qdisk));
+  cr_assert_not(qdisk_needs_flush(qdisk));
+
+  cr_assert(push_dummy_record(qdisk, record_len));
+  cr_assert(qdisk_flush(qdisk));
+  cr_assert(qdisk_needs_flush(qdisk), "records within the sync-interval() should stay unsynced");
+  cr_assert_eq(_get_length_stored_in_header(filename), 2);
+
+  cr_assert(push_dummy_record(qdisk, record_len));
+  cr_assert(qdisk_sync(qdisk));
+  cr_assert_not(qdisk_needs_flush(qdisk));
+  cr_assert_eq(qdisk_get_write_syscalls(qdisk), 3);
+  cr_assert_eq(_get_length_stored_in_header(filename), 3);
+
+  qdisk_stop(qdisk, NULL, NULL, NULL);
+  cleanup_qdisk(filename, qdisk);
+}
+
+Test(qdisk, records_are_read_ahead_in_a_single_chunk)
+{
+  const gchar *filename = "test_qdisk_read_ahead.rqf";
+  QDisk *qdisk = create_qdisk(TDISKQ_RELIABLE, filename, MiB(1));
+  qdisk_start(qdisk, NULL, NULL, NULL);
+
+  guint record_len = 128;
+  for (gint i = 0; i < 100; i++)
+    cr_assert(push_dummy_record(qdisk, record_len));
+
+  GString *popped_data = g_string_new(NULL);
+  for (gint i = 0; i < 100; i++)
+    {
+      cr_assert(reliable_pop_record_without_backlog(qdisk, popped_data));
+      assert_dummy_record(popped_data, record_len);
+    }
+  g_string_free(popped_data, TRUE);
+  cr_assert_eq(qdisk_get_read_syscalls(qdisk), 1);
+
+  qdisk_stop(qdisk, NULL, NULL, NULL);
+  cleanup_qdisk(filename, qdisk);
+}
+
+Test(qdisk, records_written_after_reading_ahead_are_read_from_the_file)
+{
+  const gchar *filename = "test_qdisk_read_ahead_write.rqf";
+  QDisk *qdisk = create_qdisk(TDISKQ_RELIABLE, filename, MiB(1));
+  qdisk_start(qdisk, NULL, NULL, NULL);
+
+  GString *popped_data = g_string_new(NULL);
+  cr_assert(push_dummy_record(qdisk, 128));
+  cr_assert(push_dummy_record(qdisk, 128));
+  cr_assert(reliable_pop_record_without_backlog(qdisk, popped_data));
+  assert_dummy_record(popped_data, 128);
+
+  cr_assert(push_dummy_record(qdisk, 256));
+  cr_assert(reliable_pop_record_without_backlog(qdisk, popped_data));
+  assert_dummy_record(popped_data, 128);
+  cr_assert(reliable_pop_record_without_backlog(qdisk, popped_data));
+  assert_dummy_record(popped_data, 256);
+  cr_assert_eq(qdisk_get_read_syscalls(qdisk), 2);
+  g_string_free(popped_data, TRUE);
+
+  qdisk_stop(qdisk, NULL, NULL, NULL);
+  cleanup_qdisk(filename, qdisk);
+}
+
+static gboolean
+segment_exists(const gchar *filename, gint64 segment)
+{
+  gchar *segment_filename = g_strdup_printf("%s.%08" G_GINT64_FORMAT, filename, segment);
+  gboolean exists = access(segment_filename, F_OK) == 0;
+
+  g_free(segment_filename);
+  return exists;
+}
+
+static void
+cleanup_segments(const gchar *filename, gint64 number_of_segments)
+{
+  for (gint64 i = 0; i < number_of_segments; i++)
+    {
+      gchar *segment_filename = g_strdup_printf("%s.%08" G_GINT64_FORMAT, filename, i);
+      unlink(segment_filename);
+      g_free(segment_filename);
+    }
+}
+
+Test(qdisk, records_spanning_segments_are_read_back)
+{
+  const gchar *filename = "test_qdisk_segments.rqf";
+  QDisk *qdisk = create_qdisk(TDISKQ_RELIABLE, filename, MiB(1));
+  disk_queue_options_segment_size_set(qdisk_get_options(qdisk), MIN_SEGMENT_SIZE);
+  qdisk_start(qdisk, NULL, NULL, NULL);
+
+  guint record_len = 10000;
+  for (gint i = 0; i < 20; i++)
+    cr_assert(push_dummy_record(qdisk, record_len));
+
+  cr_assert(segment_exists(filename, 0));
+  cr_assert(segment_exists(filename, 3));
+  cr_assert_not(segment_exists(filename, 4));
+  cr_assert_eq(qdisk_get_used_useful_space(qdisk), 20 * (record_len + FRAME_LENGTH));
+
+  GString *popped_data = g_string_new(NULL);
+  for (gint i = 0; i < 20; i++)
+    {
+      cr_assert(qdisk_pop_head(qdisk, popped_data));
+      assert_dummy_record(popped_data, record_len);
+    }
+  g_string_free(popped_data, TRUE);
+
+  qdisk_stop(qdisk, NULL, NULL, NULL);
+  cleanup_segments(filename, 4);
+  cleanup_qdisk(filename, qdisk);
+}
+
+Test(qdisk, acknowledged_segments_are_deleted)
+{
+  const gchar *filename = "test_qdisk_segments_deleted.rqf";
+  QDisk *qdisk = create_qdisk(TDISKQ_RELIABLE, filename, MiB(1));
+  disk_queue_options_segment_size_set(qdisk_get_options(qdisk), MIN_SEGMENT_SIZE);
+  qdisk_start(qdisk, NULL, NULL, NULL);
+
+  guint record_len = 10000;
+  for (gint i = 0; i < 20; i++)
+    cr_assert(push_dummy_record(qdisk, record_len));
+
+  GString *popped_data = g_string_new(NULL);
+  for (gint i = 0; i < 20; i++)
+    cr_assert(qdisk_pop_head(qdisk, popped_data));
+  g_string_free(popped_data, TRUE);
+
+  for (gint i = 0; i < 10; i++)
+    cr_assert(qdisk_ack_backlog(qdisk));
+  cr_assert_not(segment_exists(filename, 0));
+  cr_assert(segment_exists(filename, 1));
+
+  for (gint i = 0; i < 10; i++)
+    cr_assert(qdisk_ack_backlog(qdisk));
+  cr_assert_not(segment_exists(filename, 2));
+  cr_assert(segment_exists(filename, 3));
+  cr_assert_eq(qdisk_get_used_useful_space(qdisk), 0);
+
+  qdisk_stop(qdisk, NULL, NULL, NULL);
+  cleanup_segments(filename, 4);
+  cleanup_qdisk(filename, qdisk);
+}
+
+Test(qdisk, capacity_of_segmented_qdisk_can_be_changed)
+{
+  const gchar *filename = "test_qdisk_segments_capacity.rqf";
+  QDisk *qdisk = create_qdisk(TDISKQ_RELIABLE, filename, MiB(1));
+  DiskQueueOptions *options = qdisk_get_options(qdisk);
+  disk_queue_options_segment_size_set(options, MIN_SEGMENT_SIZE);
+  qdisk_start(qdisk, NULL, NULL, NULL);
+
+  guint record_len = 10000;
+  while (push_dummy_record(qdisk, record_len))
+    ;
+  cr_assert(qdisk_stop(qdisk, NULL, NULL, NULL));
+
+  disk_queue_options_capacity_bytes_set(options, MiB(2));
+  qdisk_start(qdisk, NULL, NULL, NULL);
+  cr_assert_eq(qdisk_get_maximum_size(qdisk), MiB(2));
+  cr_assert(push_dummy_record(qdisk, record_len));
+
+  qdisk_stop(qdisk, NULL, NULL, NULL);
+  cleanup_segments(filename, MiB(1) / MIN_SEGMENT_SIZE + 1);
+  cleanup_qdisk(filename, qdisk);
+}
+
+/* QDisk-internal: the version follows the 4-byte magic in the header */
+static guint8
+_read_header_version(const gchar *filename)
+{
+  guint8 header[5];
+  FILE *f = fopen(filename, "rb");
+
+  cr_assert_not_null(f);
+  cr_assert_eq(fread(header, 1, sizeof(header), f), sizeof(header));
+  fclose(f);
+  return header[4];
+}
+
+Test(qdisk, files_without_compression_keep_the_old_header_version)
+{
+  const gchar *filename = "test_qdisk_no_compression_version.rqf";
+  QDisk *qdisk = create_qdisk(TDISKQ_RELIABLE, filename, MiB(1));
+  cr_assert(disk_queue_options_compression_set(qdisk_get_options(qdisk), "none"));
+  qdisk_start(qdisk, NULL, NULL, NULL);
+  cr_assert(push_dummy_record(qdisk, 128));
+  cr_assert(qdisk_stop(qdisk, NULL, NULL, NULL));
+
+  cr_assert_eq(_read_header_version(filename), 3);
+  cleanup_qdisk(filename, qdisk);
+}
+
+Test(qdisk, segmented_files_get_a_new_header_version_and_their_segments_are_listed)
+{
+  const gchar *filename = "test_qdisk_segments_version.rqf";
+  QDisk *qdisk = create_qdisk(TDISKQ_RELIABLE, filename, MiB(1));
+  disk_queue_options_segment_size_set(qdisk_get_options(qdisk), MIN_SEGMENT_SIZE);
+  qdisk_start(qdisk, NULL, NULL, NULL);
+
+  for (gint i = 0; i < 20; i++)
+    cr_assert(push_dummy_record(qdisk, 10000));
+  cr_assert(qdisk_stop(qdisk, NULL, NULL, NULL));
+  cr_assert_eq(_read_header_version(filename), 6);
+
+  GList *segment_filenames = qdisk_get_segment_filenames(filename);
+  cr_assert_eq(g_list_length(segment_filenames), 4);
+  cr_assert_str_eq(segment_filenames->data, "test_qdisk_segments_version.rqf.00000000");
+  cr_assert_str_eq(g_list_nth_data(segment_filenames, 3), "test_qdisk_segments_version.rqf.00000003");
+  g_list_free_full(segment_filenames, g_free);
+
+  cleanup_segments(filename, 4);
+  cleanup_qdisk(filename, qdisk);
+}
+
+Test(qdisk, files_of_newer_versions_are_rejected_and_left_alone)
+{
+  const gchar *filename = "test_qdisk_newer_version.rqf";
+  QDisk *qdisk = create_qdisk(TDISKQ_RELIABLE, filename, MiB(1));
+  qdisk_start(qdisk, NULL, NULL, NULL);
+  cr_assert(push_dummy_record(qdisk, 128));
+  cr_assert(qdisk_stop(qdisk, NULL, NULL, NULL));
+
+  guint8 newer_version = 100;
+  FILE *f = fopen(filename, "r+b");
+  cr_assert_not_null(f);
+  cr_assert_eq(fseek(f, 4, SEEK_SET), 0);
+  cr_assert_eq(fwrite(&newer_version, 1, 1, f), 1);
+  fclose(f);
+
+  cr_assert_not(qdisk_start(qdisk, NULL, NULL, NULL));
+  cr_assert_eq(_read_header_version(filename), newer_version);
+
+  cleanup_qdisk(filename, qdisk);
+}
+
+#if SYSLOG_NG_HAVE_ZSTD
+
+Test(qdisk, compressed_records_are_smaller_and_read_back_unchanged)
+{
+  const gchar *filename = "test_qdisk_compression.rqf";
+  QDisk *qdisk = create_qdisk(TDISKQ_RELIABLE, filename, MiB(1));
+  cr_assert(disk_queue_options_compression_set(qdisk_get_options(qdisk), "zstd"));
+  qdisk_start(qdisk, NULL, NULL, NULL);
+
+  guint record_len = 4096;
+  for (gint i = 0; i < 10; i++)
+    cr_assert(push_dummy_record(qdisk, record_len));
+  cr_assert_lt(qdisk_get_written_bytes(qdisk), 10 * record_len / 10);
+
+  GString *popped_data = g_string_new(NULL);
+  for (gint i = 0; i < 10; i++)
+    {
+      cr_assert(reliable_pop_record_without_backlog(qdisk, popped_data));
+      assert_dummy_record(popped_data, record_len);
+    }
+  g_string_free(popped_data, TRUE);
+
+  qdisk_stop(qdisk, NULL, NULL, NULL);
+  cleanup_qdisk(filename, qdisk);
+}
+
+Test(qdisk, compressed_records_can_be_read_with_compression_disabled)
+{
+  const gchar *filename = "test_qdisk_compression_disabled.rqf";
+  QDisk *qdisk = create_qdisk(TDISKQ_RELIABLE, filename, MiB(1));
+  DiskQueueOptions *options = qdisk_get_options(qdisk);
+  cr_assert(disk_queue_options_compression_set(options, "zstd"));
+  qdisk_start(qdisk, NULL, NULL, NULL);
+
+  guint record_len = 4096;
+  cr_assert(push_dummy_record(qdisk, record_len));
+  cr_assert(qdisk_stop(qdisk, NULL, NULL, NULL));
+  cr_assert_eq(_read_header_version(filename), 5);
+
+  cr_assert(disk_queue_options_compression_set(options, "none"));
+  qdisk_start(qdisk, NULL, NULL, NULL);
+  cr_assert(push_dummy_record(qdisk, record_len));
+  cr_assert_eq(qdisk_get_length(qdisk), 2);
+
+  /* the file still contains compressed records */
+  cr_assert_eq(_read_header_version(filename), 5);
+
+  GString *popped_data = g_string_new(NULL);
+  for (gint i = 0; i < 2; i++)
+    {
+      cr_assert(reliable_pop_record_without_backlog(qdisk, popped_data));
+      assert_dummy_record(popped_data, record_len);
+    }
+  g_string_free(popped_data, TRUE);
+
+  qdisk_stop(qdisk, NULL, NULL, NULL);
+  cleanup_qdisk(filename, qdisk);
+}
+
+#define DICTIONARY_SAMPLES 2000
+
+static gchar *
+_format_log_line(gint i)
+{
+  return g_strdup_printf("<13>1 2026-10-17T10:%02d:%02dZ host%d sshd %d - - Accepted publickey for user%d from "
+                         "10.0.0.%d port %d", i / 60 % 60, i % 60, i % 8, 1000 + i, i % 16, i % 256, 40000 + i);
+}
+
+static void
+_train_compression_dictionary(const gchar *dictionary_filename)
+{
+  GString *samples = g_string_new(NULL);
+  size_t sample_sizes[DICTIONARY_SAMPLES];
+  for (gint i = 0; i < DICTIONARY_SAMPLES; i++)
+    {
+      gchar *line = _format_log_line(i);
+      g_string_append(samples, line);
+      sample_sizes[i] = strlen(line);
+      g_free(line);
+    }
+
+  gchar dictionary[4096];
+  size_t dictionary_len = ZDICT_trainFromBuffer(dictionary, sizeof(dictionary), samples->str, sample_sizes,
+                                                DICTIONARY_SAMPLES);
+  cr_assert_not(ZDICT_isError(dictionary_len), "Error training dictionary: %s", ZDICT_getErrorName(dictionary_len));
+  cr_assert(g_file_set_contents(dictionary_filename, dictionary, dictionary_len, NULL));
+  g_string_free(samples, TRUE);
+}
+
+static gboolean
+_generate_log_line_payload(SerializeArchive *sa, gpointer user_data)
+{
+  const gchar *line = (const gchar *) user_data;
+
+  serialize_archive_write_bytes(sa, line, strlen(line));
+  return TRUE;
+}
+
+static gboolean
+_push_log_line(QDisk *qdisk, gint i)
+{
+  GString *data = g_string_new(NULL);
+  gchar *line = _format_log_line(i);
+  qdisk_serialize(data, _generate_log_line_payload, line, NULL);
+  gboolean success = qdisk_push_tail(qdisk, data);
+  g_free(line);
+  g_string_free(data, TRUE);
+
+  return success;
+}
+
+Test(qdisk, records_compressed_with_a_dictionary_are_read_back_unchanged)
+{
+  const gchar *filename = "test_qdisk_compression_dictionary.rqf";
+  const gchar *dictionary_filename = "test_qdisk_compression_dictionary.zdict";
+  _train_compression_dictionary(dictionary_filename);
+
+  QDisk *qdisk = create_qdisk(TDISKQ_RELIABLE, filename, MiB(1));
+  cr_assert(disk_queue_options_compression_set(qdisk_get_options(qdisk), "zstd"));
+  disk_queue_options_compression_dictionary_set(qdisk_get_options(qdisk), dictionary_filename);
+  cr_assert(qdisk_start(qdisk, NULL, NULL, NULL));
+
+  /* log lines are too short to be compressed on their own */
+  for (gint i = 0; i < 100; i++)
+    cr_assert(_push_log_line(qdisk, i));
+  cr_assert_lt(qdisk_get_compressed_bytes(qdisk), qdisk_get_uncompressed_bytes(qdisk) / 2);
+
+  cr_assert(qdisk_stop(qdisk, NULL, NULL, NULL));
+  cr_assert_eq(_read_header_version(filename), 7);
+
+  cr_assert(qdisk_start(qdisk, NULL, NULL, NULL));
+  GString *popped_data = g_string_new(NULL);
+  for (gint i = 0; i < 100; i++)
+    {
+      gchar *line = _format_log_line(i);
+      cr_assert(reliable_pop_record_without_backlog(qdisk, popped_data));
+      cr_assert_str_eq(popped_data->str, line);
+      g_free(line);
+    }
+  g_string_free(popped_data, TRUE);
+
+  qdisk_stop(qdisk, NULL, NULL, NULL);
+  cleanup_qdisk(filename, qdisk);
+  unlink(dictionary_filename);
+}
+
+Test(qdisk, files_compressed_with_a_dictionary_are_not_loaded_without_it)
+{
+  const gchar *filename = "test_qdisk_compression_dictionary_missing.rqf";
+  const gchar *dictionary_filename = "test_qdisk_compression_dictionary_missing.zdict";
+  _train_compression_dictionary(dictionary_filename);
+
+  QDisk *qdisk = create_qdisk(TDISKQ_RELIABLE, filename, MiB(1));
+  cr_assert(disk_queue_options_compression_set(qdisk_get_options(qdisk), "zstd"));
+  disk_queue_options_compression_dictionary_set(qdisk_get_options(qdisk), dictionary_filename);
+  cr_assert(qdisk_start(qdisk, NULL, NULL, NULL));
+  cr_assert(_push_log_line(qdisk, 0));
+  cr_assert(qdisk_stop(qdisk, NULL, NULL, NULL));
+
+  QDisk *without_dictionary = create_qdisk(TDISKQ_RELIABLE, filename, MiB(1));
+  cr_assert(disk_queue_options_compression_set(qdisk_get_options(without_dictionary), "zstd"));
+  cr_assert_not(qdisk_start(without_dictionary, NULL, NULL, NULL));
+  DiskQueueOptions *opts = qdisk_get_options(without_dictionary);
+  qdisk_free(without_dictionary);
+  disk_queue_options_destroy(opts);
+  g_free(opts);
+
+  cleanup_qdisk(filename, qdisk);
+  unlink(dictionary_filename);
+}
+
+#endif
+
 static void
 setup(void)
 {
@@ -125,7 +125,7 @@ _prepare_eof_test(LogQueueDiskReliable *dq, LogMessage **msg1, LogMessage **msg2
   (*msg2)->ack_func = _dummy_ack;
   log_msg_add_ack(*msg2, &local_path_options);
 
-  dq->super.qdisk->hdr->write_head = start_pos;
+  dq->super.qdisk->write_head = start_pos;
   dq->super.qdisk->hdr->read_head = QDISK_RESERVED_SPACE + mark_message_serialized_size + 1;
   dq->super.qdisk->hdr->backlog_head = dq->super.qdisk->hdr->read_head;
 
@@ -134,7 +134,7 @@ _prepare_eof_test(LogQueueDiskReliable *dq, LogMessage **msg1, LogMessage **msg2
 
   cr_assert_eq(dq->flow_control_window->length, NUMBER_MESSAGES_IN_QUEUE(2), "%s",
                "Messages aren't in flow_control_window");
-  cr_assert_eq(dq->super.qdisk->hdr->write_head, QDISK_RESERVED_SPACE + mark_message_serialized_size,
+  cr_assert_eq(dq->super.qdisk->write_head, QDISK_RESERVED_SPACE + mark_message_serialized_size,
                "%s", "Bad write head");
   cr_assert_eq(num_of_ack, 0, "%s", "Messages are acked");
 
@@ -156,7 +156,7 @@ test_read_over_eof(LogQueueDiskReliable *dq, LogMessage *msg1, LogMessage *msg2)
   cr_assert_not_null(read_message2, "%s", "Can't read message from queue");
   cr_assert_eq(dq->flow_control_window->length, 0, "%s", "Queue reliable isn't empty");
   cr_assert_eq(dq->backlog->length, NUMBER_MESSAGES_IN_QUEUE(2), "%s", "Messages aren't in the backlog");
-  cr_assert_eq(dq->super.qdisk->hdr->read_head, dq->super.qdisk->hdr->write_head,
+  cr_assert_eq(dq->super.qdisk->hdr->read_head, dq->super.qdisk->write_head,
                "%s", "Read head in bad position");
   cr_assert_eq(msg1, read_message1, "%s", "Message 1 isn't read from flow_control_window");
   cr_assert_eq(msg2, read_message2, "%s", "Message 2 isn't read from flow_control_window");
@@ -175,7 +175,7 @@ test_rewind_over_eof(LogQueueDiskReliable *dq)
   gint64 previous_read_head = dq->super.qdisk->hdr->read_head;
   read_message3 = log_queue_pop_head(&dq->super.super, &local_path_options);
   cr_assert_not_null(read_message3, "%s", "Can't read message from queue");
-  cr_assert_eq(dq->super.qdisk->hdr->read_head, dq->super.qdisk->hdr->write_head,
+  cr_assert_eq(dq->super.qdisk->hdr->read_head, dq->super.qdisk->write_head,
                "%s", "Read head in bad position");
 
   cr_assert_eq(msg3, read_message3, "%s", "Message 3 isn't read from flow_control_window");
@@ -187,7 +187,7 @@ test_rewind_over_eof(LogQueueDiskReliable *dq)
 
   read_message3 = log_queue_pop_head(&dq->super.super, &local_path_options);
   cr_assert_not_null(read_message3, "%s", "Can't read message from queue");
-  cr_assert_eq(dq->super.qdisk->hdr->read_head, dq->super.qdisk->hdr->write_head,
+  cr_assert_eq(dq->super.qdisk->hdr->read_head, dq->super.qdisk->write_head,
                "%s", "Read head in bad position");
   cr_assert_eq(msg3, read_message3, "%s", "Message 3 isn't read from flow_control_window");
 
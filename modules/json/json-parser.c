@@ -107,6 +107,51 @@ json_parser_process_object(JSONParser *self,
                            const gchar *prefix,
                            LogMessage *msg);
 
+/* numbers and booleans are stored in binary form, they are only formatted
+ * as strings if someone asks for that */
+static gboolean
+json_parser_extract_native_value_from_simple_json_object(JSONParser *self,
+                                                         struct json_object *jso,
+                                                         const gchar *prefix, const gchar *obj_key,
+                                                         LogMessage *msg)
+{
+  NVNativeValue value;
+  LogMessageValueType type;
+
+  switch (json_object_get_type(jso))
+    {
+    case json_type_boolean:
+      value.kind = NVN_BOOLEAN;
+      value.i64 = !!json_object_get_boolean(jso);
+      type = LM_VT_BOOLEAN;
+      break;
+    case json_type_double:
+      value.kind = NVN_DOUBLE;
+      value.d = json_object_get_double(jso);
+      type = LM_VT_DOUBLE;
+      break;
+    case json_type_int:
+      value.kind = NVN_INT64;
+      value.i64 = json_object_get_int64(jso);
+      type = LM_VT_INTEGER;
+      break;
+    default:
+      return FALSE;
+    }
+
+  if (prefix)
+    {
+      GString *key = scratch_buffers_alloc();
+
+      g_string_assign(key, prefix);
+      g_string_append(key, obj_key);
+      log_msg_set_value_native(msg, log_msg_get_value_handle(key->str), &value, type);
+    }
+  else
+    log_msg_set_value_native(msg, log_msg_get_value_handle(obj_key), &value, type);
+  return TRUE;
+}
+
 
 static gboolean
 json_parser_extract_string_from_simple_json_object(JSONParser *self,
@@ -241,7 +286,8 @@ json_parser_process_attribute(JSONParser *self,
   ScratchBuffersMarker marker;
   scratch_buffers_mark(&marker);
 
-  if (!json_parser_extract_value_from_simple_json_object(self, jso, prefix, obj_key, msg) &&
+  if (!json_parser_extract_native_value_from_simple_json_object(self, jso, prefix, obj_key, msg) &&
+      !json_parser_extract_value_from_simple_json_object(self, jso, prefix, obj_key, msg) &&
       !json_parser_extract_values_from_complex_json_object(self, jso, prefix, obj_key, msg))
     {
       msg_debug("JSON parser encountered an unknown type, skipping",
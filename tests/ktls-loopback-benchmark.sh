@@ -0,0 +1,92 @@
+#!/bin/sh
+#############################################################################
+# Copyright (c) 2026 Axoflow
+#
+# This program is free software; you can redistribute it and/or modify it
+# under the terms of the GNU General Public License version 2 as published
+# by the Free Software Foundation, or (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software
+# Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+#
+# As an additional exemption you are allowed to compile & link against the
+# OpenSSL libraries as published by the OpenSSL project. See the file
+# COPYING for details.
+#
+#############################################################################
+#
+# Compares the throughput and CPU usage of a TLS network() source with
+# tls(ktls(no)) and tls(ktls(yes)) over the loopback interface.
+#
+# usage: ktls-loopback-benchmark.sh [seconds] [connections] [message-size]
+#
+# SYSLOG_NG, LOGGEN and PORT can be set in the environment to override the
+# binaries and the TCP port used.  Kernel TLS requires the "tls" kernel
+# module to be loaded (modprobe tls), otherwise OpenSSL silently falls back
+# to userspace TLS and both runs should produce similar numbers.
+#
+
+set -e
+
+DURATION=${1:-10}
+CONNECTIONS=${2:-4}
+MSG_SIZE=${3:-256}
+SYSLOG_NG=${SYSLOG_NG:-syslog-ng}
+LOGGEN=${LOGGEN:-loggen}
+PORT=${PORT:-16514}
+HZ=`getconf CLK_TCK`
+
+WORKDIR=`mktemp -d`
+trap 'rm -rf "$WORKDIR"' EXIT
+
+openssl req -x509 -newkey rsa:2048 -nodes -days 1 -subj "/CN=localhost" \
+  -keyout "$WORKDIR/server.key" -out "$WORKDIR/server.crt" >/dev/null 2>&1
+
+cpu_ticks()
+{
+  # utime + stime, see proc(5)
+  awk '{ print $14 + $15 }' /proc/$1/stat
+}
+
+run_benchmark()
+{
+  ktls=$1
+  conf="$WORKDIR/syslog-ng-ktls-$ktls.conf"
+
+  cat >"$conf" <<EOF
+@version: current
+options { stats(level(0)); };
+source s_tls {
+  network(ip("127.0.0.1") port($PORT) transport(tls) max-connections($CONNECTIONS)
+    tls(key-file("$WORKDIR/server.key") cert-file("$WORKDIR/server.crt")
+        peer-verify(optional-untrusted) ktls($ktls)));
+};
+destination d_null { file("/dev/null"); };
+log { source(s_tls); destination(d_null); };
+EOF
+
+  "$SYSLOG_NG" -F -f "$conf" -R "$WORKDIR/persist" -c "$WORKDIR/ctl" -p "$WORKDIR/pid" &
+  pid=$!
+  sleep 2
+
+  before=`cpu_ticks $pid`
+  rate=`"$LOGGEN" --use-ssl --inet --stream --active-connections "$CONNECTIONS" --interval "$DURATION" \
+          --size "$MSG_SIZE" 127.0.0.1 "$PORT" 2>&1 | sed -n 's/.*average rate = \([0-9.]*\).*/\1/p' | tail -n 1`
+  after=`cpu_ticks $pid`
+
+  kill $pid
+  wait $pid || true
+
+  cpu=`echo "$before $after $DURATION $HZ" | awk '{ printf "%.1f", ($2 - $1) * 100 / $4 / $3 }'`
+  printf "ktls(%-3s)  %12s msg/sec  %6s%% CPU\n" "$ktls" "$rate" "$cpu"
+}
+
+echo "Running $DURATION second(s) with $CONNECTIONS connection(s), $MSG_SIZE byte messages"
+run_benchmark no
+run_benchmark yes